@@ -11,6 +11,7 @@
 #include "env.hpp"
 
 #include <string>
+#include <cstdlib>
 
 namespace orcus {
 
@@ -28,6 +29,22 @@ struct ORCUS_DLLPUBLIC config
      */
     bool structure_check;
 
+    /**
+     * Maximum number of threads a filter may use to parse its input, for
+     * filters that support parallel parsing.  When the value is 1, the
+     * input is parsed on the calling thread.  When it's 0, the number of
+     * hardware threads is used.
+     */
+    size_t thread_count;
+
+    /**
+     * Number of rows a filter buffers before it stores them one column at a
+     * time, for filters that support batched import.  Columns of numbers
+     * are then converted and passed to the sheet in bulk.  When the value
+     * is 0, each cell is passed to the sheet as it is parsed.
+     */
+    size_t batch_row_count;
+
     config();
 };
 
@@ -67,7 +84,8 @@ struct ORCUS_DLLPUBLIC json_config
      * Control whether or not to preserve the order of object's child
      * name/value pairs.  By definition, JSON's object is an unordered set of
      * name/value pairs, but in some cases preserving the original order may
-     * be desirable.
+     * be desirable.  json_document_tree always preserves the original
+     * order regardless of this setting.
      */
     bool preserve_object_order;
 
@@ -88,6 +106,34 @@ struct ORCUS_DLLPUBLIC json_config
      */
     bool persistent_string_values;
 
+    /**
+     * When true, the stream is parsed in the JSON Lines format, where each
+     * line contains one JSON document.  json_document_tree stores the
+     * documents as the elements of its root array, in their original order.
+     */
+    bool lines;
+
+    /**
+     * Maximum number of threads to use when parsing a stream in the JSON
+     * Lines format.  When the value is 1, the stream is parsed on the
+     * calling thread.  When it's 0, the number of hardware threads is used.
+     */
+    size_t thread_count;
+
+    /**
+     * When true, json_document_tree only indexes the structure of the
+     * stream during load, and creates the child nodes of each array and
+     * object when they are first accessed.  Syntax errors inside arrays and
+     * objects are then reported on that access instead of during load.
+     * String values point to the original stream, which the caller must
+     * keep alive for the entire life cycle of the document tree,
+     * regardless of persistent_string_values.  This option is not used for
+     * JSON Lines streams, and references to external files are not
+     * resolved.  Streams of 4 GiB or larger cannot be loaded lazily, and
+     * cause a json_document_error to be thrown.
+     */
+    bool lazy;
+
     json_config();
     ~json_config();
 };
@@ -42,6 +42,15 @@ public:
      */
     void load(const std::string& strm);
 
+    /**
+     * Load raw string stream containing CSS rules to populate the document
+     * tree.
+     *
+     * @param p pointer to the stream containing raw CSS rules.
+     * @param n size of the stream.
+     */
+    void load(const char* p, size_t n);
+
     /**
      * Insert or replace properties for given selector and pseudo element
      * flags.
@@ -21,6 +21,17 @@ public:
     csv_parser(const char* p, size_t n, handler_type& hdl, const csv::parser_config& config);
     void parse();
 
+    /**
+     * Parse rows until reaching the first row that begins at or past the
+     * specified offset.  The last row parsed may extend past the offset.
+     *
+     * @param stop offset from the beginning of the stream.
+     *
+     * @return offset at which parsing stopped, which is either the
+     *         beginning of a row or the end of the stream.
+     */
+    size_t parse_rows(size_t stop);
+
 private:
 
     // handlers
@@ -28,7 +39,14 @@ private:
     void cell();
     void quoted_cell();
 
-    void parse_cell_with_quote(const char* p0, size_t len0);
+    /**
+     * Push a quoted cell value that contains escaped quotes, after
+     * unescaping them.
+     *
+     * @param p0 first character after the opening quote.
+     * @param p_close position of the closing quote.
+     */
+    void parse_cell_with_quote(const char* p0, const char* p_close);
 
     /**
      * Push cell value to the handler.
@@ -60,13 +78,23 @@ void csv_parser<_Handler>::parse()
     m_handler.end_parse();
 }
 
+template<typename _Handler>
+size_t csv_parser<_Handler>::parse_rows(size_t stop)
+{
+    m_handler.begin_parse();
+    while (has_char() && static_cast<size_t>(mp_char - mp_begin) < stop)
+        row();
+    m_handler.end_parse();
+    return mp_char - mp_begin;
+}
+
 template<typename _Handler>
 void csv_parser<_Handler>::row()
 {
     m_handler.begin_row();
     while (true)
     {
-        if (is_text_qualifier(cur_char()))
+        if (has_char() && is_text_qualifier(cur_char()))
             quoted_cell();
         else
             cell();
@@ -88,7 +116,9 @@ void csv_parser<_Handler>::row()
             return;
         }
 
-        assert(is_delim(c));
+        // Skip the delimiter.  In malformed input, a closing quote may be
+        // followed by something else, which gets skipped as well.  This also
+        // happens when parsing starts at a guessed row boundary.
         next();
 
         if (m_config.trim_cell_value)
@@ -100,16 +130,9 @@ template<typename _Handler>
 void csv_parser<_Handler>::cell()
 {
     const char* p = mp_char;
-    size_t len = 0;
-    char c = cur_char();
-    while (c != '\n' && !is_delim(c))
-    {
-        ++len;
-        next();
-        if (!has_char())
-            break;
-        c = cur_char();
-    }
+    const char* p_end = m_scanner.find_cell_end(p);
+    size_t len = p_end - p;
+    next(len);
 
     if (!len)
         p = NULL;
@@ -123,95 +146,70 @@ void csv_parser<_Handler>::quoted_cell()
 #if ORCUS_DEBUG_CSV
     cout << "--- quoted cell" << endl;
 #endif
-    char c = cur_char();
-    assert(is_text_qualifier(c));
+    assert(is_text_qualifier(cur_char()));
+    bool escaped = false;
+    const char* p_close = m_scanner.find_closing_quote(mp_char, escaped);
     next(); // Skip the opening quote.
     if (!has_char())
         return;
 
     const char* p0 = mp_char;
-    size_t len = 1;
-    for (; has_char(); next(), ++len)
+    if (p_close == mp_end)
     {
-        c = cur_char();
-#if ORCUS_DEBUG_CSV
-        cout << "'" << c << "'" << endl;
-#endif
-        if (!is_text_qualifier(c))
-            continue;
+        if (escaped)
+            throw csv::parse_error("stream ended prematurely while parsing quoted cell.");
 
-        // current char is a quote. Check if the next char is also a text
-        // qualifier.
-
-        if (has_next() && is_text_qualifier(next_char()))
-        {
-            next();
-            parse_cell_with_quote(p0, len);
-            return;
-        }
+        // Stream ended prematurely.  Handle it gracefully.
+        m_handler.cell(p0, mp_end - p0);
+        mp_char = mp_end;
+        return;
+    }
 
-        // Closing quote.
-        m_handler.cell(p0, len-1);
-        next();
-        skip_blanks();
+    if (escaped)
+    {
+        parse_cell_with_quote(p0, p_close);
         return;
     }
 
-    // Stream ended prematurely.  Handle it gracefully.
-    m_handler.cell(p0, len);
-    next();
+    m_handler.cell(p0, p_close - p0);
+    mp_char = p_close;
+    next(); // Skip the closing quote.
     skip_blanks();
 }
 
 template<typename _Handler>
-void csv_parser<_Handler>::parse_cell_with_quote(const char* p0, size_t len0)
+void csv_parser<_Handler>::parse_cell_with_quote(const char* p0, const char* p_close)
 {
 #if ORCUS_DEBUG_CSV
     using namespace std;
     cout << "--- parse cell with quote" << endl;
 #endif
-    assert(is_text_qualifier(cur_char()));
+    assert(is_text_qualifier(*p_close));
 
-    // Push the preceding chars to the temp buffer.
+    // Every quote before the closing one is the first of a double
+    // quotation.  Copy each segment up to and including it to the cell
+    // buffer, and skip the second one.
     m_cell_buf.reset();
-    m_cell_buf.append(p0, len0);
-
-    // Parse the rest, until the closing quote.
-    next();
-    const char* p_cur = mp_char;
-    size_t cur_len = 0;
-    for (; has_char(); next(), ++cur_len)
+    const char* p = p0;
+    while (p != p_close)
     {
-        char c = cur_char();
-#if ORCUS_DEBUG_CSV
-        cout << "'" << c << "'" << endl;
-#endif
-        if (!is_text_qualifier(c))
-            continue;
+        const char* p_quote = static_cast<const char*>(
+            std::memchr(p, m_config.text_qualifier, p_close - p));
 
-        if (has_next() && is_text_qualifier(next_char()))
+        if (!p_quote)
         {
-            // double quotation.  Copy the current segment to the cell buffer.
-            m_cell_buf.append(p_cur, cur_len);
-
-            next(); // to the 2nd quote.
-            p_cur = mp_char;
-            cur_len = 0;
-            continue;
+            m_cell_buf.append(p, p_close - p);
+            break;
         }
 
-        // closing quote.  Flush the current segment to the cell
-        // buffer, push the value to the handler, and exit normally.
-        m_cell_buf.append(p_cur, cur_len);
-
-        m_handler.cell(m_cell_buf.get(), m_cell_buf.size());
-        next();
-        skip_blanks();
-        return;
+        m_cell_buf.append(p, p_quote - p + 1);
+        p = p_quote + 2;
     }
 
-    // Stream ended prematurely.
-    throw csv::parse_error("stream ended prematurely while parsing quoted cell.");
+    m_handler.cell(m_cell_buf.get(), m_cell_buf.size());
+    mp_char = p_close;
+    next(); // Skip the closing quote.
+    skip_blanks();
 }
 
 template<typename _Handler>
@@ -13,6 +13,7 @@
 #include "parser_global.hpp"
 #include "parser_base.hpp"
 
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <exception>
@@ -48,11 +49,83 @@ public:
     virtual const char* what() const throw();
 };
 
+/**
+ * Locates the structural characters of a csv stream, i.e. delimiters, text
+ * qualifiers and linefeeds.  The stream is classified one 64-byte block at
+ * a time into bitmasks, using SIMD compares where available, so that the
+ * parser can jump from one structural character to the next instead of
+ * testing every byte.
+ */
+class ORCUS_PSR_DLLPUBLIC block_scanner
+{
+    const char* mp_begin;
+    const char* mp_end;
+    const char* mp_block; /// beginning of the currently classified block.
+
+    uint64_t m_ends;   /// delimiters and linefeeds in the current block.
+    uint64_t m_quotes; /// text qualifiers in the current block.
+
+    std::string m_delimiters;
+    char m_text_qualifier;
+    unsigned char m_char_types[256];
+
+    /**
+     * Classify the block containing the specified position, unless it's
+     * already the current one.
+     *
+     * @return offset of the position within the block.
+     */
+    size_t load_block(const char* p);
+
+    void classify_tail(const char* p, size_t n);
+
+public:
+    block_scanner(const char* p, size_t n, const parser_config& config);
+
+    /**
+     * Find the end of a cell value that is not quoted.
+     *
+     * @param p position to start the search from.
+     *
+     * @return position of the first delimiter or linefeed at or after the
+     *         specified position, or the end of the stream if there is
+     *         none.
+     */
+    const char* find_cell_end(const char* p);
+
+    /**
+     * Find the quote that closes a quoted cell value.  A pair of
+     * consecutive quotes inside the value is an escaped quote.
+     *
+     * @param p position of the opening quote.
+     * @param escaped set to true if the value contains escaped quotes.
+     *
+     * @return position of the closing quote, or the end of the stream if
+     *         the value is not closed.
+     */
+    const char* find_closing_quote(const char* p, bool& escaped);
+};
+
+/**
+ * Find the end of the last complete row in a stream, following the same
+ * rules as the parser.  A row is complete when it ends with a linefeed
+ * that is not inside a quoted cell value.
+ *
+ * @param p pointer to the beginning of a row.
+ * @param n length of the stream.
+ * @param config parser configuration.
+ *
+ * @return offset just past the linefeed that ends the last complete row,
+ *         or 0 if the stream contains no complete row.
+ */
+ORCUS_PSR_DLLPUBLIC size_t find_last_row_end(const char* p, size_t n, const parser_config& config);
+
 class ORCUS_PSR_DLLPUBLIC parser_base : public ::orcus::parser_base
 {
 protected:
     const csv::parser_config& m_config;
     cell_buffer m_cell_buf;
+    block_scanner m_scanner;
 
 protected:
     parser_base(const char* p, size_t n, const parser_config& config);
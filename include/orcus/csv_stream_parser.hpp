@@ -0,0 +1,146 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef ORCUS_CSV_STREAM_PARSER_HPP
+#define ORCUS_CSV_STREAM_PARSER_HPP
+
+#include "csv_parser.hpp"
+#include "exception.hpp"
+
+#include <istream>
+#include <vector>
+
+namespace orcus {
+
+/**
+ * Parses csv content from an input stream through a window of fixed size,
+ * so that the memory used does not depend on the size of the stream.  Each
+ * time the window is filled, the complete rows in it are parsed, and the
+ * remainder is moved to the front of the window before reading more.
+ *
+ * Cell values passed to the handler point into the window, and are only
+ * valid until the handler returns.  A row that does not fit in the window
+ * grows the window to the size of the row.
+ */
+template<typename _Handler>
+class csv_stream_parser
+{
+public:
+    typedef _Handler handler_type;
+
+    /**
+     * @param is input stream to read from.
+     * @param hdl handler that receives the parsed rows.
+     * @param config parser configuration.
+     * @param window_size initial size of the window in bytes.
+     */
+    csv_stream_parser(
+        std::istream& is, handler_type& hdl, const csv::parser_config& config,
+        size_t window_size = 1024*1024);
+
+    void parse();
+
+private:
+
+    /**
+     * Forwards the rows of each window to the handler.  The parse as a
+     * whole begins and ends only once.
+     */
+    class window_handler
+    {
+        handler_type& m_handler;
+    public:
+        window_handler(handler_type& hdl) : m_handler(hdl) {}
+
+        void begin_parse() {}
+        void end_parse() {}
+        void begin_row() { m_handler.begin_row(); }
+        void end_row() { m_handler.end_row(); }
+        void cell(const char* p, size_t n) { m_handler.cell(p, n); }
+    };
+
+    /**
+     * Fill the unused part of the window from the stream.
+     *
+     * @return false if the end of the stream has been reached.
+     */
+    bool fill();
+
+    void parse_window(size_t n);
+
+private:
+    std::istream& m_stream;
+    handler_type& m_handler;
+    const csv::parser_config& m_config;
+    std::vector<char> m_window;
+    size_t m_size; /// number of bytes in the window.
+};
+
+template<typename _Handler>
+csv_stream_parser<_Handler>::csv_stream_parser(
+    std::istream& is, handler_type& hdl, const csv::parser_config& config, size_t window_size) :
+    m_stream(is), m_handler(hdl), m_config(config), m_window(window_size ? window_size : 1), m_size(0) {}
+
+template<typename _Handler>
+void csv_stream_parser<_Handler>::parse()
+{
+    m_handler.begin_parse();
+
+    while (fill())
+    {
+        size_t n = csv::find_last_row_end(m_window.data(), m_size, m_config);
+        if (!n)
+        {
+            // The window doesn't hold a complete row.
+            if (m_size == m_window.size())
+                m_window.resize(m_window.size() * 2);
+            continue;
+        }
+
+        parse_window(n);
+
+        // Move the incomplete row to the front.
+        m_size -= n;
+        std::memmove(m_window.data(), m_window.data() + n, m_size);
+    }
+
+    // The rest of the stream is parsed as it is, including the last row
+    // without a linefeed.
+    parse_window(m_size);
+    m_size = 0;
+
+    m_handler.end_parse();
+}
+
+template<typename _Handler>
+bool csv_stream_parser<_Handler>::fill()
+{
+    size_t n = m_window.size() - m_size;
+    m_stream.read(m_window.data() + m_size, n);
+    if (m_stream.bad())
+        throw general_error("csv_stream_parser: failed to read from the stream.");
+
+    size_t read = static_cast<size_t>(m_stream.gcount());
+    m_size += read;
+    return read == n;
+}
+
+template<typename _Handler>
+void csv_stream_parser<_Handler>::parse_window(size_t n)
+{
+    if (!n)
+        return;
+
+    window_handler hdl(m_handler);
+    csv_parser<window_handler> parser(m_window.data(), n, hdl, m_config);
+    parser.parse();
+}
+
+}
+
+#endif
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -11,6 +11,7 @@
 #include "env.hpp"
 
 #include <string>
+#include <ostream>
 
 namespace orcus {
 
@@ -46,6 +47,13 @@ public:
     virtual void dump_flat(const std::string& outdir) const = 0;
     virtual void dump_html(const std::string& outdir) const = 0;
     virtual void dump_check(std::ostream& os) const = 0;
+    virtual void dump_csv(const std::string& outdir) const = 0;
+
+    /**
+     * Print the amount of memory used by the document.  The default
+     * implementation prints nothing.
+     */
+    virtual void dump_memory_usage(std::ostream& os) const;
 };
 
 }}
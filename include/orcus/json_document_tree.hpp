@@ -68,6 +68,12 @@ enum class node_t
 /**
  * Each node instance represents a JSON value object stored in the document
  * tree.
+ *
+ * When the document was loaded lazily, the methods that access the child
+ * nodes of an array or object create them on first access, and throw
+ * orcus::json::parse_error if the array or object contains a syntax error.
+ * Such a document must not be accessed from more than one thread at a
+ * time.
  */
 class ORCUS_DLLPUBLIC node
 {
@@ -216,8 +222,16 @@ public:
      * Load raw string stream containing a JSON structure to populate the
      * document tree.
      *
+     * When the lazy option of the configuration is set, the document tree
+     * keeps referencing the stream regardless of the
+     * persistent_string_values option, and the caller must keep it alive
+     * and unmodified for the entire life cycle of the document tree.
+     *
      * @param strm stream containing a JSON structure.
      * @param config configuration object.
+     *
+     * @exception orcus::json_document_error if the lazy option is set and
+     *                 the stream is 4 GiB or larger.
      */
     void load(const std::string& strm, const json_config& config);
 
@@ -225,14 +239,24 @@ public:
      * Load raw string stream containing a JSON structure to populate the
      * document tree.
      *
+     * When the lazy option of the configuration is set, the document tree
+     * keeps referencing the stream regardless of the
+     * persistent_string_values option, and the caller must keep it alive
+     * and unmodified for the entire life cycle of the document tree.
+     *
      * @param p pointer to the stream containing a JSON structure.
      * @param n size of the stream.
      * @param config configuration object.
+     *
+     * @exception orcus::json_document_error if the lazy option is set and
+     *                 the stream is 4 GiB or larger.
      */
     void load(const char* p, size_t n, const json_config& config);
 
     /**
-     * Get the root node of the document.
+     * Get the root node of the document.  When the document was loaded from
+     * a stream in the JSON Lines format, the root node is an array whose
+     * elements are the documents of the lines, in their original order.
      *
      * @return root node of the document.
      */
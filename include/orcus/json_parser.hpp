@@ -12,6 +12,7 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstring>
 
 namespace orcus {
 
@@ -40,15 +41,43 @@ public:
      */
     void parse();
 
+    /**
+     * Parse in two stages.  The first stage locates all structural
+     * characters of the stream in one vectorized pass, and the second
+     * stage walks through them without visiting the blanks and the string
+     * contents in between.  The handler receives the same callbacks as
+     * with parse(), but the index takes four bytes per structural
+     * character.
+     */
+    void parse_indexed();
+
+    /**
+     * Parse a stream in the JSON Lines format, where each line contains
+     * one JSON document.  Each document must be either an object or an
+     * array as with parse(), and the handler receives begin_parse() and
+     * end_parse() around each of them.  Blank lines are skipped.
+     */
+    void parse_lines();
+
 private:
     void root_value();
     void value();
     void array();
     void object();
+    void object_key();
     void number();
     void number_with_exp(double base);
     void string();
 
+    char indexed_char(uint32_t pos) const;
+    void indexed_value(uint32_t pos, const uint32_t*& index);
+    void indexed_array(const uint32_t*& index);
+    void indexed_object(const uint32_t*& index);
+    void indexed_string(uint32_t pos, const uint32_t*& index, bool key);
+    void indexed_literal(uint32_t pos, const char* literal, size_t n, uint32_t next_pos);
+    void indexed_number(uint32_t pos, uint32_t next_pos);
+    void indexed_value_end(uint32_t next_pos);
+
 private:
     handler_type& m_handler;
 };
@@ -73,6 +102,63 @@ void json_parser<_Handler>::parse()
     m_handler.end_parse();
 }
 
+template<typename _Handler>
+void json_parser<_Handler>::parse_indexed()
+{
+    const uint32_t* index = build_structural_index();
+    if (!index)
+    {
+        parse();
+        return;
+    }
+
+    m_handler.begin_parse();
+
+    uint32_t pos = *index++;
+    switch (indexed_char(pos))
+    {
+        case 0:
+            // The stream is blank.
+            m_handler.end_parse();
+            return;
+        case '[':
+            indexed_array(index);
+        break;
+        case '{':
+            indexed_object(index);
+        break;
+        default:
+            json::parse_error::throw_with(
+                "root_value: either '[' or '{' was expected, but '", indexed_char(pos), "' was found.", pos);
+    }
+
+    if (indexed_char(*index))
+        throw json::parse_error("parse: unexpected trailing string segment.", *index);
+
+    m_handler.end_parse();
+}
+
+template<typename _Handler>
+void json_parser<_Handler>::parse_lines()
+{
+    const char* end = mp_end;
+    while (mp_char != end)
+    {
+        // Parse each line as if the stream ended there, so that the
+        // offsets remain relative to the whole stream.
+        const char* eol = static_cast<const char*>(std::memchr(mp_char, '\n', end - mp_char));
+        mp_end = eol ? eol : end;
+
+        skip_blanks();
+        if (has_char())
+            parse();
+
+        mp_char = eol ? eol + 1 : end;
+    }
+
+    mp_end = end;
+}
+
 template<typename _Handler>
 void json_parser<_Handler>::root_value()
 {
@@ -141,6 +227,10 @@ void json_parser<_Handler>::array()
     m_handler.begin_array();
     for (next(); has_char(); next())
     {
+        skip_blanks();
+        if (!has_char())
+            break;
+
         if (cur_char() == ']')
         {
             m_handler.end_array();
@@ -149,25 +239,24 @@ void json_parser<_Handler>::array()
             return;
         }
 
-        skip_blanks();
         value();
         skip_blanks();
 
-        if (has_char())
+        if (!has_char())
+            break;
+
+        switch (cur_char())
         {
-            switch (cur_char())
-            {
-                case ']':
-                    m_handler.end_array();
-                    next();
-                    skip_blanks();
-                    return;
-                case ',':
-                    continue;
-                default:
-                    json::parse_error::throw_with(
-                        "array: either ']' or ',' expected, but '", cur_char(), "' found.", offset());
-            }
+            case ']':
+                m_handler.end_array();
+                next();
+                skip_blanks();
+                return;
+            case ',':
+                continue;
+            default:
+                json::parse_error::throw_with(
+                    "array: either ']' or ',' expected, but '", cur_char(), "' found.", offset());
         }
     }
 
@@ -200,22 +289,12 @@ void json_parser<_Handler>::object()
                     "object: '\"' was expected, but '", cur_char(), "' found.", offset());
         }
 
-        parse_quoted_string_state res = parse_string();
-        if (!res.str)
-        {
-            // Parsing was unsuccessful.
-            if (res.length == parse_quoted_string_state::error_no_closing_quote)
-                throw json::parse_error("object: stream ended prematurely before reaching the closing quote of a key.", offset());
-            else if (res.length == parse_quoted_string_state::error_illegal_escape_char)
-                json::parse_error::throw_with(
-                    "object: illegal escape character '", cur_char(), "' in key value.", offset());
-            else
-                throw json::parse_error("object: unknown error while parsing a key value.", offset());
-        }
-
-        m_handler.object_key(res.str, res.length, res.transient);
+        object_key();
 
         skip_blanks();
+        if (!has_char())
+            throw json::parse_error("object: stream ended prematurely before reaching ':'.", offset());
+
         if (cur_char() != ':')
             json::parse_error::throw_with(
                 "object: ':' was expected, but '", cur_char(), "' found.", offset());
@@ -250,20 +329,42 @@ void json_parser<_Handler>::object()
     throw json::parse_error("object: closing '}' was never reached.", offset());
 }
 
+template<typename _Handler>
+void json_parser<_Handler>::object_key()
+{
+    parse_quoted_string_state res = parse_string();
+    if (!res.str)
+    {
+        // Parsing was unsuccessful.
+        if (res.length == parse_quoted_string_state::error_no_closing_quote)
+            throw json::parse_error("object: stream ended prematurely before reaching the closing quote of a key.", offset());
+        else if (res.length == parse_quoted_string_state::error_illegal_escape_char)
+            json::parse_error::throw_with(
+                "object: illegal escape character '", cur_char(), "' in key value.", offset());
+        else
+            throw json::parse_error("object: unknown error while parsing a key value.", offset());
+    }
+
+    m_handler.object_key(res.str, res.length, res.transient);
+}
+
 template<typename _Handler>
 void json_parser<_Handler>::number()
 {
     assert(is_numeric(cur_char()) || cur_char() == '-');
 
     double val = parse_double_or_throw();
-    switch (cur_char())
+    if (has_char())
     {
-        case 'e':
-        case 'E':
-            number_with_exp(val);
-            return;
-        default:
-            ;
+        switch (cur_char())
+        {
+            case 'e':
+            case 'E':
+                number_with_exp(val);
+                return;
+            default:
+                ;
+        }
     }
     m_handler.number(val);
     skip_blanks();
@@ -302,6 +403,223 @@ void json_parser<_Handler>::string()
         throw json::parse_error("string: unknown error.", offset());
 }
 
+template<typename _Handler>
+char json_parser<_Handler>::indexed_char(uint32_t pos) const
+{
+    // Blanks are never indexed, so the null character marks the end.
+    const char* p = mp_begin + pos;
+    return p == mp_end ? 0 : *p;
+}
+
+template<typename _Handler>
+void json_parser<_Handler>::indexed_value(uint32_t pos, const uint32_t*& index)
+{
+    char c = indexed_char(pos);
+    switch (c)
+    {
+        case '[':
+            indexed_array(index);
+        break;
+        case '{':
+            indexed_object(index);
+        break;
+        case '"':
+            indexed_string(pos, index, false);
+        break;
+        case 't':
+            indexed_literal(pos, "true", 4, *index);
+            m_handler.boolean_true();
+        break;
+        case 'f':
+            indexed_literal(pos, "false", 5, *index);
+            m_handler.boolean_false();
+        break;
+        case 'n':
+            indexed_literal(pos, "null", 4, *index);
+            m_handler.null();
+        break;
+        case '-':
+            indexed_number(pos, *index);
+        break;
+        default:
+            if (!is_numeric(c))
+                json::parse_error::throw_with("value: failed to parse '", c, "'.", pos);
+
+            indexed_number(pos, *index);
+    }
+}
+
+template<typename _Handler>
+void json_parser<_Handler>::indexed_array(const uint32_t*& index)
+{
+    m_handler.begin_array();
+
+    uint32_t pos = *index++;
+    if (indexed_char(pos) == ']')
+    {
+        m_handler.end_array();
+        return;
+    }
+
+    while (indexed_char(pos))
+    {
+        indexed_value(pos, index);
+
+        pos = *index++;
+        switch (indexed_char(pos))
+        {
+            case ']':
+                m_handler.end_array();
+                return;
+            case ',':
+                pos = *index++;
+                if (indexed_char(pos) == ']')
+                {
+                    m_handler.end_array();
+                    return;
+                }
+                continue;
+            case 0:
+            break;
+            default:
+                json::parse_error::throw_with(
+                    "array: either ']' or ',' expected, but '", indexed_char(pos), "' found.", pos);
+        }
+    }
+
+    throw json::parse_error("array: failed to parse array.", pos);
+}
+
+template<typename _Handler>
+void json_parser<_Handler>::indexed_object(const uint32_t*& index)
+{
+    m_handler.begin_object();
+
+    uint32_t pos = *index++;
+    if (indexed_char(pos) == '}')
+    {
+        m_handler.end_object();
+        return;
+    }
+
+    for (;;)
+    {
+        switch (indexed_char(pos))
+        {
+            case '"':
+                break;
+            case 0:
+                throw json::parse_error("object: stream ended prematurely before reaching a key.", pos);
+            default:
+                json::parse_error::throw_with(
+                    "object: '\"' was expected, but '", indexed_char(pos), "' found.", pos);
+        }
+
+        indexed_string(pos, index, true);
+
+        pos = *index++;
+        if (indexed_char(pos) != ':')
+            json::parse_error::throw_with(
+                "object: ':' was expected, but '", indexed_char(pos), "' found.", pos);
+
+        pos = *index++;
+        if (!indexed_char(pos))
+            throw json::parse_error("object: stream ended prematurely before reaching a value.", pos);
+
+        indexed_value(pos, index);
+
+        pos = *index++;
+        switch (indexed_char(pos))
+        {
+            case '}':
+                m_handler.end_object();
+                return;
+            case ',':
+                pos = *index++;
+                if (indexed_char(pos) == '}')
+                {
+                    m_handler.end_object();
+                    return;
+                }
+                continue;
+            case 0:
+                throw json::parse_error("object: stream ended prematurely before reaching either ']' or ','.", pos);
+            default:
+                json::parse_error::throw_with(
+                    "object: either ']' or ',' expected, but '", indexed_char(pos), "' found.", pos);
+        }
+    }
+}
+
+template<typename _Handler>
+void json_parser<_Handler>::indexed_string(uint32_t pos, const uint32_t*& index, bool key)
+{
+    // The next position after the opening quote is that of the closing
+    // quote, unless the string is not closed.
+    uint32_t end_pos = *index;
+    const char* p = mp_begin + pos + 1;
+    size_t n = end_pos - pos - 1;
+
+    if (indexed_char(end_pos) == '"' && !std::memchr(p, '\\', n))
+    {
+        if (key)
+            m_handler.object_key(p, n, false);
+        else
+            m_handler.string(p, n, false);
+    }
+    else
+    {
+        // Leave the strings with escaped characters, and the broken ones, to
+        // the regular parser.
+        mp_char = p - 1;
+        if (key)
+            object_key();
+        else
+            string();
+    }
+
+    ++index;
+}
+
+template<typename _Handler>
+void json_parser<_Handler>::indexed_literal(uint32_t pos, const char* literal, size_t n, uint32_t next_pos)
+{
+    mp_char = mp_begin + pos;
+    if (size_t(mp_end - mp_char) < n || std::memcmp(mp_char, literal, n))
+        json::parse_error::throw_with("value: '", literal, n, "' expected.", pos);
+
+    mp_char += n;
+    indexed_value_end(next_pos);
+}
+
+template<typename _Handler>
+void json_parser<_Handler>::indexed_number(uint32_t pos, uint32_t next_pos)
+{
+    mp_char = mp_begin + pos;
+    double val = parse_double_or_throw();
+    if (has_char() && (cur_char() == 'e' || cur_char() == 'E'))
+    {
+        next();
+        if (!has_char())
+            throw json::parse_error("number_with_exp: illegal exponent value.", offset());
+
+        long exp = parse_long_or_throw();
+        val *= std::pow(10.0, exp);
+    }
+
+    m_handler.number(val);
+    indexed_value_end(next_pos);
+}
+
+template<typename _Handler>
+void json_parser<_Handler>::indexed_value_end(uint32_t next_pos)
+{
+    // Only blanks may follow the value up to the next structural character.
+    skip_blanks();
+    if (mp_char != mp_begin + next_pos)
+        json::parse_error::throw_with("value: unexpected character '", cur_char(), "' after a value.", offset());
+}
+
 }
 
 #endif
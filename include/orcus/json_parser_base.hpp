@@ -11,6 +11,7 @@
 #include "orcus/parser_base.hpp"
 #include "orcus/parser_global.hpp"
 
+#include <cstdint>
 #include <memory>
 
 namespace orcus { namespace json {
@@ -27,6 +28,21 @@ public:
         const char* msg_before, const char* p, size_t n, const char* msg_after, std::ptrdiff_t offset);
 };
 
+/**
+ * Locate all structural characters of a JSON stream in one vectorized
+ * pass, as json_parser::parse_indexed() does.
+ *
+ * @param p pointer to the stream.
+ * @param n size of the stream.
+ * @param size receives the number of structural characters.
+ *
+ * @return positions of the structural characters followed by the length
+ *         of the stream, or nullptr if the stream is too large to be
+ *         indexed.
+ */
+ORCUS_PSR_DLLPUBLIC std::unique_ptr<uint32_t[]> build_structural_index(
+    const char* p, size_t n, size_t& size);
+
 class ORCUS_PSR_DLLPUBLIC parser_base : public ::orcus::parser_base
 {
     struct impl;
@@ -47,6 +63,20 @@ protected:
     long parse_long_or_throw();
     double parse_double_or_throw();
 
+    /**
+     * Locate all structural characters of the stream in one vectorized
+     * pass.  They are the operators outside of strings, the quotes that
+     * open and close strings, and the first character of every other
+     * value.  The characters between two adjacent positions are either
+     * blanks, or a part of the string or value that starts at the former
+     * position.
+     *
+     * @return positions of the structural characters followed by the length
+     *         of the stream, or nullptr if the stream is too large to be
+     *         indexed.  The index remains valid until it is built again.
+     */
+    const uint32_t* build_structural_index();
+
     parse_quoted_string_state parse_string();
 
     void skip_blanks();
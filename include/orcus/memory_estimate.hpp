@@ -0,0 +1,60 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef INCLUDED_ORCUS_MEMORY_ESTIMATE_HPP
+#define INCLUDED_ORCUS_MEMORY_ESTIMATE_HPP
+
+#include <cstdlib>
+#include <string>
+
+/**
+ * Internal helpers that estimate the heap memory used by standard
+ * containers, shared by the memory usage reports of the libraries.  This
+ * header is not installed.
+ */
+
+namespace orcus {
+
+/**
+ * Size of a string instance plus the heap memory it allocated.
+ */
+inline size_t get_string_bytes(const std::string& s)
+{
+    size_t bytes = sizeof(std::string);
+    if (s.capacity() > std::string().capacity())
+        // Not stored in the small string buffer.
+        bytes += s.capacity() + 1;
+
+    return bytes;
+}
+
+/**
+ * Estimate the size of a single node of an unordered container, which
+ * holds the value, the next pointer and the cached hash value.
+ */
+template<typename _ValueT>
+size_t estimate_hash_node_bytes()
+{
+    return sizeof(_ValueT) + 2 * sizeof(void*);
+}
+
+/**
+ * Estimate the heap memory used by the buckets and nodes of an unordered
+ * container, excluding memory owned by its elements.
+ */
+template<typename _HashT>
+size_t estimate_hash_container_bytes(const _HashT& store)
+{
+    return store.bucket_count() * sizeof(void*) +
+        store.size() * estimate_hash_node_bytes<typename _HashT::value_type>();
+}
+
+}
+
+#endif
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -10,12 +10,18 @@
 
 #include "interface.hpp"
 
+#include <istream>
+
 namespace orcus {
 
 namespace spreadsheet { namespace iface {
     class import_factory;
 }}
 
+namespace csv {
+    struct parser_config;
+}
+
 class ORCUS_DLLPUBLIC orcus_csv : public iface::import_filter
 {
     orcus_csv(const orcus_csv&); // disabled
@@ -27,11 +33,29 @@ public:
     virtual void read_file(const std::string& filepath);
     virtual void read_stream(const char* content, size_t len);
 
+    /**
+     * Import csv content from an input stream.  The stream is read through
+     * a window of fixed size rather than loaded as a whole, so that streams
+     * larger than the available memory can be imported into a factory that
+     * doesn't keep all of the content in memory.
+     *
+     * @param is input stream to read the content from.
+     */
+    void read_stream(std::istream& is);
+
     virtual const char* get_name() const;
 
 private:
     void parse(const char* content, size_t len);
 
+    /**
+     * Split the content into chunks at row boundaries, and parse them
+     * concurrently.  The rows are inserted into the sheet in their original
+     * order.
+     */
+    void parse_parallel(
+        const char* content, size_t len, const csv::parser_config& config, size_t chunk_count);
+
 private:
     spreadsheet::iface::import_factory* mp_factory;
 };
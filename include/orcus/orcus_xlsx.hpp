@@ -10,10 +10,14 @@
 
 #include "interface.hpp"
 
+#include <memory>
+
 namespace orcus {
 
 namespace spreadsheet { namespace iface { class import_factory; }}
 
+class zip_archive_stream;
+
 struct xlsx_rel_sheet_info;
 struct xlsx_rel_table_info;
 struct orcus_xlsx_impl;
@@ -37,8 +41,34 @@ public:
 
     virtual const char* get_name() const;
 
+    /**
+     * Import a newer version of the document previously imported by this
+     * instance into the same document.  The size and CRC of every part read
+     * during the previous import are compared against those in the new
+     * package, and only the worksheets whose parts have changed are
+     * imported again.  When a part shared by all worksheets has changed,
+     * such as the workbook, the shared strings or the styles, the document
+     * is emptied and imported again in full.
+     *
+     * @param filepath path to the new version of the document.
+     *
+     * @return true if only the changed worksheets were imported, or false
+     *         if the whole document was imported.
+     */
+    bool reimport_file(const std::string& filepath);
+
+    /**
+     * Same as reimport_file(), but the package is read from a memory
+     * buffer.
+     */
+    bool reimport_stream(const char* content, size_t len);
+
 private:
 
+    void read_package(std::unique_ptr<zip_archive_stream>&& stream);
+
+    bool reimport_package(std::unique_ptr<zip_archive_stream>&& stream);
+
     void set_formulas_to_doc();
 
     void read_workbook(const std::string& dir_path, const std::string& file_name);
@@ -15,6 +15,7 @@
 namespace orcus {
 
 class cell_buffer;
+class pstring;
 
 enum class string_escape_char_t
 {
@@ -73,6 +74,43 @@ ORCUS_PSR_DLLPUBLIC double parse_numeric(const char*& p, size_t max_length);
 
 ORCUS_PSR_DLLPUBLIC long parse_integer(const char*& p, size_t max_length);
 
+/**
+ * Check whether the entire character range represents a decimal number,
+ * and if so, convert it to a double-precision value.  Leading blanks and
+ * an optional sign are allowed, followed by digits with an optional
+ * decimal point and an optional exponent.  The decimal point is always
+ * '.' regardless of the current locale.  Hexadecimal notation, "inf" and
+ * "nan" are not recognized.
+ *
+ * Unlike strtod, this function never reads beyond the specified range,
+ * so the input does not need to be null-terminated.  The result is
+ * correctly rounded.
+ *
+ * @param p pointer to the first character of the range.
+ * @param n length of the range.
+ * @param value receives the converted value when the range is a number.
+ *              It is left unmodified otherwise.
+ *
+ * @return true if the range represents a number, false otherwise.
+ */
+ORCUS_PSR_DLLPUBLIC bool parse_numeric_string(const char* p, size_t n, double& value);
+
+/**
+ * Convert an array of character ranges to double-precision values in the
+ * same way as parse_numeric_string(), stopping at the first range that is
+ * not a number.  Plain decimal values of up to 15 digits, which make up
+ * most numeric columns, are converted eight digits at a time.
+ *
+ * @param strs array of character ranges to convert.
+ * @param n number of ranges in the array.
+ * @param values array of at least n elements that receives the converted
+ *               values.
+ *
+ * @return number of ranges converted.  It is less than n when the range at
+ *         that position is not a number.
+ */
+ORCUS_PSR_DLLPUBLIC size_t parse_numeric_strings(const pstring* strs, size_t n, double* values);
+
 /**
  * Two single-quote characters ('') represent one single-quote character.
  */
@@ -13,7 +13,9 @@
 #include "../env.hpp"
 
 #include <map>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <ixion/address.hpp>
 
@@ -98,6 +100,7 @@ struct ORCUS_SPM_DLLPUBLIC table_style_t
 struct ORCUS_SPM_DLLPUBLIC table_t
 {
     typedef std::vector<table_column_t> columns_type;
+    typedef std::unordered_map<pstring, size_t, pstring::hash> column_index_type;
 
     size_t identifier;
 
@@ -109,12 +112,60 @@ struct ORCUS_SPM_DLLPUBLIC table_t
     size_t totals_row_count;
 
     auto_filter_t filter;
-    columns_type columns;
     table_style_t style;
 
     table_t();
 
     void reset();
+
+    /**
+     * @return all columns of this table, in order of their positions.
+     */
+    const columns_type& get_columns() const;
+
+    void reserve_columns(size_t n);
+
+    /**
+     * Append a new column to the end of the table.
+     */
+    void append_column(const table_column_t& col);
+
+    /**
+     * Rename an existing column.
+     *
+     * @param pos position of the column to rename.
+     * @param name new name of the column.
+     */
+    void set_column_name(size_t pos, const pstring& name);
+
+    /**
+     * Find the first column by the specified name at or after a given
+     * position.
+     *
+     * @param name name of the column to find.
+     * @param offset position of the column to start the search from.
+     *
+     * @return iterator pointing to the column, or get_columns().end() if
+     *         no column by that name exists at or after the offset.
+     */
+    columns_type::const_iterator find_column(const pstring& name, size_t offset = 0) const;
+
+    /**
+     * @return number of bytes used by the columns and their name index.
+     */
+    size_t get_column_memory_usage() const;
+
+private:
+    void build_column_index();
+
+    /**
+     * Columns are only modified via the methods above so that the name
+     * index always reflects them.
+     */
+    columns_type m_columns;
+
+    /** Position of the first column of each name. */
+    column_index_type m_column_index;
 };
 
 }}
@@ -11,6 +11,7 @@
 #include "orcus/env.hpp"
 #include "orcus/interface.hpp"
 #include "orcus/spreadsheet/types.hpp"
+#include "orcus/spreadsheet/memory_usage.hpp"
 
 #include <ostream>
 
@@ -26,6 +27,7 @@ namespace orcus {
 
 class pstring;
 class string_pool;
+struct date_time_t;
 
 namespace spreadsheet {
 
@@ -35,6 +37,7 @@ class import_styles;
 class sheet;
 
 struct table_t;
+struct styles_remap_t;
 struct document_impl;
 
 /**
@@ -72,6 +75,18 @@ public:
      */
     void clear();
 
+    /**
+     * Remove the content of a single sheet, along with the tables defined
+     * on it, so that the sheet can be imported again.  The sheet keeps its
+     * position and name.
+     *
+     * @param sheet_name name of the sheet to clear.
+     *
+     * @return pointer to the cleared sheet, or NULL if no sheet exists by
+     *         the specified name.
+     */
+    sheet* clear_sheet(const pstring& sheet_name);
+
     /**
      * Dump document content to specified output directory.
      */
@@ -91,12 +106,31 @@ public:
      */
     virtual void dump_check(std::ostream& os) const;
 
+    /**
+     * Dump the content of each sheet as a CSV file into the specified
+     * output directory.  The name of each file will be [sheet name].csv.
+     */
+    virtual void dump_csv(const std::string& outdir) const;
+
+    /**
+     * Print the breakdown of the memory used by the document, as returned
+     * by get_memory_usage().
+     */
+    virtual void dump_memory_usage(std::ostream& os) const;
+
     sheet_t get_sheet_index(const pstring& name) const;
     pstring get_sheet_name(sheet_t sheet_pos) const;
 
     size_t sheet_size() const;
 
     void set_origin_date(int year, int month, int day);
+
+    /**
+     * Get the origin date, from which date-time cell values are counted in
+     * days.  It defaults to 1899-12-30 when the document doesn't specify
+     * one.
+     */
+    date_time_t get_origin_date() const;
     void set_formula_grammar(formula_grammar_t grammar);
     formula_grammar_t get_formula_grammar() const;
 
@@ -121,6 +155,79 @@ public:
 
     void finalize();
 
+    /**
+     * Put the finalized document into a read-only state, in which all const
+     * member functions of the document, its sheets, styles and shared
+     * strings can be called concurrently from multiple threads without
+     * locking.  All look-up structures that would otherwise be built on
+     * first access get built here.
+     *
+     * Once frozen, the member functions that modify the document structure
+     * throw general_error.  The client code must not modify the content of
+     * a frozen document through other means, such as the sheet import
+     * interfaces.  Only clear() returns it to a modifiable state.
+     */
+    void freeze();
+
+    /**
+     * @return true if the document has been frozen by freeze().
+     */
+    bool is_frozen() const;
+
+    /**
+     * Freeze the document, and convert its look-up structures into forms
+     * that take less memory.  Per-column cell format and date-time trees
+     * become flat sorted arrays, the string pool releases its interning
+     * index, the set of formula cells pending calculation is released, and
+     * the unused capacity of all arrays is released.  Look-ups into the
+     * flat arrays use binary search.
+     *
+     * @return estimated number of bytes released.
+     */
+    size_t compact();
+
+    /**
+     * Get the amount of heap memory used by the document, broken down by
+     * the structures that hold it.  This walks all cells, and takes time
+     * proportional to the number of non-empty cells.
+     */
+    memory_usage_t get_memory_usage() const;
+
+    /**
+     * Merge identical style records, and update the cell format IDs of all
+     * cells in all sheets to reference the surviving records.  Call this
+     * after the import is complete.
+     *
+     * @return index maps from old to new style record indices, along with
+     *         deduplication statistics.
+     */
+    styles_remap_t deduplicate_styles();
+
+    /**
+     * Save the entire document content to a binary snapshot file, which
+     * can be loaded much faster than the original file can be imported.
+     * The snapshot stores the string pool, the cell values, formula
+     * expressions, styles, sheet properties, tables and auto filters.
+     * Formula results are not stored; they get recalculated on load.  A
+     * general_error is thrown without writing the file if a formula cell
+     * has no expression that could be compiled again on load.
+     *
+     * @param filepath path of the file to write to.
+     */
+    void save_snapshot(const std::string& filepath) const;
+
+    /**
+     * Replace the document content with that of a snapshot file written
+     * by save_snapshot().  The document is finalized once loaded.  A
+     * general_error is thrown if the file cannot be read, in which case
+     * the document is left unchanged, or if it is not a valid snapshot,
+     * in which case the document is cleared again and left empty rather
+     * than partially loaded.
+     *
+     * @param filepath path of the snapshot file.
+     */
+    void load_snapshot(const std::string& filepath);
+
 private:
     void insert_dirty_cell(const ixion::abs_address_t& pos);
 
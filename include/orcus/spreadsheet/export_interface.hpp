@@ -12,15 +12,112 @@
 #include "../env.hpp"
 
 #include <ostream>
+#include <vector>
+#include <cstdint>
 
 namespace orcus { namespace spreadsheet { namespace iface {
 
+/**
+ * Type of cell reported in a column chunk.
+ */
+enum class column_cell_t : uint8_t
+{
+    empty = 0,
+    numeric,
+    string,
+    formula,
+    unknown
+};
+
+/**
+ * Content of a contiguous range of rows within a single column.  The
+ * buffers follow the Apache Arrow columnar layout, so a consumer can wrap
+ * them as Arrow arrays without converting them:
+ *
+ * <ul>
+ * <li>numeric values form a float64 array with a validity bitmap,</li>
+ * <li>string values form an int32 array of dictionary indices into the
+ *     string table, with its own validity bitmap,</li>
+ * <li>cell types form a run-end encoded uint8 array.</li>
+ * </ul>
+ *
+ * In a validity bitmap, bit (i % 8) of byte (i / 8) is set when element i
+ * holds a value.  Formula cells contribute their cached results to the
+ * numeric or string values.
+ */
+struct ORCUS_DLLPUBLIC column_chunk
+{
+    row_t row_start;   /// first row of the chunk.
+    size_t length;     /// number of rows in the chunk.
+
+    std::vector<double> numeric_values;
+    std::vector<uint8_t> numeric_validity;
+    size_t numeric_null_count;
+
+    std::vector<int32_t> string_ids;
+    std::vector<uint8_t> string_validity;
+    size_t string_null_count;
+
+    /** Exclusive end of each run, counted from the start of the chunk. */
+    std::vector<int32_t> type_run_ends;
+    std::vector<column_cell_t> type_run_values;
+
+    column_chunk();
+
+    /**
+     * Set the row range, and size all buffers for it with every element
+     * empty.  Buffer capacity is retained across calls.
+     */
+    void reset(row_t _row_start, size_t _length);
+
+    /**
+     * Append a run of cells of the same type, merging it with the last run
+     * when the types match.
+     */
+    void append_type_run(column_cell_t type, size_t run_length);
+};
+
+/**
+ * Strings of a document, indexed by string ID, in the Arrow large_utf8
+ * layout: string i occupies bytes [offsets[i], offsets[i+1]) of data.
+ */
+struct ORCUS_DLLPUBLIC string_table
+{
+    std::vector<int64_t> offsets;
+    std::vector<char> data;
+
+    void clear();
+};
+
 class export_sheet
 {
 public:
     ORCUS_DLLPUBLIC virtual ~export_sheet() = 0;
 
     virtual void write_string(std::ostream& os, orcus::spreadsheet::row_t row, orcus::spreadsheet::col_t col) const = 0;
+
+    /**
+     * Get the number of rows and columns spanned by the non-empty cells,
+     * counting from the top-left cell of the sheet.  The default
+     * implementation reports an empty sheet.
+     */
+    ORCUS_DLLPUBLIC virtual void get_data_size(row_t& row_count, col_t& col_count) const;
+
+    /**
+     * Fill a chunk with the content of a range of rows within a column,
+     * in one call.  Rows outside the sheet are reported as empty.  The
+     * default implementation reports all cells as empty.
+     *
+     * @param col column to read.
+     * @param row_start first row to read.
+     * @param length number of rows to read.
+     * @param chunk chunk to fill.  Its previous content is discarded.
+     *
+     * @exception orcus::general_error if a string identifier doesn't fit in
+     *            the int32 range of the string dictionary indices.
+     */
+    ORCUS_DLLPUBLIC virtual void get_column_chunk(
+        col_t col, row_t row_start, size_t length, column_chunk& chunk) const;
 };
 
 class export_factory
@@ -29,6 +126,12 @@ public:
     ORCUS_DLLPUBLIC virtual ~export_factory() = 0;
 
     virtual const export_sheet* get_sheet(const char* sheet_name, size_t sheet_name_length) const = 0;
+
+    /**
+     * Get the strings that the string IDs of column chunks refer to.  The
+     * default implementation returns an empty table.
+     */
+    ORCUS_DLLPUBLIC virtual void get_string_table(string_table& table) const;
 };
 
 }}}
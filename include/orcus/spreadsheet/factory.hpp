@@ -31,6 +31,8 @@ public:
     virtual iface::import_sheet* get_sheet(const char* sheet_name, size_t sheet_name_length);
     virtual iface::import_sheet* get_sheet(sheet_t sheet_index);
     virtual void finalize();
+    virtual iface::import_sheet* reset_sheet(const char* sheet_name, size_t sheet_name_length);
+    virtual bool reset();
 
 private:
     import_factory_impl* mp_impl;
@@ -45,6 +47,7 @@ public:
     virtual ~export_factory();
 
     virtual const iface::export_sheet* get_sheet(const char* sheet_name, size_t sheet_name_length) const;
+    virtual void get_string_table(iface::string_table& table) const;
 
 private:
     export_factory_impl* mp_impl;
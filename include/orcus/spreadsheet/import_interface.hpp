@@ -492,6 +492,17 @@ public:
      */
     virtual void set_value(orcus::spreadsheet::row_t row, orcus::spreadsheet::col_t col, double value) = 0;
 
+    /**
+     * Set numerical values to consecutive cells in a column.  The default
+     * implementation calls set_value() for each cell.
+     *
+     * @param row row ID of the first cell
+     * @param col column ID
+     * @param values array of values being assigned to the cells.
+     * @param n number of values in the array.
+     */
+    virtual void set_values(orcus::spreadsheet::row_t row, orcus::spreadsheet::col_t col, const double* values, size_t n);
+
     /**
      * Set a boolean value to a cell.
      *
@@ -729,6 +740,29 @@ public:
      * chance to perform post-processing if necessary.
      */
     virtual void finalize() = 0;
+
+    /**
+     * Remove all content from an existing sheet, so that it can be imported
+     * again when only some sheets of a previously imported document have
+     * changed.  Cells in other sheets that depend on this sheet should be
+     * recalculated at the next finalize() call.
+     *
+     * @return pointer to the emptied sheet instance, or NULL if no sheet
+     *         exists by the specified name or the client app doesn't
+     *         support re-importing.  The default implementation returns
+     *         NULL.
+     */
+    virtual import_sheet* reset_sheet(const char* sheet_name, size_t sheet_name_length);
+
+    /**
+     * Remove all content from the document, so that a new version of it
+     * can be imported from scratch.
+     *
+     * @return true if the document has been emptied, or false if the client
+     *         app doesn't support re-importing.  The default implementation
+     *         returns false.
+     */
+    virtual bool reset();
 };
 
 }}}
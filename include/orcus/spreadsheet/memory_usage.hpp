@@ -0,0 +1,86 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef INCLUDED_ORCUS_SPREADSHEET_MEMORY_USAGE_HPP
+#define INCLUDED_ORCUS_SPREADSHEET_MEMORY_USAGE_HPP
+
+#include "../env.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+namespace orcus { namespace spreadsheet {
+
+/**
+ * Heap memory used by the content of a single sheet, in bytes.
+ */
+struct ORCUS_SPM_DLLPUBLIC sheet_memory_usage_t
+{
+    /** Cell values and block headers of the column stores. */
+    size_t cell_stores;
+
+    /** Formula cell instances and their formula tokens. */
+    size_t formula_tokens;
+
+    /**
+     * Cell format and date-time look-up structures, and the column width,
+     * row height and hidden state trees.
+     */
+    size_t format_trees;
+
+    /** Merged cell range index. */
+    size_t merge_ranges;
+
+    /** Auto filter of the sheet. */
+    size_t auto_filter;
+
+    sheet_memory_usage_t();
+
+    size_t total() const;
+};
+
+/**
+ * Heap memory used by a document, in bytes, broken down by the structures
+ * that hold it.
+ *
+ * Memory held by the structures that orcus owns is computed from the
+ * actual string and array capacities.  Memory held by containers that don't
+ * expose their allocations, such as the hash and tree nodes of the
+ * standard containers and the ixion and mdds cell stores, is computed from
+ * their element counts and node layouts, and doesn't include the overhead
+ * of the memory allocator.
+ */
+struct ORCUS_SPM_DLLPUBLIC memory_usage_t
+{
+    /** Interned strings used by the styles, tables and other records. */
+    size_t string_pool;
+
+    /** Cell string table. */
+    size_t shared_strings;
+
+    /** Format runs of rich text cell strings. */
+    size_t format_runs;
+
+    /** Style records. */
+    size_t styles;
+
+    /** Tables and their column and filter definitions. */
+    size_t tables;
+
+    /** Memory used by each sheet, in sheet order. */
+    std::vector<sheet_memory_usage_t> sheets;
+
+    memory_usage_t();
+
+    size_t total() const;
+};
+
+}}
+
+#endif
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
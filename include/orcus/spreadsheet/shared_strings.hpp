@@ -16,6 +16,7 @@
 #include <cstdlib>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace ixion { class model_context; }
 
@@ -26,31 +27,78 @@ class string_pool;
 namespace spreadsheet {
 
 class import_styles;
+class snapshot_writer;
+class snapshot_reader;
 
-struct ORCUS_SPM_DLLPUBLIC format_run
+/**
+ * Formatting attributes of a single format run.  Identical attribute sets
+ * are stored only once and shared among all runs that use them.
+ */
+struct ORCUS_SPM_DLLPUBLIC format_run_attrs
 {
-    size_t pos;
-    size_t size;
     pstring font;
     double font_size;
     color_t color;
     bool bold:1;
     bool italic:1;
 
-    format_run();
+    format_run_attrs();
 
     void reset();
     bool formatted() const;
+
+    bool operator== (const format_run_attrs& r) const;
+
+    struct hash
+    {
+        size_t operator() (const format_run_attrs& v) const;
+    };
 };
 
-typedef std::vector<format_run> format_runs_t;
+struct ORCUS_SPM_DLLPUBLIC format_run
+{
+    size_t pos;
+    size_t size;
+
+    /** Shared attributes of this run.  This is never NULL. */
+    const format_run_attrs* attrs;
+
+    format_run();
+};
+
+/**
+ * Read-only view of the format runs of a single string.  The view points
+ * into the storage owned by import_shared_strings, which may be
+ * reallocated by any call to append_segment() that adds a formatted run,
+ * compact() and read_snapshot().  The view is invalid after any of these
+ * calls.
+ */
+class ORCUS_SPM_DLLPUBLIC format_runs_span
+{
+    const format_run* mp_begin;
+    const format_run* mp_end;
+
+public:
+    typedef const format_run* const_iterator;
+
+    format_runs_span();
+    format_runs_span(const format_run* p_begin, const format_run* p_end);
+
+    const_iterator begin() const { return mp_begin; }
+    const_iterator end() const { return mp_end; }
+
+    size_t size() const { return mp_end - mp_begin; }
+    bool empty() const { return mp_begin == mp_end; }
+
+    const format_run& operator[] (size_t pos) const { return mp_begin[pos]; }
+};
 
 /**
  * This class handles global pool of string instances.
  */
 class ORCUS_DLLPUBLIC import_shared_strings : public iface::import_shared_strings
 {
-    typedef std::unordered_map<pstring, size_t, pstring::hash> str_index_map_type;
+    typedef std::unordered_set<format_run_attrs, format_run_attrs::hash> run_attrs_store_type;
 
     import_shared_strings() = delete;
     import_shared_strings(const import_shared_strings&) = delete;
@@ -58,9 +106,6 @@ class ORCUS_DLLPUBLIC import_shared_strings : public iface::import_shared_string
 
 public:
 
-    // format runs for all shared strings, mapped by string IDs.
-    typedef std::unordered_map<size_t, format_runs_t*> format_runs_map_type;
-
     import_shared_strings(orcus::string_pool& sp, ixion::model_context& cxt, import_styles& styles);
     virtual ~import_shared_strings();
 
@@ -76,27 +121,71 @@ public:
     virtual void append_segment(const char* s, size_t n);
     virtual size_t commit_segments();
 
-    const format_runs_t* get_format_runs(size_t index) const;
+    /**
+     * Get the format runs of a string.
+     *
+     * @param index ID of the string.
+     *
+     * @return view of the format runs, which is empty if the string is not
+     *         formatted.
+     */
+    format_runs_span get_format_runs(size_t index) const;
 
     const std::string* get_string(size_t index) const;
 
     void dump() const;
 
+    /**
+     * Release the unused capacity of the format run storage and the
+     * buffers used while importing strings.
+     *
+     * @return number of bytes released.
+     */
+    size_t compact();
+
+    /**
+     * @return heap memory used by the format runs and their attributes.
+     */
+    size_t get_format_runs_memory_usage() const;
+
+    /**
+     * Write all strings and their format runs to a document snapshot.
+     */
+    void write_snapshot(snapshot_writer& writer) const;
+
+    /**
+     * Restore all strings and their format runs from a document snapshot.
+     * The string pool must be empty, so that each string gets back the ID
+     * it had when the snapshot was written.
+     */
+    void read_snapshot(snapshot_reader& reader);
+
 private:
     orcus::string_pool& m_string_pool;
     ixion::model_context& m_cxt;
     import_styles& m_styles;
 
     /**
-     * Container for all format runs of all formatted strings.  Format runs
-     * are mapped with the string IDs.
+     * Format runs of all formatted strings, stored contiguously in the order
+     * of their string IDs.
      */
-    format_runs_map_type m_formats;
+    std::vector<format_run> m_format_runs;
+
+    /**
+     * Offsets into m_format_runs, indexed by string ID.  The runs of string
+     * i are in [m_format_run_offsets[i], m_format_run_offsets[i+1]).  The
+     * table only extends as far as the last formatted string.
+     */
+    std::vector<size_t> m_format_run_offsets;
+
+    /** Deduplicated attribute sets referenced by the format runs. */
+    run_attrs_store_type m_run_attrs;
 
     ::std::string   m_cur_segment_string;
-    format_run      m_cur_format;
-    format_runs_t* mp_cur_format_runs;
-    str_index_map_type m_set;
+    format_run_attrs m_cur_format;
+
+    /** Position in m_format_runs where the runs of the current string start. */
+    size_t m_cur_runs_begin;
 };
 
 }}
@@ -10,9 +10,12 @@
 
 #include "orcus/spreadsheet/import_interface.hpp"
 #include "orcus/spreadsheet/export_interface.hpp"
+#include "orcus/spreadsheet/sheet_cell_iterator.hpp"
+#include "orcus/spreadsheet/memory_usage.hpp"
 #include "orcus/env.hpp"
 
 #include <ostream>
+#include <vector>
 
 namespace orcus {
 
@@ -21,6 +24,8 @@ class pstring;
 namespace spreadsheet {
 
 class document;
+class snapshot_writer;
+class snapshot_reader;
 struct sheet_impl;
 struct auto_filter_t;
 
@@ -49,6 +54,14 @@ public:
     virtual void set_auto(row_t row, col_t col, const char* p, size_t n);
     virtual void set_string(row_t row, col_t col, size_t sindex);
     virtual void set_value(row_t row, col_t col, double value);
+
+    /**
+     * The model context only takes numeric cells one at a time, so this
+     * still inserts each value separately.  It lets importers hand over a
+     * whole run now, so that the cells can be inserted as a single block
+     * once the model context supports it.
+     */
+    virtual void set_values(row_t row, col_t col, const double* values, size_t n);
     virtual void set_bool(row_t row, col_t col, bool value);
     virtual void set_date_time(row_t row, col_t col, int year, int month, int day, int hour, int minute, double second);
     virtual void set_format(row_t row, col_t col, size_t index);
@@ -71,6 +84,9 @@ public:
     // Export methods
 
     virtual void write_string(std::ostream& os, row_t row, col_t col) const;
+    virtual void get_data_size(row_t& row_count, col_t& col_count) const;
+    virtual void get_column_chunk(
+        col_t col, row_t row_start, size_t length, iface::column_chunk& chunk) const;
 
     void set_col_width(col_t col, col_width_t width);
     col_width_t get_col_width(col_t col, col_t* col_start, col_t* col_end) const;
@@ -86,6 +102,19 @@ public:
 
     size_t get_string_identifier(row_t row, col_t col) const;
 
+    /**
+     * Check whether a cell holds a date-time value.  Date-time values are
+     * stored as numeric cells whose value is the number of days since the
+     * document's origin date, with the time of day as the fractional part.
+     */
+    bool is_date_time(row_t row, col_t col) const;
+
+    /**
+     * Get the value of a date-time cell, converted back from its serial
+     * value.
+     */
+    date_time_t get_date_time(row_t row, col_t col) const;
+
     auto_filter_t* get_auto_filter_data();
     const auto_filter_t* get_auto_filter_data() const;
     void set_auto_filter_data(auto_filter_t* p);
@@ -94,17 +123,85 @@ public:
     col_t col_size() const;
     sheet_t get_index() const;
 
+    /**
+     * Get an iterator positioned at the first non-empty cell of this sheet.
+     * Empty cells are skipped without being visited.
+     *
+     * @param order order in which to visit the cells.
+     */
+    sheet_cell_iterator begin_cells(cell_order_t order = cell_order_t::column_major) const;
+
+    /**
+     * Get the end position iterator for begin_cells().
+     */
+    sheet_cell_iterator end_cells() const;
+
     void finalize();
 
+    /**
+     * Build all look-up trees that the const accessors would otherwise
+     * build on demand, so that the accessors no longer modify the sheet.
+     * Called by document::freeze().
+     */
+    void freeze();
+
+    /**
+     * Freeze the sheet, and convert the cell format and date-time look-up
+     * trees into flat sorted arrays, which take less memory.  Called by
+     * document::compact().
+     *
+     * @return estimated number of bytes released.
+     */
+    size_t compact();
+
+    /**
+     * Get the amount of heap memory used by the content of this sheet.
+     */
+    sheet_memory_usage_t get_memory_usage() const;
+
+    /**
+     * Remove all cells, cell formats, merged ranges, auto filter, and reset
+     * the row and column properties to their defaults.  The sheet itself
+     * and its name stay in the document.
+     */
+    void clear();
+
     void dump_flat(std::ostream& os) const;
     void dump_check(std::ostream& os, const pstring& sheet_name) const;
     void dump_html(const ::std::string& filepath) const;
 
+    /**
+     * Write the content of the data range as comma-separated values, one
+     * line per row.  Fields are quoted as needed, and numbers are written
+     * with the fewest digits that preserve their exact values.  Formula
+     * cells are written as their cached results.
+     */
+    void dump_csv(std::ostream& os) const;
+
     /**
      * Get the cell format ID of specified cell.
      */
     size_t get_cell_format(row_t row, col_t col) const;
 
+    /**
+     * Replace the cell format IDs of all cells using the specified map.
+     * IDs outside the range of the map are left unchanged.
+     *
+     * @param xf_map map from current cell format IDs to new ones.
+     */
+    void remap_cell_formats(const std::vector<size_t>& xf_map);
+
+    /**
+     * Write the cells and properties of this sheet to a document snapshot.
+     */
+    void write_snapshot(snapshot_writer& writer) const;
+
+    /**
+     * Restore the cells and properties of this sheet from a document
+     * snapshot.  The sheet must be empty.
+     */
+    void read_snapshot(snapshot_reader& reader);
+
 private:
     sheet_impl* mp_impl;
 };
@@ -0,0 +1,111 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef INCLUDED_ORCUS_SPREADSHEET_SHEET_CELL_ITERATOR_HPP
+#define INCLUDED_ORCUS_SPREADSHEET_SHEET_CELL_ITERATOR_HPP
+
+#include "types.hpp"
+#include "../env.hpp"
+
+#include <cstddef>
+#include <iterator>
+
+#include <ixion/types.hpp>
+
+namespace ixion {
+
+class model_context;
+class formula_cell;
+
+}
+
+namespace orcus { namespace spreadsheet {
+
+struct sheet_cell_iterator_impl;
+
+/**
+ * Order in which sheet_cell_iterator visits cells.
+ */
+enum class cell_order_t
+{
+    /** Top to bottom within each column, then left to right. */
+    column_major,
+    /** Left to right within each row, then top to bottom. */
+    row_major
+};
+
+/**
+ * Single non-empty cell visited by sheet_cell_iterator.  Which member of
+ * the value union is valid depends on the cell type; cells of types other
+ * than string, numeric and formula have unknown type and no value.
+ */
+struct ORCUS_SPM_DLLPUBLIC sheet_cell_t
+{
+    row_t row;
+    col_t col;
+    ixion::celltype_t type;
+
+    union
+    {
+        double numeric;
+        size_t string_id;
+        const ixion::formula_cell* formula;
+    };
+
+    sheet_cell_t();
+};
+
+/**
+ * Forward iterator over the non-empty cells of a sheet.  It walks the
+ * underlying column stores block by block, so a full traversal takes time
+ * proportional to the number of non-empty cells rather than to the size of
+ * the data range.
+ *
+ * The iterator is invalidated when the content of the sheet changes.
+ */
+class ORCUS_SPM_DLLPUBLIC sheet_cell_iterator
+{
+    sheet_cell_iterator_impl* mp_impl;
+
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef sheet_cell_t value_type;
+    typedef const sheet_cell_t* pointer;
+    typedef const sheet_cell_t& reference;
+    typedef std::ptrdiff_t difference_type;
+
+    /**
+     * Create an end position iterator.
+     */
+    sheet_cell_iterator();
+
+    sheet_cell_iterator(const ixion::model_context& cxt, sheet_t sheet, cell_order_t order);
+    sheet_cell_iterator(const sheet_cell_iterator& other);
+    ~sheet_cell_iterator();
+
+    sheet_cell_iterator& operator= (const sheet_cell_iterator& other);
+
+    bool operator== (const sheet_cell_iterator& other) const;
+    bool operator!= (const sheet_cell_iterator& other) const;
+
+    const sheet_cell_t& operator* () const;
+    const sheet_cell_t* operator-> () const;
+
+    sheet_cell_iterator& operator++ ();
+    sheet_cell_iterator operator++ (int);
+
+    /**
+     * @return true if the iterator has moved past the last non-empty cell.
+     */
+    bool at_end() const;
+};
+
+}}
+
+#endif
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -20,6 +20,9 @@ class string_pool;
 
 namespace spreadsheet {
 
+class snapshot_writer;
+class snapshot_reader;
+
 struct ORCUS_SPM_DLLPUBLIC color_t
 {
     color_elem_t alpha;
@@ -130,6 +133,34 @@ struct ORCUS_SPM_DLLPUBLIC cell_style_t
     void reset();
 };
 
+/**
+ * Result of style record deduplication.  Each index map translates a
+ * record index as originally committed into the index of the record that
+ * replaced it.
+ */
+struct ORCUS_SPM_DLLPUBLIC styles_remap_t
+{
+    typedef std::vector<size_t> index_map_type;
+
+    index_map_type fonts;
+    index_map_type fills;
+    index_map_type borders;
+    index_map_type protections;
+    index_map_type cell_formats;
+
+    size_t records_before; /// total record count before deduplication.
+    size_t records_after;  /// total record count after deduplication.
+    size_t bytes_saved;    /// storage released by removing duplicates.
+
+    styles_remap_t();
+
+    /**
+     * @return ratio of record count before deduplication to that after.
+     *         1.0 means no duplicates were found.
+     */
+    double dedup_ratio() const;
+};
+
 class ORCUS_SPM_DLLPUBLIC import_styles : public iface::import_styles
 {
 public:
@@ -214,6 +245,44 @@ public:
     size_t get_dxf_count() const;
     size_t get_cell_styles_count() const;
 
+    /**
+     * Merge identical font, fill, border, protection and cell format
+     * records so that each distinct record is stored only once.  Font,
+     * fill, border and protection references held by the cell formats,
+     * cell style formats and differential formats are updated to point to
+     * the surviving records.  The first occurrence of each record keeps
+     * its relative order, so index 0 always stays the default.
+     *
+     * Cell format indices stored outside of this class need to be
+     * translated by the caller using the returned cell format map.
+     *
+     * @return index maps from old to new indices, and statistics.
+     */
+    styles_remap_t deduplicate();
+
+    /**
+     * Release the unused capacity of all style record arrays.
+     *
+     * @return number of bytes released.
+     */
+    size_t compact();
+
+    /**
+     * @return heap memory used by all style records.  Strings referenced by
+     *         the records are owned by the string pool.
+     */
+    size_t get_memory_usage() const;
+
+    /**
+     * Write all style records to a document snapshot.
+     */
+    void write_snapshot(snapshot_writer& writer) const;
+
+    /**
+     * Replace all style records with those stored in a document snapshot.
+     */
+    void read_snapshot(snapshot_reader& reader);
+
 private:
     string_pool& m_string_pool;
 
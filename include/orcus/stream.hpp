@@ -11,9 +11,42 @@
 #include "env.hpp"
 
 #include <string>
+#include <memory>
+#include <cstddef>
 
 namespace orcus {
 
+class pstring;
+
+/**
+ * Read-only view of the content of a file.  The file is mapped into memory
+ * where the platform supports it, which avoids copying its content.  When
+ * the file cannot be mapped, e.g. when it's a pipe, its content is read
+ * into an internal buffer instead.  In either case the content is followed
+ * by a null byte, which is not included in its size.
+ */
+class ORCUS_PSR_DLLPUBLIC file_content
+{
+    struct impl;
+    std::unique_ptr<impl> mp_impl;
+
+public:
+    file_content(const file_content&) = delete;
+    file_content& operator=(const file_content&) = delete;
+
+    /**
+     * @param filepath file to open.  A general_error is thrown when the file
+     *                 cannot be opened.
+     */
+    explicit file_content(const char* filepath);
+    ~file_content();
+
+    const char* data() const;
+    size_t size() const;
+    bool empty() const;
+    pstring str() const;
+};
+
 /**
  * Load the content of a file into a file stream.
  *
@@ -34,6 +67,9 @@ ORCUS_PSR_DLLPUBLIC std::string load_file_content(const char* filepath);
 ORCUS_PSR_DLLPUBLIC std::string create_parse_error_output(
     const std::string& strm, std::ptrdiff_t offset);
 
+ORCUS_PSR_DLLPUBLIC std::string create_parse_error_output(
+    const file_content& strm, std::ptrdiff_t offset);
+
 }
 
 #endif
@@ -63,6 +63,24 @@ public:
     void clear();
     size_t size() const;
 
+    /**
+     * Release the look-up index used for interning, keeping all interned
+     * strings.  Call this once no more strings are expected to be interned.
+     * The index is rebuilt on the next call to intern().
+     *
+     * @return estimated number of bytes released.
+     */
+    size_t compact();
+
+    /**
+     * Get the amount of heap memory used by the pool.  The size of the
+     * stored strings is tracked as they get interned; the size of the
+     * look-up index is derived from its bucket and element counts.
+     *
+     * @return number of bytes used.
+     */
+    size_t get_memory_usage() const;
+
     void swap(string_pool& other);
 
 private:
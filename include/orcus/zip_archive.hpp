@@ -10,6 +10,7 @@
 
 #include "env.hpp"
 #include <cstdlib>
+#include <cstdint>
 #include <exception>
 #include <string>
 #include <vector>
@@ -31,6 +32,24 @@ public:
     virtual const char* what() const throw();
 };
 
+/**
+ * Size and checksum of a single file entry, as recorded in the central
+ * directory of a zip archive.  Together they can be used to tell whether
+ * an entry has changed between two versions of an archive without
+ * uncompressing it.
+ */
+struct ORCUS_PSR_DLLPUBLIC zip_file_entry_stat
+{
+    size_t size_compressed;
+    size_t size_uncompressed;
+    uint32_t crc32;
+
+    zip_file_entry_stat();
+
+    bool operator== (const zip_file_entry_stat& r) const;
+    bool operator!= (const zip_file_entry_stat& r) const;
+};
+
 class ORCUS_PSR_DLLPUBLIC zip_archive
 {
     zip_archive_impl* mp_impl;
@@ -83,6 +102,16 @@ public:
      */
     size_t get_file_entry_count() const;
 
+    /**
+     * Get the size and checksum of a file entry without reading its data.
+     *
+     * @param entry_name file entry name.
+     * @param stat structure to put the values into.
+     *
+     * @return true if the entry exists, false otherwise.
+     */
+    bool get_file_entry_stat(const pstring& entry_name, zip_file_entry_stat& stat) const;
+
     /**
      * Retrieve data stream of specified file entry into buffer. The retrieved
      * data stream gets uncompressed if the original stream is compressed.
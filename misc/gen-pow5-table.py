@@ -0,0 +1,69 @@
+#!/usr/bin/env python
+########################################################################
+#
+#  This Source Code Form is subject to the terms of the Mozilla Public
+#  License, v. 2.0. If a copy of the MPL was not distributed with this
+#  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+#
+########################################################################
+
+"""Generate the table of 128-bit truncated powers of five used by the
+Eisel-Lemire number parsing algorithm in parse_numeric_string().
+
+Each entry is the power of five 5^q for q in [-342, 308], normalized so that
+its most significant bit is set, and stored as a pair of 64-bit words with
+the high word first.
+"""
+
+import argparse, sys
+
+smallest_power = -342
+largest_power = 308
+
+
+def gen_entries():
+    for q in range(smallest_power, 0):
+        power5 = 5 ** -q
+        z = 0
+        while (1 << z) < power5:
+            z += 1
+        if q >= -27:
+            b = z + 127
+            c = 2 ** b // power5 + 1
+        else:
+            b = 2 * z + 2 * 64
+            c = 2 ** b // power5 + 1
+            # truncate
+            while c >= (1 << 128):
+                c //= 2
+        yield q, c
+
+    for q in range(0, largest_power + 1):
+        power5 = 5 ** q
+        # move the most significant bit in position
+        while power5 < (1 << 127):
+            power5 *= 2
+        # truncate
+        while power5 >= (1 << 128):
+            power5 //= 2
+        yield q, power5
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("output", help="output .inl file")
+    args = parser.parse_args()
+
+    mask = (1 << 64) - 1
+    with open(args.output, "w") as f:
+        f.write("// This file has been auto-generated.  Do not hand-edit this.\n\n")
+        f.write("const int pow5_table_min_exp = %d;\n" % smallest_power)
+        f.write("const int pow5_table_max_exp = %d;\n\n" % largest_power)
+        f.write("const uint64_t pow5_table[] = {\n")
+        for q, v in gen_entries():
+            f.write("    0x%016xULL, 0x%016xULL, // 5^%d\n" % (v >> 64, v & mask, q))
+        f.write("};\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,116 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+ * Measure the time it takes to load a JSON document tree and to destroy
+ * it.  The input is either a JSON file, or a generated array of records
+ * of the specified size.  With "lazy", the document is loaded lazily, and
+ * the time includes looking up one value in the middle of the document.
+ *
+ * g++ -std=c++11 -O2 -I../include json_document_tree_perf.cpp \
+ *     -lorcus-0.11 -lorcus-parser-0.11
+ *
+ * Usage: json_document_tree_perf [input.json | size in MB] [repeat count] [lazy]
+ */
+
+#include "orcus/json_document_tree.hpp"
+#include "orcus/config.hpp"
+#include "orcus/stream.hpp"
+
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <cstring>
+
+#include <stdio.h>
+#include <sys/time.h>
+
+using namespace std;
+using namespace orcus;
+
+namespace {
+
+double get_time()
+{
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/**
+ * Build an array of records, each of which is an object with string,
+ * numeric, boolean and null values, and nested arrays and objects.
+ */
+string generate_json(size_t size)
+{
+    ostringstream os;
+    os << "[";
+    for (size_t i = 0; os.tellp() < static_cast<streampos>(size); ++i)
+    {
+        if (i)
+            os << ",";
+
+        os << "{\"id\":" << i
+           << ",\"name\":\"item " << i << "\""
+           << ",\"price\":" << (i % 1000) * 0.25
+           << ",\"active\":" << (i % 2 ? "true" : "false")
+           << ",\"note\":null"
+           << ",\"tags\":[\"red\",\"green\",\"blue\"]"
+           << ",\"position\":{\"x\":" << i % 97 << ",\"y\":" << i % 89 << "}}";
+    }
+    os << "]";
+    return os.str();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    string content;
+    if (argc > 1 && strtoul(argv[1], NULL, 10) == 0)
+        content = load_file_content(argv[1]);
+    else
+    {
+        size_t mb = argc > 1 ? strtoul(argv[1], NULL, 10) : 100;
+        content = generate_json(mb * 1024 * 1024);
+    }
+
+    size_t repeat = argc > 2 ? strtoul(argv[2], NULL, 10) : 3;
+
+    json_config config;
+    config.persistent_string_values = false;
+    config.lazy = argc > 3 && !strcmp(argv[3], "lazy");
+
+    double load_time = 0.0, destroy_time = 0.0;
+    for (size_t i = 0; i < repeat; ++i)
+    {
+        unique_ptr<json_document_tree> doc(new json_document_tree);
+
+        double start = get_time();
+        doc->load(content, config);
+        if (config.lazy)
+        {
+            json_document_tree::node root = doc->get_document_root();
+            root.child(root.child_count() / 2).child(0);
+        }
+        double end = get_time();
+        load_time += end - start;
+
+        doc.reset();
+        destroy_time += get_time() - end;
+    }
+
+    fprintf(stdout, "input size: %zu bytes  repeat: %zu\n", content.size(), repeat);
+    fprintf(stdout, "load: %g sec  destroy: %g sec (average)\n", load_time / repeat, destroy_time / repeat);
+
+    return EXIT_SUCCESS;
+}
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
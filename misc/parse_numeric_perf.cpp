@@ -0,0 +1,175 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+ * Compare strtod against parse_numeric_string() for classifying the cells
+ * of a CSV stream whose columns contain a mix of numbers and strings.
+ *
+ * g++ -std=c++11 -O2 -I../include parse_numeric_perf.cpp -lorcus-parser-0.11
+ */
+
+#include "orcus/csv_parser.hpp"
+#include "orcus/parser_global.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <stdio.h>
+#include <sys/time.h>
+
+using namespace std;
+
+namespace {
+
+class stack_printer
+{
+public:
+    explicit stack_printer(const char* msg) :
+        m_msg(msg)
+    {
+        fprintf(stdout, "%s: --begin\n", m_msg.c_str());
+        m_start_time = getTime();
+    }
+
+    ~stack_printer()
+    {
+        double end_time = getTime();
+        fprintf(stdout, "%s: --end (duration: %g sec)\n", m_msg.c_str(), (end_time - m_start_time));
+    }
+
+private:
+    double getTime() const
+    {
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        return tv.tv_sec + tv.tv_usec / 1000000.0;
+    }
+
+    ::std::string m_msg;
+    double m_start_time;
+};
+
+/**
+ * Build a CSV stream with integer, decimal, scientific, date and free-text
+ * columns.
+ */
+string build_csv(size_t row_count)
+{
+    ostringstream os;
+    unsigned int seed = 12345;
+    for (size_t row = 0; row < row_count; ++row)
+    {
+        seed = seed * 1103515245 + 12345;
+        os << row << ',';
+        os << (seed % 100000) / 100.0 << ',';
+        os << (seed % 997) << '.' << (seed % 31) << "e-" << (seed % 12) << ',';
+        os << "2016-" << (seed % 12 + 1) << '-' << (seed % 28 + 1) << ',';
+        os << "item " << (seed % 50) << ',';
+        os << ((seed & 1) ? "N/A" : "-12.75") << '\n';
+    }
+    return os.str();
+}
+
+class handler_base
+{
+public:
+    size_t m_numeric_count;
+    size_t m_string_count;
+    double m_sum;
+
+    handler_base() : m_numeric_count(0), m_string_count(0), m_sum(0.0) {}
+
+    void begin_parse() {}
+    void end_parse() {}
+    void begin_row() {}
+    void end_row() {}
+};
+
+/**
+ * Classify each cell the way sheet::set_auto used to, with the buffer
+ * first copied to make it null-terminated for strtod.
+ */
+class strtod_handler : public handler_base
+{
+    string m_buf;
+public:
+    void cell(const char* p, size_t n)
+    {
+        if (!n)
+            return;
+
+        m_buf.assign(p, n);
+        char* endptr = NULL;
+        double val = strtod(m_buf.c_str(), &endptr);
+        if (endptr == m_buf.c_str() + n)
+        {
+            ++m_numeric_count;
+            m_sum += val;
+        }
+        else
+            ++m_string_count;
+    }
+};
+
+class parse_numeric_handler : public handler_base
+{
+public:
+    void cell(const char* p, size_t n)
+    {
+        if (!n)
+            return;
+
+        double val = 0.0;
+        if (orcus::parse_numeric_string(p, n, val))
+        {
+            ++m_numeric_count;
+            m_sum += val;
+        }
+        else
+            ++m_string_count;
+    }
+};
+
+template<typename _Handler>
+void run(const char* name, const string& content, const orcus::csv::parser_config& config)
+{
+    _Handler hdl;
+    {
+        stack_printer __stack_printer__(name);
+        orcus::csv_parser<_Handler> parser(&content[0], content.size(), hdl, config);
+        parser.parse();
+    }
+
+    cout << "  numeric: " << hdl.m_numeric_count << "  string: " << hdl.m_string_count
+        << "  sum: " << hdl.m_sum << endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t row_count = 2000000;
+    if (argc > 1)
+        row_count = strtoul(argv[1], NULL, 10);
+
+    string content = build_csv(row_count);
+    cout << "rows: " << row_count << "  bytes: " << content.size() << endl;
+
+    orcus::csv::parser_config config;
+    config.delimiters.push_back(',');
+    config.text_qualifier = '"';
+
+    run<strtod_handler>("strtod", content, config);
+    run<parse_numeric_handler>("parse_numeric_string", content, config);
+
+    return EXIT_SUCCESS;
+}
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
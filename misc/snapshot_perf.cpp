@@ -0,0 +1,130 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+/**
+ * Compare the time it takes to import an xlsx file against the time it
+ * takes to load the same document from its binary snapshot.
+ *
+ * g++ -std=c++11 -O2 -I../include snapshot_perf.cpp -lorcus-0.11 \
+ *     -lorcus-spreadsheet-model-0.11 -lorcus-parser-0.11 -lixion-0.11
+ *
+ * Usage: snapshot_perf <input.xlsx> [snapshot file] [repeat count]
+ */
+
+#include "orcus/orcus_xlsx.hpp"
+#include "orcus/spreadsheet/document.hpp"
+#include "orcus/spreadsheet/factory.hpp"
+
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <stdio.h>
+#include <sys/time.h>
+
+using namespace std;
+using namespace orcus;
+
+namespace {
+
+class stack_printer
+{
+public:
+    explicit stack_printer(const char* msg) :
+        m_msg(msg)
+    {
+        fprintf(stdout, "%s: --begin\n", m_msg.c_str());
+        m_start_time = getTime();
+    }
+
+    ~stack_printer()
+    {
+        double end_time = getTime();
+        fprintf(stdout, "%s: --end (duration: %g sec)\n", m_msg.c_str(), (end_time - m_start_time));
+    }
+
+private:
+    double getTime() const
+    {
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        return tv.tv_sec + tv.tv_usec / 1000000.0;
+    }
+
+    ::std::string m_msg;
+    double m_start_time;
+};
+
+void import_xlsx(spreadsheet::document& doc, const char* path)
+{
+    spreadsheet::import_factory factory(doc);
+    orcus_xlsx app(&factory);
+    app.read_file(path);
+}
+
+string dump(const spreadsheet::document& doc)
+{
+    ostringstream os;
+    doc.dump_check(os);
+    return os.str();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        cerr << "usage: snapshot_perf <input.xlsx> [snapshot file] [repeat count]" << endl;
+        return EXIT_FAILURE;
+    }
+
+    const char* input_path = argv[1];
+    string snapshot_path = argc > 2 ? argv[2] : "snapshot_perf.bin";
+    size_t repeat = argc > 3 ? strtoul(argv[3], NULL, 10) : 5;
+
+    string expected;
+    {
+        spreadsheet::document doc;
+        import_xlsx(doc, input_path);
+        expected = dump(doc);
+
+        stack_printer __stack_printer__("save snapshot");
+        doc.save_snapshot(snapshot_path);
+    }
+
+    {
+        stack_printer __stack_printer__("import xlsx");
+        for (size_t i = 0; i < repeat; ++i)
+        {
+            spreadsheet::document doc;
+            import_xlsx(doc, input_path);
+        }
+    }
+
+    {
+        stack_printer __stack_printer__("load snapshot");
+        for (size_t i = 0; i < repeat; ++i)
+        {
+            spreadsheet::document doc;
+            doc.load_snapshot(snapshot_path);
+        }
+    }
+
+    // Make sure the snapshot reproduces the same content.
+    spreadsheet::document doc;
+    doc.load_snapshot(snapshot_path);
+    bool same = dump(doc) == expected;
+    cout << "repeat: " << repeat << "  content identical: " << (same ? "yes" : "no") << endl;
+
+    std::remove(snapshot_path.c_str());
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
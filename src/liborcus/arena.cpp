@@ -0,0 +1,47 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "arena.hpp"
+
+namespace orcus {
+
+namespace {
+
+const size_t block_size = 256 * 1024;
+
+/**
+ * Requests larger than this get a block of their own, so that the rest of
+ * the current block is not wasted.
+ */
+const size_t max_shared_size = block_size / 8;
+
+char* align_pointer(char* p, size_t align)
+{
+    return p + (align - reinterpret_cast<uintptr_t>(p) % align) % align;
+}
+
+}
+
+arena::arena() : mp_cur(nullptr), mp_end(nullptr) {}
+
+void* arena::allocate_slow(size_t n, size_t align)
+{
+    if (n + align > max_shared_size)
+    {
+        m_blocks.emplace_back(new char[n + align]);
+        return align_pointer(m_blocks.back().get(), align);
+    }
+
+    m_blocks.emplace_back(new char[block_size]);
+    mp_cur = m_blocks.back().get();
+    mp_end = mp_cur + block_size;
+    return allocate(n, align);
+}
+
+}
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -0,0 +1,101 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef INCLUDED_ORCUS_ARENA_HPP
+#define INCLUDED_ORCUS_ARENA_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace orcus {
+
+/**
+ * Allocates objects from large blocks of memory, which are all released
+ * together when the arena is destroyed.  Objects are never freed nor
+ * destroyed individually, so they must not own any memory that is not
+ * allocated from the same arena.
+ */
+class arena
+{
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    char* mp_cur;
+    char* mp_end;
+
+    void* allocate_slow(size_t n, size_t align);
+
+public:
+    arena();
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    void* allocate(size_t n, size_t align)
+    {
+        size_t pad = (align - reinterpret_cast<uintptr_t>(mp_cur) % align) % align;
+        if (n + pad > static_cast<size_t>(mp_end - mp_cur))
+            return allocate_slow(n, align);
+
+        char* p = mp_cur + pad;
+        mp_cur = p + n;
+        return p;
+    }
+
+    template<typename _T, typename... _Args>
+    _T* create(_Args&&... args)
+    {
+        return new (allocate(sizeof(_T), alignof(_T))) _T(std::forward<_Args>(args)...);
+    }
+};
+
+/**
+ * Standard allocator that allocates from an arena.  Deallocation does
+ * nothing, which lets containers that use it be discarded without running
+ * their destructors.
+ */
+template<typename _T>
+class arena_allocator
+{
+    template<typename _U> friend class arena_allocator;
+
+    arena* mp_arena;
+
+public:
+    typedef _T value_type;
+
+    arena_allocator(arena& a) : mp_arena(&a) {}
+
+    template<typename _U>
+    arena_allocator(const arena_allocator<_U>& other) : mp_arena(other.mp_arena) {}
+
+    _T* allocate(size_t n)
+    {
+        return static_cast<_T*>(mp_arena->allocate(n * sizeof(_T), alignof(_T)));
+    }
+
+    void deallocate(_T*, size_t) {}
+
+    template<typename _U>
+    bool operator== (const arena_allocator<_U>& other) const
+    {
+        return mp_arena == other.mp_arena;
+    }
+
+    template<typename _U>
+    bool operator!= (const arena_allocator<_U>& other) const
+    {
+        return mp_arena != other.mp_arena;
+    }
+};
+
+}
+
+#endif
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
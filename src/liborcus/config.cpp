@@ -9,13 +9,16 @@
 
 namespace orcus {
 
-config::config() : debug(false), structure_check(true) {}
+config::config() : debug(false), structure_check(true), thread_count(1), batch_row_count(0) {}
 
 json_config::json_config() :
     output_format(output_format_type::none),
     preserve_object_order(true),
     resolve_references(false),
-    persistent_string_values(true) {}
+    persistent_string_values(true),
+    lines(false),
+    thread_count(1),
+    lazy(false) {}
 
 json_config::~json_config() {}
 
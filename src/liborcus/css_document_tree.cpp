@@ -546,15 +546,20 @@ css_document_tree::~css_document_tree()
 
 void css_document_tree::load(const std::string& strm)
 {
-    if (strm.empty())
+    load(strm.data(), strm.size());
+}
+
+void css_document_tree::load(const char* p, size_t n)
+{
+    if (!n)
         return;
 
 #if ORCUS_DEBUG_CSS_DOCTREE
-    cout << "original: '" << strm << "'" << endl << endl;
+    cout << "original: '" << pstring(p, n) << "'" << endl << endl;
 #endif
 
     parser_handler handler(*this);
-    css_parser<parser_handler> parser(&strm[0], strm.size(), handler);
+    css_parser<parser_handler> parser(p, n, handler);
     parser.parse();
 }
 
@@ -34,5 +34,7 @@ const config& import_filter::get_config() const
 
 document_dumper::~document_dumper() {}
 
+void document_dumper::dump_memory_usage(std::ostream& /*os*/) const {}
+
 }}
 /* vim:set shiftwidth=4 softtabstop=4 expandtab: */
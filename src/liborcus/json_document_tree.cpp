@@ -12,8 +12,10 @@
 #include "orcus/config.hpp"
 #include "orcus/stream.hpp"
 #include "orcus/string_pool.hpp"
+#include "orcus/cell_buffer.hpp"
 
 #include "json_util.hpp"
+#include "arena.hpp"
 
 #include <string>
 #include <vector>
@@ -21,6 +23,12 @@
 #include <sstream>
 #include <limits>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <thread>
+#include <cmath>
 
 #include <boost/current_function.hpp>
 #include <boost/filesystem.hpp>
@@ -36,6 +44,11 @@ json_document_error::~json_document_error() throw() {}
 
 namespace json { namespace detail {
 
+/**
+ * Base of all value nodes.  Nodes are allocated from the arena of the
+ * document and are never destroyed individually, so none of them may own
+ * memory outside of the arena.
+ */
 struct json_value
 {
     node_t type;
@@ -43,7 +56,6 @@ struct json_value
 
     json_value() : type(node_t::unset), parent(nullptr) {}
     json_value(node_t _type) : type(_type), parent(nullptr) {}
-    virtual ~json_value() {}
 };
 
 }}
@@ -64,7 +76,6 @@ struct json_value_string : public json_value
 
     json_value_string() : json_value(node_t::string) {}
     json_value_string(const pstring& s) : json_value(node_t::string), value_string(s) {}
-    virtual ~json_value_string() {}
 };
 
 struct json_value_number : public json_value
@@ -76,37 +87,428 @@ struct json_value_number : public json_value
         value_number(std::numeric_limits<double>::quiet_NaN()) {}
 
     json_value_number(double num) : json_value(node_t::number), value_number(num) {}
+};
+
+class lazy_tape;
 
-    virtual ~json_value_number() {}
+/**
+ * Array or object.  When the document is loaded lazily, its child values
+ * are created from the tape on first access.
+ */
+struct json_value_container : public json_value
+{
+    lazy_tape* tape;      /// tape to create the child values from, or nullptr once they exist.
+    uint32_t tape_entry;  /// entry of the opening bracket or brace in the tape.
+
+    json_value_container(node_t _type) : json_value(_type), tape(nullptr), tape_entry(0) {}
 };
 
-struct json_value_array : public json_value
+struct json_value_array : public json_value_container
 {
-    std::vector<std::unique_ptr<json_value>> value_array;
+    std::vector<json_value*, arena_allocator<json_value*>> value_array;
 
-    json_value_array() : json_value(node_t::array) {}
-    virtual ~json_value_array() {}
+    json_value_array(arena& a) : json_value_container(node_t::array), value_array(a) {}
 };
 
-struct json_value_object : public json_value
+struct json_object_item
 {
-    using object_type = std::unordered_map<pstring, std::unique_ptr<json_value>, pstring::hash>;
+    pstring key;
+    json_value* value;
 
-    std::vector<pstring> key_order;
-    object_type value_object;
+    json_object_item(const pstring& _key, json_value* _value) : key(_key), value(_value) {}
+};
+
+/**
+ * Object that stores its name/value pairs in their original order.  Keys
+ * of a small object are searched linearly, and a hash index is built only
+ * once the object has more than index_threshold pairs.
+ */
+struct json_value_object : public json_value_container
+{
+    using items_type = std::vector<json_object_item, arena_allocator<json_object_item>>;
+
+    /** Maps each key to its position in the items. */
+    using index_type = std::unordered_map<
+        pstring, size_t, pstring::hash, std::equal_to<pstring>,
+        arena_allocator<std::pair<const pstring, size_t>>>;
+
+    static const size_t index_threshold = 16;
+
+    items_type items;
+    index_type* index;
 
     bool has_ref;
 
-    json_value_object() : json_value(node_t::object), has_ref(false) {}
-    virtual ~json_value_object() {}
+    json_value_object(arena& a) :
+        json_value_container(node_t::object), items(a), index(nullptr), has_ref(false) {}
+
+    json_value* find(const pstring& key) const
+    {
+        if (index)
+        {
+            auto it = index->find(key);
+            return it == index->end() ? nullptr : items[it->second].value;
+        }
+
+        for (auto it = items.begin(), ite = items.end(); it != ite; ++it)
+        {
+            if (it->key == key)
+                return it->value;
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * Append a new name/value pair.  When the key already exists, the
+     * object is left unchanged.
+     *
+     * @return value associated with the key.
+     */
+    json_value* insert(arena& a, const pstring& key, json_value* value)
+    {
+        if (index)
+        {
+            auto r = index->insert(std::make_pair(key, items.size()));
+            if (!r.second)
+                return items[r.first->second].value;
+
+            items.emplace_back(key, value);
+            return value;
+        }
+
+        json_value* existing = find(key);
+        if (existing)
+            return existing;
+
+        items.emplace_back(key, value);
+
+        if (items.size() > index_threshold)
+        {
+            index = a.create<index_type>(index_type::allocator_type(a));
+            index->reserve(items.size() * 2);
+            for (size_t i = 0, n = items.size(); i < n; ++i)
+                index->insert(std::make_pair(items[i].key, i));
+        }
+
+        return value;
+    }
 
+    /**
+     * Take over the child values of another object in the same arena.
+     */
     void swap(json_value_object& src)
     {
-        key_order.swap(src.key_order);
-        value_object.swap(src.value_object);
+        items.swap(src.items);
+        std::swap(index, src.index);
+
+        for (auto it = items.begin(), ite = items.end(); it != ite; ++it)
+            it->value->parent = this;
+
+        for (auto it = src.items.begin(), ite = src.items.end(); it != ite; ++it)
+            it->value->parent = &src;
     }
 };
 
+/**
+ * Structural index of a stream loaded lazily, along with the entry of the
+ * matching closing bracket or brace of each opening one.  Only the
+ * nesting of arrays and objects is checked during load.  The rest of the
+ * syntax of each array or object is checked when its child values are
+ * created, one level at a time.
+ */
+class lazy_tape
+{
+    const char* mp_begin;
+    size_t m_size;
+
+    std::unique_ptr<uint32_t[]> m_index;
+    std::unique_ptr<uint32_t[]> m_matches;  /// closing entry of each opening entry.
+    size_t m_entry_count;
+
+    arena& m_arena;
+    string_pool& m_pool;
+    cell_buffer m_buffer;
+
+    char entry_char(uint32_t entry) const
+    {
+        // The last entry marks the end of the stream.
+        return entry < m_entry_count ? mp_begin[m_index[entry]] : 0;
+    }
+
+    pstring create_string(uint32_t& entry)
+    {
+        uint32_t pos = m_index[entry];
+        if (entry_char(entry + 1) != '"')
+            throw json::parse_error("string: stream ended prematurely before reaching the closing quote.", pos);
+
+        const char* p = mp_begin + pos + 1;
+        size_t n = m_index[entry + 1] - pos - 1;
+        entry += 2;
+
+        if (!std::memchr(p, '\\', n))
+            return pstring(p, n);
+
+        const char* p_quote = p - 1;
+        parse_quoted_string_state res = parse_double_quoted_string(p_quote, m_size - pos, m_buffer);
+        if (!res.str)
+            throw json::parse_error("string: illegal escape character.", p_quote - mp_begin);
+
+        return m_pool.intern(res.str, res.length).first;
+    }
+
+    /**
+     * Check that only blanks follow a scalar value up to the next entry.
+     */
+    void check_value_end(const char* p, uint32_t& entry)
+    {
+        const char* p_next = mp_begin + m_index[++entry];
+        for (; p != p_next && *p <= ' '; ++p)
+            ;
+
+        if (p != p_next)
+            json::parse_error::throw_with("value: unexpected character '", *p, "' after a value.", p - mp_begin);
+    }
+
+    json_value* create_literal(uint32_t& entry, const char* literal, size_t n, node_t type)
+    {
+        uint32_t pos = m_index[entry];
+        if (m_size - pos < n || std::memcmp(mp_begin + pos, literal, n))
+            json::parse_error::throw_with("value: '", literal, n, "' expected.", pos);
+
+        check_value_end(mp_begin + pos + n, entry);
+        return m_arena.create<json_value>(type);
+    }
+
+    json_value* create_number(uint32_t& entry)
+    {
+        uint32_t pos = m_index[entry];
+        const char* p = mp_begin + pos;
+        const char* p_end = mp_begin + m_size;
+        double val = parse_numeric(p, p_end - p);
+        if (p == mp_begin + pos)
+            throw json::parse_error("parse_double_or_throw: failed to parse double precision value.", pos);
+
+        if (p != p_end && (*p == 'e' || *p == 'E'))
+        {
+            const char* p_exp = ++p;
+            long exp = parse_integer(p, p_end - p);
+            if (p == p_exp)
+                throw json::parse_error("number_with_exp: illegal exponent value.", p - mp_begin);
+
+            val *= std::pow(10.0, exp);
+        }
+
+        check_value_end(p, entry);
+        return m_arena.create<json_value_number>(val);
+    }
+
+    json_value* create_container(uint32_t& entry, json_value_container* jvc)
+    {
+        jvc->tape = this;
+        jvc->tape_entry = entry;
+        entry = m_matches[entry] + 1;
+        return jvc;
+    }
+
+    /**
+     * Create the value that starts at an entry, and move to the entry that
+     * follows the value.
+     */
+    json_value* create_value(uint32_t& entry)
+    {
+        char c = entry_char(entry);
+        switch (c)
+        {
+            case '[':
+                return create_container(entry, m_arena.create<json_value_array>(m_arena));
+            case '{':
+                return create_container(entry, m_arena.create<json_value_object>(m_arena));
+            case '"':
+                return m_arena.create<json_value_string>(create_string(entry));
+            case 't':
+                return create_literal(entry, "true", 4, node_t::boolean_true);
+            case 'f':
+                return create_literal(entry, "false", 5, node_t::boolean_false);
+            case 'n':
+                return create_literal(entry, "null", 4, node_t::null);
+            case '-':
+                return create_number(entry);
+            default:
+                if (!is_numeric(c))
+                    json::parse_error::throw_with("value: failed to parse '", c, "'.", m_index[entry]);
+
+                return create_number(entry);
+        }
+    }
+
+    void load_array(json_value_array& jva)
+    {
+        uint32_t end = m_matches[jva.tape_entry];
+        uint32_t entry = jva.tape_entry + 1;
+        while (entry != end)
+        {
+            json_value* value = create_value(entry);
+            value->parent = &jva;
+            jva.value_array.push_back(value);
+
+            if (entry == end)
+                break;
+
+            if (entry_char(entry) != ',')
+                json::parse_error::throw_with(
+                    "array: either ']' or ',' expected, but '", entry_char(entry), "' found.", m_index[entry]);
+
+            ++entry;
+        }
+    }
+
+    void load_object(json_value_object& jvo)
+    {
+        uint32_t end = m_matches[jvo.tape_entry];
+        uint32_t entry = jvo.tape_entry + 1;
+        while (entry != end)
+        {
+            if (entry_char(entry) != '"')
+                json::parse_error::throw_with(
+                    "object: '\"' was expected, but '", entry_char(entry), "' found.", m_index[entry]);
+
+            pstring key = create_string(entry);
+
+            if (entry_char(entry) != ':')
+                json::parse_error::throw_with(
+                    "object: ':' was expected, but '", entry_char(entry), "' found.", m_index[entry]);
+
+            if (++entry == end)
+                throw json::parse_error("object: '}' was found before reaching a value.", m_index[entry]);
+
+            json_value* value = create_value(entry);
+            value->parent = &jvo;
+            jvo.insert(m_arena, key, value);
+
+            if (entry == end)
+                break;
+
+            if (entry_char(entry) != ',')
+                json::parse_error::throw_with(
+                    "object: either '}' or ',' expected, but '", entry_char(entry), "' found.", m_index[entry]);
+
+            ++entry;
+        }
+    }
+
+public:
+    lazy_tape(
+        const char* p, size_t n, std::unique_ptr<uint32_t[]>&& index, size_t entry_count,
+        arena& a, string_pool& pool) :
+        mp_begin(p), m_size(n), m_index(std::move(index)),
+        m_matches(new uint32_t[entry_count]), m_entry_count(entry_count),
+        m_arena(a), m_pool(pool) {}
+
+    /**
+     * Match the brackets and braces of the whole stream.
+     *
+     * @return root node whose child values are yet to be created, or
+     *         nullptr if the stream is blank.
+     */
+    json_value* create_root()
+    {
+        if (!m_entry_count)
+            return nullptr;
+
+        std::vector<uint32_t> opened;
+        for (uint32_t entry = 0; entry < m_entry_count; ++entry)
+        {
+            char c = entry_char(entry);
+            switch (c)
+            {
+                case '[':
+                case '{':
+                    opened.push_back(entry);
+                    continue;
+                case ']':
+                case '}':
+                    // The closing character code is that of the opening one plus 2.
+                    if (opened.empty() || entry_char(opened.back()) + 2 != c)
+                        json::parse_error::throw_with(
+                            "lazy_tape: unexpected '", c, "' that does not close an array or object.",
+                            m_index[entry]);
+
+                    m_matches[opened.back()] = entry;
+                    opened.pop_back();
+                    if (opened.empty() && entry + 1 < m_entry_count)
+                        throw json::parse_error("parse: unexpected trailing string segment.", m_index[entry + 1]);
+                    continue;
+                default:
+                    ;
+            }
+
+            if (opened.empty())
+                json::parse_error::throw_with(
+                    "root_value: either '[' or '{' was expected, but '", c, "' was found.", m_index[entry]);
+        }
+
+        if (!opened.empty())
+        {
+            const char* msg = entry_char(opened.back()) == '['
+                ? "array: failed to parse array." : "object: closing '}' was never reached.";
+            throw json::parse_error(msg, m_size);
+        }
+
+        uint32_t entry = 0;
+        if (entry_char(entry) == '[')
+            return create_container(entry, m_arena.create<json_value_array>(m_arena));
+
+        return create_container(entry, m_arena.create<json_value_object>(m_arena));
+    }
+
+    /**
+     * Create the child values of an array or object.  The values of nested
+     * arrays and objects are created when they are accessed in turn.  When
+     * a syntax error is found, the values created so far are discarded,
+     * and the same error is thrown on the next access.
+     */
+    void load_children(json_value_container& jvc)
+    {
+        try
+        {
+            if (jvc.type == node_t::array)
+                load_array(static_cast<json_value_array&>(jvc));
+            else
+                load_object(static_cast<json_value_object&>(jvc));
+        }
+        catch (...)
+        {
+            if (jvc.type == node_t::array)
+                static_cast<json_value_array&>(jvc).value_array.clear();
+            else
+            {
+                json_value_object& jvo = static_cast<json_value_object&>(jvc);
+                jvo.items.clear();
+                jvo.index = nullptr;
+            }
+            throw;
+        }
+
+        jvc.tape = nullptr;
+    }
+};
+
+/**
+ * Make sure that the child values of an array or object exist, which may
+ * not be the case when the document was loaded lazily.
+ */
+void load_children(const json_value* v)
+{
+    if (v->type != node_t::array && v->type != node_t::object)
+        return;
+
+    json_value_container* jvc = const_cast<json_value_container*>(
+        static_cast<const json_value_container*>(v));
+    if (jvc->tape)
+        jvc->tape->load_children(*jvc);
+}
+
 void dump_repeat(std::ostringstream& os, const char* s, int repeat)
 {
     for (int i = 0; i < repeat; ++i)
@@ -124,6 +526,8 @@ void dump_value(std::ostringstream& os, const json_value* v, int level, const ps
     if (key)
         os << quote << *key << quote << ": ";
 
+    load_children(v);
+
     switch (v->type)
     {
         case node_t::array:
@@ -133,7 +537,7 @@ void dump_value(std::ostringstream& os, const json_value* v, int level, const ps
             size_t n = vals.size();
             size_t pos = 0;
             for (auto it = vals.begin(), ite = vals.end(); it != ite; ++it, ++pos)
-                dump_item(os, nullptr, it->get(), level, pos < (n-1));
+                dump_item(os, nullptr, *it, level, pos < (n-1));
 
             dump_repeat(os, tab, level);
             os << "]";
@@ -153,36 +557,13 @@ void dump_value(std::ostringstream& os, const json_value* v, int level, const ps
         break;
         case node_t::object:
         {
-            const std::vector<pstring>& key_order = static_cast<const json_value_object*>(v)->key_order;
-            auto& vals = static_cast<const json_value_object*>(v)->value_object;
+            auto& items = static_cast<const json_value_object*>(v)->items;
             os << "{" << std::endl;
-            size_t n = vals.size();
+            size_t n = items.size();
 
-            if (key_order.empty())
-            {
-                // Dump object's children unordered.
-                size_t pos = 0;
-                for (auto it = vals.begin(), ite = vals.end(); it != ite; ++it, ++pos)
-                {
-                    const pstring& key = it->first;
-                    auto& val = it->second;
-
-                    dump_item(os, &key, val.get(), level, pos < (n-1));
-                }
-            }
-            else
-            {
-                // Dump them based on key's original ordering.
-                size_t pos = 0;
-                for (auto it = key_order.begin(), ite = key_order.end(); it != ite; ++it, ++pos)
-                {
-                    const pstring& key = *it;
-                    auto val_pos = vals.find(key);
-                    assert(val_pos != vals.end());
-
-                    dump_item(os, &key, val_pos->second.get(), level, pos < (n-1));
-                }
-            }
+            size_t pos = 0;
+            for (auto it = items.begin(), ite = items.end(); it != ite; ++it, ++pos)
+                dump_item(os, &it->key, it->value, level, pos < (n-1));
 
             dump_repeat(os, tab, level);
             os << "}";
@@ -252,6 +633,8 @@ void dump_object_item_xml(
 
 void dump_value_xml(std::ostringstream& os, const json_value* v, int level)
 {
+    load_children(v);
+
     switch (v->type)
     {
         case node_t::array:
@@ -266,7 +649,7 @@ void dump_value_xml(std::ostringstream& os, const json_value* v, int level)
             for (auto it = vals.begin(), ite = vals.end(); it != ite; ++it)
             {
                 os << "<item>";
-                dump_value_xml(os, it->get(), level+1);
+                dump_value_xml(os, *it, level+1);
                 os << "</item>";
             }
 
@@ -294,31 +677,9 @@ void dump_value_xml(std::ostringstream& os, const json_value* v, int level)
                 os << " xmlns=\"" << NS_orcus_json_xml << "\"";
             os << ">";
 
-            auto& key_order = static_cast<const json_value_object*>(v)->key_order;
-            auto& vals = static_cast<const json_value_object*>(v)->value_object;
-
-            if (key_order.empty())
-            {
-                // Dump object's children unordered.
-                for (auto it = vals.begin(), ite = vals.end(); it != ite; ++it)
-                {
-                    auto& key = it->first;
-                    auto& val = it->second;
-                    dump_object_item_xml(os, key, val.get(), level);
-                }
-            }
-            else
-            {
-                // Dump them based on key's original ordering.
-                for (auto it = key_order.begin(), ite = key_order.end(); it != ite; ++it)
-                {
-                    auto& key = *it;
-                    auto val_pos = vals.find(key);
-                    assert(val_pos != vals.end());
-
-                    dump_object_item_xml(os, key, val_pos->second.get(), level);
-                }
-            }
+            auto& items = static_cast<const json_value_object*>(v)->items;
+            for (auto it = items.begin(), ite = items.end(); it != ite; ++it)
+                dump_object_item_xml(os, it->key, it->value, level);
 
             os << "</object>";
         }
@@ -377,13 +738,15 @@ class parser_handler
 {
     const json_config& m_config;
 
-    std::unique_ptr<json_value> m_root;
+    json_value* m_root;
+    std::vector<json_value*> m_roots;
     std::vector<parser_stack> m_stack;
     std::vector<external_ref> m_external_refs;
 
+    arena& m_arena;
     string_pool& m_pool;
 
-    json_value* push_value(std::unique_ptr<json_value>&& value)
+    json_value* push_value(json_value* value)
     {
         assert(!m_stack.empty());
         parser_stack& cur = m_stack.back();
@@ -394,8 +757,8 @@ class parser_handler
             {
                 json_value_array* jva = static_cast<json_value_array*>(cur.node);
                 value->parent = jva;
-                jva->value_array.push_back(std::move(value));
-                return jva->value_array.back().get();
+                jva->value_array.push_back(value);
+                return value;
             }
             break;
             case node_t::object:
@@ -407,7 +770,7 @@ class parser_handler
                 if (m_config.resolve_references &&
                     key == "$ref" && value->type == node_t::string)
                 {
-                    json_value_string* jvs = static_cast<json_value_string*>(value.get());
+                    json_value_string* jvs = static_cast<json_value_string*>(value);
                     if (!jvo->has_ref && !jvs->value_string.empty() && jvs->value_string[0] != '#')
                     {
                         // Store the external reference path and the destination
@@ -417,13 +780,7 @@ class parser_handler
                     }
                 }
 
-                if (m_config.preserve_object_order)
-                    jvo->key_order.push_back(key);
-
-                auto r = jvo->value_object.insert(
-                    std::make_pair(key, std::move(value)));
-
-                return r.first->second.get();
+                return jvo->insert(m_arena, key, value);
             }
             break;
             default:
@@ -438,30 +795,32 @@ class parser_handler
     }
 
 public:
-    parser_handler(const json_config& config, string_pool& pool) :
-        m_config(config), m_pool(pool) {}
+    parser_handler(const json_config& config, arena& a, string_pool& pool) :
+        m_config(config), m_root(nullptr), m_arena(a), m_pool(pool) {}
 
     void begin_parse()
     {
-        m_root.reset();
+        m_root = nullptr;
     }
 
     void end_parse()
     {
+        if (m_root)
+            m_roots.push_back(m_root);
     }
 
     void begin_array()
     {
         if (m_root)
         {
-            json_value* jv = push_value(orcus::make_unique<json_value_array>());
+            json_value* jv = push_value(m_arena.create<json_value_array>(m_arena));
             assert(jv && jv->type == node_t::array);
             m_stack.push_back(parser_stack(jv));
         }
         else
         {
-            m_root = orcus::make_unique<json_value_array>();
-            m_stack.push_back(parser_stack(m_root.get()));
+            m_root = m_arena.create<json_value_array>(m_arena);
+            m_stack.push_back(parser_stack(m_root));
         }
     }
 
@@ -475,14 +834,14 @@ public:
     {
         if (m_root)
         {
-            json_value* jv = push_value(orcus::make_unique<json_value_object>());
+            json_value* jv = push_value(m_arena.create<json_value_object>(m_arena));
             assert(jv && jv->type == node_t::object);
             m_stack.push_back(parser_stack(jv));
         }
         else
         {
-            m_root = orcus::make_unique<json_value_object>();
-            m_stack.push_back(parser_stack(m_root.get()));
+            m_root = m_arena.create<json_value_object>(m_arena);
+            m_stack.push_back(parser_stack(m_root));
         }
     }
 
@@ -503,17 +862,17 @@ public:
 
     void boolean_true()
     {
-        push_value(orcus::make_unique<json_value>(node_t::boolean_true));
+        push_value(m_arena.create<json_value>(node_t::boolean_true));
     }
 
     void boolean_false()
     {
-        push_value(orcus::make_unique<json_value>(node_t::boolean_false));
+        push_value(m_arena.create<json_value>(node_t::boolean_false));
     }
 
     void null()
     {
-        push_value(orcus::make_unique<json_value>(node_t::null));
+        push_value(m_arena.create<json_value>(node_t::null));
     }
 
     void string(const char* p, size_t len, bool transient)
@@ -523,17 +882,26 @@ public:
             // The tree manages the life cycle of this string value.
             s = m_pool.intern(s).first;
 
-        push_value(orcus::make_unique<json_value_string>(s));
+        push_value(m_arena.create<json_value_string>(s));
     }
 
     void number(double val)
     {
-        push_value(orcus::make_unique<json_value_number>(val));
+        push_value(m_arena.create<json_value_number>(val));
     }
 
-    void swap(std::unique_ptr<json_value>& other_root)
+    json_value* get_root()
     {
-        other_root.swap(m_root);
+        return m_root;
+    }
+
+    /**
+     * @return roots of all documents parsed so far, which are more than one
+     *         only for a stream in the JSON Lines format.
+     */
+    const std::vector<json_value*>& get_roots() const
+    {
+        return m_roots;
     }
 
     const std::vector<external_ref>& get_external_refs() const
@@ -542,6 +910,85 @@ public:
     }
 };
 
+/**
+ * JSON Lines streams smaller than this many bytes per thread are parsed on
+ * the calling thread.
+ */
+const size_t min_lines_chunk_size = 64 * 1024;
+
+/**
+ * Segment of a JSON Lines stream parsed by one thread.  It consists of
+ * whole lines, and its nodes and strings are stored in its own arena and
+ * string pool.
+ */
+struct lines_chunk
+{
+    const char* p;
+    size_t size;
+    size_t offset;  /// offset of the segment in the whole stream.
+
+    std::unique_ptr<arena> chunk_arena;
+    std::unique_ptr<string_pool> pool;
+    std::unique_ptr<parser_handler> handler;
+    std::exception_ptr error;
+
+    lines_chunk() : p(nullptr), size(0), offset(0) {}
+};
+
+class lines_chunk_parser
+{
+    lines_chunk& m_chunk;
+public:
+    lines_chunk_parser(lines_chunk& chunk) : m_chunk(chunk) {}
+
+    void operator() ()
+    {
+        try
+        {
+            json_parser<parser_handler> parser(m_chunk.p, m_chunk.size, *m_chunk.handler);
+            parser.parse_lines();
+        }
+        catch (const json::parse_error& e)
+        {
+            // Make the offset relative to the whole stream.
+            m_chunk.error = std::make_exception_ptr(
+                json::parse_error(e.what(), e.offset() + m_chunk.offset));
+        }
+        catch (...)
+        {
+            m_chunk.error = std::current_exception();
+        }
+    }
+};
+
+/**
+ * Joins all threads that are still running when it goes out of scope.
+ */
+class thread_joiner
+{
+    std::vector<std::thread>& m_threads;
+public:
+    thread_joiner(std::vector<std::thread>& threads) : m_threads(threads) {}
+
+    ~thread_joiner()
+    {
+        for (size_t i = 0; i < m_threads.size(); ++i)
+        {
+            if (m_threads[i].joinable())
+                m_threads[i].join();
+        }
+    }
+};
+
+void append_records(json_value_array& root, const std::vector<json_value*>& records)
+{
+    for (auto it = records.begin(), ite = records.end(); it != ite; ++it)
+    {
+        (*it)->parent = &root;
+        root.value_array.push_back(*it);
+    }
+}
+
 }
 
 namespace json { namespace detail {
@@ -580,10 +1027,12 @@ node_t node::type() const
 
 size_t node::child_count() const
 {
+    load_children(mp_impl->m_node);
+
     switch (mp_impl->m_node->type)
     {
         case node_t::object:
-            return static_cast<const json_value_object*>(mp_impl->m_node)->value_object.size();
+            return static_cast<const json_value_object*>(mp_impl->m_node)->items.size();
         case node_t::array:
             return static_cast<const json_value_array*>(mp_impl->m_node)->value_array.size();
         case node_t::string:
@@ -603,18 +1052,13 @@ std::vector<pstring> node::keys() const
     if (mp_impl->m_node->type != node_t::object)
         throw json_document_error("node::keys: this node is not of object type.");
 
-    const json_value_object* jvo = static_cast<const json_value_object*>(mp_impl->m_node);
-    if (!jvo->key_order.empty())
-        // Prefer to use key_order when it's populated.
-        return jvo->key_order;
+    load_children(mp_impl->m_node);
 
+    const json_value_object* jvo = static_cast<const json_value_object*>(mp_impl->m_node);
     std::vector<pstring> keys;
-    std::for_each(jvo->value_object.begin(), jvo->value_object.end(),
-        [&](const json_value_object::object_type::value_type& node)
-        {
-            keys.push_back(node.first);
-        }
-    );
+    keys.reserve(jvo->items.size());
+    for (auto it = jvo->items.begin(), ite = jvo->items.end(); it != ite; ++it)
+        keys.push_back(it->key);
 
     return keys;
 }
@@ -624,28 +1068,28 @@ pstring node::key(size_t index) const
     if (mp_impl->m_node->type != node_t::object)
         throw json_document_error("node::key: this node is not of object type.");
 
+    load_children(mp_impl->m_node);
+
     const json_value_object* jvo = static_cast<const json_value_object*>(mp_impl->m_node);
-    if (index >= jvo->key_order.size())
+    if (index >= jvo->items.size())
         throw std::out_of_range("node::key: index is out-of-range.");
 
-    return jvo->key_order[index];
+    return jvo->items[index].key;
 }
 
 node node::child(size_t index) const
 {
+    load_children(mp_impl->m_node);
+
     switch (mp_impl->m_node->type)
     {
         case node_t::object:
         {
-            // This works only when the key order is preserved.
             const json_value_object* jvo = static_cast<const json_value_object*>(mp_impl->m_node);
-            if (index >= jvo->key_order.size())
+            if (index >= jvo->items.size())
                 throw std::out_of_range("node::child: index is out-of-range");
 
-            const pstring& key = jvo->key_order[index];
-            auto it = jvo->value_object.find(key);
-            assert(it != jvo->value_object.end());
-            return node(it->second.get());
+            return node(jvo->items[index].value);
         }
         break;
         case node_t::array:
@@ -654,7 +1098,7 @@ node node::child(size_t index) const
             if (index >= jva->value_array.size())
                 throw std::out_of_range("node::child: index is out-of-range");
 
-            return node(jva->value_array[index].get());
+            return node(jva->value_array[index]);
         }
         break;
         case node_t::string:
@@ -673,16 +1117,18 @@ node node::child(const pstring& key) const
     if (mp_impl->m_node->type != node_t::object)
         throw json_document_error("node::child: this node is not of object type.");
 
+    load_children(mp_impl->m_node);
+
     const json_value_object* jvo = static_cast<const json_value_object*>(mp_impl->m_node);
-    auto it = jvo->value_object.find(key);
-    if (it == jvo->value_object.end())
+    json_value* jv = jvo->find(key);
+    if (!jv)
     {
         std::ostringstream os;
         os << "node::child: this object does not have a key labeled '" << key << "'";
         throw json_document_error(os.str());
     }
 
-    return node(it->second.get());
+    return node(jv);
 }
 
 node node::parent() const
@@ -715,35 +1161,80 @@ double node::numeric_value() const
 
 struct json_document_tree::impl
 {
-    std::unique_ptr<json_value> m_root;
+    std::unique_ptr<arena> m_arena;
+    json_value* m_root;
     std::unique_ptr<string_pool> m_own_pool;
     string_pool& m_pool;
 
-    impl() : m_own_pool(orcus::make_unique<string_pool>()), m_pool(*m_own_pool) {}
-    impl(string_pool& pool) : m_pool(pool) {}
+    /** Storage of the chunks of a JSON Lines stream parsed on multiple threads. */
+    std::vector<std::unique_ptr<arena>> m_chunk_arenas;
+    std::vector<std::unique_ptr<string_pool>> m_chunk_pools;
+
+    /** Tape of a document loaded lazily. */
+    std::unique_ptr<lazy_tape> m_tape;
+
+    impl() :
+        m_arena(orcus::make_unique<arena>()), m_root(nullptr),
+        m_own_pool(orcus::make_unique<string_pool>()), m_pool(*m_own_pool) {}
+
+    impl(string_pool& pool) :
+        m_arena(orcus::make_unique<arena>()), m_root(nullptr), m_pool(pool) {}
+
+    /**
+     * Parse a JSON stream into nodes allocated from the specified arena,
+     * and resolve its external references.  The referenced documents are
+     * loaded into the same arena, so that their nodes can be moved into
+     * this document.
+     *
+     * @return root node of the parsed document.
+     */
+    json_value* parse(const char* p, size_t n, const json_config& config, arena& a);
+
+    void resolve_external_refs(
+        const std::vector<external_ref>& external_refs, const json_config& config, arena& a);
+
+    /**
+     * Index the structure of a JSON stream without creating any nodes other
+     * than the root.  A json_document_error is thrown if the stream is too
+     * large to be indexed, and std::bad_alloc if the index cannot be
+     * allocated.
+     *
+     * @return root node of the document.
+     */
+    json_value* parse_lazy(const char* p, size_t n, arena& a, std::unique_ptr<lazy_tape>& tape);
+
+    /**
+     * Parse a JSON Lines stream into a root array that contains the
+     * document of each line in order.  When the stream is split into
+     * chunks that are parsed on multiple threads, the nodes of each chunk
+     * are allocated from its own arena and the strings are stored in its
+     * own pool, both of which are appended to the specified containers.
+     *
+     * @return root array node.
+     */
+    json_value* parse_lines(
+        const char* p, size_t n, const json_config& config, arena& a,
+        std::vector<std::unique_ptr<arena>>& chunk_arenas,
+        std::vector<std::unique_ptr<string_pool>>& chunk_pools);
 };
 
-json_document_tree::json_document_tree() : mp_impl(orcus::make_unique<impl>()) {}
-json_document_tree::json_document_tree(string_pool& pool) : mp_impl(orcus::make_unique<impl>(pool)) {}
-json_document_tree::~json_document_tree() {}
-
-void json_document_tree::load(const std::string& strm, const json_config& config)
+json_value* json_document_tree::impl::parse(const char* p, size_t n, const json_config& config, arena& a)
 {
-    load(strm.data(), strm.size(), config);
+    parser_handler hdl(config, a, m_pool);
+    json_parser<parser_handler> parser(p, n, hdl);
+    parser.parse_indexed();
+    json_value* root = hdl.get_root();
+    resolve_external_refs(hdl.get_external_refs(), config, a);
+    return root;
 }
 
-void json_document_tree::load(const char* p, size_t n, const json_config& config)
+void json_document_tree::impl::resolve_external_refs(
+    const std::vector<external_ref>& external_refs, const json_config& config, arena& a)
 {
-    parser_handler hdl(config, mp_impl->m_pool);
-    json_parser<parser_handler> parser(p, n, hdl);
-    parser.parse();
-    hdl.swap(mp_impl->m_root);
-
-    auto& external_refs = hdl.get_external_refs();
-
     json_config ext_config = config;
     // The stream will get destroyed after each parsing of an external json file.
     ext_config.persistent_string_values = true;
+    ext_config.lines = false;
 
     fs::path parent_dir = config.input_path;
     parent_dir = parent_dir.parent_path();
@@ -754,13 +1245,13 @@ void json_document_tree::load(const char* p, size_t n, const json_config& config
         extpath /= extfile;
 
         // Get the stream content from the path.
-        std::string ext_strm = load_file_content(extpath.string().c_str());
+        file_content ext_strm(extpath.string().c_str());
 
         ext_config.input_path = extpath.string();
-        json_document_tree doc(mp_impl->m_pool);
+        json_value* ext_root = nullptr;
         try
         {
-            doc.load(ext_strm, ext_config);
+            ext_root = parse(ext_strm.data(), ext_strm.size(), ext_config, a);
         }
         catch (const json::parse_error& e)
         {
@@ -774,12 +1265,11 @@ void json_document_tree::load(const char* p, size_t n, const json_config& config
             throw general_error(os.str());
         }
 
-        json_value* root = doc.mp_impl->m_root.get();
-        if (root->type == node_t::object)
+        if (ext_root && ext_root->type == node_t::object)
         {
-            json_value_object* jvo_src = static_cast<json_value_object*>(root);
+            json_value_object* jvo_src = static_cast<json_value_object*>(ext_root);
             json_value_object* jvo_dest = it->dest;
-            if (jvo_dest->value_object.size() == 1)
+            if (jvo_dest->items.size() == 1)
             {
                 // Swap with the referenced object only when the destination
                 // has one child value i.e. it only has '$ref'.
@@ -790,9 +1280,140 @@ void json_document_tree::load(const char* p, size_t n, const json_config& config
     }
 }
 
+json_value* json_document_tree::impl::parse_lazy(
+    const char* p, size_t n, arena& a, std::unique_ptr<lazy_tape>& tape)
+{
+    // The index stores 32-bit offsets.
+    if (n >= std::numeric_limits<uint32_t>::max())
+        throw json_document_error("stream is too large to be loaded lazily; the limit is 4 GiB.");
+
+    size_t entry_count = 0;
+    std::unique_ptr<uint32_t[]> index = json::build_structural_index(p, n, entry_count);
+    if (!index)
+        throw std::bad_alloc();
+
+    tape = orcus::make_unique<lazy_tape>(p, n, std::move(index), entry_count, a, m_pool);
+    return tape->create_root();
+}
+
+json_value* json_document_tree::impl::parse_lines(
+    const char* p, size_t n, const json_config& config, arena& a,
+    std::vector<std::unique_ptr<arena>>& chunk_arenas,
+    std::vector<std::unique_ptr<string_pool>>& chunk_pools)
+{
+    json_value_array* root = a.create<json_value_array>(a);
+
+    size_t thread_count = config.thread_count;
+    if (!thread_count)
+        thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    size_t chunk_count = std::min(thread_count, n / min_lines_chunk_size);
+    if (chunk_count <= 1)
+    {
+        parser_handler hdl(config, a, m_pool);
+        json_parser<parser_handler> parser(p, n, hdl);
+        parser.parse_lines();
+        append_records(*root, hdl.get_roots());
+        resolve_external_refs(hdl.get_external_refs(), config, a);
+        return root;
+    }
+
+    // Split the stream into chunks of roughly equal size, each of which
+    // ends at a line break.
+    std::vector<lines_chunk> chunks(chunk_count);
+    size_t pos = 0;
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+        size_t end = n;
+        if (i < chunk_count - 1)
+        {
+            end = std::max(pos, n / chunk_count * (i+1));
+            const char* eol = static_cast<const char*>(std::memchr(p + end, '\n', n - end));
+            end = eol ? eol - p + 1 : n;
+        }
+
+        lines_chunk& chunk = chunks[i];
+        chunk.p = p + pos;
+        chunk.size = end - pos;
+        chunk.offset = pos;
+        chunk.chunk_arena = orcus::make_unique<arena>();
+        chunk.pool = orcus::make_unique<string_pool>();
+        chunk.handler = orcus::make_unique<parser_handler>(config, *chunk.chunk_arena, *chunk.pool);
+        pos = end;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(chunk_count);
+    {
+        thread_joiner joiner(threads);
+        for (size_t i = 0; i < chunk_count; ++i)
+            threads.push_back(std::thread(lines_chunk_parser(chunks[i])));
+    }
+
+    // Report the error of the earliest chunk, which is the first error in
+    // the stream.
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+        if (chunks[i].error)
+            std::rethrow_exception(chunks[i].error);
+    }
+
+    size_t record_count = 0;
+    for (size_t i = 0; i < chunk_count; ++i)
+        record_count += chunks[i].handler->get_roots().size();
+
+    root->value_array.reserve(record_count);
+
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+        lines_chunk& chunk = chunks[i];
+        append_records(*root, chunk.handler->get_roots());
+
+        // The referenced documents are loaded into the arena of the chunk,
+        // so that the objects that refer to them can take over their nodes.
+        resolve_external_refs(chunk.handler->get_external_refs(), config, *chunk.chunk_arena);
+
+        chunk_arenas.push_back(std::move(chunk.chunk_arena));
+        chunk_pools.push_back(std::move(chunk.pool));
+    }
+
+    return root;
+}
+
+json_document_tree::json_document_tree() : mp_impl(orcus::make_unique<impl>()) {}
+json_document_tree::json_document_tree(string_pool& pool) : mp_impl(orcus::make_unique<impl>(pool)) {}
+json_document_tree::~json_document_tree() {}
+
+void json_document_tree::load(const std::string& strm, const json_config& config)
+{
+    load(strm.data(), strm.size(), config);
+}
+
+void json_document_tree::load(const char* p, size_t n, const json_config& config)
+{
+    // Build the new tree in its own arena, and release the old tree all at
+    // once after the new one has been loaded successfully.
+    std::unique_ptr<arena> new_arena = orcus::make_unique<arena>();
+    std::vector<std::unique_ptr<arena>> chunk_arenas;
+    std::vector<std::unique_ptr<string_pool>> chunk_pools;
+    std::unique_ptr<lazy_tape> tape;
+
+    if (config.lines)
+        mp_impl->m_root = mp_impl->parse_lines(p, n, config, *new_arena, chunk_arenas, chunk_pools);
+    else if (config.lazy)
+        mp_impl->m_root = mp_impl->parse_lazy(p, n, *new_arena, tape);
+    else
+        mp_impl->m_root = mp_impl->parse(p, n, config, *new_arena);
+
+    mp_impl->m_arena.swap(new_arena);
+    mp_impl->m_chunk_arenas.swap(chunk_arenas);
+    mp_impl->m_chunk_pools.swap(chunk_pools);
+    mp_impl->m_tape.swap(tape);
+}
+
 json_document_tree::node json_document_tree::get_document_root() const
 {
-    return node(mp_impl->m_root.get());
+    return node(mp_impl->m_root);
 }
 
 std::string json_document_tree::dump() const
@@ -800,12 +1421,12 @@ std::string json_document_tree::dump() const
     if (!mp_impl->m_root)
         return std::string();
 
-    return dump_json_tree(mp_impl->m_root.get());
+    return dump_json_tree(mp_impl->m_root);
 }
 
 std::string json_document_tree::dump_xml() const
 {
-    return dump_xml_tree(mp_impl->m_root.get());
+    return dump_xml_tree(mp_impl->m_root);
 }
 
 }
@@ -16,6 +16,7 @@
 #include <cassert>
 #include <cstdlib>
 #include <iostream>
+#include <sstream>
 
 using namespace std;
 using namespace orcus;
@@ -184,6 +185,300 @@ void test_json_parse_invalid()
     }
 }
 
+/**
+ * Load into the same tree more than once.  Each load replaces the nodes of
+ * the previous one, and a failed load leaves the previous nodes intact.
+ */
+void test_json_reload()
+{
+    json_config test_config;
+    json_document_tree doc;
+
+    // Large enough to span multiple blocks of node storage.
+    string large = "[";
+    for (size_t i = 0; i < 20000; ++i)
+    {
+        if (i)
+            large += ",";
+        large += "{\"key\": [1, 2, \"value\"]}";
+    }
+    large += "]";
+
+    doc.load(large, test_config);
+    json_document_tree::node root = doc.get_document_root();
+    assert(root.type() == json_node_t::array);
+    assert(root.child_count() == 20000);
+    assert(root.child(19999).child("key").child(2).string_value() == "value");
+
+    doc.load(string("{\"a\": 1, \"b\": [true]}"), test_config);
+    root = doc.get_document_root();
+    assert(root.type() == json_node_t::object);
+    assert(root.child_count() == 2);
+    assert(root.keys().size() == 2);
+    assert(root.child("b").child(0).type() == json_node_t::boolean_true);
+
+    try
+    {
+        doc.load(string("{\"c\": [1, 2"), test_config);
+        assert(false);
+    }
+    catch (const json::parse_error&)
+    {
+        // works as expected.
+    }
+
+    root = doc.get_document_root();
+    assert(root.type() == json_node_t::object);
+    assert(root.child("a").numeric_value() == 1.0);
+}
+
+/**
+ * Look up the keys of objects of various sizes, some of which are large
+ * enough to be indexed.  The keys stay in their original order, and the
+ * first of duplicate keys wins.
+ */
+void test_json_object_keys()
+{
+    json_config test_config;
+    test_config.preserve_object_order = false;
+
+    for (size_t n = 0; n < 40; ++n)
+    {
+        ostringstream os;
+        os << "{";
+        for (size_t i = 0; i < n; ++i)
+            os << "\"key" << (n - i) << "\": " << i << ", ";
+        os << "\"key1\": -1}";
+
+        json_document_tree doc;
+        doc.load(os.str(), test_config);
+        json_document_tree::node root = doc.get_document_root();
+
+        size_t count = n ? n : 1;
+        assert(root.child_count() == count);
+        vector<pstring> keys = root.keys();
+        assert(keys.size() == count);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            ostringstream os_key;
+            os_key << "key" << (n - i);
+            string key = os_key.str();
+            assert(keys[i] == key.c_str());
+            assert(root.key(i) == key.c_str());
+            assert(root.child(i).numeric_value() == i);
+            assert(root.child(pstring(key.data(), key.size())).numeric_value() == i);
+        }
+
+        if (!n)
+            assert(root.child("key1").numeric_value() == -1.0);
+
+        try
+        {
+            root.child("key0");
+            assert(false);
+        }
+        catch (const json_document_error&)
+        {
+            // works as expected.
+        }
+    }
+}
+
+/**
+ * Load a stream in the JSON Lines format on one and on multiple threads.
+ * Both produce the same records in the same order, and report the same
+ * error offset for a broken record.
+ */
+void test_json_lines()
+{
+    // Large enough to be split into multiple chunks.
+    ostringstream os;
+    const size_t record_count = 20000;
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        os << "{\"id\": " << i << ", \"name\": \"record \\\"" << i << "\\\"\", \"tags\": [\"a\", \"b\"]}";
+        os << (i % 100 ? "\n" : "\r\n\n");
+    }
+    string strm = os.str();
+
+    json_config test_config;
+    test_config.lines = true;
+
+    json_document_tree doc_single;
+    doc_single.load(strm, test_config);
+
+    test_config.thread_count = 4;
+    json_document_tree doc;
+    doc.load(strm, test_config);
+
+    json_document_tree::node root = doc.get_document_root();
+    assert(root.type() == json_node_t::array);
+    assert(root.child_count() == record_count);
+    for (size_t i = 0; i < record_count; ++i)
+    {
+        json_document_tree::node record = root.child(i);
+        assert(record.child("id").numeric_value() == i);
+        assert(record.parent().identity() == root.identity());
+
+        ostringstream os_name;
+        os_name << "record \"" << i << "\"";
+        assert(record.child("name").string_value() == os_name.str().c_str());
+    }
+
+    assert(doc.dump() == doc_single.dump());
+
+    json_document_tree doc_blank;
+    doc_blank.load(string("\n  \n"), test_config);
+    assert(doc_blank.get_document_root().child_count() == 0);
+
+    // Break a record near the end.
+    strm.insert(strm.size() - 3, "@");
+    std::ptrdiff_t offsets[2];
+    size_t thread_counts[2] = { 1, 4 };
+    for (size_t i = 0; i < 2; ++i)
+    {
+        test_config.thread_count = thread_counts[i];
+        try
+        {
+            json_document_tree doc_broken;
+            doc_broken.load(strm, test_config);
+            assert(false);
+        }
+        catch (const json::parse_error& e)
+        {
+            offsets[i] = e.offset();
+        }
+    }
+
+    assert(offsets[0] == offsets[1]);
+    assert(offsets[0] > std::ptrdiff_t(strm.size()) - 20);
+}
+
+/**
+ * @return dump of a stream loaded either eagerly or lazily, or "error" if
+ *         the stream failed to parse at any point.
+ */
+string load_and_dump(const string& strm, bool lazy)
+{
+    json_config test_config;
+    test_config.lazy = lazy;
+    json_document_tree doc;
+    try
+    {
+        doc.load(strm, test_config);
+        return doc.dump();
+    }
+    catch (const json::parse_error&)
+    {
+        return "error";
+    }
+}
+
+/**
+ * Load documents lazily.  They have the same content as those loaded
+ * eagerly, and the syntax errors inside arrays and objects are reported
+ * when their child nodes are accessed.
+ */
+void test_json_lazy()
+{
+    json_config test_config;
+    test_config.lazy = true;
+
+    for (size_t i = 0; i < ORCUS_N_ELEMENTS(json_test_dirs); ++i)
+        verify_input(test_config, json_test_dirs[i]);
+
+    ostringstream os;
+    os << "[";
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        if (i)
+            os << ",\n";
+        os << "{\"id\": " << i << ", \"name\": \"item \\\"" << i << "\\\"\", \"values\": [1.5e2, true, null, [], {}]}";
+    }
+    os << "]";
+    string strm = os.str();
+
+    json_document_tree doc;
+    doc.load(strm, test_config);
+    json_document_tree::node root = doc.get_document_root();
+    json_document_tree::node record = root.child(5000);
+    assert(number_expected(record.child("id"), 5000.0));
+    assert(string_expected(record.child("name"), "item \"5000\""));
+    assert(record.child("values").child_count() == 5);
+    assert(number_expected(record.child("values").child(0), 150.0));
+    assert(record.child("values").child(1).type() == json_node_t::boolean_true);
+    assert(record.child("values").child(3).child_count() == 0);
+    assert(record.parent().identity() == root.identity());
+    assert(root.child_count() == 10000);
+
+    // Errors in the nesting are found during load.
+    const char* invalids[] = { "[1, 2", "[1}", "[1] 2", "\"key\"", "{\"a\": [}]" };
+    for (size_t i = 0; i < ORCUS_N_ELEMENTS(invalids); ++i)
+    {
+        try
+        {
+            doc.load(string(invalids[i]), test_config);
+            assert(false);
+        }
+        catch (const json::parse_error&)
+        {
+            // works as expected.
+        }
+    }
+
+    // Other errors are found when the array or object that contains them
+    // is accessed, as many times as it's accessed.
+    // The stream must stay alive as long as the document.
+    strm = "[1, {\"a\": tru}, [2]]";
+    doc.load(strm, test_config);
+    root = doc.get_document_root();
+    assert(number_expected(root.child(0), 1.0));
+    assert(number_expected(root.child(2).child(0), 2.0));
+    json_document_tree::node obj = root.child(1);
+    for (size_t i = 0; i < 2; ++i)
+    {
+        try
+        {
+            obj.child("a");
+            assert(false);
+        }
+        catch (const json::parse_error& e)
+        {
+            assert(e.offset() == 10);
+        }
+    }
+
+    // Streams of random fragments either fail to parse both eagerly and
+    // lazily, or have the same content.
+    const char* fragments[] = {
+        "[", "]", "{", "}", ":", ",", " ", "\"key\"", "\"esc\\\"aped\"",
+        "12", "-3.5e1", "1e", "true", "nul", "x",
+    };
+
+    unsigned int seed = 1;
+    for (size_t i = 0; i < 20000; ++i)
+    {
+        string fuzzed = i % 2 ? "[" : "{\"k\":[";
+        for (size_t j = 0, n = i % 20; j < n; ++j)
+        {
+            seed = seed * 1103515245 + 12345;
+            fuzzed += fragments[(seed >> 16) % ORCUS_N_ELEMENTS(fragments)];
+        }
+        fuzzed += i % 2 ? "]" : "]}";
+
+        string expected = load_and_dump(fuzzed, false);
+        string actual = load_and_dump(fuzzed, true);
+        if (expected != actual)
+        {
+            cerr << "stream: '" << fuzzed << "'" << endl;
+            cerr << "expected: " << expected << endl;
+            cerr << "actual: " << actual << endl;
+            assert(false);
+        }
+    }
+}
+
 std::unique_ptr<json_document_tree> get_doc_tree(const char* filepath)
 {
     json_config test_config;
@@ -381,6 +676,10 @@ int main()
     test_json_resolve_refs();
     test_json_parse_empty();
     test_json_parse_invalid();
+    test_json_reload();
+    test_json_object_keys();
+    test_json_lines();
+    test_json_lazy();
     test_json_traverse_basic1();
     test_json_traverse_basic2();
     test_json_traverse_basic3();
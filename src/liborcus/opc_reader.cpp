@@ -66,6 +66,9 @@ private:
 
 opc_reader::part_handler::~part_handler() {}
 
+opc_reader::part_stat::part_stat(const std::string& _path, const zip_file_entry_stat& _stat) :
+    path(_path), stat(_stat) {}
+
 opc_reader::opc_reader(const config& opt, xmlns_repository& ns_repo, session_context& cxt, part_handler& handler) :
     m_config(opt),
     m_ns_repo(ns_repo),
@@ -74,25 +77,57 @@ opc_reader::opc_reader(const config& opt, xmlns_repository& ns_repo, session_con
     m_opc_rel_handler(new opc_relations_context(m_session_cxt, opc_tokens)) {}
 
 void opc_reader::read_file(std::unique_ptr<zip_archive_stream>&& stream)
+{
+    open_file(std::move(stream));
+
+    if (m_config.debug)
+        list_content();
+    read_content();
+
+    close_file();
+}
+
+void opc_reader::open_file(std::unique_ptr<zip_archive_stream>&& stream)
 {
     m_archive_stream.reset(stream.release());
     m_archive.reset(new zip_archive(m_archive_stream.get()));
 
     m_archive->load();
 
+    // Start afresh, in case a package has been read before.
+    m_parts.clear();
+    m_ext_defaults.clear();
+    m_handled_parts.clear();
+    m_read_parts.clear();
+    m_dir_stack.clear();
     m_dir_stack.push_back(string()); // push root directory.
+}
 
-    if (m_config.debug)
-        list_content();
-    read_content();
-
+void opc_reader::close_file()
+{
     m_archive.reset();
     m_archive_stream.reset();
 }
 
 bool opc_reader::open_zip_stream(const string& path, vector<unsigned char>& buf)
 {
-    return m_archive->read_file_entry(path.c_str(), buf);
+    if (!m_archive->read_file_entry(path.c_str(), buf))
+        return false;
+
+    zip_file_entry_stat stat;
+    m_archive->get_file_entry_stat(path.c_str(), stat);
+    m_read_parts.push_back(part_stat(path, stat));
+    return true;
+}
+
+bool opc_reader::get_part_stat(const std::string& path, zip_file_entry_stat& stat) const
+{
+    return m_archive->get_file_entry_stat(path.c_str(), stat);
+}
+
+const opc_reader::part_stats_type& opc_reader::get_read_parts() const
+{
+    return m_read_parts;
 }
 
 void opc_reader::read_part(const pstring& path, const schema_t type, opc_rel_extra* data)
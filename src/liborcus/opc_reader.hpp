@@ -64,11 +64,51 @@ public:
             schema_t type, const std::string& dir_path, const std::string& file_name, opc_rel_extra* data) = 0;
     };
 
+    /**
+     * Path and zip entry stat of a part that has been read.
+     */
+    struct part_stat
+    {
+        std::string path;
+        zip_file_entry_stat stat;
+
+        part_stat(const std::string& _path, const zip_file_entry_stat& _stat);
+    };
+
+    typedef std::vector<part_stat> part_stats_type;
+
     opc_reader(const config& opt, xmlns_repository& ns_repo, session_context& session_cxt, part_handler& handler);
 
+    /**
+     * Read the entire package, starting from its root relations.
+     */
     void read_file(std::unique_ptr<zip_archive_stream>&& stream);
+
+    /**
+     * Open a package without reading any part yet.  Use read_content() or
+     * read_part() to read its content, then close it with close_file().
+     */
+    void open_file(std::unique_ptr<zip_archive_stream>&& stream);
+
+    void close_file();
+
+    void read_content();
+
     bool open_zip_stream(const std::string& path, std::vector<unsigned char>& buf);
 
+    /**
+     * Get the size and checksum of a part in the currently open package.
+     *
+     * @return false if the package has no such part.
+     */
+    bool get_part_stat(const std::string& path, zip_file_entry_stat& stat) const;
+
+    /**
+     * Get the parts read since the package was opened, in the order they
+     * were read.
+     */
+    const part_stats_type& get_read_parts() const;
+
     /**
      * Read an xml part inside package.  The path is relative to the relation
      * file.
@@ -91,7 +131,6 @@ public:
 private:
 
     void list_content() const;
-    void read_content();
     void read_content_types();
     void read_relations(const char* path, std::vector<opc_rel_t>& rels);
 
@@ -112,6 +151,7 @@ private:
     std::vector<xml_part_t> m_ext_defaults;
     dir_stack_type m_dir_stack;
     part_set_type m_handled_parts;
+    part_stats_type m_read_parts;
 };
 
 }
@@ -8,13 +8,21 @@
 #include "orcus/orcus_csv.hpp"
 
 #include "orcus/csv_parser.hpp"
+#include "orcus/csv_stream_parser.hpp"
+#include "orcus/parser_global.hpp"
 #include "orcus/pstring.hpp"
 #include "orcus/global.hpp"
 #include "orcus/stream.hpp"
+#include "orcus/string_pool.hpp"
+#include "orcus/config.hpp"
 #include "orcus/spreadsheet/import_interface.hpp"
 
 #include <cstring>
 #include <iostream>
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
 
 using namespace std;
 
@@ -56,14 +64,451 @@ private:
     spreadsheet::col_t m_col;
 };
 
+csv::parser_config create_parser_config()
+{
+    csv::parser_config config;
+    config.delimiters.push_back(',');
+    config.text_qualifier = '"';
+    return config;
+}
+
+/**
+ * Inputs smaller than this many bytes per thread are parsed on the calling
+ * thread.
+ */
+const size_t min_chunk_size = 1024 * 1024;
+
+struct csv_cell
+{
+    spreadsheet::row_t row; /// row position relative to the chunk.
+    spreadsheet::col_t col;
+    size_t offset; /// offset of the value in the input stream, or in the chunk's buffer.
+    size_t size;
+    bool buffered; /// whether the value is stored in the chunk's buffer.
+
+    csv_cell(spreadsheet::row_t _row, spreadsheet::col_t _col, size_t _offset, size_t _size, bool _buffered) :
+        row(_row), col(_col), offset(_offset), size(_size), buffered(_buffered) {}
+};
+
+/**
+ * Segment of the input parsed by one thread.  It starts at the first row
+ * that begins at or past its nominal start offset, and extends to the first
+ * row that begins at or past the nominal start offset of the next chunk.
+ */
+struct csv_chunk
+{
+    size_t nominal_begin;
+    size_t nominal_end;
+    size_t quote_count; /// number of quotes between the nominal offsets.
+    size_t separator_count; /// number of delimiters and linefeeds between the nominal offsets.
+
+    size_t begin; /// offset of the first row.
+    size_t end;   /// offset at which parsing stopped.
+
+    spreadsheet::row_t row_size;
+    std::vector<csv_cell> cells;
+    std::string buffer; /// unescaped cell values, which are not in the input stream.
+    std::string error;
+    std::exception_ptr exception; /// exception other than parse_error thrown by a worker thread.
+
+    csv_chunk() :
+        nominal_begin(0), nominal_end(0), quote_count(0), separator_count(0), begin(0), end(0), row_size(0) {}
+};
+
+/**
+ * Handler that buffers the cells of a chunk for later insertion into the
+ * sheet.
+ */
+class csv_chunk_handler
+{
+public:
+    csv_chunk_handler(csv_chunk& chunk, const char* p, size_t n) :
+        m_chunk(chunk), mp_begin(p), mp_end(p+n), m_col(0) {}
+
+    void begin_parse() {}
+    void end_parse() {}
+    void begin_row() {}
+
+    void end_row()
+    {
+        ++m_chunk.row_size;
+        m_col = 0;
+    }
+
+    void cell(const char* p, size_t n)
+    {
+        if (n && (p < mp_begin || mp_end <= p))
+        {
+            // Unescaped value stored in the parser's temporary buffer.
+            m_chunk.cells.push_back(csv_cell(m_chunk.row_size, m_col, m_chunk.buffer.size(), n, true));
+            m_chunk.buffer.append(p, n);
+        }
+        else
+            m_chunk.cells.push_back(csv_cell(m_chunk.row_size, m_col, n ? p - mp_begin : 0, n, false));
+
+        ++m_col;
+    }
+
+private:
+    csv_chunk& m_chunk;
+    const char* mp_begin;
+    const char* mp_end;
+    spreadsheet::col_t m_col;
+};
+
+/**
+ * Buffers a block of cells one column at a time, and passes them to the
+ * sheet when flushed.  The type of each column is inferred from its first
+ * non-empty cell in the block.  Numeric columns are converted in bulk, and
+ * each run of numbers in consecutive rows is passed with a single
+ * set_values() call.  Cells of text columns, and the cells of numeric
+ * columns that are not numbers, go through set_auto() as usual.
+ */
+class column_batcher
+{
+    struct column_block
+    {
+        std::vector<pstring> strs;
+        std::vector<spreadsheet::row_t> rows;
+    };
+
+    std::vector<column_block> m_columns;
+    std::vector<double> m_values;
+    string_pool m_pool; /// transient cell values of the current block.
+
+    void push_values(
+        spreadsheet::iface::import_sheet& sheet, spreadsheet::col_t col,
+        const column_block& block, size_t begin, size_t end)
+    {
+        while (begin < end)
+        {
+            size_t run_end = begin + 1;
+            while (run_end < end && block.rows[run_end] == block.rows[run_end-1] + 1)
+                ++run_end;
+
+            sheet.set_values(block.rows[begin], col, &m_values[begin], run_end - begin);
+            begin = run_end;
+        }
+    }
+
+    void push_column(spreadsheet::iface::import_sheet& sheet, spreadsheet::col_t col, const column_block& block)
+    {
+        size_t n = block.strs.size();
+        if (m_values.size() < n)
+            m_values.resize(n);
+
+        size_t converted = parse_numeric_strings(block.strs.data(), n, m_values.data());
+        if (!converted)
+        {
+            // Text column.
+            for (size_t i = 0; i < n; ++i)
+                sheet.set_auto(block.rows[i], col, block.strs[i].get(), block.strs[i].size());
+            return;
+        }
+
+        size_t pos = 0;
+        while (true)
+        {
+            push_values(sheet, col, block, pos, pos + converted);
+            pos += converted;
+            if (pos == n)
+                break;
+
+            sheet.set_auto(block.rows[pos], col, block.strs[pos].get(), block.strs[pos].size());
+            ++pos;
+            converted = parse_numeric_strings(&block.strs[pos], n - pos, &m_values[pos]);
+        }
+    }
+
+public:
+    /**
+     * @param transient whether the value needs to be copied because it may
+     *                  change before the block is flushed.
+     */
+    void append(spreadsheet::row_t row, spreadsheet::col_t col, const char* p, size_t n, bool transient)
+    {
+        if (!n)
+            // Empty cells are skipped, as set_auto() does.
+            return;
+
+        if (m_columns.size() <= static_cast<size_t>(col))
+            m_columns.resize(col + 1);
+
+        column_block& block = m_columns[col];
+        block.strs.push_back(transient ? m_pool.intern(p, n).first : pstring(p, n));
+        block.rows.push_back(row);
+    }
+
+    void flush(spreadsheet::iface::import_sheet* sheet)
+    {
+        for (size_t col = 0; col < m_columns.size(); ++col)
+        {
+            column_block& block = m_columns[col];
+            if (sheet && !block.strs.empty())
+                push_column(*sheet, static_cast<spreadsheet::col_t>(col), block);
+
+            block.strs.clear();
+            block.rows.clear();
+        }
+
+        m_pool.clear();
+    }
+};
+
+/**
+ * Handler that buffers the cells of a block of rows, and passes them to
+ * the sheet one column at a time when the block is full.
+ */
+class csv_batch_handler
+{
+public:
+    csv_batch_handler(
+        spreadsheet::iface::import_factory& factory, const char* p, size_t n, size_t batch_row_count) :
+        m_factory(factory), mp_sheet(NULL), mp_begin(p), mp_end(p+n),
+        m_batch_row_count(batch_row_count), m_block_row_size(0), m_row(0), m_col(0) {}
+
+    void begin_parse()
+    {
+        const char* sheet_name = "data";
+        mp_sheet = m_factory.append_sheet(sheet_name, strlen(sheet_name));
+    }
+
+    void end_parse()
+    {
+        flush();
+    }
+
+    void begin_row() {}
+
+    void end_row()
+    {
+        ++m_row;
+        m_col = 0;
+        if (++m_block_row_size >= m_batch_row_count)
+            flush();
+    }
+
+    void cell(const char* p, size_t n)
+    {
+        // Unescaped values are stored in the parser's temporary buffer.
+        bool transient = p < mp_begin || mp_end <= p;
+        m_batcher.append(m_row, m_col, p, n, transient);
+        ++m_col;
+    }
+
+    void flush()
+    {
+        m_batcher.flush(mp_sheet);
+        m_block_row_size = 0;
+    }
+
+private:
+    spreadsheet::iface::import_factory& m_factory;
+    spreadsheet::iface::import_sheet* mp_sheet;
+    const char* mp_begin;
+    const char* mp_end;
+    column_batcher m_batcher;
+    size_t m_batch_row_count;
+    size_t m_block_row_size;
+    spreadsheet::row_t m_row;
+    spreadsheet::col_t m_col;
+};
+
+/**
+ * Parse the rows of a chunk from the specified offset, and record where
+ * parsing stopped.
+ */
+void parse_chunk(
+    const char* content, size_t len, const csv::parser_config& config,
+    csv_chunk& chunk, size_t begin)
+{
+    chunk.begin = begin;
+    chunk.end = begin;
+    chunk.row_size = 0;
+    chunk.cells.clear();
+    chunk.buffer.clear();
+    chunk.error.clear();
+
+    if (begin >= len)
+        return;
+
+    chunk.cells.reserve(chunk.separator_count + 1);
+    csv_chunk_handler handler(chunk, content, len);
+    csv_parser<csv_chunk_handler> parser(content+begin, len-begin, handler, config);
+    try
+    {
+        // The previous chunk may have ended past the nominal end of this
+        // one, in which case there is nothing to parse.
+        size_t stop = chunk.nominal_end > begin ? chunk.nominal_end - begin : 0;
+        chunk.end = begin + parser.parse_rows(stop);
+    }
+    catch (const csv::parse_error& e)
+    {
+        chunk.error = e.what();
+        chunk.end = len;
+    }
+}
+
+/**
+ * Count the quotes in a chunk, and the separators to estimate the number of
+ * cells it contains.
+ */
+class chunk_counter
+{
+    const char* mp_content;
+    const csv::parser_config& m_config;
+    csv_chunk& m_chunk;
+public:
+    chunk_counter(const char* content, const csv::parser_config& config, csv_chunk& chunk) :
+        mp_content(content), m_config(config), m_chunk(chunk) {}
+
+    void operator() ()
+    {
+        bool separators[256] = { false };
+        separators[static_cast<unsigned char>('\n')] = true;
+        for (size_t i = 0; i < m_config.delimiters.size(); ++i)
+            separators[static_cast<unsigned char>(m_config.delimiters[i])] = true;
+
+        size_t quote_count = 0, separator_count = 0;
+        const char* p = mp_content + m_chunk.nominal_begin;
+        const char* p_end = mp_content + m_chunk.nominal_end;
+        for (; p != p_end; ++p)
+        {
+            quote_count += *p == m_config.text_qualifier;
+            separator_count += separators[static_cast<unsigned char>(*p)];
+        }
+
+        m_chunk.quote_count = quote_count;
+        m_chunk.separator_count = separator_count;
+    }
+};
+
+/**
+ * Guess where the first row of a chunk begins, assuming that quotes only
+ * appear in pairs around and within quoted cell values.  The quote count
+ * parity up to the nominal start of the chunk tells whether that position
+ * is inside a quoted value.  The guess is verified after the preceding
+ * chunk has been parsed.
+ */
+class chunk_parser
+{
+    const char* mp_content;
+    size_t m_len;
+    const csv::parser_config& m_config;
+    csv_chunk& m_chunk;
+    bool m_quoted; /// whether the nominal start is inside a quoted value.
+
+public:
+    chunk_parser(
+        const char* content, size_t len, const csv::parser_config& config,
+        csv_chunk& chunk, bool quoted) :
+        mp_content(content), m_len(len), m_config(config), m_chunk(chunk), m_quoted(quoted) {}
+
+    void operator() ()
+    {
+        try
+        {
+            parse_guessed_rows();
+        }
+        catch (...)
+        {
+            // Let the committing thread rethrow it.
+            m_chunk.exception = std::current_exception();
+        }
+    }
+
+private:
+    void parse_guessed_rows()
+    {
+        // A row begins right at the nominal start when it follows a
+        // linefeed outside of a quoted value.  Otherwise skip to the next
+        // such linefeed.
+        size_t pos = m_chunk.nominal_begin;
+        if (pos && (m_quoted || mp_content[pos-1] != '\n'))
+        {
+            bool quoted = m_quoted;
+            for (; pos < m_len; ++pos)
+            {
+                char c = mp_content[pos];
+                if (c == m_config.text_qualifier)
+                    quoted = !quoted;
+                else if (c == '\n' && !quoted)
+                    break;
+            }
+
+            // Skip the linefeed.
+            if (pos < m_len)
+                ++pos;
+        }
+
+        parse_chunk(mp_content, m_len, m_config, m_chunk, pos);
+    }
+};
+
+/**
+ * Joins all threads that are still running when it goes out of scope.
+ */
+class thread_joiner
+{
+    std::vector<std::thread>& m_threads;
+public:
+    thread_joiner(std::vector<std::thread>& threads) : m_threads(threads) {}
+
+    ~thread_joiner()
+    {
+        for (size_t i = 0; i < m_threads.size(); ++i)
+        {
+            if (m_threads[i].joinable())
+                m_threads[i].join();
+        }
+    }
+};
+
+void push_chunk(
+    spreadsheet::iface::import_sheet& sheet, spreadsheet::row_t row_offset,
+    const char* content, const csv_chunk& chunk)
+{
+    std::vector<csv_cell>::const_iterator it = chunk.cells.begin(), it_end = chunk.cells.end();
+    for (; it != it_end; ++it)
+    {
+        const char* p = it->buffered ? chunk.buffer.data() : content;
+        sheet.set_auto(row_offset + it->row, it->col, p + it->offset, it->size);
+    }
+}
+
+/**
+ * Pass the cells of a chunk to the sheet in blocks of the specified number
+ * of rows.
+ */
+void push_chunk_batched(
+    spreadsheet::iface::import_sheet& sheet, spreadsheet::row_t row_offset,
+    const char* content, const csv_chunk& chunk, size_t batch_row_count, column_batcher& batcher)
+{
+    size_t block_end_row = batch_row_count;
+    std::vector<csv_cell>::const_iterator it = chunk.cells.begin(), it_end = chunk.cells.end();
+    for (; it != it_end; ++it)
+    {
+        if (static_cast<size_t>(it->row) >= block_end_row)
+        {
+            batcher.flush(&sheet);
+            block_end_row = (it->row / batch_row_count + 1) * batch_row_count;
+        }
+
+        const char* p = it->buffered ? chunk.buffer.data() : content;
+        batcher.append(row_offset + it->row, it->col, p + it->offset, it->size, false);
+    }
+
+    batcher.flush(&sheet);
+}
+
 }
 
 orcus_csv::orcus_csv(spreadsheet::iface::import_factory* factory) : mp_factory(factory) {}
 
 void orcus_csv::read_file(const string& filepath)
 {
-    string strm = load_file_content(filepath.c_str());
-    parse(&strm[0], strm.size());
+    file_content content(filepath.c_str());
+    parse(content.data(), content.size());
 
     mp_factory->finalize();
 }
@@ -78,6 +523,51 @@ void orcus_csv::read_stream(const char* content, size_t len)
     mp_factory->finalize();
 }
 
+void orcus_csv::read_stream(std::istream& is)
+{
+    // Like an empty buffer, an empty stream creates no sheet.
+    if (is.peek() == std::char_traits<char>::eof())
+    {
+        mp_factory->finalize();
+        return;
+    }
+
+    csv::parser_config config = create_parser_config();
+
+    size_t batch_row_count = get_config().batch_row_count;
+    if (batch_row_count)
+    {
+        // The window contents change as the stream is read, so the handler
+        // needs to treat all cell values as transient.
+        csv_batch_handler handler(*mp_factory, NULL, 0, batch_row_count);
+        csv_stream_parser<csv_batch_handler> parser(is, handler, config);
+        try
+        {
+            parser.parse();
+        }
+        catch (const csv::parse_error& e)
+        {
+            handler.flush();
+            cout << "parse failed: " << e.what() << endl;
+        }
+    }
+    else
+    {
+        csv_handler handler(*mp_factory);
+        csv_stream_parser<csv_handler> parser(is, handler, config);
+        try
+        {
+            parser.parse();
+        }
+        catch (const csv::parse_error& e)
+        {
+            cout << "parse failed: " << e.what() << endl;
+        }
+    }
+
+    mp_factory->finalize();
+}
+
 const char* orcus_csv::get_name() const
 {
     static const char* name = "csv";
@@ -89,10 +579,39 @@ void orcus_csv::parse(const char* content, size_t len)
     if (!len)
         return;
 
+    csv::parser_config config = create_parser_config();
+
+    size_t thread_count = get_config().thread_count;
+    if (!thread_count)
+        thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    size_t chunk_count = std::min(thread_count, len / min_chunk_size);
+    if (chunk_count > 1)
+    {
+        parse_parallel(content, len, config, chunk_count);
+        return;
+    }
+
+    size_t batch_row_count = get_config().batch_row_count;
+    if (batch_row_count)
+    {
+        csv_batch_handler handler(*mp_factory, content, len, batch_row_count);
+        csv_parser<csv_batch_handler> parser(content, len, handler, config);
+        try
+        {
+            parser.parse();
+        }
+        catch (const csv::parse_error& e)
+        {
+            // Store the rows parsed before the error, as the unbatched
+            // import does.
+            handler.flush();
+            cout << "parse failed: " << e.what() << endl;
+        }
+        return;
+    }
+
     csv_handler handler(*mp_factory);
-    csv::parser_config config;
-    config.delimiters.push_back(',');
-    config.text_qualifier = '"';
     csv_parser<csv_handler> parser(content, len, handler, config);
     try
     {
@@ -104,6 +623,78 @@ void orcus_csv::parse(const char* content, size_t len)
     }
 }
 
+void orcus_csv::parse_parallel(
+    const char* content, size_t len, const csv::parser_config& config, size_t chunk_count)
+{
+    std::vector<csv_chunk> chunks(chunk_count);
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+        chunks[i].nominal_begin = len / chunk_count * i;
+        chunks[i].nominal_end = i == chunk_count - 1 ? len : len / chunk_count * (i+1);
+    }
+
+    // First pass: count the quotes and separators in each chunk.
+    std::vector<std::thread> threads;
+    threads.reserve(chunk_count);
+    thread_joiner joiner(threads);
+    for (size_t i = 0; i < chunk_count; ++i)
+        threads.push_back(std::thread(chunk_counter(content, config, chunks[i])));
+
+    for (size_t i = 0; i < chunk_count; ++i)
+        threads[i].join();
+
+    // Second pass: parse the chunks into their own row buffers.
+    threads.clear();
+    size_t quote_count = 0;
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+        bool quoted = (quote_count % 2) != 0;
+        threads.push_back(std::thread(chunk_parser(content, len, config, chunks[i], quoted)));
+        quote_count += chunks[i].quote_count;
+    }
+
+    const char* sheet_name = "data";
+    spreadsheet::iface::import_sheet* sheet = mp_factory->append_sheet(sheet_name, strlen(sheet_name));
+
+    // Commit the rows in order, as each chunk becomes available.  A chunk
+    // whose first row was guessed wrong is parsed again from where the
+    // preceding chunk actually ended.
+    size_t batch_row_count = get_config().batch_row_count;
+    column_batcher batcher;
+    spreadsheet::row_t row_offset = 0;
+    size_t pos = 0;
+    for (size_t i = 0; i < chunk_count; ++i)
+    {
+        threads[i].join();
+        csv_chunk& chunk = chunks[i];
+        if (chunk.begin != pos)
+            parse_chunk(content, len, config, chunk, pos);
+        else if (chunk.exception)
+            std::rethrow_exception(chunk.exception);
+
+        if (sheet)
+        {
+            if (batch_row_count)
+                push_chunk_batched(*sheet, row_offset, content, chunk, batch_row_count, batcher);
+            else
+                push_chunk(*sheet, row_offset, content, chunk);
+        }
+
+        row_offset += chunk.row_size;
+        pos = chunk.end;
+
+        // Release the buffered cells early.
+        std::vector<csv_cell>().swap(chunk.cells);
+        std::string().swap(chunk.buffer);
+
+        if (!chunk.error.empty())
+        {
+            cout << "parse failed: " << chunk.error << endl;
+            return;
+        }
+    }
+}
+
 }
 
 /* vim:set shiftwidth=4 softtabstop=4 expandtab: */
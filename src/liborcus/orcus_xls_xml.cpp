@@ -77,11 +77,11 @@ void orcus_xls_xml::read_file(const string& filepath)
     cout << "reading " << filepath << endl;
 #endif
 
-    string strm = load_file_content(filepath.c_str());
-    if (strm.empty())
+    file_content content(filepath.c_str());
+    if (content.empty())
         return;
 
-    read_stream(&strm[0], strm.size());
+    read_stream(content.data(), content.size());
 }
 
 void orcus_xls_xml::read_stream(const char* content, size_t len)
@@ -33,6 +33,7 @@
 #include <string>
 #include <cstring>
 #include <sstream>
+#include <vector>
 
 using namespace std;
 
@@ -116,6 +117,52 @@ public:
     }
 };
 
+namespace {
+
+/**
+ * Worksheet part read during an import.
+ */
+struct xlsx_sheet_part
+{
+    std::string path; /// full path of the part within the package.
+    std::string name; /// sheet name.
+    size_t id;        /// sheet ID.
+
+    xlsx_sheet_part(const std::string& _path, const std::string& _name, size_t _id) :
+        path(_path), name(_name), id(_id) {}
+};
+
+/**
+ * Part read during an import, along with the worksheet whose content
+ * depends on it.
+ */
+struct xlsx_part_record
+{
+    static const size_t no_sheet = static_cast<size_t>(-1);
+
+    std::string path;
+    zip_file_entry_stat stat;
+    size_t sheet; /// index of the worksheet part, or no_sheet if shared by all.
+
+    xlsx_part_record(const std::string& _path, const zip_file_entry_stat& _stat, size_t _sheet) :
+        path(_path), stat(_stat), sheet(_sheet) {}
+};
+
+/**
+ * Range of read parts that were read while reading a single worksheet.
+ */
+struct xlsx_sheet_read_range
+{
+    size_t begin;
+    size_t end;
+    size_t sheet;
+
+    xlsx_sheet_read_range(size_t _begin, size_t _end, size_t _sheet) :
+        begin(_begin), end(_end), sheet(_sheet) {}
+};
+
+}
+
 struct orcus_xlsx_impl
 {
     session_context m_cxt;
@@ -124,11 +171,67 @@ struct orcus_xlsx_impl
     xlsx_opc_handler m_opc_handler;
     opc_reader m_opc_reader;
 
+    /** Worksheet parts of the last imported package, in import order. */
+    std::vector<xlsx_sheet_part> m_sheet_parts;
+
+    /** All parts read from the last imported package. */
+    std::vector<xlsx_part_record> m_part_records;
+
+    /** Parts read for each worksheet during the current session. */
+    std::vector<xlsx_sheet_read_range> m_sheet_read_ranges;
+
+    /** When true, worksheets are read into existing, emptied sheets. */
+    bool m_reimport;
+
     orcus_xlsx_impl(spreadsheet::iface::import_factory* factory, orcus_xlsx& parent) :
         m_cxt(new xlsx_session_data),
         mp_factory(factory),
         m_opc_handler(parent),
-        m_opc_reader(parent.get_config(), m_ns_repo, m_cxt, m_opc_handler) {}
+        m_opc_reader(parent.get_config(), m_ns_repo, m_cxt, m_opc_handler),
+        m_reimport(false) {}
+
+    void clear_records()
+    {
+        m_sheet_parts.clear();
+        m_part_records.clear();
+        m_sheet_read_ranges.clear();
+    }
+
+    /**
+     * Add a record for each part read during the current session.
+     */
+    void record_read_parts()
+    {
+        const opc_reader::part_stats_type& parts = m_opc_reader.get_read_parts();
+        for (size_t i = 0, n = parts.size(); i < n; ++i)
+        {
+            size_t sheet = xlsx_part_record::no_sheet;
+            std::vector<xlsx_sheet_read_range>::const_iterator it = m_sheet_read_ranges.begin();
+            for (; it != m_sheet_read_ranges.end(); ++it)
+            {
+                if (it->begin <= i && i < it->end)
+                {
+                    sheet = it->sheet;
+                    break;
+                }
+            }
+
+            m_part_records.push_back(xlsx_part_record(parts[i].path, parts[i].stat, sheet));
+        }
+
+        m_sheet_read_ranges.clear();
+    }
+
+    size_t find_sheet_part(const std::string& path) const
+    {
+        for (size_t i = 0, n = m_sheet_parts.size(); i < n; ++i)
+        {
+            if (m_sheet_parts[i].path == path)
+                return i;
+        }
+
+        return xlsx_part_record::no_sheet;
+    }
 };
 
 orcus_xlsx::orcus_xlsx(spreadsheet::iface::import_factory* factory) :
@@ -195,21 +298,35 @@ bool orcus_xlsx::detect(const unsigned char* blob, size_t size)
 void orcus_xlsx::read_file(const string& filepath)
 {
     std::unique_ptr<zip_archive_stream> stream(new zip_archive_stream_fd(filepath.c_str()));
-    mp_impl->m_opc_reader.read_file(std::move(stream));
+    read_package(std::move(stream));
+}
 
-    // Formulas need to be inserted to the document after the shared string
-    // table get imported, because tokenization of formulas may add new shared
-    // string instances.
-    set_formulas_to_doc();
+void orcus_xlsx::read_stream(const char* content, size_t len)
+{
+    std::unique_ptr<zip_archive_stream> stream(new zip_archive_stream_blob(
+                reinterpret_cast<const unsigned char*>(content), len));
+    read_package(std::move(stream));
+}
 
-    mp_impl->mp_factory->finalize();
+bool orcus_xlsx::reimport_file(const string& filepath)
+{
+    std::unique_ptr<zip_archive_stream> stream(new zip_archive_stream_fd(filepath.c_str()));
+    return reimport_package(std::move(stream));
 }
 
-void orcus_xlsx::read_stream(const char* content, size_t len)
+bool orcus_xlsx::reimport_stream(const char* content, size_t len)
 {
     std::unique_ptr<zip_archive_stream> stream(new zip_archive_stream_blob(
                 reinterpret_cast<const unsigned char*>(content), len));
+    return reimport_package(std::move(stream));
+}
+
+void orcus_xlsx::read_package(std::unique_ptr<zip_archive_stream>&& stream)
+{
+    mp_impl->m_reimport = false;
+    mp_impl->clear_records();
     mp_impl->m_opc_reader.read_file(std::move(stream));
+    mp_impl->record_read_parts();
 
     // Formulas need to be inserted to the document after the shared string
     // table get imported, because tokenization of formulas may add new shared
@@ -219,6 +336,95 @@ void orcus_xlsx::read_stream(const char* content, size_t len)
     mp_impl->mp_factory->finalize();
 }
 
+bool orcus_xlsx::reimport_package(std::unique_ptr<zip_archive_stream>&& stream)
+{
+    orcus_xlsx_impl& impl = *mp_impl;
+    if (impl.m_part_records.empty())
+    {
+        // Nothing has been imported yet.
+        read_package(std::move(stream));
+        return false;
+    }
+
+    impl.m_opc_reader.open_file(std::move(stream));
+
+    // Find the worksheets whose parts have changed.  A change in any part
+    // shared by all worksheets, or a missing part, requires a full import.
+    std::vector<bool> changed(impl.m_sheet_parts.size(), false);
+    bool full = false;
+    std::vector<xlsx_part_record>::const_iterator it = impl.m_part_records.begin(), it_end = impl.m_part_records.end();
+    for (; it != it_end; ++it)
+    {
+        zip_file_entry_stat stat;
+        if (impl.m_opc_reader.get_part_stat(it->path, stat) && stat == it->stat)
+            continue;
+
+        if (it->sheet == xlsx_part_record::no_sheet)
+        {
+            full = true;
+            break;
+        }
+
+        changed[it->sheet] = true;
+    }
+
+    for (size_t i = 0, n = changed.size(); !full && i < n; ++i)
+    {
+        if (!changed[i])
+            continue;
+
+        const string& name = impl.m_sheet_parts[i].name;
+        if (!impl.mp_factory->reset_sheet(name.data(), name.size()))
+            full = true;
+    }
+
+    if (full)
+    {
+        if (!impl.mp_factory->reset())
+        {
+            impl.m_opc_reader.close_file();
+            throw general_error("orcus_xlsx: the import factory doesn't support re-importing documents.");
+        }
+
+        impl.m_reimport = false;
+        impl.clear_records();
+        impl.m_opc_reader.read_content();
+    }
+    else
+    {
+        impl.m_reimport = true;
+        for (size_t i = 0, n = changed.size(); i < n; ++i)
+        {
+            if (!changed[i])
+                continue;
+
+            const xlsx_sheet_part& part = impl.m_sheet_parts[i];
+            xlsx_rel_sheet_info info;
+            info.name = pstring(part.name.data(), part.name.size());
+            info.id = part.id;
+            impl.m_opc_reader.read_part(pstring(part.path.data(), part.path.size()), SCH_od_rels_worksheet, &info);
+        }
+        impl.m_reimport = false;
+
+        // Replace the records of the re-imported worksheets.
+        std::vector<xlsx_part_record> records;
+        for (it = impl.m_part_records.begin(); it != it_end; ++it)
+        {
+            if (it->sheet == xlsx_part_record::no_sheet || !changed[it->sheet])
+                records.push_back(*it);
+        }
+        impl.m_part_records.swap(records);
+    }
+
+    impl.record_read_parts();
+    impl.m_opc_reader.close_file();
+
+    set_formulas_to_doc();
+    impl.mp_factory->finalize();
+
+    return !full;
+}
+
 const char* orcus_xlsx::get_name() const
 {
     static const char* name = "xlsx";
@@ -271,6 +477,9 @@ void orcus_xlsx::set_formulas_to_doc()
                 f.row, f.column, orcus::spreadsheet::formula_grammar_t::xlsx_2007, &f.exp[0], f.exp.size());
         }
     }
+
+    sdata.m_shared_formulas.clear();
+    sdata.m_formulas.clear();
 }
 
 void orcus_xlsx::read_workbook(const string& dir_path, const string& file_name)
@@ -320,6 +529,8 @@ void orcus_xlsx::read_sheet(const string& dir_path, const string& file_name, xls
         cout << "read_sheet: file path = " << filepath << endl;
     }
 
+    size_t parts_begin = mp_impl->m_opc_reader.get_read_parts().size();
+
     vector<unsigned char> buffer;
     if (!mp_impl->m_opc_reader.open_zip_stream(filepath, buffer))
         return;
@@ -333,9 +544,25 @@ void orcus_xlsx::read_sheet(const string& dir_path, const string& file_name, xls
         cout << "  sheet name: " << data->name << "  sheet ID: " << data->id << endl;
     }
 
-    spreadsheet::iface::import_sheet* sheet = mp_impl->mp_factory->append_sheet(data->name.get(), data->name.size());
-    if (!sheet)
-        throw general_error("orcus_xlsx::read_sheet: failed to append sheet.");
+    spreadsheet::iface::import_sheet* sheet = NULL;
+    size_t sheet_part = 0;
+    if (mp_impl->m_reimport)
+    {
+        // The sheet has been emptied before the re-import.
+        sheet = mp_impl->mp_factory->get_sheet(data->name.get(), data->name.size());
+        sheet_part = mp_impl->find_sheet_part(filepath);
+        if (!sheet || sheet_part == xlsx_part_record::no_sheet)
+            throw general_error("orcus_xlsx::read_sheet: failed to find the sheet to re-import.");
+    }
+    else
+    {
+        sheet = mp_impl->mp_factory->append_sheet(data->name.get(), data->name.size());
+        if (!sheet)
+            throw general_error("orcus_xlsx::read_sheet: failed to append sheet.");
+
+        sheet_part = mp_impl->m_sheet_parts.size();
+        mp_impl->m_sheet_parts.push_back(xlsx_sheet_part(filepath, data->name.str(), data->id));
+    }
 
     xml_stream_parser parser(
         get_config(), mp_impl->m_ns_repo, ooxml_tokens,
@@ -351,6 +578,10 @@ void orcus_xlsx::read_sheet(const string& dir_path, const string& file_name, xls
     handler->pop_rel_extras(table_info);
     handler.reset();
     mp_impl->m_opc_reader.check_relation_part(file_name, &table_info);
+
+    // All parts read so far since the sheet part belong to this sheet.
+    mp_impl->m_sheet_read_ranges.push_back(
+        xlsx_sheet_read_range(parts_begin, mp_impl->m_opc_reader.get_read_parts().size(), sheet_part));
 }
 
 void orcus_xlsx::read_shared_strings(const string& dir_path, const string& file_name)
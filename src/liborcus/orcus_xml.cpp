@@ -449,7 +449,7 @@ struct orcus_xml_impl
     spreadsheet::iface::export_factory* mp_export_factory;
 
     /** original xml data stream. */
-    string m_data_strm;
+    std::unique_ptr<file_content> mp_data_strm;
 
     /** xml namespace repository for the whole session. */
     xmlns_repository& m_ns_repo;
@@ -527,8 +527,8 @@ void orcus_xml::read_file(const char* filepath)
 #if ORCUS_DEBUG_XML
     cout << "reading file " << filepath << endl;
 #endif
-    string& strm = mp_impl->m_data_strm;
-    strm = load_file_content(filepath);
+    mp_impl->mp_data_strm.reset(new file_content(filepath));
+    const file_content& strm = *mp_impl->mp_data_strm;
     if (strm.empty())
         return;
 
@@ -568,7 +568,7 @@ void orcus_xml::read_file(const char* filepath)
     xml_data_sax_handler handler(
        *mp_impl->mp_import_factory, mp_impl->m_link_positions, mp_impl->m_map_tree);
 
-    sax_ns_parser<xml_data_sax_handler> parser(strm.c_str(), strm.size(), ns_cxt, handler);
+    sax_ns_parser<xml_data_sax_handler> parser(strm.data(), strm.size(), ns_cxt, handler);
     parser.parse();
 }
 
@@ -591,7 +591,7 @@ void orcus_xml::write_file(const char* filepath)
         // We can't export data witout export factory.
         return;
 
-    if (mp_impl->m_data_strm.empty())
+    if (!mp_impl->mp_data_strm || mp_impl->mp_data_strm->empty())
         // Original xml stream is missing.  We need it.
         return;
 
@@ -618,7 +618,7 @@ void orcus_xml::write_file(const char* filepath)
     dump_links(links);
 #endif
 
-    const char* begin_pos = &mp_impl->m_data_strm[0];
+    const char* begin_pos = mp_impl->mp_data_strm->data();
     for (; it != it_end; ++it)
     {
         const xml_map_tree::element& elem = **it;
@@ -688,7 +688,7 @@ void orcus_xml::write_file(const char* filepath)
     }
 
     // Flush the remaining stream.
-    const char* strm_end = &mp_impl->m_data_strm[mp_impl->m_data_strm.size()-1];
+    const char* strm_end = mp_impl->mp_data_strm->data() + mp_impl->mp_data_strm->size() - 1;
     file << pstring(begin_pos, strm_end-begin_pos);
 }
 
@@ -56,6 +56,12 @@ import_conditional_format* import_sheet::get_conditional_format()
     return NULL;
 }
 
+void import_sheet::set_values(row_t row, col_t col, const double* values, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        set_value(row + i, col, values[i]);
+}
+
 import_global_settings::~import_global_settings() {}
 
 import_factory::~import_factory() {}
@@ -75,10 +81,82 @@ import_styles* import_factory::get_styles()
     return NULL;
 }
 
+import_sheet* import_factory::reset_sheet(const char*, size_t)
+{
+    return NULL;
+}
+
+bool import_factory::reset()
+{
+    return false;
+}
+
+column_chunk::column_chunk() :
+    row_start(0), length(0), numeric_null_count(0), string_null_count(0) {}
+
+void column_chunk::reset(row_t _row_start, size_t _length)
+{
+    row_start = _row_start;
+    length = _length;
+
+    size_t bitmap_size = (length + 7) / 8;
+
+    numeric_values.assign(length, 0.0);
+    numeric_validity.assign(bitmap_size, 0);
+    numeric_null_count = length;
+
+    string_ids.assign(length, 0);
+    string_validity.assign(bitmap_size, 0);
+    string_null_count = length;
+
+    type_run_ends.clear();
+    type_run_values.clear();
+}
+
+void column_chunk::append_type_run(column_cell_t type, size_t run_length)
+{
+    if (!run_length)
+        return;
+
+    if (!type_run_values.empty() && type_run_values.back() == type)
+    {
+        type_run_ends.back() += static_cast<int32_t>(run_length);
+        return;
+    }
+
+    int32_t end = type_run_ends.empty() ? 0 : type_run_ends.back();
+    type_run_ends.push_back(end + static_cast<int32_t>(run_length));
+    type_run_values.push_back(type);
+}
+
+void string_table::clear()
+{
+    offsets.clear();
+    data.clear();
+}
+
 export_sheet::~export_sheet() {}
 
+void export_sheet::get_data_size(row_t& row_count, col_t& col_count) const
+{
+    row_count = 0;
+    col_count = 0;
+}
+
+void export_sheet::get_column_chunk(col_t /*col*/, row_t row_start, size_t length, column_chunk& chunk) const
+{
+    chunk.reset(row_start, length);
+    chunk.append_type_run(column_cell_t::empty, length);
+}
+
 export_factory::~export_factory() {}
 
+void export_factory::get_string_table(string_table& table) const
+{
+    table.clear();
+    table.offsets.push_back(0);
+}
+
 }}}
 
 /* vim:set shiftwidth=4 softtabstop=4 expandtab: */
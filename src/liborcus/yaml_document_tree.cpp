@@ -554,9 +554,14 @@ yaml_document_tree::yaml_document_tree() : mp_impl(orcus::make_unique<impl>()) {
 yaml_document_tree::~yaml_document_tree() {}
 
 void yaml_document_tree::load(const std::string& strm)
+{
+    load(strm.data(), strm.size());
+}
+
+void yaml_document_tree::load(const char* p, size_t n)
 {
     handler hdl;
-    yaml_parser<handler> parser(strm.data(), strm.size(), hdl);
+    yaml_parser<handler> parser(p, n, hdl);
     parser.parse();
     hdl.swap(mp_impl->m_docs);
 }
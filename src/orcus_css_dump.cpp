@@ -14,9 +14,9 @@ int main(int argc, char** argv)
         return EXIT_FAILURE;
 
     const char* filepath = argv[1];
-    std::string strm = orcus::load_file_content(filepath);
+    orcus::file_content strm(filepath);
     orcus::css_document_tree doc;
-    doc.load(strm);
+    doc.load(strm.data(), strm.size());
     doc.dump();
 
     return EXIT_SUCCESS;
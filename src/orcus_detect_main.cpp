@@ -22,7 +22,7 @@ int main(int argc, char** argv) try
         return EXIT_FAILURE;
 
     const char* filepath = argv[1];
-    string strm = load_file_content(filepath);
+    file_content strm(filepath);
 
     if (strm.empty())
     {
@@ -30,7 +30,7 @@ int main(int argc, char** argv) try
         return EXIT_FAILURE;
     }
 
-    format_t detected_type = detect(reinterpret_cast<const unsigned char*>(&strm[0]), strm.size());
+    format_t detected_type = detect(reinterpret_cast<const unsigned char*>(strm.data()), strm.size());
 
     cout << "type: ";
     switch (detected_type)
@@ -35,7 +35,7 @@ const char* help_output =
 
 const char* help_output_format =
 "Specify the format of output file.  Supported format types are: "
-"1) flat text format (flat), 2) HTML format (html), or 3) no output (none).";
+"1) flat text format (flat), 2) HTML format (html), 3) CSV format (csv), or 4) no output (none).";
 
 const char* help_dump_check =
 "Dump the the content to stdout in a special format used for content verification in unit tests.";
@@ -43,6 +43,17 @@ const char* help_dump_check =
 const char* help_debug =
 "Turn on a debug mode to generate run-time debug output.";
 
+const char* help_mem_report =
+"Print the amount of memory used by the loaded document to stdout, broken down by its internal structures.";
+
+const char* help_thread_count =
+"Number of threads to use when parsing the input, for the filters that support parallel parsing.  "
+"Specify 0 to use as many threads as the hardware supports.  The default is 1.";
+
+const char* help_batch_rows =
+"Number of rows to buffer before storing them one column at a time, for the filters that support batched import.  "
+"Numeric columns are then converted and stored in bulk.  The default is 0, which stores each cell as it is parsed.";
+
 const char* help_json_output =
 "Output file path.";
 
@@ -53,6 +64,14 @@ const char* help_json_output_format =
 "  3) flat tree dump (check)\n"
 "  4) no output (none).";
 
+const char* help_json_lines =
+"Parse the input in the JSON Lines format, where each line contains one JSON document.  "
+"The documents are output as the elements of one array.";
+
+const char* help_json_thread_count =
+"Number of threads to use when parsing the input in the JSON Lines format.  "
+"Specify 0 to use as many threads as the hardware supports.  The default is 1.";
+
 const char* err_no_input_file = "No input file.";
 
 }
@@ -88,6 +107,9 @@ bool parse_import_filter_args(
         ("help,h", "Print this help.")
         ("debug,d", help_debug)
         ("dump-check", help_dump_check)
+        ("mem-report", help_mem_report)
+        ("thread-count,t", po::value<size_t>(), help_thread_count)
+        ("batch-rows", po::value<size_t>(), help_batch_rows)
         ("output,o", po::value<string>(), help_output)
         ("output-format,f", po::value<string>(), help_output_format);
 
@@ -134,6 +156,20 @@ bool parse_import_filter_args(
     if (vm.count("output-format"))
         outformat = vm["output-format"].as<string>();
 
+    if (vm.count("thread-count"))
+    {
+        config opt = app.get_config();
+        opt.thread_count = vm["thread-count"].as<size_t>();
+        app.set_config(opt);
+    }
+
+    if (vm.count("batch-rows"))
+    {
+        config opt = app.get_config();
+        opt.batch_row_count = vm["batch-rows"].as<size_t>();
+        app.set_config(opt);
+    }
+
     json_config opt;
 
     if (infile.empty())
@@ -142,15 +178,24 @@ bool parse_import_filter_args(
         return false;
     }
 
+    bool mem_report = vm.count("mem-report") > 0;
+
     if (vm.count("dump-check"))
     {
         // 'outdir' is used as the output file path in this mode.
-        return handle_dump_check(app, doc, infile, outdir);
+        bool ret = handle_dump_check(app, doc, infile, outdir);
+        if (ret && mem_report)
+            doc.dump_memory_usage(cout);
+        return ret;
     }
 
+    if (outformat.empty() && mem_report)
+        // Only report the memory usage.
+        outformat = "none";
+
     if (outformat.empty())
     {
-        cerr << "No output format specified.  Choose either 'flat', 'html' or 'none'." << endl;
+        cerr << "No output format specified.  Choose either 'flat', 'html', 'csv' or 'none'." << endl;
         return false;
     }
 
@@ -158,6 +203,8 @@ bool parse_import_filter_args(
     {
         // When "none" format is specified, just read the input file and exit.
         app.read_file(infile);
+        if (mem_report)
+            doc.dump_memory_usage(cout);
         return true;
     }
 
@@ -184,12 +231,17 @@ bool parse_import_filter_args(
         doc.dump_flat(outdir);
     else if (outformat == "html")
         doc.dump_html(outdir);
+    else if (outformat == "csv")
+        doc.dump_csv(outdir);
     else
     {
         // Do nothing, but warning about unknown output format type.
         cerr << "Unknown output format type '" << outformat << "'. No output files have been generated." << endl;
     }
 
+    if (mem_report)
+        doc.dump_memory_usage(cout);
+
     return true;
 }
 
@@ -205,6 +257,8 @@ std::unique_ptr<json_config> parse_json_args(int argc, char** argv)
     desc.add_options()
         ("help,h", "Print this help.")
         ("resolve-refs", "Resolve JSON references to external files.")
+        ("lines,l", help_json_lines)
+        ("thread-count,t", po::value<size_t>(), help_json_thread_count)
         ("output,o", po::value<string>(), help_json_output)
         ("output-format,f", po::value<string>(), help_json_output_format);
 
@@ -250,6 +304,12 @@ std::unique_ptr<json_config> parse_json_args(int argc, char** argv)
     if (vm.count("resolve-refs"))
         config->resolve_references = true;
 
+    if (vm.count("lines"))
+        config->lines = true;
+
+    if (vm.count("thread-count"))
+        config->thread_count = vm["thread-count"].as<size_t>();
+
     if (vm.count("output-format"))
     {
         std::string outformat = vm["output-format"].as<string>();
@@ -23,12 +23,12 @@
 using namespace std;
 using namespace orcus;
 
-std::unique_ptr<json_document_tree> load_doc(const std::string& strm, const json_config& config)
+std::unique_ptr<json_document_tree> load_doc(const file_content& strm, const json_config& config)
 {
     std::unique_ptr<json_document_tree> doc(orcus::make_unique<json_document_tree>());
     try
     {
-        doc->load(strm, config);
+        doc->load(strm.data(), strm.size(), config);
     }
     catch (const json::parse_error& e)
     {
@@ -46,7 +46,7 @@ int main(int argc, char** argv)
 
     try
     {
-        std::string strm = load_file_content(config->input_path.c_str());
+        file_content strm(config->input_path.c_str());
         std::unique_ptr<json_document_tree> doc = load_doc(strm, *config);
 
         switch (config->output_format)
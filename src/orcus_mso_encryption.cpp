@@ -17,12 +17,12 @@ int main(int argc, char** argv) try
         return EXIT_FAILURE;
 
     mso::encryption_info_reader reader;
-    string strm = load_file_content(argv[1]);
+    file_content strm(argv[1]);
 
     if (strm.empty())
         return EXIT_FAILURE;
 
-    reader.read(&strm[0], strm.size());
+    reader.read(strm.data(), strm.size());
 
     return EXIT_SUCCESS;
 }
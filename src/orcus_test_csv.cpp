@@ -6,17 +6,24 @@
  */
 
 #include "orcus/orcus_csv.hpp"
+#include "orcus/csv_parser.hpp"
+#include "orcus/csv_stream_parser.hpp"
+#include "orcus/config.hpp"
 #include "orcus/pstring.hpp"
 #include "orcus/global.hpp"
 #include "orcus/stream.hpp"
 #include "orcus/spreadsheet/factory.hpp"
 #include "orcus/spreadsheet/document.hpp"
+#include "orcus/spreadsheet/sheet.hpp"
 
 #include <cstdlib>
 #include <cassert>
+#include <clocale>
+#include <cstring>
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 using namespace orcus;
 using namespace std;
@@ -63,11 +70,427 @@ void test_csv_import()
     }
 }
 
+/**
+ * Write each imported document back out as CSV, import that again, and
+ * check that the content survives the round trip.
+ */
+void test_csv_export()
+{
+    size_t n = sizeof(dirs)/sizeof(dirs[0]);
+    for (size_t i = 0; i < n; ++i)
+    {
+        string path(dirs[i]);
+        path.append("input.csv");
+        spreadsheet::document doc;
+        spreadsheet::import_factory factory(doc);
+        orcus_csv app(&factory);
+        app.read_file(path.c_str());
+
+        const spreadsheet::sheet* sh = doc.get_sheet(0);
+        assert(sh);
+        ostringstream os_csv;
+        sh->dump_csv(os_csv);
+        string csv = os_csv.str();
+        assert(!csv.empty());
+
+        spreadsheet::document doc2;
+        spreadsheet::import_factory factory2(doc2);
+        orcus_csv app2(&factory2);
+        app2.read_stream(csv.data(), csv.size());
+
+        ostringstream os1, os2;
+        doc.dump_check(os1);
+        doc2.dump_check(os2);
+        assert(os1.str() == os2.str());
+    }
+}
+
+/**
+ * Numbers are written with '.' as the decimal separator even when the C
+ * locale uses ',', which would otherwise split the cells of the exported
+ * CSV.
+ */
+void test_csv_export_locale()
+{
+    const char* content = "0.1,-2.5,1234567.125\n0.333333333333,1e-7,42\n";
+
+    spreadsheet::document doc;
+    spreadsheet::import_factory factory(doc);
+    orcus_csv app(&factory);
+    app.read_stream(content, strlen(content));
+    const spreadsheet::sheet* sh = doc.get_sheet(0);
+    assert(sh);
+
+    ostringstream os_csv, os_check;
+    sh->dump_csv(os_csv);
+    doc.dump_check(os_check);
+
+    const char* locales[] = {
+        "de_DE.UTF-8", "de_DE.utf8", "de_DE", "fr_FR.UTF-8", "fr_FR.utf8", "fr_FR"
+    };
+
+    string saved = setlocale(LC_NUMERIC, NULL);
+    const char* found = NULL;
+    for (size_t i = 0; i < sizeof(locales)/sizeof(locales[0]) && !found; ++i)
+        found = setlocale(LC_NUMERIC, locales[i]);
+
+    if (!found)
+    {
+        cout << "test_csv_export_locale: no locale with a ',' decimal separator is available." << endl;
+        return;
+    }
+
+    ostringstream os_csv_locale, os_check_locale;
+    sh->dump_csv(os_csv_locale);
+    doc.dump_check(os_check_locale);
+    setlocale(LC_NUMERIC, saved.c_str());
+
+    assert(os_csv_locale.str() == os_csv.str());
+    assert(os_check_locale.str() == os_check.str());
+    assert(os_csv.str().find("0.1,-2.5,") == 0);
+}
+
+typedef std::vector<std::vector<std::string>> csv_rows_type;
+
+class csv_rows_handler
+{
+    csv_rows_type& m_rows;
+public:
+    csv_rows_handler(csv_rows_type& rows) : m_rows(rows) {}
+
+    void begin_parse() {}
+    void end_parse() {}
+    void begin_row() { m_rows.push_back(std::vector<std::string>()); }
+    void end_row() {}
+
+    void cell(const char* p, size_t n)
+    {
+        m_rows.back().push_back(std::string(p, n));
+    }
+};
+
+/**
+ * The parser scans its input in blocks.  Shift the same content across the
+ * block boundaries to make sure that delimiters, quotes and escaped quotes
+ * are found regardless of where they fall.
+ */
+void test_csv_parser_block_boundaries()
+{
+    const std::string long_value(100, 'v');
+
+    std::string body;
+    body += "plain,\"quoted, with delimiter\",\"escaped \"\"quote\"\"\"\n";
+    body += ",,\"\"\"\",\"multi\nline\"\n";
+    body += long_value + ",\"" + long_value + "\"\"" + long_value + "\",end";
+
+    csv_rows_type expected;
+    expected.push_back(std::vector<std::string>());
+    expected.back().push_back("plain");
+    expected.back().push_back("quoted, with delimiter");
+    expected.back().push_back("escaped \"quote\"");
+    expected.push_back(std::vector<std::string>());
+    expected.back().push_back("");
+    expected.back().push_back("");
+    expected.back().push_back("\"");
+    expected.back().push_back("multi\nline");
+    expected.push_back(std::vector<std::string>());
+    expected.back().push_back(long_value);
+    expected.back().push_back(long_value + "\"" + long_value);
+    expected.back().push_back("end");
+
+    csv::parser_config config;
+    config.delimiters.push_back(',');
+    config.text_qualifier = '"';
+
+    for (size_t shift = 0; shift < 130; ++shift)
+    {
+        std::string content(shift, 'p');
+        content += "\n";
+        content += body;
+
+        csv_rows_type rows;
+        csv_rows_handler hdl(rows);
+        csv_parser<csv_rows_handler> parser(content.data(), content.size(), hdl, config);
+        parser.parse();
+
+        assert(rows.size() == expected.size() + 1);
+        assert(rows[0].size() == 1 && rows[0][0] == std::string(shift, 'p'));
+        for (size_t i = 0; i < expected.size(); ++i)
+            assert(rows[i+1] == expected[i]);
+    }
+
+    // A trailing delimiter ends with an empty cell.
+    std::string content = "a,";
+    csv_rows_type rows;
+    csv_rows_handler hdl(rows);
+    csv_parser<csv_rows_handler> parser(content.data(), content.size(), hdl, config);
+    parser.parse();
+    assert(rows.size() == 1 && rows[0].size() == 2);
+    assert(rows[0][0] == "a" && rows[0][1].empty());
+}
+
+string import_dump(const string& content, size_t thread_count, size_t batch_row_count = 0)
+{
+    spreadsheet::document doc;
+    spreadsheet::import_factory factory(doc);
+    orcus_csv app(&factory);
+    config opt;
+    opt.thread_count = thread_count;
+    opt.batch_row_count = batch_row_count;
+    app.set_config(opt);
+    app.read_stream(content.data(), content.size());
+
+    ostringstream os;
+    doc.dump_check(os);
+    return os.str();
+}
+
+/**
+ * Import a few megabytes of generated content on multiple threads, and
+ * check that the result matches that of the single-threaded import.  The
+ * content has quoted cells spanning multiple lines, and quotes in
+ * unquoted cells which throw off the guessed chunk boundaries.
+ */
+void test_csv_import_parallel()
+{
+    for (size_t stray_quotes = 0; stray_quotes < 2; ++stray_quotes)
+    {
+        string content;
+        unsigned int seed = 1;
+        while (content.size() < 3 * 1024 * 1024)
+        {
+            for (size_t col = 0; col < 5; ++col)
+            {
+                seed = seed * 1103515245 + 12345;
+                unsigned int r = (seed >> 16) % 16;
+
+                if (col)
+                    content.push_back(',');
+
+                if (r == 0)
+                    content += "\"multi\nline, with \"\"quotes\"\"\"";
+                else if (r == 1 && stray_quotes)
+                    content += "5\" tall";
+                else if (r < 8)
+                    content += "text";
+                else
+                {
+                    ostringstream os;
+                    os << (seed >> 8) % 100000;
+                    content += os.str();
+                }
+            }
+            content.push_back('\n');
+        }
+
+        string expected = import_dump(content, 1);
+        assert(!expected.empty());
+        assert(import_dump(content, 4) == expected);
+    }
+
+    // A quoted cell that spans more than one whole chunk, so that the
+    // preceding chunk ends past the nominal end of the next one.
+    string content = "a,b\n\"" + string(3 * 1024 * 1024, 'x') + "\",1\n";
+    for (size_t i = 0; i < 1000; ++i)
+        content += "text,2\n";
+
+    string expected = import_dump(content, 1);
+    assert(!expected.empty());
+    assert(import_dump(content, 4) == expected);
+}
+
+}
+
+/**
+ * Import with cells batched by column, and check that the result matches
+ * that of the cell-by-cell import.  The numeric columns contain the
+ * occasional text cell, empty cell and quoted number.
+ */
+void test_csv_import_batched()
+{
+    size_t n = sizeof(dirs)/sizeof(dirs[0]);
+    for (size_t i = 0; i < n; ++i)
+    {
+        string path(dirs[i]);
+        path.append("input.csv");
+        string content = load_file_content(path.c_str());
+        string expected = import_dump(content, 1);
+        assert(import_dump(content, 1, 1) == expected);
+        assert(import_dump(content, 1, 1000) == expected);
+    }
+
+    string content;
+    unsigned int seed = 1;
+    while (content.size() < 3 * 1024 * 1024)
+    {
+        for (size_t col = 0; col < 5; ++col)
+        {
+            seed = seed * 1103515245 + 12345;
+            unsigned int r = (seed >> 16) % 32;
+
+            if (col)
+                content.push_back(',');
+
+            if (r == 0)
+                content += "text";
+            else if (r == 1)
+                content += "\"-12.5\"";
+            else if (r == 2)
+                ; // empty cell
+            else if (col == 0)
+                content += "label";
+            else
+            {
+                ostringstream os;
+                if (r % 2)
+                    os << (seed >> 8) % 1000000;
+                else
+                    os << -double((seed >> 8) % 100000) / 100;
+                content += os.str();
+            }
+        }
+        content.push_back('\n');
+    }
+
+    string expected = import_dump(content, 1);
+    assert(!expected.empty());
+    assert(import_dump(content, 1, 7) == expected);
+    assert(import_dump(content, 1, 4096) == expected);
+    assert(import_dump(content, 4, 4096) == expected);
+}
+
+/**
+ * Parse through windows of various sizes, and check that the rows match
+ * those parsed from the whole content.  Quoted cells span window
+ * boundaries, and some rows are longer than the window.
+ */
+void test_csv_stream_parser()
+{
+    const char* fragments[] = {
+        "a", ",", "\n", "\"", "\"\"", " ", "plain text", "\"quoted,\nvalue\"", "12.5", "\"\"\""
+    };
+    const size_t fragment_count = sizeof(fragments)/sizeof(fragments[0]);
+
+    csv::parser_config config;
+    config.delimiters.push_back(',');
+    config.text_qualifier = '"';
+
+    unsigned int seed = 1;
+    for (size_t i = 0; i < 500; ++i)
+    {
+        std::string content;
+        for (size_t j = 0; j < 40; ++j)
+        {
+            seed = seed * 1103515245 + 12345;
+            content += fragments[(seed >> 16) % fragment_count];
+        }
+
+        if (i % 10 == 0)
+            content += std::string(300, 'L') + ",\"" + std::string(300, 'Q') + "\"\n";
+
+        config.trim_cell_value = (i % 2) != 0;
+
+        csv_rows_type expected;
+        bool expected_error = false;
+        {
+            csv_rows_handler hdl(expected);
+            csv_parser<csv_rows_handler> parser(content.data(), content.size(), hdl, config);
+            try
+            {
+                parser.parse();
+            }
+            catch (const csv::parse_error&)
+            {
+                expected_error = true;
+            }
+        }
+
+        const size_t window_sizes[] = { 1, 3, 16, 64, 4096 };
+        for (size_t j = 0; j < sizeof(window_sizes)/sizeof(window_sizes[0]); ++j)
+        {
+            csv_rows_type rows;
+            csv_rows_handler hdl(rows);
+            istringstream is(content);
+            csv_stream_parser<csv_rows_handler> parser(is, hdl, config, window_sizes[j]);
+            bool error = false;
+            try
+            {
+                parser.parse();
+            }
+            catch (const csv::parse_error&)
+            {
+                error = true;
+            }
+
+            assert(error == expected_error);
+            assert(rows == expected);
+        }
+    }
+}
+
+void test_csv_import_stream()
+{
+    size_t n = sizeof(dirs)/sizeof(dirs[0]);
+    for (size_t i = 0; i < n; ++i)
+    {
+        string path(dirs[i]);
+        path.append("input.csv");
+        string content = load_file_content(path.c_str());
+
+        for (size_t batch_row_count = 0; batch_row_count < 2; ++batch_row_count)
+        {
+            spreadsheet::document doc;
+            spreadsheet::import_factory factory(doc);
+            orcus_csv app(&factory);
+            config opt;
+            opt.batch_row_count = batch_row_count;
+            app.set_config(opt);
+            istringstream is(content);
+            app.read_stream(is);
+
+            ostringstream os;
+            doc.dump_check(os);
+            assert(os.str() == import_dump(content, 1));
+        }
+    }
+}
+
+void test_csv_import_empty()
+{
+    // Neither an empty buffer nor an empty stream creates a sheet.
+    for (size_t batch_row_count = 0; batch_row_count < 2; ++batch_row_count)
+    {
+        config opt;
+        opt.batch_row_count = batch_row_count;
+
+        spreadsheet::document doc;
+        spreadsheet::import_factory factory(doc);
+        orcus_csv app(&factory);
+        app.set_config(opt);
+        app.read_stream("", 0);
+        assert(doc.sheet_size() == 0);
+
+        spreadsheet::document doc2;
+        spreadsheet::import_factory factory2(doc2);
+        orcus_csv app2(&factory2);
+        app2.set_config(opt);
+        istringstream is;
+        app2.read_stream(is);
+        assert(doc2.sheet_size() == 0);
+    }
 }
 
 int main()
 {
     test_csv_import();
+    test_csv_export();
+    test_csv_export_locale();
+    test_csv_parser_block_boundaries();
+    test_csv_import_parallel();
+    test_csv_import_batched();
+    test_csv_stream_parser();
+    test_csv_import_stream();
+    test_csv_import_empty();
     return EXIT_SUCCESS;
 }
 /* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -23,6 +23,9 @@
 
 #include <mdds/flat_segment_tree.hpp>
 
+#include <ixion/address.hpp>
+#include <ixion/model_context.hpp>
+
 using namespace orcus;
 using namespace orcus::spreadsheet;
 using namespace std;
@@ -124,8 +127,8 @@ void test_ods_import_formatted_text()
     assert(str && *str == "Normal Text");
     size_t xfid = sh->get_cell_format(0,0);
     assert(xfid == 0); // ID of 0 represents default format.
-    const format_runs_t* fmt = ss->get_format_runs(str_id);
-    assert(!fmt); // The string should be unformatted.
+    format_runs_span fmt = ss->get_format_runs(str_id);
+    assert(fmt.empty()); // The string should be unformatted.
 
     // A2 is all bold via cell format.
     str_id = sh->get_string_identifier(1,0);
@@ -137,7 +140,7 @@ void test_ods_import_formatted_text()
     const font_t* font_data = styles->get_font(xf->font);
     assert(font_data && font_data->bold && !font_data->italic);
     fmt = ss->get_format_runs(str_id);
-    assert(!fmt); // This string should be unformatted.
+    assert(fmt.empty()); // This string should be unformatted.
 
     // A3 is all italic.
     str_id = sh->get_string_identifier(2,0);
@@ -149,7 +152,7 @@ void test_ods_import_formatted_text()
     font_data = styles->get_font(xf->font);
     assert(font_data && !font_data->bold && font_data->italic);
     fmt = ss->get_format_runs(str_id);
-    assert(!fmt); // This string should be unformatted.
+    assert(fmt.empty()); // This string should be unformatted.
 
     // A4 is all bolid and italic.
     str_id = sh->get_string_identifier(3,0);
@@ -161,7 +164,7 @@ void test_ods_import_formatted_text()
     font_data = styles->get_font(xf->font);
     assert(font_data && font_data->bold && font_data->italic);
     fmt = ss->get_format_runs(str_id);
-    assert(!fmt); // This string should be unformatted.
+    assert(fmt.empty()); // This string should be unformatted.
 
     // A5 has mixed format runs.
     str_id = sh->get_string_identifier(4,0);
@@ -172,15 +175,15 @@ void test_ods_import_formatted_text()
     assert(xf);
     font_data = styles->get_font(xf->font);
     fmt = ss->get_format_runs(str_id);
-    assert(fmt); // This string should be formatted.
+    assert(!fmt.empty()); // This string should be formatted.
 
     {
         // Check the bold format segment.
         bool_segment_type bold_runs(0, str->size(), font_data->bold);
-        for (size_t i = 0, n = fmt->size(); i < n; ++i)
+        for (size_t i = 0, n = fmt.size(); i < n; ++i)
         {
-            format_run run = fmt->at(i);
-            bold_runs.insert_back(run.pos, run.pos+run.size, run.bold);
+            const format_run& run = fmt[i];
+            bold_runs.insert_back(run.pos, run.pos+run.size, run.attrs->bold);
         }
 
         bold_runs.build_tree();
@@ -205,10 +208,10 @@ void test_ods_import_formatted_text()
     {
         // Check the italic format segment.
         bool_segment_type italic_runs(0, str->size(), font_data->italic);
-        for (size_t i = 0, n = fmt->size(); i < n; ++i)
+        for (size_t i = 0, n = fmt.size(); i < n; ++i)
         {
-            format_run run = fmt->at(i);
-            italic_runs.insert_back(run.pos, run.pos+run.size, run.italic);
+            const format_run& run = fmt[i];
+            italic_runs.insert_back(run.pos, run.pos+run.size, run.attrs->italic);
         }
 
         italic_runs.build_tree();
@@ -238,6 +241,78 @@ void test_ods_import_formatted_text()
     }
 }
 
+void test_ods_import_date_cells()
+{
+    const char* filepath = SRCDIR"/test/ods/date-cell/input.ods";
+    document doc;
+    import_factory factory(doc);
+    orcus_ods app(&factory);
+    app.read_file(filepath);
+
+    assert(doc.sheet_size() > 0);
+    const spreadsheet::sheet* sh = doc.get_sheet(0);
+    assert(sh);
+
+    // This document uses 1904-01-01 as its origin date.
+    date_time_t origin = doc.get_origin_date();
+    assert(origin.year == 1904 && origin.month == 1 && origin.day == 1);
+
+    const ixion::model_context& cxt = doc.get_model_context();
+
+    // B1 contains 2001-12-25, stored as days since the origin date.
+    assert(!sh->is_date_time(0, 0));
+    assert(sh->is_date_time(0, 1));
+    assert(cxt.get_numeric_value(ixion::abs_address_t(0, 0, 1)) == 35788.0);
+    date_time_t dt = sh->get_date_time(0, 1);
+    assert(dt.year == 2001 && dt.month == 12 && dt.day == 25);
+    assert(dt.hour == 0 && dt.minute == 0 && dt.second == 0.0);
+
+    // B2 contains 2013-04-09T21:34:09.
+    assert(sh->is_date_time(1, 1));
+    double serial = cxt.get_numeric_value(ixion::abs_address_t(0, 1, 1));
+    assert(39911.0 < serial && serial < 39912.0);
+    dt = sh->get_date_time(1, 1);
+    assert(dt.year == 2013 && dt.month == 4 && dt.day == 9);
+    assert(dt.hour == 21 && dt.minute == 34 && dt.second == 9.0);
+}
+
+void test_ods_overwrite_date_cells()
+{
+    const char* filepath = SRCDIR"/test/ods/date-cell/input.ods";
+    document doc;
+    import_factory factory(doc);
+    orcus_ods app(&factory);
+    app.read_file(filepath);
+
+    spreadsheet::sheet* sh = doc.get_sheet(0);
+    assert(sh);
+    assert(sh->is_date_time(0, 1));
+    assert(sh->is_date_time(1, 1));
+
+    // Overwriting a date cell with a plain number clears its date-time
+    // flag, without affecting the neighboring date cell.
+    sh->set_value(0, 1, 42.0);
+    assert(!sh->is_date_time(0, 1));
+    assert(sh->is_date_time(1, 1));
+
+    const ixion::model_context& cxt = doc.get_model_context();
+    assert(cxt.get_numeric_value(ixion::abs_address_t(0, 0, 1)) == 42.0);
+
+    // The same goes for the other cell types.
+    sh->set_date_time(0, 1, 2001, 12, 25, 0, 0, 0.0);
+    assert(sh->is_date_time(0, 1));
+    sh->set_auto(0, 1, "text", 4);
+    assert(!sh->is_date_time(0, 1));
+
+    sh->set_bool(1, 1, true);
+    assert(!sh->is_date_time(1, 1));
+
+    // The flat dump no longer prints the cell as a date.
+    ostringstream os;
+    sh->dump_flat(os);
+    assert(os.str().find("2013-04-09") == string::npos);
+}
+
 }
 
 int main()
@@ -245,6 +320,8 @@ int main()
     test_ods_import_cell_values();
     test_ods_import_column_widths_row_heights();
     test_ods_import_formatted_text();
+    test_ods_import_date_cells();
+    test_ods_overwrite_date_cells();
     return EXIT_SUCCESS;
 }
 /* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -9,18 +9,26 @@
 #include "orcus/pstring.hpp"
 #include "orcus/global.hpp"
 #include "orcus/stream.hpp"
+#include "orcus/exception.hpp"
 #include "orcus/spreadsheet/factory.hpp"
 #include "orcus/spreadsheet/document.hpp"
 #include "orcus/spreadsheet/sheet.hpp"
 #include "orcus/spreadsheet/auto_filter.hpp"
+#include "orcus/spreadsheet/styles.hpp"
 
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #include <cassert>
 #include <string>
+#include <fstream>
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <thread>
 
 #include <ixion/address.hpp>
+#include <ixion/model_context.hpp>
 
 using namespace orcus;
 using namespace orcus::spreadsheet;
@@ -132,22 +140,47 @@ void test_xlsx_table()
     assert(p->range == range);
 
     // Table1 has 2 table columns.
-    assert(p->columns.size() == 2);
+    const table_t::columns_type& columns = p->get_columns();
+    assert(columns.size() == 2);
 
-    const table_column_t* tcol = &p->columns[0];
+    const table_column_t* tcol = &columns[0];
     assert(tcol);
     assert(tcol->identifier == 1);
     assert(tcol->name == "Category");
     assert(tcol->totals_row_label == "Total");
     assert(tcol->totals_row_function == totals_row_function_t::none);
 
-    tcol = &p->columns[1];
+    tcol = &columns[1];
     assert(tcol);
     assert(tcol->identifier == 2);
     assert(tcol->name == "Value");
     assert(tcol->totals_row_label.empty());
     assert(tcol->totals_row_function == totals_row_function_t::sum);
 
+    // Look up columns by name.
+    assert(p->find_column("Category") == columns.begin());
+    assert(p->find_column("Value") == columns.begin() + 1);
+    assert(p->find_column("Value", 1) == columns.begin() + 1);
+    assert(p->find_column("Category", 1) == columns.end());
+    assert(p->find_column("Nonexistent") == columns.end());
+
+    {
+        // Renaming a column keeps the lookup in sync with the new names.
+        table_t renamed = *p;
+        const table_t::columns_type& cols = renamed.get_columns();
+        renamed.set_column_name(1, "Amount");
+        assert(renamed.find_column("Amount") == cols.begin() + 1);
+        assert(renamed.find_column("Value") == cols.end());
+
+        // Make both columns share a name, then rename the first one away.
+        renamed.set_column_name(1, "Category");
+        assert(renamed.find_column("Category") == cols.begin());
+        assert(renamed.find_column("Category", 1) == cols.begin() + 1);
+        renamed.set_column_name(0, "Label");
+        assert(renamed.find_column("Category") == cols.begin() + 1);
+        assert(renamed.find_column("Label") == cols.begin());
+    }
+
     const auto_filter_t& filter = p->filter;
 
     // Auto filter range is C3:D8.
@@ -171,6 +204,780 @@ void test_xlsx_table()
     assert(style.show_column_stripes == false);
 }
 
+void test_xlsx_deduplicate_styles()
+{
+    string path(SRCDIR"/test/xlsx/borders/single-cells.xlsx");
+    document doc;
+    import_factory factory(doc);
+    orcus_xlsx app(&factory);
+    app.read_file(path.c_str());
+
+    const sheet* sh = doc.get_sheet(0);
+    assert(sh);
+    const import_styles* styles = doc.get_styles();
+    assert(styles);
+
+    // Record the border styles of all cells before deduplication.
+    const row_t row_count = 30;
+    const col_t col_count = 10;
+    vector<border_style_t> before;
+    for (row_t row = 0; row < row_count; ++row)
+    {
+        for (col_t col = 0; col < col_count; ++col)
+        {
+            const cell_format_t* xf = styles->get_cell_format(sh->get_cell_format(row, col));
+            assert(xf);
+            const border_t* border = styles->get_border(xf->border);
+            assert(border);
+            before.push_back(border->top.style);
+        }
+    }
+
+    size_t xf_count = styles->get_cell_formats_count();
+    styles_remap_t remap = doc.deduplicate_styles();
+    assert(remap.cell_formats.size() == xf_count);
+    assert(remap.cell_formats[0] == 0);
+    assert(remap.records_after <= remap.records_before);
+    assert(remap.dedup_ratio() >= 1.0);
+    assert(styles->get_cell_formats_count() <= xf_count);
+
+    // Every cell must still resolve to the same border style.
+    vector<border_style_t>::const_iterator it = before.begin();
+    for (row_t row = 0; row < row_count; ++row)
+    {
+        for (col_t col = 0; col < col_count; ++col, ++it)
+        {
+            const cell_format_t* xf = styles->get_cell_format(sh->get_cell_format(row, col));
+            assert(xf);
+            const border_t* border = styles->get_border(xf->border);
+            assert(border);
+            assert(border->top.style == *it);
+        }
+    }
+}
+
+/**
+ * Deduplicate a set of style records with known duplicates, and check the
+ * exact outcome.
+ */
+void test_deduplicate_styles_known_duplicates()
+{
+    document doc;
+    import_styles* styles = doc.get_styles();
+
+    // Fonts 2 and 3 duplicate fonts 0 and 1, respectively.
+    for (size_t i = 0; i < 4; ++i)
+    {
+        styles->set_font_name("Calibri", 7);
+        styles->set_font_size(11.0);
+        styles->set_font_bold(i % 2 != 0);
+        styles->commit_font();
+    }
+
+    // Border 2 duplicates border 1.
+    styles->commit_border();
+    for (size_t i = 0; i < 2; ++i)
+    {
+        styles->set_border_style(border_direction_t::top, border_style_t::thin);
+        styles->commit_border();
+    }
+
+    // Once fonts and borders are deduplicated, cell format 2 duplicates
+    // cell format 1, and cell format 3 duplicates cell format 0.  Cell
+    // format 4 is unique.
+    const size_t xf_fonts[] = { 0, 1, 3, 2, 1 };
+    const size_t xf_borders[] = { 0, 1, 2, 0, 0 };
+    for (size_t i = 0; i < 5; ++i)
+    {
+        styles->set_xf_font(xf_fonts[i]);
+        styles->set_xf_border(xf_borders[i]);
+        styles->commit_cell_xf();
+    }
+
+    sheet* sh = doc.append_sheet("Test", 100, 10);
+    for (size_t i = 0; i < 5; ++i)
+        sh->set_format(i, 0, i);
+
+    styles_remap_t remap = doc.deduplicate_styles();
+
+    // 4 fonts, 3 borders and 5 cell formats become 2, 2 and 3.
+    assert(remap.records_before == 12);
+    assert(remap.records_after == 7);
+    assert(remap.dedup_ratio() > 1.0);
+    assert(remap.bytes_saved > 0);
+
+    assert(styles->get_font_count() == 2);
+    assert(styles->get_border_count() == 2);
+    assert(styles->get_cell_formats_count() == 3);
+
+    const size_t expected_fonts[] = { 0, 1, 0, 1 };
+    assert(remap.fonts == styles_remap_t::index_map_type(expected_fonts, expected_fonts + 4));
+    const size_t expected_borders[] = { 0, 1, 1 };
+    assert(remap.borders == styles_remap_t::index_map_type(expected_borders, expected_borders + 3));
+
+    // Originally distinct duplicate cell formats now share an index.
+    const size_t expected_xfs[] = { 0, 1, 1, 0, 2 };
+    assert(remap.cell_formats == styles_remap_t::index_map_type(expected_xfs, expected_xfs + 5));
+    assert(remap.cell_formats[1] == remap.cell_formats[2]);
+    assert(remap.cell_formats[0] == remap.cell_formats[3]);
+
+    // The cells refer to the surviving cell formats.
+    for (size_t i = 0; i < 5; ++i)
+        assert(sh->get_cell_format(i, 0) == expected_xfs[i]);
+
+    const cell_format_t* xf = styles->get_cell_format(1);
+    assert(xf && xf->font == 1 && xf->border == 1);
+    const font_t* font = styles->get_font(xf->font);
+    assert(font && font->bold && font->name == "Calibri");
+}
+
+void test_xlsx_cell_iterator()
+{
+    string path(SRCDIR"/test/xlsx/raw-values-1/input.xlsx");
+    document doc;
+    import_factory factory(doc);
+    orcus_xlsx app(&factory);
+    app.read_file(path.c_str());
+
+    const ixion::model_context& cxt = doc.get_model_context();
+    const sheet* sh = doc.get_sheet(0);
+    assert(sh);
+    ixion::abs_range_t range = cxt.get_data_range(0);
+    assert(range.valid());
+
+    // Both orders must visit exactly the non-empty cells, in order.
+    cell_order_t orders[] = { cell_order_t::column_major, cell_order_t::row_major };
+    for (size_t i = 0; i < 2; ++i)
+    {
+        bool row_major = orders[i] == cell_order_t::row_major;
+        sheet_cell_iterator it = sh->begin_cells(orders[i]), it_end = sh->end_cells();
+
+        size_t outer_count = row_major ? range.last.row + 1 : range.last.column + 1;
+        size_t inner_count = row_major ? range.last.column + 1 : range.last.row + 1;
+        for (size_t outer = 0; outer < outer_count; ++outer)
+        {
+            for (size_t inner = 0; inner < inner_count; ++inner)
+            {
+                row_t row = row_major ? outer : inner;
+                col_t col = row_major ? inner : outer;
+                ixion::abs_address_t pos(0, row, col);
+                ixion::celltype_t ct = cxt.get_celltype(pos);
+                if (ct == ixion::celltype_t::empty)
+                    continue;
+
+                assert(it != it_end);
+                assert(it->row == row);
+                assert(it->col == col);
+                assert(it->type == ct);
+                if (ct == ixion::celltype_t::numeric)
+                    assert(it->numeric == cxt.get_numeric_value(pos));
+                else if (ct == ixion::celltype_t::string)
+                    assert(it->string_id == cxt.get_string_identifier(pos));
+                ++it;
+            }
+        }
+
+        assert(it == it_end);
+    }
+}
+
+void test_xlsx_column_chunk()
+{
+    string path(SRCDIR"/test/xlsx/raw-values-1/input.xlsx");
+    document doc;
+    import_factory factory(doc);
+    orcus_xlsx app(&factory);
+    app.read_file(path.c_str());
+
+    spreadsheet::export_factory efactory(doc);
+    const iface::export_sheet* sh = efactory.get_sheet("Num", 3);
+    assert(sh);
+
+    row_t row_count = 0;
+    col_t col_count = 0;
+    sh->get_data_size(row_count, col_count);
+    assert(row_count == 7);
+    assert(col_count == 5);
+
+    // Column A holds 1.1, 1.2 and 1.3 in rows 2 to 4.
+    iface::column_chunk chunk;
+    sh->get_column_chunk(0, 0, row_count, chunk);
+    assert(chunk.length == 7);
+    assert(chunk.numeric_null_count == 4);
+    assert(chunk.numeric_validity.size() == 1);
+    assert(chunk.numeric_validity[0] == 0x0E);
+    assert(chunk.numeric_values[1] == 1.1);
+    assert(chunk.numeric_values[3] == 1.3);
+    assert(chunk.string_null_count == 7);
+    assert(chunk.type_run_ends.size() == 3);
+    assert(chunk.type_run_ends[0] == 1 && chunk.type_run_values[0] == iface::column_cell_t::empty);
+    assert(chunk.type_run_ends[1] == 4 && chunk.type_run_values[1] == iface::column_cell_t::numeric);
+    assert(chunk.type_run_ends[2] == 7 && chunk.type_run_values[2] == iface::column_cell_t::empty);
+
+    // String IDs resolve through the string table.
+    sh = efactory.get_sheet("Text", 4);
+    assert(sh);
+    sh->get_column_chunk(0, 0, 3, chunk);
+    assert(chunk.string_null_count == 0);
+    assert(chunk.string_validity[0] == 0x07);
+
+    iface::string_table strings;
+    efactory.get_string_table(strings);
+    const char* expected[] = { "A", "B", "C" };
+    for (size_t i = 0; i < 3; ++i)
+    {
+        int32_t sid = chunk.string_ids[i];
+        assert(static_cast<size_t>(sid) + 1 < strings.offsets.size());
+        string s(&strings.data[0] + strings.offsets[sid], strings.offsets[sid+1] - strings.offsets[sid]);
+        assert(s == expected[i]);
+    }
+
+    // Reading past the end of the sheet reports empty cells.
+    sh->get_column_chunk(0, doc.get_sheet(1)->row_size() - 2, 10, chunk);
+    assert(chunk.type_run_ends.size() == 1);
+    assert(chunk.type_run_ends[0] == 10);
+    assert(chunk.type_run_values[0] == iface::column_cell_t::empty);
+}
+
+void test_xlsx_snapshot()
+{
+    const char* paths[] = {
+        SRCDIR"/test/xlsx/raw-values-1/input.xlsx",
+        SRCDIR"/test/xlsx/formula-shared.xlsx",
+        SRCDIR"/test/xlsx/borders/single-cells.xlsx",
+        SRCDIR"/test/xlsx/column-width-row-height/input.xlsx",
+        SRCDIR"/test/xlsx/date-cell/input.xlsx",
+        SRCDIR"/test/xlsx/formatted-text/bold-and-italic.xlsx",
+    };
+
+    const char* snapshot_path = "snapshot.bin";
+
+    for (size_t i = 0, n = sizeof(paths)/sizeof(paths[0]); i < n; ++i)
+    {
+        cout << paths[i] << endl;
+        document doc;
+        import_factory factory(doc);
+        orcus_xlsx app(&factory);
+        app.read_file(paths[i]);
+
+        doc.save_snapshot(snapshot_path);
+        document doc2;
+        doc2.load_snapshot(snapshot_path);
+        std::remove(snapshot_path);
+
+        // Cell content, including formula results, must be identical.
+        ostringstream os1, os2;
+        doc.dump_check(os1);
+        doc2.dump_check(os2);
+        assert(os1.str() == os2.str());
+
+        const import_styles* styles1 = doc.get_styles();
+        const import_styles* styles2 = doc2.get_styles();
+        assert(styles1->get_font_count() == styles2->get_font_count());
+        assert(styles1->get_border_count() == styles2->get_border_count());
+        assert(styles1->get_cell_formats_count() == styles2->get_cell_formats_count());
+
+        assert(doc.sheet_size() == doc2.sheet_size());
+        for (sheet_t j = 0; j < static_cast<sheet_t>(doc.sheet_size()); ++j)
+        {
+            const sheet* sh1 = doc.get_sheet(j);
+            const sheet* sh2 = doc2.get_sheet(j);
+            assert(doc.get_sheet_name(j) == doc2.get_sheet_name(j));
+
+            row_t row_count = 0;
+            col_t col_count = 0;
+            sh1->get_data_size(row_count, col_count);
+            for (col_t col = 0; col < col_count; ++col)
+            {
+                assert(sh1->get_col_width(col, NULL, NULL) == sh2->get_col_width(col, NULL, NULL));
+                for (row_t row = 0; row < row_count; ++row)
+                    assert(sh1->get_cell_format(row, col) == sh2->get_cell_format(row, col));
+            }
+
+            for (row_t row = 0; row < row_count; ++row)
+                assert(sh1->get_row_height(row, NULL, NULL) == sh2->get_row_height(row, NULL, NULL));
+        }
+    }
+}
+
+void assert_same_filter(const auto_filter_t& af1, const auto_filter_t& af2)
+{
+    assert(af1.range == af2.range);
+    assert(af1.columns.size() == af2.columns.size());
+    auto_filter_t::columns_type::const_iterator it1 = af1.columns.begin(), it2 = af2.columns.begin();
+    for (; it1 != af1.columns.end(); ++it1, ++it2)
+    {
+        assert(it1->first == it2->first);
+        assert(it1->second.match_values == it2->second.match_values);
+    }
+}
+
+void test_xlsx_snapshot_tables()
+{
+    struct check
+    {
+        const char* path;
+        const char* table_name;
+    };
+
+    const check checks[] = {
+        { SRCDIR"/test/xlsx/table/table-1.xlsx", "Table1" },
+        { SRCDIR"/test/xlsx/table/table-2.xlsx", "Table2" },
+        { SRCDIR"/test/xlsx/table/autofilter.xlsx", NULL },
+    };
+
+    const char* snapshot_path = "snapshot.bin";
+
+    for (size_t i = 0, n = sizeof(checks)/sizeof(checks[0]); i < n; ++i)
+    {
+        cout << checks[i].path << endl;
+        document doc;
+        import_factory factory(doc);
+        orcus_xlsx app(&factory);
+        app.read_file(checks[i].path);
+
+        doc.save_snapshot(snapshot_path);
+        document doc2;
+        doc2.load_snapshot(snapshot_path);
+        std::remove(snapshot_path);
+
+        // Formulas with structured references must evaluate the same,
+        // which requires the tables to be in place.
+        ostringstream os1, os2;
+        doc.dump_check(os1);
+        doc2.dump_check(os2);
+        assert(os1.str() == os2.str());
+
+        if (checks[i].table_name)
+        {
+            const table_t* tab1 = doc.get_table(checks[i].table_name);
+            const table_t* tab2 = doc2.get_table(checks[i].table_name);
+            assert(tab1 && tab2);
+            assert(tab1->identifier == tab2->identifier);
+            assert(tab1->name == tab2->name);
+            assert(tab1->display_name == tab2->display_name);
+            assert(tab1->range == tab2->range);
+            assert(tab1->totals_row_count == tab2->totals_row_count);
+            assert_same_filter(tab1->filter, tab2->filter);
+
+            assert(tab1->columns.size() == tab2->columns.size());
+            for (size_t j = 0; j < tab1->columns.size(); ++j)
+            {
+                const table_column_t& col1 = tab1->columns[j];
+                const table_column_t& col2 = tab2->columns[j];
+                assert(col1.identifier == col2.identifier);
+                assert(col1.name == col2.name);
+                assert(col1.totals_row_label == col2.totals_row_label);
+                assert(col1.totals_row_function == col2.totals_row_function);
+                assert(tab2->find_column(col1.name) == tab2->columns.begin() + j);
+            }
+
+            assert(tab1->style.name == tab2->style.name);
+            assert(tab1->style.show_first_column == tab2->style.show_first_column);
+            assert(tab1->style.show_last_column == tab2->style.show_last_column);
+            assert(tab1->style.show_row_stripes == tab2->style.show_row_stripes);
+            assert(tab1->style.show_column_stripes == tab2->style.show_column_stripes);
+        }
+
+        const auto_filter_t* af1 = doc.get_sheet(0)->get_auto_filter_data();
+        const auto_filter_t* af2 = doc2.get_sheet(0)->get_auto_filter_data();
+        assert(!af1 == !af2);
+        if (af1)
+            assert_same_filter(*af1, *af2);
+    }
+}
+
+void test_xlsx_snapshot_invalid()
+{
+    const char* snapshot_path = "snapshot.bin";
+    document doc;
+    import_factory factory(doc);
+    orcus_xlsx app(&factory);
+    app.read_file(SRCDIR"/test/xlsx/table/table-2.xlsx");
+    doc.save_snapshot(snapshot_path);
+
+    document doc2;
+    doc2.load_snapshot(snapshot_path);
+    assert(doc2.sheet_size() > 0);
+    assert(doc2.get_table("Table2"));
+
+    // A truncated snapshot leaves the document empty, not half-loaded.
+    string content = load_file_content(snapshot_path);
+    content.resize(content.size() * 3 / 4);
+    {
+        ofstream file(snapshot_path, ios::out | ios::binary);
+        file.write(content.data(), content.size());
+    }
+
+    try
+    {
+        doc2.load_snapshot(snapshot_path);
+        assert(!"general_error was not thrown");
+    }
+    catch (const general_error&)
+    {
+    }
+
+    std::remove(snapshot_path);
+    assert(doc2.sheet_size() == 0);
+    assert(!doc2.get_table("Table2"));
+}
+
+}
+
+namespace {
+
+/**
+ * Alter the checksum recorded in the central directory for a part, which
+ * makes the part appear modified without changing its content.
+ */
+void touch_zip_entry(string& content, const char* name)
+{
+    size_t name_len = strlen(name);
+    for (size_t pos = 0; pos + 46 + name_len <= content.size(); ++pos)
+    {
+        // Central directory file header signature, 0x02014b50.
+        if (content.compare(pos, 4, "PK\x01\x02", 4))
+            continue;
+
+        size_t n = static_cast<unsigned char>(content[pos+28]) |
+            (static_cast<unsigned char>(content[pos+29]) << 8);
+
+        if (n == name_len && !content.compare(pos+46, n, name))
+        {
+            // The CRC-32 value is stored at offset 16.
+            content[pos+16] ^= 0xFF;
+            return;
+        }
+    }
+
+    assert(!"central directory entry not found.");
+}
+
+string dump_check_content(const document& doc)
+{
+    ostringstream os;
+    doc.dump_check(os);
+    return os.str();
+}
+
+}
+
+void test_xlsx_reimport()
+{
+    const char* paths[] = {
+        SRCDIR"/test/xlsx/raw-values-1/input.xlsx",
+        SRCDIR"/test/xlsx/formula-simple.xlsx",
+    };
+
+    for (size_t i = 0, n = sizeof(paths)/sizeof(paths[0]); i < n; ++i)
+    {
+        cout << paths[i] << endl;
+        string content = load_file_content(paths[i]);
+
+        document doc;
+        import_factory factory(doc);
+        orcus_xlsx app(&factory);
+        app.read_stream(content.data(), content.size());
+        string expected = dump_check_content(doc);
+        size_t sheet_count = doc.sheet_size();
+
+        // Nothing has changed.  No sheet gets re-imported.
+        bool incremental = app.reimport_stream(content.data(), content.size());
+        assert(incremental);
+        assert(dump_check_content(doc) == expected);
+        assert(doc.sheet_size() == sheet_count);
+
+        // Only the first sheet appears modified.
+        string modified = content;
+        touch_zip_entry(modified, "xl/worksheets/sheet1.xml");
+        incremental = app.reimport_stream(modified.data(), modified.size());
+        assert(incremental);
+        assert(dump_check_content(doc) == expected);
+        assert(doc.sheet_size() == sheet_count);
+
+        // A change in a part shared by all sheets triggers a full import.
+        modified = content;
+        touch_zip_entry(modified, "xl/workbook.xml");
+        incremental = app.reimport_stream(modified.data(), modified.size());
+        assert(!incremental);
+        assert(dump_check_content(doc) == expected);
+        assert(doc.sheet_size() == sheet_count);
+    }
+
+    {
+        // The first sheet has different cell values, and all the other
+        // parts are identical.  Only the first sheet gets re-imported.
+        document doc;
+        import_factory factory(doc);
+        orcus_xlsx app(&factory);
+        app.read_file(paths[0]);
+        assert(doc.sheet_size() == 2);
+
+        const ixion::model_context& cxt = doc.get_model_context();
+        assert(cxt.get_numeric_value(ixion::abs_address_t(0, 1, 0)) == 1.1);
+        assert(cxt.get_numeric_value(ixion::abs_address_t(0, 6, 2)) == 5.0);
+
+        const sheet* sheet1 = doc.get_sheet(0);
+        const sheet* sheet2 = doc.get_sheet(1);
+        ostringstream os_before;
+        sheet2->dump_csv(os_before);
+
+        bool incremental = app.reimport_file(SRCDIR"/test/xlsx/raw-values-1/modified-sheet1.xlsx");
+        assert(incremental);
+        assert(doc.sheet_size() == 2);
+
+        // The new values appear in the first sheet.
+        assert(cxt.get_numeric_value(ixion::abs_address_t(0, 1, 0)) == 10.5);
+        assert(cxt.get_numeric_value(ixion::abs_address_t(0, 6, 2)) == 50.0);
+        assert(cxt.get_numeric_value(ixion::abs_address_t(0, 2, 0)) == 1.2);
+
+        // The second sheet is the same object, with the same content.
+        assert(doc.get_sheet(0) == sheet1);
+        assert(doc.get_sheet(1) == sheet2);
+        ostringstream os_after;
+        sheet2->dump_csv(os_after);
+        assert(os_before.str() == os_after.str());
+
+        // The result matches that of a full import.
+        document doc2;
+        import_factory factory2(doc2);
+        orcus_xlsx app2(&factory2);
+        app2.read_file(SRCDIR"/test/xlsx/raw-values-1/modified-sheet1.xlsx");
+        assert(dump_check_content(doc) == dump_check_content(doc2));
+    }
+
+    // Re-importing a different package replaces the whole content.
+    document doc;
+    import_factory factory(doc);
+    orcus_xlsx app(&factory);
+    app.read_file(paths[0]);
+    bool incremental = app.reimport_file(paths[1]);
+    assert(!incremental);
+
+    document doc2;
+    import_factory factory2(doc2);
+    orcus_xlsx app2(&factory2);
+    app2.read_file(paths[1]);
+    assert(dump_check_content(doc) == dump_check_content(doc2));
+}
+
+namespace {
+
+/**
+ * Read everything the const interface of a document exposes into a
+ * string, so that results from different threads can be compared.
+ */
+string read_document(const document& doc)
+{
+    ostringstream os;
+    doc.dump_check(os);
+
+    for (sheet_t i = 0, n = static_cast<sheet_t>(doc.sheet_size()); i < n; ++i)
+    {
+        const sheet* sh = doc.get_sheet(i);
+        row_t row_count = 0;
+        col_t col_count = 0;
+        sh->get_data_size(row_count, col_count);
+
+        for (col_t col = 0; col < col_count; ++col)
+        {
+            os << sh->get_col_width(col, NULL, NULL) << ' ';
+            for (row_t row = 0; row < row_count; ++row)
+                os << sh->get_cell_format(row, col) << (sh->is_date_time(row, col) ? 'd' : ' ');
+        }
+
+        for (row_t row = 0; row < row_count; ++row)
+            os << sh->get_row_height(row, NULL, NULL) << ' ';
+
+        sh->dump_csv(os);
+    }
+
+    return os.str();
+}
+
+struct document_reader
+{
+    const document& m_doc;
+    const string& m_expected;
+    size_t m_repeat;
+    bool& m_result;
+
+    document_reader(const document& doc, const string& expected, size_t repeat, bool& result) :
+        m_doc(doc), m_expected(expected), m_repeat(repeat), m_result(result) {}
+
+    void operator() () const
+    {
+        m_result = true;
+        for (size_t i = 0; i < m_repeat; ++i)
+        {
+            if (read_document(m_doc) != m_expected)
+                m_result = false;
+        }
+    }
+};
+
+}
+
+void test_xlsx_frozen_concurrent_read()
+{
+    const char* paths[] = {
+        SRCDIR"/test/xlsx/column-width-row-height/input.xlsx",
+        SRCDIR"/test/xlsx/date-cell/input.xlsx",
+        SRCDIR"/test/xlsx/formula-simple.xlsx",
+        SRCDIR"/test/xlsx/borders/single-cells.xlsx",
+    };
+
+    const size_t thread_count = 16;
+    const size_t repeat = 20;
+
+    for (size_t i = 0, n = sizeof(paths)/sizeof(paths[0]); i < n; ++i)
+    {
+        cout << paths[i] << endl;
+        document doc;
+        import_factory factory(doc);
+        orcus_xlsx app(&factory);
+        app.read_file(paths[i]);
+
+        // Compute the expected content from a separate, non-frozen copy, so
+        // that none of the lazily built look-up trees get built on the
+        // frozen document before the threads start.
+        string expected;
+        {
+            document doc2;
+            import_factory factory2(doc2);
+            orcus_xlsx app2(&factory2);
+            app2.read_file(paths[i]);
+            expected = read_document(doc2);
+        }
+
+        assert(!doc.is_frozen());
+        doc.freeze();
+        assert(doc.is_frozen());
+
+        vector<std::thread> threads;
+        bool results[thread_count];
+        for (size_t j = 0; j < thread_count; ++j)
+            threads.push_back(std::thread(document_reader(doc, expected, repeat, results[j])));
+
+        for (size_t j = 0; j < thread_count; ++j)
+        {
+            threads[j].join();
+            assert(results[j]);
+        }
+
+        // Structural changes are rejected.
+        size_t sheet_count = doc.sheet_size();
+        try
+        {
+            doc.append_sheet("Extra", 100, 100);
+            assert(!"append_sheet on a frozen document didn't throw.");
+        }
+        catch (const general_error&)
+        {
+            // expected.
+        }
+
+        assert(doc.sheet_size() == sheet_count);
+
+        // Clearing makes the document modifiable again.
+        doc.clear();
+        assert(!doc.is_frozen());
+    }
+}
+
+void test_xlsx_compact()
+{
+    const char* paths[] = {
+        SRCDIR"/test/xlsx/column-width-row-height/input.xlsx",
+        SRCDIR"/test/xlsx/date-cell/input.xlsx",
+        SRCDIR"/test/xlsx/borders/single-cells.xlsx",
+        SRCDIR"/test/xlsx/formatted-text/bold-and-italic.xlsx",
+    };
+
+    const char* snapshot_path = "compact.bin";
+
+    for (size_t i = 0, n = sizeof(paths)/sizeof(paths[0]); i < n; ++i)
+    {
+        cout << paths[i] << endl;
+        document doc;
+        import_factory factory(doc);
+        orcus_xlsx app(&factory);
+        app.read_file(paths[i]);
+        string expected = read_document(doc);
+
+        size_t bytes = doc.compact();
+        cout << "bytes released: " << bytes << endl;
+        assert(bytes > 0);
+        assert(doc.is_frozen());
+        assert(read_document(doc) == expected);
+
+        // Compacting twice is harmless.
+        doc.compact();
+        assert(read_document(doc) == expected);
+
+        // A compacted document can still be saved.
+        doc.save_snapshot(snapshot_path);
+        document doc2;
+        doc2.load_snapshot(snapshot_path);
+        std::remove(snapshot_path);
+        assert(read_document(doc2) == expected);
+    }
+}
+
+void test_xlsx_memory_usage()
+{
+    const char* paths[] = {
+        SRCDIR"/test/xlsx/raw-values-1/input.xlsx",
+        SRCDIR"/test/xlsx/formula-shared.xlsx",
+        SRCDIR"/test/xlsx/borders/single-cells.xlsx",
+        SRCDIR"/test/xlsx/table/table-1.xlsx",
+    };
+
+    for (size_t i = 0, n = sizeof(paths)/sizeof(paths[0]); i < n; ++i)
+    {
+        cout << paths[i] << endl;
+        document doc;
+        import_factory factory(doc);
+        orcus_xlsx app(&factory);
+        app.read_file(paths[i]);
+
+        memory_usage_t usage = doc.get_memory_usage();
+        doc.dump_memory_usage(cout);
+        assert(usage.sheets.size() == doc.sheet_size());
+        assert(usage.styles > 0);
+        assert(usage.total() > usage.string_pool);
+
+        size_t cell_stores = 0;
+        for (size_t j = 0; j < usage.sheets.size(); ++j)
+            cell_stores += usage.sheets[j].cell_stores;
+        assert(cell_stores > 0);
+
+        // Compacting never increases the usage, and leaves the cell stores
+        // alone.
+        doc.compact();
+        memory_usage_t usage2 = doc.get_memory_usage();
+        assert(usage2.total() <= usage.total());
+        assert(usage2.string_pool <= usage.string_pool);
+        for (size_t j = 0; j < usage.sheets.size(); ++j)
+            assert(usage2.sheets[j].cell_stores == usage.sheets[j].cell_stores);
+    }
+
+    // Tables are accounted for.
+    document doc;
+    import_factory factory(doc);
+    orcus_xlsx app(&factory);
+    app.read_file(SRCDIR"/test/xlsx/table/table-1.xlsx");
+    assert(doc.get_memory_usage().tables > 0);
+
+    // So are formula tokens.
+    doc.clear();
+    app.read_file(SRCDIR"/test/xlsx/formula-simple.xlsx");
+    memory_usage_t usage = doc.get_memory_usage();
+    size_t formula_tokens = 0;
+    for (size_t j = 0; j < usage.sheets.size(); ++j)
+        formula_tokens += usage.sheets[j].formula_tokens;
+    assert(formula_tokens > 0);
 }
 
 int main()
@@ -178,6 +985,17 @@ int main()
     test_xlsx_import();
     test_xlsx_table_autofilter();
     test_xlsx_table();
+    test_xlsx_deduplicate_styles();
+    test_deduplicate_styles_known_duplicates();
+    test_xlsx_cell_iterator();
+    test_xlsx_column_chunk();
+    test_xlsx_snapshot();
+    test_xlsx_snapshot_tables();
+    test_xlsx_snapshot_invalid();
+    test_xlsx_reimport();
+    test_xlsx_frozen_concurrent_read();
+    test_xlsx_compact();
+    test_xlsx_memory_usage();
     return EXIT_SUCCESS;
 }
 /* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -27,10 +27,10 @@ int main(int argc, char** argv)
     if (argc < 2)
         return EXIT_FAILURE;
 
-    string strm;
+    std::unique_ptr<file_content> strm;
     try
     {
-        strm = load_file_content(argv[1]);
+        strm.reset(new file_content(argv[1]));
     }
     catch (const std::exception& e)
     {
@@ -38,7 +38,7 @@ int main(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
-    if (strm.empty())
+    if (strm->empty())
         return EXIT_FAILURE;
 
     try
@@ -46,7 +46,7 @@ int main(int argc, char** argv)
         xmlns_repository repo;
         xmlns_context cxt = repo.create_context();
         dom_tree_sax_handler hdl(cxt);
-        sax_ns_parser<dom_tree_sax_handler> parser(strm.c_str(), strm.size(), cxt, hdl);
+        sax_ns_parser<dom_tree_sax_handler> parser(strm->data(), strm->size(), cxt, hdl);
         parser.parse();
         ostringstream os;
         hdl.dump_compact(os);
@@ -54,7 +54,7 @@ int main(int argc, char** argv)
     }
     catch (const sax::malformed_xml_error& e)
     {
-        cerr << create_parse_error_output(strm, e.offset()) << endl;
+        cerr << create_parse_error_output(*strm, e.offset()) << endl;
         cerr << e.what() << endl;
         return EXIT_FAILURE;
     }
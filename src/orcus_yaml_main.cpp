@@ -147,10 +147,10 @@ int main(int argc, char** argv)
 
     try
     {
-        std::string strm = load_file_content(config->input_path.c_str());
+        file_content strm(config->input_path.c_str());
 
         yaml_document_tree doc;
-        doc.load(strm);
+        doc.load(strm.data(), strm.size());
 
         switch (config->output_format)
         {
@@ -7,8 +7,227 @@
 
 #include "orcus/csv_parser_base.hpp"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#define ORCUS_CSV_SSE2 1
+#include <emmintrin.h>
+#else
+#define ORCUS_CSV_SSE2 0
+#endif
+
 namespace orcus { namespace csv {
 
+namespace {
+
+const size_t block_size = 64;
+
+const unsigned char char_type_end   = 0x01;
+const unsigned char char_type_quote = 0x02;
+
+/**
+ * Bit i of the returned value is the parity of bits 0 through i of the
+ * input value.
+ */
+uint64_t prefix_xor(uint64_t v)
+{
+    v ^= v << 1;
+    v ^= v << 2;
+    v ^= v << 4;
+    v ^= v << 8;
+    v ^= v << 16;
+    v ^= v << 32;
+    return v;
+}
+
+size_t count_trailing_zeros(uint64_t v)
+{
+    assert(v);
+#if defined(__GNUC__)
+    return __builtin_ctzll(v);
+#else
+    size_t n = 0;
+    for (; !(v & 1); v >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+#if ORCUS_CSV_SSE2
+
+/**
+ * Get the positions of all occurrences of a character within a 64-byte
+ * block, given as four 16-byte chunks.
+ */
+uint64_t match_block(const __m128i* chunks, char c)
+{
+    __m128i pattern = _mm_set1_epi8(c);
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        uint64_t m = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[i], pattern)));
+        mask |= m << (i * 16);
+    }
+    return mask;
+}
+
+#endif
+
+}
+
+block_scanner::block_scanner(const char* p, size_t n, const parser_config& config) :
+    mp_begin(p), mp_end(p+n), mp_block(NULL), m_ends(0), m_quotes(0),
+    m_delimiters(config.delimiters), m_text_qualifier(config.text_qualifier)
+{
+    std::memset(m_char_types, 0, sizeof(m_char_types));
+    m_char_types[static_cast<unsigned char>('\n')] |= char_type_end;
+    for (size_t i = 0; i < m_delimiters.size(); ++i)
+        m_char_types[static_cast<unsigned char>(m_delimiters[i])] |= char_type_end;
+    m_char_types[static_cast<unsigned char>(m_text_qualifier)] |= char_type_quote;
+}
+
+size_t block_scanner::load_block(const char* p)
+{
+    size_t pos = p - mp_begin;
+    const char* block = mp_begin + (pos - pos % block_size);
+    if (block == mp_block)
+        return p - mp_block;
+
+    mp_block = block;
+    size_t n = mp_end - block;
+    if (n < block_size)
+    {
+        classify_tail(block, n);
+        return p - mp_block;
+    }
+
+#if ORCUS_CSV_SSE2
+    __m128i chunks[4];
+    for (size_t i = 0; i < 4; ++i)
+        chunks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+
+    m_ends = match_block(chunks, '\n');
+    for (size_t i = 0; i < m_delimiters.size(); ++i)
+        m_ends |= match_block(chunks, m_delimiters[i]);
+
+    m_quotes = match_block(chunks, m_text_qualifier);
+#else
+    classify_tail(block, block_size);
+#endif
+
+    return p - mp_block;
+}
+
+void block_scanner::classify_tail(const char* p, size_t n)
+{
+    m_ends = 0;
+    m_quotes = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        unsigned char type = m_char_types[static_cast<unsigned char>(p[i])];
+        m_ends |= static_cast<uint64_t>(type & char_type_end) << i;
+        m_quotes |= static_cast<uint64_t>((type & char_type_quote) >> 1) << i;
+    }
+}
+
+const char* block_scanner::find_cell_end(const char* p)
+{
+    for (; p < mp_end; p = mp_block + block_size)
+    {
+        size_t offset = load_block(p);
+        uint64_t ends = m_ends & (~static_cast<uint64_t>(0) << offset);
+        if (ends)
+            return mp_block + count_trailing_zeros(ends);
+    }
+
+    return mp_end;
+}
+
+const char* block_scanner::find_closing_quote(const char* p, bool& escaped)
+{
+    escaped = false;
+
+    // All bits set while an odd number of quotes have been seen since the
+    // opening one.
+    uint64_t parity = 0;
+
+    for (++p; p < mp_end; p = mp_block + block_size)
+    {
+        size_t offset = load_block(p);
+        uint64_t quotes = m_quotes & (~static_cast<uint64_t>(0) << offset);
+        if (!quotes)
+            continue;
+
+        // Quotes that are immediately followed by another quote.
+        uint64_t followed = quotes >> 1;
+        const char* p_next = mp_block + block_size;
+        if (p_next < mp_end && *p_next == m_text_qualifier)
+            followed |= static_cast<uint64_t>(1) << 63;
+
+        // Quotes pair up from the start of each run.  An odd-numbered quote
+        // that is not followed by another quote closes the value.
+        uint64_t odd = prefix_xor(quotes) ^ parity;
+        uint64_t closing = quotes & odd & ~followed;
+        if (closing)
+        {
+            size_t pos = count_trailing_zeros(closing);
+            if (quotes & ((static_cast<uint64_t>(1) << pos) - 1))
+                escaped = true;
+
+            return mp_block + pos;
+        }
+
+        escaped = true;
+        parity = (odd >> 63) ? ~static_cast<uint64_t>(0) : 0;
+    }
+
+    return mp_end;
+}
+
+size_t find_last_row_end(const char* p, size_t n, const parser_config& config)
+{
+    // Step through the cells the same way the parser does.
+    block_scanner scanner(p, n, config);
+    const char* p_end = p + n;
+    const char* p_row_end = p;
+    const char* cur = p;
+
+    while (cur != p_end)
+    {
+        if (*cur == config.text_qualifier)
+        {
+            bool escaped = false;
+            cur = scanner.find_closing_quote(cur, escaped);
+            if (cur == p_end)
+                break;
+
+            // Skip the closing quote and any blanks after it.
+            for (++cur; cur != p_end && (*cur == ' ' || *cur == '\t'); ++cur)
+                ;
+        }
+        else
+            cur = scanner.find_cell_end(cur);
+
+        if (cur == p_end)
+            break;
+
+        if (*cur == '\n')
+        {
+            p_row_end = ++cur;
+            continue;
+        }
+
+        // Skip the delimiter.
+        ++cur;
+
+        if (config.trim_cell_value)
+        {
+            for (; cur != p_end && (*cur == ' ' || *cur == '\t'); ++cur)
+                ;
+        }
+    }
+
+    return p_row_end - p;
+}
+
 parser_config::parser_config() :
     text_qualifier('\0'),
     trim_cell_value(false) {}
@@ -24,7 +243,7 @@ const char* parse_error::what() const throw()
 
 parser_base::parser_base(
     const char* p, size_t n, const csv::parser_config& config) :
-    ::orcus::parser_base(p, n), m_config(config) {}
+    ::orcus::parser_base(p, n), m_config(config), m_scanner(p, n, config) {}
 
 bool parser_base::is_blank(char c) const
 {
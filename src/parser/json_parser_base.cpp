@@ -11,9 +11,293 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <new>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define ORCUS_JSON_SSE2 1
+#include <emmintrin.h>
+#else
+#define ORCUS_JSON_SSE2 0
+#endif
 
 namespace orcus { namespace json {
 
+namespace {
+
+const size_t block_size = 64;
+
+/**
+ * Characters of a 64-byte block by their type, one bit per character.
+ */
+struct block_masks
+{
+    uint64_t ops;         /// '{', '}', '[', ']', ':' and ','.
+    uint64_t quotes;
+    uint64_t backslashes;
+    uint64_t blanks;      /// any character that skip_blanks() skips.
+};
+
+/**
+ * Bit i of the returned value is the parity of bits 0 through i of the
+ * input value.
+ */
+uint64_t prefix_xor(uint64_t v)
+{
+    v ^= v << 1;
+    v ^= v << 2;
+    v ^= v << 4;
+    v ^= v << 8;
+    v ^= v << 16;
+    v ^= v << 32;
+    return v;
+}
+
+size_t popcount(uint64_t v)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(v);
+#else
+    size_t n = 0;
+    for (; v; v &= v - 1)
+        ++n;
+    return n;
+#endif
+}
+
+size_t count_trailing_zeros(uint64_t v)
+{
+    assert(v);
+#if defined(__GNUC__)
+    return __builtin_ctzll(v);
+#else
+    size_t n = 0;
+    for (; !(v & 1); v >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+#if ORCUS_JSON_SSE2
+
+/**
+ * Combine the results of comparing four 16-byte chunks into one mask.
+ */
+uint64_t to_mask(const __m128i* results)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        uint64_t m = static_cast<uint32_t>(_mm_movemask_epi8(results[i]));
+        mask |= m << (i * 16);
+    }
+    return mask;
+}
+
+void classify_block(const char* p, block_masks& masks)
+{
+    __m128i ops[4], quotes[4], backslashes[4], blanks[4];
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 16));
+
+        // '[' and ']', '{' and '}' differ only in 0x20 bit.
+        __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        ops[i] = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+            _mm_or_si128(
+                _mm_cmpeq_epi8(v, _mm_set1_epi8(':')),
+                _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+
+        quotes[i] = _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+        backslashes[i] = _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'));
+
+        // Signed comparison, same as skip_blanks().
+        blanks[i] = _mm_cmplt_epi8(v, _mm_set1_epi8(' ' + 1));
+    }
+
+    masks.ops = to_mask(ops);
+    masks.quotes = to_mask(quotes);
+    masks.backslashes = to_mask(backslashes);
+    masks.blanks = to_mask(blanks);
+}
+
+#else
+
+void classify_block(const char* p, block_masks& masks)
+{
+    masks.ops = 0;
+    masks.quotes = 0;
+    masks.backslashes = 0;
+    masks.blanks = 0;
+
+    for (size_t i = 0; i < block_size; ++i)
+    {
+        uint64_t bit = uint64_t(1) << i;
+        char c = p[i];
+        switch (c)
+        {
+            case '{':
+            case '}':
+            case '[':
+            case ']':
+            case ':':
+            case ',':
+                masks.ops |= bit;
+            break;
+            case '"':
+                masks.quotes |= bit;
+            break;
+            case '\\':
+                masks.backslashes |= bit;
+            break;
+            default:
+                if (c <= ' ')
+                    masks.blanks |= bit;
+        }
+    }
+}
+
+#endif
+
+/**
+ * Builds the structural index one block at a time, carrying the state that
+ * spans block boundaries.
+ */
+class structural_indexer
+{
+    uint64_t m_prev_escaped;   /// 1 if the first character of the next block is escaped.
+    uint64_t m_prev_in_string; /// all ones if the previous block ended inside a string.
+    uint64_t m_prev_separator; /// 1 if the previous block ended with a separator.
+
+    /**
+     * Find the characters that are escaped by a backslash, i.e. those that
+     * follow an odd number of consecutive backslashes.
+     */
+    uint64_t find_escaped(uint64_t backslashes)
+    {
+        const uint64_t even_bits = 0x5555555555555555ULL;
+
+        backslashes &= ~m_prev_escaped;
+        uint64_t follows_escape = backslashes << 1 | m_prev_escaped;
+
+        // Adding the start of each run of backslashes that begins on an odd
+        // bit carries through the run, which flips the parity of the
+        // characters following it.
+        uint64_t odd_starts = backslashes & ~even_bits & ~follows_escape;
+        uint64_t even_carries = odd_starts + backslashes;
+        m_prev_escaped = even_carries < odd_starts ? 1 : 0;
+
+        uint64_t invert_mask = even_carries << 1;
+        return (even_bits ^ invert_mask) & follows_escape;
+    }
+
+public:
+    structural_indexer() : m_prev_escaped(0), m_prev_in_string(0), m_prev_separator(1) {}
+
+    /**
+     * @return bits of the structural characters in the block.
+     */
+    uint64_t index_block(const block_masks& masks)
+    {
+        uint64_t quotes = masks.quotes & ~find_escaped(masks.backslashes);
+
+        // Opening quotes and string contents, but not closing quotes.
+        uint64_t in_string = prefix_xor(quotes) ^ m_prev_in_string;
+        m_prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+        // A scalar value such as a number starts where a character other
+        // than a separator follows a separator.
+        uint64_t separators = masks.blanks | masks.ops | quotes;
+        uint64_t follows_separator = separators << 1 | m_prev_separator;
+        m_prev_separator = separators >> 63;
+        uint64_t scalar_starts = ~separators & follows_separator;
+
+        return ((masks.ops | scalar_starts) & ~in_string) | quotes;
+    }
+};
+
+/**
+ * Write the positions of the set bits.  The destination must have room
+ * for 64 positions, as they are written eight at a time to avoid branching
+ * on each bit.
+ */
+void write_positions(uint32_t* dest, uint32_t base, uint64_t bits)
+{
+    while (bits)
+    {
+        for (size_t i = 0; i < 8; ++i)
+        {
+            dest[i] = base + (bits ? count_trailing_zeros(bits) : 0);
+            bits &= bits - 1;
+        }
+        dest += 8;
+    }
+}
+
+/**
+ * @param index array that receives the positions, which must have room for
+ *              one more block than the length of the stream.
+ *
+ * @return number of positions in the index.
+ */
+size_t build_index(const char* p, size_t n, uint32_t* index)
+{
+    structural_indexer indexer;
+    block_masks masks;
+    size_t size = 0;
+
+    size_t pos = 0;
+    for (; pos + block_size <= n; pos += block_size)
+    {
+        classify_block(p + pos, masks);
+        uint64_t bits = indexer.index_block(masks);
+
+        // Positions past the last set bit are overwritten by the next block.
+        write_positions(index + size, pos, bits);
+        size += popcount(bits);
+    }
+
+    if (pos < n)
+    {
+        // Pad the last block with blanks.
+        char buf[block_size];
+        std::memset(buf, ' ', block_size);
+        std::memcpy(buf, p + pos, n - pos);
+        classify_block(buf, masks);
+        uint64_t bits = indexer.index_block(masks) & ((uint64_t(1) << (n - pos)) - 1);
+        write_positions(index + size, pos, bits);
+        size += popcount(bits);
+    }
+
+    return size;
+}
+
+}
+
+std::unique_ptr<uint32_t[]> build_structural_index(const char* p, size_t n, size_t& size)
+{
+    std::unique_ptr<uint32_t[]> index;
+    if (n >= std::numeric_limits<uint32_t>::max())
+        return index;
+
+    // Allocate for the worst case of every character being structural.
+    // Most of the array is never written to, and such pages are not
+    // committed by most systems.
+    index.reset(new (std::nothrow) uint32_t[n + block_size + 1]);
+    if (!index)
+        return index;
+
+    size = build_index(p, n, index.get());
+    index[size] = n;
+    return index;
+}
+
 parse_error::parse_error(const std::string& msg, std::ptrdiff_t offset) :
     ::orcus::parse_error(msg, offset) {}
 
@@ -32,6 +316,7 @@ void parse_error::throw_with(
 struct parser_base::impl
 {
     cell_buffer m_buffer;
+    std::unique_ptr<uint32_t[]> m_index;
 };
 
 parser_base::parser_base(const char* p, size_t n) :
@@ -85,10 +370,18 @@ double parser_base::parse_double_or_throw()
     return v;
 }
 
+const uint32_t* parser_base::build_structural_index()
+{
+    size_t size = 0;
+    mp_impl->m_index = json::build_structural_index(mp_begin, mp_end - mp_begin, size);
+    return mp_impl->m_index.get();
+}
+
 parse_quoted_string_state parser_base::parse_string()
 {
     assert(cur_char() == '"');
-    size_t max_length = remaining_size();
+    // The maximum length includes the opening quote.
+    size_t max_length = mp_end - mp_char;
     const char* p = mp_char;
     parse_quoted_string_state ret = parse_double_quoted_string(p, max_length, mp_impl->m_buffer);
     mp_char = p;
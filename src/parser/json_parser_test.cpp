@@ -0,0 +1,250 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "orcus/json_parser.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+using namespace std;
+using namespace orcus;
+
+namespace {
+
+/**
+ * Record all callbacks as text.
+ */
+class recording_handler
+{
+    ostringstream& m_os;
+public:
+    recording_handler(ostringstream& os) : m_os(os) {}
+
+    void begin_parse() { m_os << "<"; }
+    void end_parse() { m_os << ">"; }
+    void begin_array() { m_os << "["; }
+    void end_array() { m_os << "]"; }
+    void begin_object() { m_os << "{"; }
+    void end_object() { m_os << "}"; }
+    void boolean_true() { m_os << "t "; }
+    void boolean_false() { m_os << "f "; }
+    void null() { m_os << "n "; }
+    void number(double val) { m_os << val << " "; }
+
+    void object_key(const char* p, size_t len, bool transient)
+    {
+        m_os << "k(" << std::string(p, len) << "," << transient << ") ";
+    }
+
+    void string(const char* p, size_t len, bool transient)
+    {
+        m_os << "s(" << std::string(p, len) << "," << transient << ") ";
+    }
+};
+
+/**
+ * @return text of all callbacks, or "error" if the stream failed to parse.
+ */
+string parse_to_text(const string& strm, bool indexed)
+{
+    // Copy the stream into a buffer of its exact size, so that reading past
+    // its end gets caught by the address sanitizer.
+    std::unique_ptr<char[]> buf(new char[strm.size()]);
+    std::copy(strm.begin(), strm.end(), buf.get());
+
+    ostringstream os;
+    recording_handler hdl(os);
+    json_parser<recording_handler> parser(buf.get(), strm.size(), hdl);
+    try
+    {
+        if (indexed)
+            parser.parse_indexed();
+        else
+            parser.parse();
+    }
+    catch (const json::parse_error&)
+    {
+        return "error";
+    }
+
+    return os.str();
+}
+
+void check_indexed(const string& strm)
+{
+    string expected = parse_to_text(strm, false);
+    string actual = parse_to_text(strm, true);
+    if (expected != actual)
+    {
+        cerr << "stream: '" << strm << "'" << endl;
+        cerr << "expected: " << expected << endl;
+        cerr << "actual: " << actual << endl;
+        assert(false);
+    }
+}
+
+/**
+ * Parse both valid and broken streams in two stages, and check that the
+ * callbacks match those of the regular parse, and that the same streams
+ * fail to parse.  The fragments
+ * include backslashes and quotes, so that runs of backslashes and strings
+ * of various lengths fall across the 64-byte block boundaries of the
+ * index.
+ */
+void test_json_parse_indexed()
+{
+    const char* valids[] = {
+        "[]",
+        "[ ]",
+        "  {  }  ",
+        "[1, -2.5, 3e2, 1.5E-3, true, false, null]",
+        "{\"key\": \"value\", \"nested\": {\"array\": [[], {}, [1, [2, [3]]]]}}",
+        "[\"escaped \\\"quote\\\"\", \"backslash \\\\\", \"\\\\\\\\\", \"tab\\tnewline\\n\"]",
+        "\n\t[\r\n  \"a\" ,\n  \"b\"\n]\n",
+        "[\"\xc3\xa9t\xc3\xa9\", \"{[:,]}\"]",
+    };
+
+    for (size_t i = 0; i < sizeof(valids)/sizeof(valids[0]); ++i)
+    {
+        string strm = valids[i];
+        check_indexed(strm);
+        assert(parse_to_text(strm, true) != "error");
+
+        // Shift the content across the block boundaries.
+        for (size_t shift = 1; shift < 70; ++shift)
+            check_indexed(string(shift, ' ') + strm);
+    }
+
+    // Streams that end right where more content is expected.
+    const char* truncated[] = {
+        "{\"k\"",
+        "{\"k\"  ",
+        "{\"k\":",
+        "{\"k\": 1",
+        "[1e",
+        "[-",
+        "[\"a\"",
+    };
+
+    for (size_t i = 0; i < sizeof(truncated)/sizeof(truncated[0]); ++i)
+    {
+        string strm = truncated[i];
+        check_indexed(strm);
+        assert(parse_to_text(strm, false) == "error");
+    }
+
+    const char* fragments[] = {
+        "[", "]", "{", "}", ":", ",", " ", "\n", "\"", "\\", "\\\\", "\\\"",
+        "\"key\":", "\"long string value with a few words\"", "\"esc\\\"aped\"",
+        "12", "-3.5e1", "true", "null", "x", "                    ",
+    };
+    const size_t fragment_count = sizeof(fragments)/sizeof(fragments[0]);
+
+    unsigned int seed = 1;
+    for (size_t i = 0; i < 20000; ++i)
+    {
+        string strm = i % 2 ? "[" : "{\"k\":[";
+        size_t n = i % 60;
+        for (size_t j = 0; j < n; ++j)
+        {
+            seed = seed * 1103515245 + 12345;
+            strm += fragments[(seed >> 16) % fragment_count];
+        }
+
+        check_indexed(strm);
+    }
+
+    // Generated documents that are valid.
+    for (size_t i = 0; i < 200; ++i)
+    {
+        ostringstream os;
+        os << "[";
+        for (size_t j = 0; j < i; ++j)
+        {
+            if (j)
+                os << (j % 3 ? "," : ",\n    ");
+            seed = seed * 1103515245 + 12345;
+            switch ((seed >> 16) % 5)
+            {
+                case 0:
+                    os << "{\"id\": " << j << ", \"name\": \"item " << j << "\"}";
+                break;
+                case 1:
+                    os << "\"" << string((seed >> 8) % 80, '\\') << string((seed >> 8) % 80, '\\') << "\"";
+                break;
+                case 2:
+                    os << "[" << (seed >> 8) % 1000 << ", null]";
+                break;
+                case 3:
+                    os << "\"" << string((seed >> 8) % 100, 'v') << "\\\"\"";
+                break;
+                default:
+                    os << "false";
+            }
+        }
+        os << "]";
+
+        string strm = os.str();
+        check_indexed(strm);
+        assert(parse_to_text(strm, true) != "error");
+    }
+}
+
+void test_json_parse_lines()
+{
+    // Each record is enclosed in its own pair of begin_parse and end_parse.
+    string strm = "{\"a\": 1}\n[true, \"b\"]\r\n\n   \n  {}  \n[null]";
+    ostringstream os;
+    recording_handler hdl(os);
+    json_parser<recording_handler> parser(strm.data(), strm.size(), hdl);
+    parser.parse_lines();
+    assert(os.str() == "<{k(a,0) 1 }><[t s(b,0) ]><{}><[n ]>");
+
+    // A record may not span multiple lines.
+    strm = "{\"a\": 1}\n[1,\n2]\n";
+    ostringstream os2;
+    recording_handler hdl2(os2);
+    json_parser<recording_handler> parser2(strm.data(), strm.size(), hdl2);
+    try
+    {
+        parser2.parse_lines();
+        assert(false);
+    }
+    catch (const json::parse_error& e)
+    {
+        // The error is at the end of the second line, relative to the whole
+        // stream.
+        assert(e.offset() == 12);
+    }
+
+    // Blank streams contain no records.
+    const char* blanks[] = { "", "\n", " \n\n \r\n" };
+    for (size_t i = 0; i < sizeof(blanks)/sizeof(blanks[0]); ++i)
+    {
+        strm = blanks[i];
+        ostringstream os3;
+        recording_handler hdl3(os3);
+        json_parser<recording_handler> parser3(strm.data(), strm.size(), hdl3);
+        parser3.parse_lines();
+        assert(os3.str().empty());
+    }
+}
+
+}
+
+int main()
+{
+    test_json_parse_indexed();
+    test_json_parse_lines();
+    return EXIT_SUCCESS;
+}
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -7,8 +7,19 @@
 
 #include "orcus/parser_global.hpp"
 #include "orcus/cell_buffer.hpp"
+#include "orcus/pstring.hpp"
 
 #include <cassert>
+#include <cstring>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <string>
+#ifdef _WIN32
+#include "win_stdint.h"
+#else
+#include <stdint.h>
+#endif
 
 namespace orcus {
 
@@ -115,6 +126,398 @@ double parse_numeric(const char*& p, size_t max_length)
     return negative_sign ? -ret : ret;
 }
 
+namespace {
+
+#include "numeric_pow5_table.inl"
+
+struct uint128
+{
+    uint64_t high;
+    uint64_t low;
+};
+
+uint128 multiply_64(uint64_t a, uint64_t b)
+{
+    uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+    uint64_t b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+
+    uint64_t lo_lo = a_lo * b_lo;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t lo_hi = a_lo * b_hi;
+    uint64_t hi_hi = a_hi * b_hi;
+
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+
+    uint128 ret;
+    ret.high = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    ret.low = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    return ret;
+}
+
+int count_leading_zeros(uint64_t v)
+{
+    int n = 0;
+    for (uint64_t mask = uint64_t(1) << 63; !(v & mask); mask >>= 1)
+        ++n;
+    return n;
+}
+
+double make_double(bool negative, uint64_t mantissa, int power2)
+{
+    uint64_t bits = mantissa | (uint64_t(power2) << 52);
+    if (negative)
+        bits |= uint64_t(1) << 63;
+
+    double ret;
+    std::memcpy(&ret, &bits, sizeof(ret));
+    return ret;
+}
+
+/**
+ * Compute the double nearest to w * 10^q using the Eisel-Lemire algorithm.
+ * The 128-bit approximation of the power of five is always sufficient as
+ * long as w is exact.  The caller must make sure that w is non-zero and q
+ * is within the range of the power of five table.
+ */
+double compute_double(bool negative, uint64_t w, int q)
+{
+    const int mantissa_bits = 52;
+    const int infinite_power = 0x7FF;
+
+    int lz = count_leading_zeros(w);
+    w <<= lz;
+
+    // Multiply by the truncated power of five, and refine the product with
+    // the lower 64 bits only when the upper bits are all ones.
+    size_t index = 2 * size_t(q - pow5_table_min_exp);
+    uint128 product = multiply_64(w, pow5_table[index]);
+    const uint64_t precision_mask = uint64_t(0xFFFFFFFFFFFFFFFF) >> (mantissa_bits + 3);
+    if ((product.high & precision_mask) == precision_mask)
+    {
+        uint128 second = multiply_64(w, pow5_table[index+1]);
+        product.low += second.high;
+        if (second.high > product.low)
+            ++product.high;
+    }
+
+    int upperbit = int(product.high >> 63);
+    int shift = upperbit + 64 - mantissa_bits - 3;
+    uint64_t mantissa = product.high >> shift;
+
+    // floor(log2(10^q)) + 63, computed without floating point.
+    int power2 = (((152170 + 65536) * q) >> 16) + 63 + upperbit - lz + 1023;
+
+    if (power2 <= 0)
+    {
+        // Subnormal number.
+        if (-power2 + 1 >= 64)
+            return make_double(negative, 0, 0);
+
+        mantissa >>= -power2 + 1;
+        mantissa += (mantissa & 1);
+        mantissa >>= 1;
+        power2 = (mantissa < (uint64_t(1) << mantissa_bits)) ? 0 : 1;
+        return make_double(negative, mantissa, power2);
+    }
+
+    // Values exactly halfway between two doubles need to round to even.
+    if (product.low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1)
+    {
+        if ((mantissa << shift) == product.high)
+            mantissa &= ~uint64_t(1);
+    }
+
+    mantissa += (mantissa & 1);
+    mantissa >>= 1;
+    if (mantissa >= (uint64_t(2) << mantissa_bits))
+    {
+        mantissa = uint64_t(1) << mantissa_bits;
+        ++power2;
+    }
+
+    mantissa &= ~(uint64_t(1) << mantissa_bits);
+    if (power2 >= infinite_power)
+        return make_double(negative, 0, infinite_power);
+
+    return make_double(negative, mantissa, power2);
+}
+
+/**
+ * Slow but exact conversion, used only when the mantissa has too many
+ * significant digits for the fast path to decide the rounding.  The
+ * classic locale ensures that '.' is always the decimal separator.
+ */
+double parse_numeric_fallback(const char* p, size_t n)
+{
+    std::istringstream is(std::string(p, n));
+    is.imbue(std::locale::classic());
+    double ret = 0.0;
+    is >> ret;
+    return ret;
+}
+
+const double exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * Convert 8 decimal digits at once.  The characters are loaded into a
+ * 64-bit word, which is then validated and converted as a whole.
+ *
+ * @return false if any of the characters is not a digit.
+ */
+bool parse_8_digits(const char* p, uint64_t& value)
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+
+    // Each byte must have 0x3 in its high nibble, and must not carry into
+    // the next nibble when 6 is added to it.
+    const uint64_t high_nibbles = 0xF0F0F0F0F0F0F0F0;
+    const uint64_t zeros = 0x3030303030303030;
+    if ((v & high_nibbles) != zeros || ((v + 0x0606060606060606) & high_nibbles) != zeros)
+        return false;
+
+    // Combine adjacent digits into 2-digit, then 4-digit and finally
+    // 8-digit values.  The first character is in the lowest byte.
+    v -= zeros;
+    v = v * 10 + (v >> 8);
+    value = ((v & 0x000000FF000000FF) * (100 + (uint64_t(1000000) << 32)) +
+             ((v >> 16) & 0x000000FF000000FF) * (1 + (uint64_t(10000) << 32))) >> 32;
+    return true;
+}
+
+/**
+ * Convert a plain decimal number with an optional sign and an optional
+ * fraction, without an exponent and with at most 15 digits.  Such a
+ * mantissa is exactly representable, so the result is the same as that of
+ * the fast path of parse_numeric_string().
+ *
+ * @return false if the range is not of this form, in which case it may
+ *         still be a number.
+ */
+bool parse_short_decimal(const char* p, size_t n, double& value)
+{
+    const char* p_end = p + n;
+
+    bool negative = false;
+    if (p != p_end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    size_t digits = 0;
+    size_t frac_len = 0;
+    bool fraction = false;
+
+    for (; p != p_end; ++p)
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        // Long runs of digits are consumed 8 at a time.
+        uint64_t v;
+        if (p_end - p >= 8 && digits <= 7 && parse_8_digits(p, v))
+        {
+            mantissa = mantissa * 100000000 + v;
+            digits += 8;
+            if (fraction)
+                frac_len += 8;
+
+            p += 7;
+            continue;
+        }
+#endif
+        unsigned int d = static_cast<unsigned char>(*p) - '0';
+        if (d < 10)
+        {
+            mantissa = mantissa * 10 + d;
+            ++digits;
+            frac_len += fraction;
+        }
+        else if (*p == '.' && !fraction)
+            fraction = true;
+        else
+            return false;
+    }
+
+    if (!digits || digits > 15)
+        return false;
+
+    double v = double(mantissa);
+    if (frac_len)
+        v /= exact_powers_of_ten[frac_len];
+
+    value = negative ? -v : v;
+    return true;
+}
+
+}
+
+bool parse_numeric_string(const char* p, size_t n, double& value)
+{
+    const char* p_end = p + n;
+
+    // Skip leading blanks.
+    for (; p != p_end && is_blank(*p); ++p)
+        ;
+
+    const char* p_start = p;
+
+    if (p == p_end)
+        return false;
+
+    bool negative = false;
+    switch (*p)
+    {
+        case '-':
+            negative = true;
+            // fall through
+        case '+':
+            ++p;
+        break;
+        default:
+            ;
+    }
+
+    // Accumulate up to 19 significant digits, which always fit in 64 bits.
+    const int max_digits = 19;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exp10 = 0;
+    bool truncated = false;
+    bool has_digits = false;
+
+    for (; p != p_end && is_numeric(*p); ++p)
+    {
+        has_digits = true;
+        if (digits < max_digits)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa)
+                ++digits;
+        }
+        else
+        {
+            if (*p != '0')
+                truncated = true;
+            ++exp10;
+        }
+    }
+
+    if (p != p_end && *p == '.')
+    {
+        for (++p; p != p_end && is_numeric(*p); ++p)
+        {
+            has_digits = true;
+            if (digits < max_digits)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa)
+                    ++digits;
+                --exp10;
+            }
+            else if (*p != '0')
+                truncated = true;
+        }
+    }
+
+    if (!has_digits)
+        return false;
+
+    if (p != p_end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        bool exp_negative = false;
+        if (p != p_end && (*p == '+' || *p == '-'))
+        {
+            exp_negative = *p == '-';
+            ++p;
+        }
+
+        if (p == p_end || !is_numeric(*p))
+            return false;
+
+        int exp = 0;
+        for (; p != p_end && is_numeric(*p); ++p)
+        {
+            // Clamp to avoid overflow.  Any exponent this large is outside
+            // the range of double anyway.
+            if (exp < 100000)
+                exp = exp * 10 + (*p - '0');
+        }
+
+        exp10 += exp_negative ? -exp : exp;
+    }
+
+    if (p != p_end)
+        // Trailing characters.  This is not a number.
+        return false;
+
+    if (!mantissa)
+    {
+        value = negative ? -0.0 : 0.0;
+        return true;
+    }
+
+    if (!truncated)
+    {
+        // Fast path: both the mantissa and the power of ten are exactly
+        // representable, so a single multiplication or division rounds
+        // correctly.
+        if (-22 <= exp10 && exp10 <= 22 && mantissa <= (uint64_t(1) << 53))
+        {
+            double v = double(mantissa);
+            if (exp10 < 0)
+                v /= exact_powers_of_ten[-exp10];
+            else
+                v *= exact_powers_of_ten[exp10];
+
+            value = negative ? -v : v;
+            return true;
+        }
+    }
+
+    if (exp10 < pow5_table_min_exp)
+    {
+        value = negative ? -0.0 : 0.0;
+        return true;
+    }
+
+    if (exp10 > pow5_table_max_exp)
+    {
+        value = negative ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+        return true;
+    }
+
+    double v = compute_double(negative, mantissa, exp10);
+    if (truncated)
+    {
+        // The true value lies between mantissa and mantissa+1.  If both
+        // round to the same double we are done, otherwise defer to the
+        // exact conversion.
+        if (v != compute_double(negative, mantissa + 1, exp10))
+            v = parse_numeric_fallback(p_start, p_end - p_start);
+    }
+
+    value = v;
+    return true;
+}
+
+size_t parse_numeric_strings(const pstring* strs, size_t n, double* values)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        const char* p = strs[i].get();
+        size_t len = strs[i].size();
+        if (!parse_short_decimal(p, len, values[i]) && !parse_numeric_string(p, len, values[i]))
+            return i;
+    }
+
+    return n;
+}
+
 long parse_integer(const char*& p, size_t max_length)
 {
     const char* p_end = p + max_length;
@@ -216,6 +619,11 @@ parse_quoted_string_state parse_string_with_escaped_char(
                     buffer.append(p_head, len-1);
                     buffer.append(&c, 1);
                     ++p;
+                    if (p == p_end)
+                    {
+                        ret.length = parse_quoted_string_state::error_no_closing_quote;
+                        return ret;
+                    }
                     len = 0;
                     p_head = p;
                 break;
@@ -448,7 +856,7 @@ parse_quoted_string_state parse_double_quoted_string(
             switch (get_string_escape_char_type(c))
             {
                 case string_escape_char_t::valid:
-                    return parse_string_with_escaped_char(p, max_length, ret.str, ret.length-1, c, buffer);
+                    return parse_string_with_escaped_char(p, p_end - p, ret.str, ret.length-1, c, buffer);
                 case string_escape_char_t::control_char:
                     // do nothing on control characters.
                 break;
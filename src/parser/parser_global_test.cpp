@@ -0,0 +1,226 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "orcus/parser_global.hpp"
+#include "orcus/pstring.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace orcus;
+
+namespace {
+
+bool parse(const char* s, double& val)
+{
+    return parse_numeric_string(s, strlen(s), val);
+}
+
+}
+
+void test_parse_numeric_string_valid()
+{
+    const char* inputs[] = {
+        "0",
+        "-0",
+        "12",
+        "+12",
+        "-12.5",
+        ".5",
+        "5.",
+        "  42",
+        "1e10",
+        "1E-10",
+        "1.5e+3",
+        "0.1",
+        "3.141592653589793",
+        "123456789012345678901234567890",
+        "0.000000000000000000000000000123456789",
+        "2.2250738585072011e-308",
+        "2.2250738585072014e-308",
+        "4.9e-324",
+        "1.7976931348623157e308",
+        "9007199254740993",
+        "1e23",
+    };
+
+    for (size_t i = 0, n = sizeof(inputs)/sizeof(inputs[0]); i < n; ++i)
+    {
+        const char* s = inputs[i];
+        double val = -1.0;
+        cout << "input: '" << s << "'" << endl;
+        assert(parse(s, val));
+
+        // The result must match strtod bit for bit.
+        double expected = strtod(s, NULL);
+        assert(memcmp(&val, &expected, sizeof(double)) == 0);
+    }
+}
+
+void test_parse_numeric_string_invalid()
+{
+    const char* inputs[] = {
+        "",
+        " ",
+        "-",
+        "+",
+        ".",
+        "e5",
+        "1e",
+        "1e+",
+        "abc",
+        "12a",
+        "1.2.3",
+        "1 ",
+        "0x10",
+        "inf",
+        "nan",
+        "--1",
+    };
+
+    for (size_t i = 0, n = sizeof(inputs)/sizeof(inputs[0]); i < n; ++i)
+    {
+        const char* s = inputs[i];
+        double val = -1.0;
+        cout << "input: '" << s << "'" << endl;
+        assert(!parse(s, val));
+        assert(val == -1.0); // value should be left untouched.
+    }
+}
+
+void test_parse_numeric_string_bounded()
+{
+    // Characters past the specified length must not be read.
+    const char* s = "123abc";
+    double val = 0.0;
+    assert(parse_numeric_string(s, 3, val));
+    assert(val == 123.0);
+
+    s = "1.5e3";
+    assert(parse_numeric_string(s, 3, val));
+    assert(val == 1.5);
+}
+
+void test_parse_numeric_string_out_of_range()
+{
+    double val = 0.0;
+    assert(parse("1e400", val));
+    assert(val == numeric_limits<double>::infinity());
+
+    assert(parse("-1e400", val));
+    assert(val == -numeric_limits<double>::infinity());
+
+    assert(parse("1e-400", val));
+    assert(val == 0.0);
+}
+
+bool same_bits(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+void test_parse_numeric_strings()
+{
+    // Generate values of all lengths around the 8-digit block boundaries,
+    // with and without a sign and a fraction.
+    vector<string> inputs;
+    unsigned int seed = 1;
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        size_t int_len = (seed >> 8) % 18;
+        seed = seed * 1103515245 + 12345;
+        size_t frac_len = (seed >> 8) % 10;
+
+        ostringstream os;
+        if (seed & 0x10000)
+            os << '-';
+        else if (seed & 0x20000)
+            os << '+';
+
+        for (size_t j = 0; j < int_len; ++j)
+        {
+            seed = seed * 1103515245 + 12345;
+            os << char('0' + (seed >> 16) % 10);
+        }
+
+        if (frac_len)
+        {
+            os << '.';
+            for (size_t j = 1; j < frac_len; ++j)
+            {
+                seed = seed * 1103515245 + 12345;
+                os << char('0' + (seed >> 16) % 10);
+            }
+        }
+
+        inputs.push_back(os.str());
+    }
+
+    const char* extra[] = {
+        "0", "-0", "-0.0", ".5", "5.", "007", " 12", "1e5", "1.5E-3",
+        "123456789012345", "1234567890123456", "0.000000000000001",
+        "99999999", "100000000", "9007199254740993"
+    };
+
+    for (size_t i = 0; i < sizeof(extra)/sizeof(extra[0]); ++i)
+        inputs.push_back(extra[i]);
+
+    vector<pstring> strs;
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        double expected = 0.0;
+        if (!parse_numeric_string(inputs[i].data(), inputs[i].size(), expected))
+            continue;
+
+        strs.push_back(pstring(inputs[i].data(), inputs[i].size()));
+        double val = 0.0;
+        assert(parse_numeric_strings(&strs.back(), 1, &val) == 1);
+        if (!same_bits(val, expected))
+        {
+            cerr << "input: " << inputs[i] << "  expected: " << expected << "  actual: " << val << endl;
+            assert(false);
+        }
+    }
+
+    vector<double> values(strs.size());
+    assert(parse_numeric_strings(strs.data(), strs.size(), values.data()) == strs.size());
+
+    // Conversion stops at the first range that is not a number.
+    const char* mixed[] = { "1", "2.5", "12345678x", "4" };
+    vector<pstring> mixed_strs;
+    for (size_t i = 0; i < 4; ++i)
+        mixed_strs.push_back(pstring(mixed[i]));
+
+    assert(parse_numeric_strings(mixed_strs.data(), mixed_strs.size(), values.data()) == 2);
+    assert(values[0] == 1.0 && values[1] == 2.5);
+
+    const char* invalid[] = { "", "-", ".", "+.", "1.2.3", "1-2", "12345678:" };
+    for (size_t i = 0; i < sizeof(invalid)/sizeof(invalid[0]); ++i)
+    {
+        pstring s(invalid[i]);
+        assert(parse_numeric_strings(&s, 1, values.data()) == 0);
+    }
+}
+
+int main()
+{
+    test_parse_numeric_string_valid();
+    test_parse_numeric_string_invalid();
+    test_parse_numeric_string_bounded();
+    test_parse_numeric_string_out_of_range();
+    test_parse_numeric_strings();
+    return EXIT_SUCCESS;
+}
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
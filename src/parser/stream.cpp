@@ -14,14 +14,24 @@
 #include <tuple>
 #include <cassert>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define ORCUS_FILE_CONTENT_MMAP 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#define ORCUS_FILE_CONTENT_MMAP 0
+#endif
+
 namespace orcus {
 
 namespace {
 
 std::tuple<pstring, size_t, size_t> find_line_with_offset(
-    const std::string& strm, std::ptrdiff_t offset)
+    const pstring& strm, std::ptrdiff_t offset)
 {
-    const char* p0 = strm.data();
+    const char* p0 = strm.get();
     const char* p_end = p0 + strm.size();
     const char* p_offset = p0 + offset;
 
@@ -60,27 +70,7 @@ std::tuple<pstring, size_t, size_t> find_line_with_offset(
     return std::make_tuple(line, line_num, offset_on_line);
 }
 
-}
-
-std::string load_file_content(const char* filepath)
-{
-    std::ifstream file(filepath);
-    if (!file)
-    {
-        // failed to open the specified file.
-        std::ostringstream os;
-        os << "failed to load " << filepath;
-        throw general_error(os.str());
-    }
-
-    std::ostringstream os;
-    os << file.rdbuf();
-    file.close();
-
-    return os.str();
-}
-
-std::string create_parse_error_output(const std::string& strm, std::ptrdiff_t offset)
+std::string build_parse_error_output(const pstring& strm, std::ptrdiff_t offset)
 {
     if (offset < 0)
         return std::string();
@@ -137,6 +127,167 @@ std::string create_parse_error_output(const std::string& strm, std::ptrdiff_t of
     return os.str();
 }
 
+void throw_load_error(const char* filepath)
+{
+    std::ostringstream os;
+    os << "failed to load " << filepath;
+    throw general_error(os.str());
+}
+
+}
+
+struct file_content::impl
+{
+    const char* mp_data;
+    size_t m_size;
+
+    void* mp_mapped;
+    size_t m_mapped_size;
+
+    std::string m_buffer; /// content of a file that could not be mapped.
+
+    impl() : mp_data(NULL), m_size(0), mp_mapped(NULL), m_mapped_size(0) {}
+
+    ~impl()
+    {
+#if ORCUS_FILE_CONTENT_MMAP
+        if (mp_mapped)
+            munmap(mp_mapped, m_mapped_size);
+#endif
+    }
+
+    void use_buffer()
+    {
+        mp_data = m_buffer.data();
+        m_size = m_buffer.size();
+    }
+
+#if ORCUS_FILE_CONTENT_MMAP
+
+    void load(const char* filepath)
+    {
+        int fd = open(filepath, O_RDONLY);
+        if (fd < 0)
+            throw_load_error(filepath);
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            // The parsers expect a null byte past the end of the content.
+            // The rest of the last page is zero-filled, but when the file
+            // ends on a page boundary there is no such page.  Reserve an
+            // extra zero page then, and map the file in front of it.
+            size_t n = static_cast<size_t>(st.st_size);
+            size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            size_t mapped_size = n % page_size ? n : n + page_size;
+
+            void* p = MAP_FAILED;
+            if (mapped_size == n)
+                p = mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, 0);
+            else
+            {
+                void* reserved = mmap(NULL, mapped_size, PROT_READ, MAP_PRIVATE | MAP_ANON, -1, 0);
+                if (reserved != MAP_FAILED)
+                {
+                    p = mmap(reserved, n, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+                    if (p == MAP_FAILED)
+                        munmap(reserved, mapped_size);
+                }
+            }
+
+            if (p != MAP_FAILED)
+            {
+                close(fd);
+                madvise(p, n, MADV_SEQUENTIAL);
+                mp_mapped = p;
+                m_mapped_size = mapped_size;
+                mp_data = static_cast<const char*>(p);
+                m_size = n;
+                return;
+            }
+        }
+
+        // Not a regular file, or mapping failed.  Read it into the buffer.
+        char buf[64 * 1024];
+        while (true)
+        {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n < 0)
+            {
+                close(fd);
+                throw_load_error(filepath);
+            }
+
+            if (!n)
+                break;
+
+            m_buffer.append(buf, n);
+        }
+
+        close(fd);
+        use_buffer();
+    }
+
+#else
+
+    void load(const char* filepath)
+    {
+        std::ifstream file(filepath, std::ios::binary);
+        if (!file)
+            throw_load_error(filepath);
+
+        std::ostringstream os;
+        os << file.rdbuf();
+        m_buffer = os.str();
+        use_buffer();
+    }
+
+#endif
+};
+
+file_content::file_content(const char* filepath) : mp_impl(new impl)
+{
+    mp_impl->load(filepath);
+}
+
+file_content::~file_content() {}
+
+const char* file_content::data() const
+{
+    return mp_impl->mp_data;
+}
+
+size_t file_content::size() const
+{
+    return mp_impl->m_size;
+}
+
+bool file_content::empty() const
+{
+    return mp_impl->m_size == 0;
+}
+
+pstring file_content::str() const
+{
+    return pstring(mp_impl->mp_data, mp_impl->m_size);
+}
+
+std::string load_file_content(const char* filepath)
+{
+    file_content content(filepath);
+    return std::string(content.data(), content.size());
+}
+
+std::string create_parse_error_output(const std::string& strm, std::ptrdiff_t offset)
+{
+    return build_parse_error_output(pstring(strm.data(), strm.size()), offset);
+}
+
+std::string create_parse_error_output(const file_content& strm, std::ptrdiff_t offset)
+{
+    return build_parse_error_output(strm.str(), offset);
+}
+
 }
 
 /* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -6,11 +6,16 @@
  */
 
 #include "orcus/stream.hpp"
+#include "orcus/pstring.hpp"
+#include "orcus/exception.hpp"
 
 #include <cassert>
 #include <cstdlib>
+#include <cstdio>
 #include <string>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 
 using namespace std;
 using namespace orcus;
@@ -23,9 +28,61 @@ void test_stream_create_error_output()
     assert(output == expected);
 }
 
+void test_stream_file_content()
+{
+    const char* paths[] = {
+        SRCDIR"/test/csv/simple-numbers/input.csv",
+        SRCDIR"/test/json/basic1/input.json",
+    };
+
+    for (size_t i = 0, n = sizeof(paths)/sizeof(paths[0]); i < n; ++i)
+    {
+        ifstream file(paths[i], ios::binary);
+        assert(file);
+        ostringstream os;
+        os << file.rdbuf();
+        string expected = os.str();
+
+        file_content content(paths[i]);
+        assert(!content.empty());
+        assert(content.size() == expected.size());
+        assert(content.str().str() == expected);
+        assert(load_file_content(paths[i]) == expected);
+    }
+
+    // Empty file.
+    const char* empty_path = "stream_test_empty.tmp";
+    {
+        ofstream file(empty_path);
+    }
+
+    {
+        file_content content(empty_path);
+        assert(content.empty());
+        assert(content.size() == 0);
+    }
+    std::remove(empty_path);
+
+    // Non-existent file.
+    try
+    {
+        file_content content(empty_path);
+        assert(!"general_error was not thrown.");
+    }
+    catch (const general_error&)
+    {
+        // expected.
+    }
+
+    // The error output can be generated from the mapped content.
+    file_content content(paths[0]);
+    assert(create_parse_error_output(content, 0) == create_parse_error_output(content.str().str(), 0));
+}
+
 int main()
 {
     test_stream_create_error_output();
+    test_stream_file_content();
 
     return EXIT_SUCCESS;
 }
@@ -10,6 +10,7 @@
 #include "orcus/global.hpp"
 #include "orcus/pstring.hpp"
 #include "orcus/exception.hpp"
+#include "orcus/memory_estimate.hpp"
 
 #include <iostream>
 #include <unordered_set>
@@ -59,6 +60,17 @@ struct string_pool::impl
 {
     string_set_type m_set;
     string_store_type m_store;
+
+    /** Heap memory used by all stored string instances. */
+    size_t m_string_bytes;
+
+    impl() : m_string_bytes(0) {}
+
+    /** Heap memory used by the look-up index. */
+    size_t get_index_bytes() const
+    {
+        return estimate_hash_container_bytes(m_set);
+    }
 };
 
 string_pool::string_pool() : mp_impl(orcus::make_unique<impl>()) {}
@@ -78,11 +90,21 @@ pair<pstring, bool> string_pool::intern(const char* str, size_t n)
     if (!n)
         return pair<pstring, bool>(pstring(), false);
 
+    if (mp_impl->m_set.empty() && !mp_impl->m_store.empty())
+    {
+        // The look-up index has been released by compact().  Rebuild it.
+        mp_impl->m_set.reserve(mp_impl->m_store.size());
+        string_store_type::const_iterator it = mp_impl->m_store.begin(), it_end = mp_impl->m_store.end();
+        for (; it != it_end; ++it)
+            mp_impl->m_set.insert(pstring((*it)->data(), (*it)->size()));
+    }
+
     string_set_type::const_iterator itr = mp_impl->m_set.find(pstring(str, n));
     if (itr == mp_impl->m_set.end())
     {
         // This string has not been interned.  Intern it.
         mp_impl->m_store.push_back(orcus::make_unique<string>(str, n));
+        mp_impl->m_string_bytes += get_string_bytes(*mp_impl->m_store.back());
         pair<string_set_type::iterator,bool> r = mp_impl->m_set.insert(pstring(mp_impl->m_store.back()->data(), n));
         if (!r.second)
             throw general_error("failed to intern a new string instance.");
@@ -122,6 +144,27 @@ void string_pool::clear()
 {
     mp_impl->m_set.clear();
     mp_impl->m_store.clear();
+    mp_impl->m_string_bytes = 0;
+}
+
+size_t string_pool::compact()
+{
+    size_t bytes = mp_impl->get_index_bytes();
+    string_set_type().swap(mp_impl->m_set);
+
+    size_t capacity = mp_impl->m_store.capacity();
+    mp_impl->m_store.shrink_to_fit();
+    bytes += (capacity - mp_impl->m_store.capacity()) * sizeof(string_store_type::value_type);
+
+    return bytes;
+}
+
+size_t string_pool::get_memory_usage() const
+{
+    size_t bytes = mp_impl->m_string_bytes;
+    bytes += mp_impl->m_store.capacity() * sizeof(string_store_type::value_type);
+    bytes += mp_impl->get_index_bytes();
+    return bytes;
 }
 
 size_t string_pool::size() const
@@ -9,6 +9,7 @@
 #include "orcus/pstring.hpp"
 
 #include <iostream>
+#include <string>
 #include <cassert>
 
 using namespace std;
@@ -65,9 +66,50 @@ void test_basic()
     assert(str.get() != static_str.get());
 }
 
+void test_compact()
+{
+    string_pool pool;
+    const char* p_foo = pool.intern("foo").first.get();
+    const char* p_bar = pool.intern("bar").first.get();
+    assert(pool.size() == 2);
+
+    size_t usage = pool.get_memory_usage();
+    size_t bytes = pool.compact();
+    assert(bytes > 0);
+    assert(pool.get_memory_usage() < usage);
+
+    // Interned strings stay where they were.
+    assert(pool.size() == 2);
+
+    // The look-up index gets rebuilt on demand.
+    pair<pstring, bool> ret = pool.intern("foo");
+    assert(!ret.second);
+    assert(ret.first.get() == p_foo);
+
+    ret = pool.intern("bar");
+    assert(!ret.second);
+    assert(ret.first.get() == p_bar);
+
+    ret = pool.intern("baz");
+    assert(ret.second);
+    assert(pool.size() == 3);
+
+    // A string too long for any small string buffer adds at least its own
+    // length.
+    usage = pool.get_memory_usage();
+    string long_str(1000, 'x');
+    pool.intern(long_str.data(), long_str.size());
+    size_t usage_long = pool.get_memory_usage();
+    assert(usage_long >= usage + long_str.size());
+
+    pool.clear();
+    assert(pool.get_memory_usage() + long_str.size() < usage_long);
+}
+
 int main()
 {
     test_basic();
+    test_compact();
     return EXIT_SUCCESS;
 }
 /* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -45,6 +45,20 @@ const char* zip_error::what() const throw()
     return m_msg.c_str();
 }
 
+zip_file_entry_stat::zip_file_entry_stat() :
+    size_compressed(0), size_uncompressed(0), crc32(0) {}
+
+bool zip_file_entry_stat::operator== (const zip_file_entry_stat& r) const
+{
+    return size_compressed == r.size_compressed && size_uncompressed == r.size_uncompressed &&
+        crc32 == r.crc32;
+}
+
+bool zip_file_entry_stat::operator!= (const zip_file_entry_stat& r) const
+{
+    return !operator==(r);
+}
+
 namespace {
 
 struct zip_file_param
@@ -240,6 +254,8 @@ public:
 
     bool read_file_entry(const pstring& entry_name, vector<unsigned char>& buf) const;
 
+    bool get_file_entry_stat(const pstring& entry_name, zip_file_entry_stat& stat) const;
+
 private:
 
     /**
@@ -496,6 +512,19 @@ bool zip_archive_impl::read_file_entry(const pstring& entry_name, vector<unsigne
     return false;
 }
 
+bool zip_archive_impl::get_file_entry_stat(const pstring& entry_name, zip_file_entry_stat& stat) const
+{
+    filename_map_type::const_iterator it = m_filenames.find(entry_name);
+    if (it == m_filenames.end() || it->second >= m_file_params.size())
+        return false;
+
+    const zip_file_param& param = m_file_params[it->second];
+    stat.size_compressed = param.size_compressed;
+    stat.size_uncompressed = param.size_uncompressed;
+    stat.crc32 = param.crc32;
+    return true;
+}
+
 size_t zip_archive_impl::seek_central_dir()
 {
     // Search for the position of 0x06054b50 (read in little endian order - so
@@ -618,5 +647,10 @@ bool zip_archive::read_file_entry(const pstring& entry_name, vector<unsigned cha
     return mp_impl->read_file_entry(entry_name, buf);
 }
 
+bool zip_archive::get_file_entry_stat(const pstring& entry_name, zip_file_entry_stat& stat) const
+{
+    return mp_impl->get_file_entry_stat(entry_name, stat);
+}
+
 }
 /* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -6,6 +6,7 @@
  */
 
 #include "orcus/spreadsheet/auto_filter.hpp"
+#include "memory_global.hpp"
 
 namespace orcus { namespace spreadsheet {
 
@@ -85,8 +86,70 @@ void table_t::reset()
     range = ixion::abs_range_t(ixion::abs_range_t::invalid);
     totals_row_count = 0;
     filter.reset();
-    columns.clear();
     style.reset();
+    m_columns.clear();
+    m_column_index.clear();
+}
+
+const table_t::columns_type& table_t::get_columns() const
+{
+    return m_columns;
+}
+
+void table_t::reserve_columns(size_t n)
+{
+    m_columns.reserve(n);
+}
+
+void table_t::append_column(const table_column_t& col)
+{
+    // An existing entry means an earlier column already has this name.
+    m_column_index.insert(column_index_type::value_type(col.name, m_columns.size()));
+    m_columns.push_back(col);
+}
+
+void table_t::set_column_name(size_t pos, const pstring& name)
+{
+    m_columns.at(pos).name = name;
+
+    // Renaming may uncover or shadow a duplicate anywhere in the table.
+    build_column_index();
+}
+
+table_t::columns_type::const_iterator table_t::find_column(const pstring& name, size_t offset) const
+{
+    if (offset >= m_columns.size())
+        return m_columns.end();
+
+    column_index_type::const_iterator it = m_column_index.find(name);
+    if (it == m_column_index.end())
+        return m_columns.end();
+
+    if (it->second >= offset)
+        return m_columns.begin() + it->second;
+
+    // The first column by this name precedes the offset.  Look for a
+    // duplicate that follows it.
+    columns_type::const_iterator it_col = m_columns.begin() + offset, it_end = m_columns.end();
+    for (; it_col != it_end; ++it_col)
+    {
+        if (it_col->name == name)
+            return it_col;
+    }
+
+    return m_columns.end();
+}
+
+size_t table_t::get_column_memory_usage() const
+{
+    return get_vector_bytes(m_columns) + estimate_hash_container_bytes(m_column_index);
+}
+
+void table_t::build_column_index()
+{
+    m_column_index.clear();
+    for (size_t i = 0, n = m_columns.size(); i < n; ++i)
+        m_column_index.insert(column_index_type::value_type(m_columns[i].name, i));
 }
 
 }}
@@ -17,6 +17,11 @@
 #include "orcus/types.hpp"
 #include "orcus/string_pool.hpp"
 #include "orcus/global.hpp"
+#include "orcus/exception.hpp"
+
+#include "memory_global.hpp"
+#include "range_index.hpp"
+#include "snapshot.hpp"
 
 #include <ixion/formula.hpp>
 #include <ixion/formula_result.hpp>
@@ -28,6 +33,9 @@
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <unordered_map>
+#include <vector>
+#include <sstream>
 
 using namespace std;
 
@@ -72,6 +80,14 @@ struct sheet_item
     private:
         const ::std::string& m_filepath;
     };
+
+    class csv_printer : public std::unary_function<std::unique_ptr<sheet_item>, void>
+    {
+        const std::string& m_outdir;
+    public:
+        csv_printer(const std::string& outdir);
+        void operator() (const std::unique_ptr<sheet_item>& item) const;
+    };
 };
 
 typedef std::map<pstring, std::unique_ptr<table_t>> table_store_type;
@@ -114,26 +130,30 @@ void sheet_item::html_printer::operator() (const std::unique_ptr<sheet_item>& it
     item->data.dump_html(this_file);
 }
 
-class find_sheet_by_name : std::unary_function<std::unique_ptr<sheet_item> , bool>
+sheet_item::csv_printer::csv_printer(const string& outdir) : m_outdir(outdir) {}
+
+void sheet_item::csv_printer::operator() (const std::unique_ptr<sheet_item>& item) const
 {
-    const pstring& m_name;
-public:
-    find_sheet_by_name(const pstring& name) : m_name(name) {}
-    bool operator() (const std::unique_ptr<sheet_item>& v) const
+    string this_file = m_outdir + '/' + item->name.str() + ".csv";
+
+    ofstream file(this_file.c_str(), ios::out | ios::binary);
+    if (!file)
     {
-        return v->name == m_name;
+        cerr << "failed to create file: " << this_file << endl;
+        return;
     }
-};
 
-class find_column_by_name : std::unary_function<table_column_t, bool>
+    item->data.dump_csv(file);
+}
+
+class find_sheet_by_name : std::unary_function<std::unique_ptr<sheet_item> , bool>
 {
     const pstring& m_name;
 public:
-    find_column_by_name(const pstring& name) : m_name(name) {}
-
-    bool operator() (const table_column_t& col) const
+    find_sheet_by_name(const pstring& name) : m_name(name) {}
+    bool operator() (const std::unique_ptr<sheet_item>& v) const
     {
-        return col.name == m_name;
+        return v->name == m_name;
     }
 };
 
@@ -205,20 +225,23 @@ void adjust_row_range(ixion::abs_range_t& range, const table_t& tab, ixion::tabl
 
 class table_handler : public ixion::iface::table_handler
 {
+    typedef range_index<const table_t*> table_range_index_type;
+    typedef std::unordered_map<ixion::sheet_t, table_range_index_type> sheet_table_index_type;
+
     const ixion::model_context& m_context;
     const table_store_type& m_tables;
 
+    /** Table ranges for each sheet, for looking up tables by cell position. */
+    sheet_table_index_type m_table_ranges;
+
     const table_t* find_table(const ixion::abs_address_t& pos) const
     {
-        auto it = m_tables.begin(), it_end = m_tables.end();
-        for (; it != it_end; ++it)
-        {
-            const table_t* p = it->second.get();
-            if (p->range.contains(pos))
-                return p;
-        }
+        sheet_table_index_type::const_iterator it = m_table_ranges.find(pos.sheet);
+        if (it == m_table_ranges.end())
+            return NULL;
 
-        return NULL;
+        const table_range_index_type::entry* p = it->second.find(pos.row, pos.column);
+        return p ? p->value : NULL;
     }
 
     pstring get_string(ixion::string_id_t sid) const
@@ -235,21 +258,12 @@ class table_handler : public ixion::iface::table_handler
 
     col_t find_column(const table_t& tab, const pstring& name, size_t offset) const
     {
-        if (offset >= tab.columns.size())
-            return -1;
-
-        table_t::columns_type::const_iterator it_beg = tab.columns.begin();
-        table_t::columns_type::const_iterator it_end = tab.columns.end();
-
-        std::advance(it_beg, offset);
-        table_t::columns_type::const_iterator it =
-            std::find_if(it_beg, it_end, find_column_by_name(name));
-
-        if (it == it_end)
+        table_t::columns_type::const_iterator it = tab.find_column(name, offset);
+        if (it == tab.get_columns().end())
             // not found.
             return -1;
 
-        size_t dist = std::distance(tab.columns.begin(), it);
+        size_t dist = std::distance(tab.get_columns().begin(), it);
         return tab.range.first.column + dist;
     }
 
@@ -291,6 +305,48 @@ public:
     table_handler(const ixion::model_context& cxt, const table_store_type& tables) :
         m_context(cxt), m_tables(tables) {}
 
+    void insert_table_range(const table_t& tab)
+    {
+        const ixion::abs_range_t& range = tab.range;
+        if (!range.valid())
+            return;
+
+        m_table_ranges[range.first.sheet].insert(
+            cell_rect_t(range.first.row, range.first.column, range.last.row, range.last.column), &tab);
+    }
+
+    /**
+     * Remove the table ranges of a sheet.  Call this after the tables on
+     * that sheet have been removed from the table store.
+     */
+    void remove_table_ranges(sheet_t sheet)
+    {
+        m_table_ranges.erase(sheet);
+    }
+
+    /**
+     * @return heap memory used by the table range indices.
+     */
+    size_t get_memory_usage() const
+    {
+        size_t bytes = estimate_hash_container_bytes(m_table_ranges);
+        sheet_table_index_type::const_iterator it = m_table_ranges.begin(), it_end = m_table_ranges.end();
+        for (; it != it_end; ++it)
+            bytes += it->second.heap_size();
+
+        return bytes;
+    }
+
+    /**
+     * Pack the table ranges of all sheets for fast look-up.
+     */
+    void build_table_ranges()
+    {
+        sheet_table_index_type::iterator it = m_table_ranges.begin(), it_end = m_table_ranges.end();
+        for (; it != it_end; ++it)
+            it->second.build();
+    }
+
     virtual ixion::abs_range_t get_range(
         const ixion::abs_address_t& pos, ixion::string_id_t column_first, ixion::string_id_t column_last,
         ixion::table_areas_t areas) const
@@ -347,14 +403,21 @@ struct document_impl
     table_store_type m_tables;
     table_handler m_table_handler;
 
+    bool m_frozen;
+
     document_impl(document& doc) :
         m_doc(doc),
         mp_styles(new import_styles(m_string_pool)),
         mp_strings(new import_shared_strings(m_string_pool, m_context, *mp_styles)),
         mp_name_resolver(ixion::formula_name_resolver::get(ixion::formula_name_resolver_t::excel_a1, &m_context)),
         m_grammar(formula_grammar_t::xlsx_2007),
-        m_table_handler(m_context, m_tables)
+        m_table_handler(m_context, m_tables),
+        m_frozen(false)
     {
+        m_origin_date.year = 1899;
+        m_origin_date.month = 12;
+        m_origin_date.day = 30;
+
         m_context.set_table_handler(&m_table_handler);
     }
 
@@ -363,6 +426,16 @@ struct document_impl
         delete mp_strings;
         delete mp_styles;
     }
+
+    void check_not_frozen(const char* func) const
+    {
+        if (!m_frozen)
+            return;
+
+        std::ostringstream os;
+        os << func << ": document is frozen.";
+        throw general_error(os.str());
+    }
 };
 
 document::document() :
@@ -410,12 +483,20 @@ string_pool& document::get_string_pool()
 
 void document::insert_table(table_t* p)
 {
+    mp_impl->check_not_frozen("document::insert_table");
+
     if (!p)
         return;
 
     pstring name = p->name;
-    mp_impl->m_tables.insert(
+    std::pair<table_store_type::iterator, bool> r = mp_impl->m_tables.insert(
         table_store_type::value_type(name, std::unique_ptr<table_t>(p)));
+
+    if (!r.second)
+        // A table by the same name already exists.
+        return;
+
+    mp_impl->m_table_handler.insert_table_range(*p);
 }
 
 const table_t* document::get_table(const pstring& name) const
@@ -434,16 +515,42 @@ struct sheet_finalizer : std::unary_function<std::unique_ptr<sheet_item>, void>
     }
 };
 
+struct sheet_freezer : std::unary_function<std::unique_ptr<sheet_item>, void>
+{
+    void operator() (std::unique_ptr<sheet_item>& sh)
+    {
+        sh->data.freeze();
+    }
+};
+
 }
 
 void document::finalize()
 {
+    mp_impl->check_not_frozen("document::finalize");
+
     for_each(mp_impl->m_sheets.begin(), mp_impl->m_sheets.end(), sheet_finalizer());
+    mp_impl->m_table_handler.build_table_ranges();
     calc_formulas();
 }
 
+styles_remap_t document::deduplicate_styles()
+{
+    mp_impl->check_not_frozen("document::deduplicate_styles");
+
+    styles_remap_t remap = mp_impl->mp_styles->deduplicate();
+
+    sheet_items_type::iterator it = mp_impl->m_sheets.begin(), it_end = mp_impl->m_sheets.end();
+    for (; it != it_end; ++it)
+        (*it)->data.remap_cell_formats(remap.cell_formats);
+
+    return remap;
+}
+
 sheet* document::append_sheet(const pstring& sheet_name, row_t row_size, col_t col_size)
 {
+    mp_impl->check_not_frozen("document::append_sheet");
+
     pstring sheet_name_safe = mp_impl->m_string_pool.intern(sheet_name).first;
     sheet_t sheet_index = static_cast<sheet_t>(mp_impl->m_sheets.size());
 
@@ -486,6 +593,8 @@ const sheet* document::get_sheet(sheet_t sheet_pos) const
 
 void document::calc_formulas()
 {
+    mp_impl->check_not_frozen("document::calc_formulas");
+
     ixion::model_context& cxt = get_model_context();
     ixion::calculate_cells(cxt, mp_impl->m_dirty_cells, 0);
 }
@@ -501,6 +610,147 @@ void document::clear()
     mp_impl = new document_impl(*this);
 }
 
+void document::freeze()
+{
+    if (mp_impl->m_frozen)
+        return;
+
+    for_each(mp_impl->m_sheets.begin(), mp_impl->m_sheets.end(), sheet_freezer());
+    mp_impl->m_table_handler.build_table_ranges();
+    mp_impl->m_frozen = true;
+}
+
+bool document::is_frozen() const
+{
+    return mp_impl->m_frozen;
+}
+
+size_t document::compact()
+{
+    freeze();
+
+    size_t bytes = 0;
+    sheet_items_type::iterator it = mp_impl->m_sheets.begin(), it_end = mp_impl->m_sheets.end();
+    for (; it != it_end; ++it)
+        bytes += (*it)->data.compact();
+
+    bytes += mp_impl->mp_strings->compact();
+    bytes += mp_impl->mp_styles->compact();
+    bytes += mp_impl->m_string_pool.compact();
+
+    ixion::dirty_formula_cells_t dirty_cells;
+    bytes += estimate_hash_container_bytes(mp_impl->m_dirty_cells);
+    mp_impl->m_dirty_cells.swap(dirty_cells);
+
+    return bytes;
+}
+
+memory_usage_t document::get_memory_usage() const
+{
+    memory_usage_t ret;
+    ret.string_pool = mp_impl->m_string_pool.get_memory_usage();
+
+    // Each cell string is stored in an array of string pointers, and
+    // indexed by a hash map from a view of the string content to the string
+    // ID.  The hash map is not accessible, so assume one bucket per string.
+    typedef std::pair<pstring, size_t> string_index_entry;
+    const size_t array_slot_bytes = sizeof(void*);
+    const size_t index_bytes = estimate_hash_node_bytes<string_index_entry>() + sizeof(void*);
+
+    const ixion::model_context& cxt = mp_impl->m_context;
+    for (size_t i = 0, n = cxt.get_string_count(); i < n; ++i)
+    {
+        const std::string* p = cxt.get_string(i);
+        if (p)
+            ret.shared_strings += get_string_bytes(*p);
+
+        ret.shared_strings += array_slot_bytes + index_bytes;
+    }
+
+    ret.format_runs = mp_impl->mp_strings->get_format_runs_memory_usage();
+    ret.styles = mp_impl->mp_styles->get_memory_usage();
+
+    ret.tables = estimate_tree_container_bytes(mp_impl->m_tables);
+    table_store_type::const_iterator it_tab = mp_impl->m_tables.begin(), it_tab_end = mp_impl->m_tables.end();
+    for (; it_tab != it_tab_end; ++it_tab)
+    {
+        const table_t& tab = *it_tab->second;
+        ret.tables += sizeof(table_t);
+        ret.tables += tab.get_column_memory_usage();
+        ret.tables += get_auto_filter_bytes(tab.filter);
+    }
+    ret.tables += mp_impl->m_table_handler.get_memory_usage();
+
+    ret.sheets.reserve(mp_impl->m_sheets.size());
+    sheet_items_type::const_iterator it = mp_impl->m_sheets.begin(), it_end = mp_impl->m_sheets.end();
+    for (; it != it_end; ++it)
+        ret.sheets.push_back((*it)->data.get_memory_usage());
+
+    return ret;
+}
+
+void document::dump_memory_usage(std::ostream& os) const
+{
+    memory_usage_t usage = get_memory_usage();
+
+    os << "string pool: " << usage.string_pool << endl;
+    os << "shared strings: " << usage.shared_strings << endl;
+    os << "format runs: " << usage.format_runs << endl;
+    os << "styles: " << usage.styles << endl;
+    os << "tables: " << usage.tables << endl;
+
+    for (size_t i = 0, n = usage.sheets.size(); i < n; ++i)
+    {
+        const sheet_memory_usage_t& sh = usage.sheets[i];
+        os << "sheet '" << mp_impl->m_sheets[i]->name << "':" << endl;
+        os << "  cell stores: " << sh.cell_stores << endl;
+        os << "  formula tokens: " << sh.formula_tokens << endl;
+        os << "  format trees: " << sh.format_trees << endl;
+        os << "  merge ranges: " << sh.merge_ranges << endl;
+        os << "  auto filter: " << sh.auto_filter << endl;
+        os << "  total: " << sh.total() << endl;
+    }
+
+    os << "total: " << usage.total() << endl;
+}
+
+sheet* document::clear_sheet(const pstring& sheet_name)
+{
+    mp_impl->check_not_frozen("document::clear_sheet");
+
+    sheet_t sheet_index = get_sheet_index(sheet_name);
+    if (sheet_index == ixion::invalid_sheet)
+        return NULL;
+
+    sheet& sh = mp_impl->m_sheets[sheet_index]->data;
+    sh.clear();
+
+    // Remove the tables on this sheet.
+    table_store_type::iterator it_tab = mp_impl->m_tables.begin();
+    while (it_tab != mp_impl->m_tables.end())
+    {
+        if (it_tab->second->range.first.sheet == sheet_index)
+            it_tab = mp_impl->m_tables.erase(it_tab);
+        else
+            ++it_tab;
+    }
+    mp_impl->m_table_handler.remove_table_ranges(sheet_index);
+
+    // The erased formula cells must not be calculated.  Formula cells in
+    // other sheets remain dirty, and get recalculated at the next
+    // finalize() call.
+    ixion::dirty_formula_cells_t::iterator it_dirty = mp_impl->m_dirty_cells.begin();
+    while (it_dirty != mp_impl->m_dirty_cells.end())
+    {
+        if (it_dirty->sheet == sheet_index)
+            it_dirty = mp_impl->m_dirty_cells.erase(it_dirty);
+        else
+            ++it_dirty;
+    }
+
+    return &sh;
+}
+
 void document::dump_flat(const string& outdir) const
 {
     cout << "----------------------------------------------------------------------" << endl;
@@ -522,6 +772,11 @@ void document::dump_html(const string& outdir) const
     for_each(mp_impl->m_sheets.begin(), mp_impl->m_sheets.end(), sheet_item::html_printer(outdir));
 }
 
+void document::dump_csv(const string& outdir) const
+{
+    for_each(mp_impl->m_sheets.begin(), mp_impl->m_sheets.end(), sheet_item::csv_printer(outdir));
+}
+
 sheet_t document::get_sheet_index(const pstring& name) const
 {
     auto it = std::find_if(
@@ -559,6 +814,11 @@ void document::set_origin_date(int year, int month, int day)
     mp_impl->m_origin_date.day = day;
 }
 
+date_time_t document::get_origin_date() const
+{
+    return mp_impl->m_origin_date;
+}
+
 void document::set_formula_grammar(formula_grammar_t grammar)
 {
     if (mp_impl->m_grammar == grammar)
@@ -604,5 +864,286 @@ void document::insert_dirty_cell(const ixion::abs_address_t& pos)
     mp_impl->m_dirty_cells.insert(pos);
 }
 
+namespace {
+
+void write_range(snapshot_writer& writer, const ixion::abs_range_t& range)
+{
+    writer.write_i32(range.first.sheet);
+    writer.write_i32(range.first.row);
+    writer.write_i32(range.first.column);
+    writer.write_i32(range.last.sheet);
+    writer.write_i32(range.last.row);
+    writer.write_i32(range.last.column);
+}
+
+void read_range(snapshot_reader& reader, ixion::abs_range_t& range)
+{
+    range.first.sheet = reader.read_i32();
+    range.first.row = reader.read_i32();
+    range.first.column = reader.read_i32();
+    range.last.sheet = reader.read_i32();
+    range.last.row = reader.read_i32();
+    range.last.column = reader.read_i32();
+}
+
+void write_auto_filter(snapshot_writer& writer, const auto_filter_t& filter)
+{
+    write_range(writer, filter.range);
+    writer.write_u64(filter.columns.size());
+    auto_filter_t::columns_type::const_iterator it = filter.columns.begin(), it_end = filter.columns.end();
+    for (; it != it_end; ++it)
+    {
+        writer.write_i32(it->first);
+        const auto_filter_column_t::match_values_type& values = it->second.match_values;
+        writer.write_u64(values.size());
+        auto_filter_column_t::match_values_type::const_iterator it_val = values.begin();
+        for (; it_val != values.end(); ++it_val)
+            writer.write_string(*it_val);
+    }
+}
+
+/**
+ * Strings read from a snapshot point into its buffer, and are interned
+ * into the document's string pool to outlive it.
+ */
+void read_auto_filter(snapshot_reader& reader, string_pool& pool, auto_filter_t& filter)
+{
+    read_range(reader, filter.range);
+    for (uint64_t i = 0, n = reader.read_u64(); i < n; ++i)
+    {
+        col_t col = reader.read_i32();
+        auto_filter_column_t data;
+        for (uint64_t j = 0, m = reader.read_u64(); j < m; ++j)
+            data.match_values.insert(pool.intern(reader.read_string()).first);
+
+        filter.commit_column(col, data);
+    }
+}
+
+void write_table(snapshot_writer& writer, const table_t& tab)
+{
+    writer.write_u64(tab.identifier);
+    writer.write_string(tab.name);
+    writer.write_string(tab.display_name);
+    write_range(writer, tab.range);
+    writer.write_u64(tab.totals_row_count);
+    write_auto_filter(writer, tab.filter);
+
+    const table_t::columns_type& columns = tab.get_columns();
+    writer.write_u64(columns.size());
+    table_t::columns_type::const_iterator it = columns.begin(), it_end = columns.end();
+    for (; it != it_end; ++it)
+    {
+        writer.write_u64(it->identifier);
+        writer.write_string(it->name);
+        writer.write_string(it->totals_row_label);
+        writer.write_u32(static_cast<uint32_t>(it->totals_row_function));
+    }
+
+    const table_style_t& style = tab.style;
+    writer.write_string(style.name);
+    writer.write_u8(style.show_first_column);
+    writer.write_u8(style.show_last_column);
+    writer.write_u8(style.show_row_stripes);
+    writer.write_u8(style.show_column_stripes);
+}
+
+void read_table(snapshot_reader& reader, string_pool& pool, table_t& tab)
+{
+    tab.identifier = reader.read_u64();
+    tab.name = pool.intern(reader.read_string()).first;
+    tab.display_name = pool.intern(reader.read_string()).first;
+    read_range(reader, tab.range);
+    tab.totals_row_count = reader.read_u64();
+    read_auto_filter(reader, pool, tab.filter);
+
+    for (uint64_t i = 0, n = reader.read_u64(); i < n; ++i)
+    {
+        table_column_t col;
+        col.identifier = reader.read_u64();
+        col.name = pool.intern(reader.read_string()).first;
+        col.totals_row_label = pool.intern(reader.read_string()).first;
+
+        uint32_t func = reader.read_u32();
+        if (func > static_cast<uint32_t>(totals_row_function_t::custom))
+            throw general_error("document::load_snapshot: invalid totals row function.");
+
+        col.totals_row_function = static_cast<totals_row_function_t>(func);
+        tab.append_column(col);
+    }
+
+    table_style_t& style = tab.style;
+    style.name = pool.intern(reader.read_string()).first;
+    style.show_first_column = reader.read_u8() != 0;
+    style.show_last_column = reader.read_u8() != 0;
+    style.show_row_stripes = reader.read_u8() != 0;
+    style.show_column_stripes = reader.read_u8() != 0;
+}
+
+}
+
+void document::save_snapshot(const string& filepath) const
+{
+    snapshot_writer writer;
+
+    writer.begin_section(snapshot_section_t::document);
+    writer.write_i32(mp_impl->m_origin_date.year);
+    writer.write_i32(mp_impl->m_origin_date.month);
+    writer.write_i32(mp_impl->m_origin_date.day);
+    writer.write_u32(static_cast<uint32_t>(mp_impl->m_grammar));
+    writer.end_section();
+
+    writer.begin_section(snapshot_section_t::strings);
+    mp_impl->mp_strings->write_snapshot(writer);
+    writer.end_section();
+
+    writer.begin_section(snapshot_section_t::styles);
+    mp_impl->mp_styles->write_snapshot(writer);
+    writer.end_section();
+
+    writer.begin_section(snapshot_section_t::sheets);
+    writer.write_u64(mp_impl->m_sheets.size());
+    sheet_items_type::const_iterator it = mp_impl->m_sheets.begin(), it_end = mp_impl->m_sheets.end();
+    for (; it != it_end; ++it)
+    {
+        const sheet_item& item = **it;
+        writer.write_string(item.name);
+        writer.write_i32(item.data.row_size());
+        writer.write_i32(item.data.col_size());
+        item.data.write_snapshot(writer);
+    }
+    writer.end_section();
+
+    writer.begin_section(snapshot_section_t::tables);
+    writer.write_u64(mp_impl->m_tables.size());
+    table_store_type::const_iterator it_tab = mp_impl->m_tables.begin(), it_tab_end = mp_impl->m_tables.end();
+    for (; it_tab != it_tab_end; ++it_tab)
+        write_table(writer, *it_tab->second);
+    writer.end_section();
+
+    // Auto filters of the sheets, each preceded by its sheet index.
+    writer.begin_section(snapshot_section_t::auto_filters);
+    std::vector<sheet_t> filtered_sheets;
+    for (size_t i = 0; i < mp_impl->m_sheets.size(); ++i)
+    {
+        if (mp_impl->m_sheets[i]->data.get_auto_filter_data())
+            filtered_sheets.push_back(i);
+    }
+
+    writer.write_u64(filtered_sheets.size());
+    for (size_t i = 0; i < filtered_sheets.size(); ++i)
+    {
+        sheet_t sheet_index = filtered_sheets[i];
+        writer.write_i32(sheet_index);
+        write_auto_filter(writer, *mp_impl->m_sheets[sheet_index]->data.get_auto_filter_data());
+    }
+    writer.end_section();
+
+    ofstream file(filepath.c_str(), ios::out | ios::binary);
+    if (!file)
+        throw general_error("document::save_snapshot: failed to create " + filepath);
+
+    writer.write_to(file);
+    file.close();
+    if (!file)
+        throw general_error("document::save_snapshot: failed to write " + filepath);
+}
+
+void document::load_snapshot(const string& filepath)
+{
+    mp_impl->check_not_frozen("document::load_snapshot");
+
+    ifstream file(filepath.c_str(), ios::in | ios::binary);
+    if (!file)
+        throw general_error("document::load_snapshot: failed to open " + filepath);
+
+    file.seekg(0, ios::end);
+    streamoff size = file.tellg();
+    file.seekg(0, ios::beg);
+    if (size < 0)
+        throw general_error("document::load_snapshot: failed to read " + filepath);
+
+    // Read the whole file in one go, into a buffer aligned for the arrays
+    // that the reader hands out in place.
+    std::vector<uint64_t> buf((static_cast<size_t>(size) + 7) / 8);
+    const char* p = reinterpret_cast<const char*>(buf.data());
+    if (!file.read(reinterpret_cast<char*>(buf.data()), size))
+        throw general_error("document::load_snapshot: failed to read " + filepath);
+
+    snapshot_reader reader(p, static_cast<size_t>(size));
+
+    clear();
+
+    // Leave the document empty rather than partially loaded when the
+    // snapshot turns out to be invalid.
+    try
+    {
+        if (!reader.seek_section(snapshot_section_t::document))
+            throw general_error("document::load_snapshot: document section is missing.");
+
+        int year = reader.read_i32();
+        int month = reader.read_i32();
+        int day = reader.read_i32();
+        set_origin_date(year, month, day);
+        set_formula_grammar(static_cast<formula_grammar_t>(reader.read_u32()));
+
+        if (reader.seek_section(snapshot_section_t::strings))
+            mp_impl->mp_strings->read_snapshot(reader);
+
+        if (reader.seek_section(snapshot_section_t::styles))
+            mp_impl->mp_styles->read_snapshot(reader);
+
+        // Insert the tables before the formulas that refer to them.
+        if (reader.seek_section(snapshot_section_t::tables))
+        {
+            for (uint64_t i = 0, n = reader.read_u64(); i < n; ++i)
+            {
+                std::unique_ptr<table_t> tab(new table_t);
+                read_table(reader, mp_impl->m_string_pool, *tab);
+                if (get_table(tab->name))
+                    throw general_error("document::load_snapshot: duplicate table name.");
+
+                insert_table(tab.release());
+            }
+        }
+
+        if (reader.seek_section(snapshot_section_t::sheets))
+        {
+            for (uint64_t i = 0, n = reader.read_u64(); i < n; ++i)
+            {
+                pstring name = reader.read_string();
+                row_t row_size = reader.read_i32();
+                col_t col_size = reader.read_i32();
+                if (row_size <= 0 || col_size <= 0)
+                    throw general_error("document::load_snapshot: invalid sheet size.");
+
+                sheet* sh = append_sheet(name, row_size, col_size);
+                sh->read_snapshot(reader);
+            }
+        }
+
+        if (reader.seek_section(snapshot_section_t::auto_filters))
+        {
+            for (uint64_t i = 0, n = reader.read_u64(); i < n; ++i)
+            {
+                sheet_t sheet_index = reader.read_i32();
+                if (sheet_index < 0 || static_cast<size_t>(sheet_index) >= mp_impl->m_sheets.size())
+                    throw general_error("document::load_snapshot: invalid sheet index of auto filter.");
+
+                std::unique_ptr<auto_filter_t> filter(new auto_filter_t);
+                read_auto_filter(reader, mp_impl->m_string_pool, *filter);
+                mp_impl->m_sheets[sheet_index]->data.set_auto_filter_data(filter.release());
+            }
+        }
+
+        finalize();
+    }
+    catch (...)
+    {
+        clear();
+        throw;
+    }
+}
+
 }}
 /* vim:set shiftwidth=4 softtabstop=4 expandtab: */
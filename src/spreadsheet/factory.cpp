@@ -13,6 +13,10 @@
 #include "orcus/spreadsheet/document.hpp"
 #include "orcus/spreadsheet/global_settings.hpp"
 
+#include <ixion/model_context.hpp>
+
+#include <string>
+
 namespace orcus { namespace spreadsheet {
 
 struct import_factory_impl
@@ -74,6 +78,17 @@ void import_factory::finalize()
     mp_impl->m_doc.finalize();
 }
 
+iface::import_sheet* import_factory::reset_sheet(const char* sheet_name, size_t sheet_name_length)
+{
+    return mp_impl->m_doc.clear_sheet(pstring(sheet_name, sheet_name_length));
+}
+
+bool import_factory::reset()
+{
+    mp_impl->m_doc.clear();
+    return true;
+}
+
 struct export_factory_impl
 {
     document& m_doc;
@@ -94,5 +109,23 @@ const iface::export_sheet* export_factory::get_sheet(const char* sheet_name, siz
     return mp_impl->m_doc.get_sheet(pstring(sheet_name, sheet_name_length));
 }
 
+void export_factory::get_string_table(iface::string_table& table) const
+{
+    const ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
+    size_t n = cxt.get_string_count();
+
+    table.clear();
+    table.offsets.reserve(n + 1);
+    table.offsets.push_back(0);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const std::string* p = cxt.get_string(i);
+        if (p)
+            table.data.insert(table.data.end(), p->begin(), p->end());
+        table.offsets.push_back(static_cast<int64_t>(table.data.size()));
+    }
+}
+
 }}
 /* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -0,0 +1,94 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef ORCUS_SPREADSHEET_MEMORY_GLOBAL_HPP
+#define ORCUS_SPREADSHEET_MEMORY_GLOBAL_HPP
+
+#include "orcus/spreadsheet/auto_filter.hpp"
+#include "orcus/memory_estimate.hpp"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace orcus { namespace spreadsheet {
+
+/**
+ * Release the unused capacity of a vector.
+ *
+ * @return number of bytes released.
+ */
+template<typename _T>
+size_t shrink_vector(std::vector<_T>& v)
+{
+    size_t before = v.capacity();
+    v.shrink_to_fit();
+    return before > v.capacity() ? (before - v.capacity()) * sizeof(_T) : 0;
+}
+
+/**
+ * Estimate the heap memory used by a flat_segment_tree.  Each segment
+ * takes one leaf node, and a built tree adds about as many non-leaf nodes.
+ * A node stores its key and value, three node pointers and a reference
+ * count.
+ */
+template<typename _TreeT>
+size_t estimate_segment_tree_bytes(const _TreeT& tree)
+{
+    const size_t node_size =
+        sizeof(typename _TreeT::key_type) + sizeof(typename _TreeT::value_type) + 4 * sizeof(void*);
+
+    size_t n = 0;
+    typename _TreeT::const_iterator it = tree.begin(), it_end = tree.end();
+    for (; it != it_end; ++it)
+        ++n;
+
+    size_t bytes = n * node_size;
+    if (tree.is_tree_valid() && n > 1)
+        bytes += (n - 1) * node_size;
+
+    return bytes;
+}
+
+/**
+ * Heap memory used by the elements of a vector, including unused capacity.
+ */
+template<typename _T>
+size_t get_vector_bytes(const std::vector<_T>& v)
+{
+    return v.capacity() * sizeof(_T);
+}
+
+/**
+ * Heap memory used by the nodes of an ordered associative container,
+ * excluding memory owned by its elements.  Each node holds the value, three
+ * node pointers and the color.
+ */
+template<typename _MapT>
+size_t estimate_tree_container_bytes(const _MapT& store)
+{
+    return store.size() * (sizeof(typename _MapT::value_type) + 4 * sizeof(void*));
+}
+
+/**
+ * Heap memory used by the column filters of an auto filter.
+ */
+inline size_t get_auto_filter_bytes(const auto_filter_t& filter)
+{
+    size_t bytes = estimate_tree_container_bytes(filter.columns);
+    auto_filter_t::columns_type::const_iterator it = filter.columns.begin(), it_end = filter.columns.end();
+    for (; it != it_end; ++it)
+        bytes += estimate_hash_container_bytes(it->second.match_values);
+
+    return bytes;
+}
+
+}}
+
+#endif
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -0,0 +1,35 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "orcus/spreadsheet/memory_usage.hpp"
+
+namespace orcus { namespace spreadsheet {
+
+sheet_memory_usage_t::sheet_memory_usage_t() :
+    cell_stores(0), formula_tokens(0), format_trees(0), merge_ranges(0), auto_filter(0) {}
+
+size_t sheet_memory_usage_t::total() const
+{
+    return cell_stores + formula_tokens + format_trees + merge_ranges + auto_filter;
+}
+
+memory_usage_t::memory_usage_t() :
+    string_pool(0), shared_strings(0), format_runs(0), styles(0), tables(0) {}
+
+size_t memory_usage_t::total() const
+{
+    size_t ret = string_pool + shared_strings + format_runs + styles + tables;
+    std::vector<sheet_memory_usage_t>::const_iterator it = sheets.begin(), it_end = sheets.end();
+    for (; it != it_end; ++it)
+        ret += it->total();
+
+    return ret;
+}
+
+}}
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -0,0 +1,339 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef ORCUS_SPREADSHEET_RANGE_INDEX_HPP
+#define ORCUS_SPREADSHEET_RANGE_INDEX_HPP
+
+#include "orcus/spreadsheet/types.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace orcus { namespace spreadsheet {
+
+/**
+ * Rectangular cell range within a single sheet.  Both ends are inclusive.
+ */
+struct cell_rect_t
+{
+    row_t first_row;
+    col_t first_col;
+    row_t last_row;
+    col_t last_col;
+
+    cell_rect_t() : first_row(0), first_col(0), last_row(-1), last_col(-1) {}
+
+    cell_rect_t(row_t _first_row, col_t _first_col, row_t _last_row, col_t _last_col) :
+        first_row(_first_row), first_col(_first_col), last_row(_last_row), last_col(_last_col) {}
+
+    bool contains(row_t row, col_t col) const
+    {
+        return first_row <= row && row <= last_row && first_col <= col && col <= last_col;
+    }
+
+    bool overlaps(const cell_rect_t& r) const
+    {
+        return first_row <= r.last_row && r.first_row <= last_row &&
+            first_col <= r.last_col && r.first_col <= last_col;
+    }
+
+    void extend(const cell_rect_t& r)
+    {
+        first_row = std::min(first_row, r.first_row);
+        first_col = std::min(first_col, r.first_col);
+        last_row = std::max(last_row, r.last_row);
+        last_col = std::max(last_col, r.last_col);
+    }
+};
+
+/**
+ * Static spatial index over rectangular cell ranges, each associated with
+ * a value.  Ranges are inserted first, then build() bulk-loads them into an
+ * R-tree using sort-tile-recursive packing, which keeps the tree balanced
+ * with storage proportional to the number of ranges.  Point and range
+ * queries then take O(log n) for ranges that don't overlap each other.
+ *
+ * Queries made while the index is not built fall back to a linear scan,
+ * so the index never needs to be modified from a const method.
+ */
+template<typename _ValueT>
+class range_index
+{
+public:
+    typedef _ValueT value_type;
+
+    struct entry
+    {
+        cell_rect_t range;
+        value_type value;
+
+        entry(const cell_rect_t& _range, const value_type& _value) :
+            range(_range), value(_value) {}
+    };
+
+    typedef std::vector<entry> entries_type;
+    typedef typename entries_type::const_iterator const_iterator;
+
+private:
+    enum { node_capacity = 16 };
+
+    struct node
+    {
+        cell_rect_t bounds;
+        size_t first;   /// index of the first child node or entry.
+        size_t count;   /// number of child nodes or entries.
+        bool leaf;      /// when true, children are entries, else nodes.
+    };
+
+    typedef std::vector<node> nodes_type;
+
+    entries_type m_entries;
+    nodes_type m_nodes;  /// all nodes with the root at the end.
+    bool m_built;
+
+    struct center_row_less
+    {
+        template<typename _T>
+        bool operator() (const _T& l, const _T& r) const
+        {
+            const cell_rect_t& lr = get_bounds(l);
+            const cell_rect_t& rr = get_bounds(r);
+            return (lr.first_row + lr.last_row) < (rr.first_row + rr.last_row);
+        }
+    };
+
+    struct center_col_less
+    {
+        template<typename _T>
+        bool operator() (const _T& l, const _T& r) const
+        {
+            const cell_rect_t& lr = get_bounds(l);
+            const cell_rect_t& rr = get_bounds(r);
+            return (lr.first_col + lr.last_col) < (rr.first_col + rr.last_col);
+        }
+    };
+
+    static const cell_rect_t& get_bounds(const entry& e) { return e.range; }
+    static const cell_rect_t& get_bounds(const node& n) { return n.bounds; }
+
+    /**
+     * Order the items so that each run of node_capacity consecutive items
+     * forms a compact tile: sort by column into vertical slices, then sort
+     * each slice by row.
+     */
+    template<typename _T>
+    static void tile_sort(std::vector<_T>& items)
+    {
+        size_t n = items.size();
+        size_t group_count = (n + node_capacity - 1) / node_capacity;
+        size_t slice_count = static_cast<size_t>(std::ceil(std::sqrt(double(group_count))));
+        if (!slice_count)
+            return;
+
+        size_t slice_size = ((group_count + slice_count - 1) / slice_count) * node_capacity;
+
+        std::sort(items.begin(), items.end(), center_col_less());
+        for (size_t i = 0; i < n; i += slice_size)
+        {
+            size_t end = std::min(i + slice_size, n);
+            std::sort(items.begin() + i, items.begin() + end, center_row_less());
+        }
+    }
+
+    /**
+     * Group consecutive items into parent nodes.
+     */
+    template<typename _T>
+    static void pack(const std::vector<_T>& items, size_t offset, bool leaf, nodes_type& parents)
+    {
+        for (size_t i = 0, n = items.size(); i < n; i += node_capacity)
+        {
+            node nd;
+            nd.first = offset + i;
+            nd.count = std::min<size_t>(node_capacity, n - i);
+            nd.leaf = leaf;
+            nd.bounds = get_bounds(items[i]);
+            for (size_t j = 1; j < nd.count; ++j)
+                nd.bounds.extend(get_bounds(items[i+j]));
+
+            parents.push_back(nd);
+        }
+    }
+
+    template<typename _FuncT>
+    void query_nodes(const cell_rect_t& range, _FuncT& func) const
+    {
+        std::vector<size_t> stack;
+        stack.push_back(m_nodes.size() - 1);
+
+        while (!stack.empty())
+        {
+            const node& nd = m_nodes[stack.back()];
+            stack.pop_back();
+
+            if (!nd.bounds.overlaps(range))
+                continue;
+
+            if (nd.leaf)
+            {
+                for (size_t i = nd.first, n = nd.first + nd.count; i < n; ++i)
+                {
+                    const entry& e = m_entries[i];
+                    if (e.range.overlaps(range))
+                        func(e);
+                }
+            }
+            else
+            {
+                for (size_t i = nd.first, n = nd.first + nd.count; i < n; ++i)
+                    stack.push_back(i);
+            }
+        }
+    }
+
+    struct first_finder
+    {
+        const entry* mp_found;
+
+        first_finder() : mp_found(NULL) {}
+
+        void operator() (const entry& e)
+        {
+            if (!mp_found)
+                mp_found = &e;
+        }
+    };
+
+public:
+    range_index() : m_built(true) {}
+
+    /**
+     * Insert a new range.  This invalidates the index until the next call
+     * to build().
+     */
+    void insert(const cell_rect_t& range, const value_type& value)
+    {
+        m_entries.push_back(entry(range, value));
+        m_built = false;
+    }
+
+    void clear()
+    {
+        m_entries.clear();
+        m_nodes.clear();
+        m_built = true;
+    }
+
+    bool empty() const { return m_entries.empty(); }
+    size_t size() const { return m_entries.size(); }
+    bool is_built() const { return m_built; }
+
+    /**
+     * @return heap memory used by the entry and node arrays.
+     */
+    size_t heap_size() const
+    {
+        return m_entries.capacity() * sizeof(entry) + m_nodes.capacity() * sizeof(node);
+    }
+
+    /**
+     * Release the unused capacity of the entry and node arrays.
+     *
+     * @return number of bytes released.
+     */
+    size_t shrink_to_fit()
+    {
+        size_t before = heap_size();
+        m_entries.shrink_to_fit();
+        m_nodes.shrink_to_fit();
+        size_t after = heap_size();
+        return before > after ? before - after : 0;
+    }
+
+    /**
+     * Iterate over all inserted entries, in no particular order.
+     */
+    const_iterator begin() const { return m_entries.begin(); }
+    const_iterator end() const { return m_entries.end(); }
+
+    /**
+     * Pack all inserted ranges into the tree.
+     */
+    void build()
+    {
+        m_nodes.clear();
+        m_built = true;
+
+        if (m_entries.empty())
+            return;
+
+        // Leaf level.
+        tile_sort(m_entries);
+        nodes_type level;
+        pack(m_entries, 0, true, level);
+
+        // Upper levels, until only the root is left.
+        while (level.size() > 1)
+        {
+            tile_sort(level);
+            size_t offset = m_nodes.size();
+            m_nodes.insert(m_nodes.end(), level.begin(), level.end());
+
+            nodes_type parents;
+            pack(level, offset, false, parents);
+            level.swap(parents);
+        }
+
+        m_nodes.push_back(level[0]);
+        nodes_type(m_nodes).swap(m_nodes); // release slack.
+    }
+
+    /**
+     * Find a range that contains the specified cell.
+     *
+     * @return pointer to the entry, or NULL if no range contains the cell.
+     *         When multiple ranges contain it, any one of them is returned.
+     */
+    const entry* find(row_t row, col_t col) const
+    {
+        first_finder func;
+        query(cell_rect_t(row, col, row, col), func);
+        return func.mp_found;
+    }
+
+    /**
+     * Call the function object for every entry whose range overlaps the
+     * specified range.
+     */
+    template<typename _FuncT>
+    void query(const cell_rect_t& range, _FuncT& func) const
+    {
+        if (m_entries.empty())
+            return;
+
+        if (!m_built)
+        {
+            const_iterator it = m_entries.begin(), it_end = m_entries.end();
+            for (; it != it_end; ++it)
+            {
+                if (it->range.overlaps(range))
+                    func(*it);
+            }
+            return;
+        }
+
+        query_nodes(range, func);
+    }
+};
+
+}}
+
+#endif
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -0,0 +1,273 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "range_index.hpp"
+
+#include <cstdlib>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+using namespace orcus::spreadsheet;
+
+typedef range_index<int> index_type;
+
+struct value_collector
+{
+    vector<int> values;
+
+    void operator() (const index_type::entry& e)
+    {
+        values.push_back(e.value);
+    }
+};
+
+/**
+ * @return sorted values of all entries overlapping the range.
+ */
+vector<int> query_values(const index_type& index, const cell_rect_t& range)
+{
+    value_collector func;
+    index.query(range, func);
+    sort(func.values.begin(), func.values.end());
+    return func.values;
+}
+
+/**
+ * @return sorted values of all entries overlapping the range, by checking
+ *         every entry.
+ */
+vector<int> scan_values(const index_type& index, const cell_rect_t& range)
+{
+    vector<int> values;
+    index_type::const_iterator it = index.begin(), it_end = index.end();
+    for (; it != it_end; ++it)
+    {
+        if (it->range.overlaps(range))
+            values.push_back(it->value);
+    }
+    sort(values.begin(), values.end());
+    return values;
+}
+
+vector<int> make_values(int v1, int v2 = -1, int v3 = -1)
+{
+    vector<int> values;
+    values.push_back(v1);
+    if (v2 >= 0)
+        values.push_back(v2);
+    if (v3 >= 0)
+        values.push_back(v3);
+    sort(values.begin(), values.end());
+    return values;
+}
+
+void test_empty()
+{
+    index_type index;
+    assert(index.empty());
+    assert(index.size() == 0);
+    assert(index.is_built());
+    assert(!index.find(0, 0));
+    assert(query_values(index, cell_rect_t(0, 0, 100, 100)).empty());
+
+    index.build();
+    assert(index.is_built());
+    assert(!index.find(0, 0));
+    assert(query_values(index, cell_rect_t(0, 0, 100, 100)).empty());
+
+    // Clearing a populated index makes it empty again.
+    index.insert(cell_rect_t(1, 1, 2, 2), 1);
+    index.build();
+    assert(index.find(1, 1));
+    index.clear();
+    assert(index.empty());
+    assert(index.is_built());
+    assert(!index.find(1, 1));
+}
+
+void test_single_cell()
+{
+    index_type index;
+    index.insert(cell_rect_t(5, 3, 5, 3), 7);
+    assert(!index.is_built());
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        const index_type::entry* p = index.find(5, 3);
+        assert(p);
+        assert(p->value == 7);
+
+        // Every neighbor of the cell is outside of the range.
+        assert(!index.find(4, 3));
+        assert(!index.find(6, 3));
+        assert(!index.find(5, 2));
+        assert(!index.find(5, 4));
+        assert(!index.find(4, 2));
+        assert(!index.find(6, 4));
+
+        assert(query_values(index, cell_rect_t(0, 0, 5, 3)) == make_values(7));
+        assert(query_values(index, cell_rect_t(5, 3, 9, 9)) == make_values(7));
+        assert(query_values(index, cell_rect_t(0, 0, 4, 9)).empty());
+
+        index.build();
+        assert(index.is_built());
+    }
+}
+
+void test_boundaries()
+{
+    // B3:E9
+    index_type index;
+    index.insert(cell_rect_t(2, 1, 8, 4), 1);
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        // All four corners are inside.
+        assert(index.find(2, 1));
+        assert(index.find(2, 4));
+        assert(index.find(8, 1));
+        assert(index.find(8, 4));
+
+        // One cell past each edge is outside.
+        assert(!index.find(1, 1));
+        assert(!index.find(9, 4));
+        assert(!index.find(2, 0));
+        assert(!index.find(8, 5));
+
+        // Ranges touching an edge overlap, ranges next to it don't.
+        assert(query_values(index, cell_rect_t(0, 0, 2, 1)) == make_values(1));
+        assert(query_values(index, cell_rect_t(8, 4, 20, 20)) == make_values(1));
+        assert(query_values(index, cell_rect_t(0, 0, 1, 20)).empty());
+        assert(query_values(index, cell_rect_t(0, 5, 20, 20)).empty());
+
+        // A query range enclosing the whole range overlaps it too.
+        assert(query_values(index, cell_rect_t(0, 0, 20, 20)) == make_values(1));
+
+        index.build();
+    }
+}
+
+void test_overlapping()
+{
+    index_type index;
+    index.insert(cell_rect_t(0, 0, 9, 9), 1);  // A1:J10
+    index.insert(cell_rect_t(5, 5, 14, 14), 2); // F6:O15
+    index.insert(cell_rect_t(7, 0, 7, 20), 3);  // A8:U8
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        const index_type::entry* p = index.find(0, 0);
+        assert(p && p->value == 1);
+        p = index.find(12, 12);
+        assert(p && p->value == 2);
+        p = index.find(7, 20);
+        assert(p && p->value == 3);
+
+        // Any of the ranges containing the cell may be returned.
+        p = index.find(7, 7);
+        assert(p);
+        assert(p->range.contains(7, 7));
+
+        assert(!index.find(15, 15));
+        assert(!index.find(6, 15));
+
+        assert(query_values(index, cell_rect_t(7, 7, 7, 7)) == make_values(1, 2, 3));
+        assert(query_values(index, cell_rect_t(6, 6, 6, 6)) == make_values(1, 2));
+        assert(query_values(index, cell_rect_t(7, 15, 7, 15)) == make_values(3));
+        assert(query_values(index, cell_rect_t(10, 0, 20, 4)).empty());
+
+        index.build();
+    }
+}
+
+void test_build()
+{
+    // Enough ranges to fill several levels of the tree.
+    const int block_count = 60;
+
+    index_type index;
+    int value = 0;
+    for (int i = 0; i < block_count; ++i)
+    {
+        for (int j = 0; j < block_count; ++j)
+        {
+            row_t row = i * 3;
+            col_t col = j * 3;
+            index.insert(cell_rect_t(row, col, row + 1, col + 1), value++);
+        }
+    }
+
+    // A large range overlapping many of the blocks.
+    index.insert(cell_rect_t(10, 10, 100, 40), value++);
+    assert(index.size() == size_t(value));
+
+    vector<cell_rect_t> queries;
+    queries.push_back(cell_rect_t(0, 0, 0, 0));
+    queries.push_back(cell_rect_t(2, 2, 2, 2)); // gap between the blocks.
+    queries.push_back(cell_rect_t(50, 20, 50, 20));
+    queries.push_back(cell_rect_t(99, 30, 120, 60));
+    queries.push_back(cell_rect_t(178, 178, 200, 200));
+    queries.push_back(cell_rect_t(0, 0, 1000, 1000));
+
+    vector<vector<int>> expected;
+    for (size_t i = 0; i < queries.size(); ++i)
+        expected.push_back(scan_values(index, queries[i]));
+
+    assert(expected[0] == make_values(0));
+    assert(expected[1].empty());
+    assert(expected[5].size() == size_t(value));
+
+    // Before the build, the queries fall back to a linear scan.
+    assert(!index.is_built());
+    for (size_t i = 0; i < queries.size(); ++i)
+        assert(query_values(index, queries[i]) == expected[i]);
+
+    index.build();
+    assert(index.is_built());
+    assert(index.size() == size_t(value));
+    for (size_t i = 0; i < queries.size(); ++i)
+        assert(query_values(index, queries[i]) == expected[i]);
+
+    for (row_t row = 0; row < block_count * 3; row += 7)
+    {
+        for (col_t col = 0; col < block_count * 3; col += 5)
+        {
+            const index_type::entry* p = index.find(row, col);
+            bool in_block = (row % 3) != 2 && (col % 3) != 2;
+            bool in_large = 10 <= row && row <= 100 && 10 <= col && col <= 40;
+            assert((p != NULL) == (in_block || in_large));
+            if (p)
+                assert(p->range.contains(row, col));
+        }
+    }
+
+    // A new range is found right away, and again after the next build.
+    index.insert(cell_rect_t(500, 500, 500, 500), value);
+    assert(!index.is_built());
+    const index_type::entry* p = index.find(500, 500);
+    assert(p && p->value == value);
+
+    index.build();
+    p = index.find(500, 500);
+    assert(p && p->value == value);
+    assert(query_values(index, queries[5]) == scan_values(index, queries[5]));
+}
+
+int main()
+{
+    test_empty();
+    test_single_cell();
+    test_boundaries();
+    test_overlapping();
+    test_build();
+
+    return EXIT_SUCCESS;
+}
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
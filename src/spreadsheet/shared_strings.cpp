@@ -8,6 +8,9 @@
 #include "orcus/spreadsheet/shared_strings.hpp"
 #include "orcus/spreadsheet/styles.hpp"
 
+#include "memory_global.hpp"
+#include "snapshot.hpp"
+
 #include "orcus/pstring.hpp"
 #include "orcus/global.hpp"
 #include "orcus/string_pool.hpp"
@@ -17,20 +20,18 @@
 #include <iostream>
 #include <algorithm>
 #include <cassert>
+#include <unordered_map>
 
 using namespace std;
 
 namespace orcus { namespace spreadsheet {
 
-format_run::format_run() :
-    pos(0), size(0),
+format_run_attrs::format_run_attrs() :
     font_size(0),
     bold(false), italic(false) {}
 
-void format_run::reset()
+void format_run_attrs::reset()
 {
-    pos = 0;
-    size = 0;
     font.clear();
     font_size = 0;
     bold = false;
@@ -38,7 +39,7 @@ void format_run::reset()
     color = color_t();
 }
 
-bool format_run::formatted() const
+bool format_run_attrs::formatted() const
 {
     if (bold || italic)
         return true;
@@ -52,19 +53,41 @@ bool format_run::formatted() const
     return false;
 }
 
-import_shared_strings::import_shared_strings(orcus::string_pool& sp, ixion::model_context& cxt, import_styles& styles) :
-    m_string_pool(sp), m_cxt(cxt), m_styles(styles), mp_cur_format_runs(NULL) {}
+bool format_run_attrs::operator== (const format_run_attrs& r) const
+{
+    return font == r.font && font_size == r.font_size &&
+        color.alpha == r.color.alpha && color.red == r.color.red &&
+        color.green == r.color.green && color.blue == r.color.blue &&
+        bold == r.bold && italic == r.italic;
+}
 
-import_shared_strings::~import_shared_strings()
+size_t format_run_attrs::hash::operator() (const format_run_attrs& v) const
 {
-    for_each(m_formats.begin(), m_formats.end(),
-             map_object_deleter<format_runs_map_type>());
+    size_t n = pstring::hash()(v.font);
+    n ^= std::hash<double>()(v.font_size) + (n << 6) + (n >> 2);
 
-    // This pointer should be NULL.
-    assert(!mp_cur_format_runs);
-    delete mp_cur_format_runs;
+    size_t col = v.color.alpha;
+    col = (col << 8) | v.color.red;
+    col = (col << 8) | v.color.green;
+    col = (col << 8) | v.color.blue;
+    col = (col << 2) | (v.bold ? 2 : 0) | (v.italic ? 1 : 0);
+    n ^= col + (n << 6) + (n >> 2);
+
+    return n;
 }
 
+format_run::format_run() : pos(0), size(0), attrs(NULL) {}
+
+format_runs_span::format_runs_span() : mp_begin(NULL), mp_end(NULL) {}
+
+format_runs_span::format_runs_span(const format_run* p_begin, const format_run* p_end) :
+    mp_begin(p_begin), mp_end(p_end) {}
+
+import_shared_strings::import_shared_strings(orcus::string_pool& sp, ixion::model_context& cxt, import_styles& styles) :
+    m_string_pool(sp), m_cxt(cxt), m_styles(styles), m_cur_runs_begin(0) {}
+
+import_shared_strings::~import_shared_strings() {}
+
 size_t import_shared_strings::append(const char* s, size_t n)
 {
     return m_cxt.append_string(s, n);
@@ -75,12 +98,18 @@ size_t import_shared_strings::add(const char* s, size_t n)
     return m_cxt.add_string(s, n);
 }
 
-const format_runs_t* import_shared_strings::get_format_runs(size_t index) const
+format_runs_span import_shared_strings::get_format_runs(size_t index) const
 {
-    format_runs_map_type::const_iterator itr = m_formats.find(index);
-    if (itr != m_formats.end())
-        return itr->second;
-    return NULL;
+    if (index + 1 >= m_format_run_offsets.size())
+        return format_runs_span();
+
+    size_t pos_begin = m_format_run_offsets[index];
+    size_t pos_end = m_format_run_offsets[index+1];
+    if (pos_begin == pos_end)
+        return format_runs_span();
+
+    const format_run* p = m_format_runs.data();
+    return format_runs_span(p+pos_begin, p+pos_end);
 }
 
 const string* import_shared_strings::get_string(size_t index) const
@@ -138,14 +167,13 @@ void import_shared_strings::append_segment(const char* s, size_t n)
     if (m_cur_format.formatted())
     {
         // This segment is formatted.
-        // Record the position and size of the format run.
-        m_cur_format.pos = start_pos;
-        m_cur_format.size = n;
-
-        if (!mp_cur_format_runs)
-            mp_cur_format_runs = new format_runs_t;
-
-        mp_cur_format_runs->push_back(m_cur_format);
+        // Record the position and size of the format run, and share its
+        // attributes with all other runs formatted the same way.
+        format_run run;
+        run.pos = start_pos;
+        run.size = n;
+        run.attrs = &*m_run_attrs.insert(m_cur_format).first;
+        m_format_runs.push_back(run);
         m_cur_format.reset();
     }
 }
@@ -154,8 +182,18 @@ size_t import_shared_strings::commit_segments()
 {
     size_t sindex = m_cxt.append_string(m_cur_segment_string.data(), m_cur_segment_string.size());
     m_cur_segment_string.clear();
-    m_formats.insert(format_runs_map_type::value_type(sindex, mp_cur_format_runs));
-    mp_cur_format_runs = NULL;
+
+    if (m_cur_runs_begin < m_format_runs.size())
+    {
+        // This string is formatted.  Extend the offset table up to this
+        // string; all strings in between are unformatted and get empty
+        // ranges.
+        assert(m_format_run_offsets.size() <= sindex + 1);
+        m_format_run_offsets.resize(sindex + 1, m_cur_runs_begin);
+        m_format_run_offsets.push_back(m_format_runs.size());
+        m_cur_runs_begin = m_format_runs.size();
+    }
+
     return sindex;
 }
 
@@ -174,9 +212,147 @@ public:
 
 }
 
+size_t import_shared_strings::compact()
+{
+    size_t bytes = shrink_vector(m_format_runs);
+    bytes += shrink_vector(m_format_run_offsets);
+
+    bytes += m_cur_segment_string.capacity();
+    std::string().swap(m_cur_segment_string);
+
+    return bytes;
+}
+
+size_t import_shared_strings::get_format_runs_memory_usage() const
+{
+    size_t bytes = get_vector_bytes(m_format_runs);
+    bytes += get_vector_bytes(m_format_run_offsets);
+    bytes += estimate_hash_container_bytes(m_run_attrs);
+    return bytes;
+}
+
 void import_shared_strings::dump() const
 {
     cout << "number of shared strings: " << m_cxt.get_string_count() << endl;
+    cout << "number of format runs: " << m_format_runs.size() << endl;
+    cout << "number of unique format run attributes: " << m_run_attrs.size() << endl;
+}
+
+void import_shared_strings::write_snapshot(snapshot_writer& writer) const
+{
+    // String content, as an offset table followed by the concatenated
+    // string data.
+    size_t n = m_cxt.get_string_count();
+    std::vector<uint64_t> offsets;
+    offsets.reserve(n + 1);
+    string data;
+    for (size_t i = 0; i < n; ++i)
+    {
+        offsets.push_back(data.size());
+        const string* p = m_cxt.get_string(i);
+        if (p)
+            data += *p;
+    }
+    offsets.push_back(data.size());
+
+    writer.write_array(offsets);
+    writer.write_string(data);
+
+    // Format run attributes, referenced by index from the runs.
+    std::unordered_map<const format_run_attrs*, uint64_t> attr_indices;
+    writer.write_u64(m_run_attrs.size());
+    run_attrs_store_type::const_iterator it = m_run_attrs.begin(), it_end = m_run_attrs.end();
+    for (; it != it_end; ++it)
+    {
+        attr_indices.insert(std::make_pair(&*it, attr_indices.size()));
+        writer.write_string(it->font);
+        writer.write_f64(it->font_size);
+        writer.write_u8(it->color.alpha);
+        writer.write_u8(it->color.red);
+        writer.write_u8(it->color.green);
+        writer.write_u8(it->color.blue);
+        writer.write_u8(it->bold);
+        writer.write_u8(it->italic);
+    }
+
+    // Each run is stored as a triplet of position, size and attribute index.
+    std::vector<uint64_t> runs;
+    runs.reserve(m_format_runs.size() * 3);
+    std::vector<format_run>::const_iterator it_run = m_format_runs.begin(), it_run_end = m_format_runs.end();
+    for (; it_run != it_run_end; ++it_run)
+    {
+        runs.push_back(it_run->pos);
+        runs.push_back(it_run->size);
+        runs.push_back(attr_indices[it_run->attrs]);
+    }
+
+    writer.write_array(runs);
+    std::vector<uint64_t> run_offsets(m_format_run_offsets.begin(), m_format_run_offsets.end());
+    writer.write_array(run_offsets);
+}
+
+void import_shared_strings::read_snapshot(snapshot_reader& reader)
+{
+    size_t n = 0;
+    const uint64_t* offsets = reader.read_array<uint64_t>(n);
+    pstring data = reader.read_string();
+    if (!n)
+        throw general_error("import_shared_strings::read_snapshot: missing string offsets.");
+
+    for (size_t i = 0; i + 1 < n; ++i)
+    {
+        if (offsets[i] > offsets[i+1] || offsets[i+1] > data.size())
+            throw general_error("import_shared_strings::read_snapshot: invalid string offset.");
+
+        size_t sindex = m_cxt.append_string(data.get() + offsets[i], offsets[i+1] - offsets[i]);
+        if (sindex != i)
+            throw general_error("import_shared_strings::read_snapshot: string pool is not empty.");
+    }
+
+    std::vector<const format_run_attrs*> attrs;
+    for (uint64_t i = 0, n_attrs = reader.read_u64(); i < n_attrs; ++i)
+    {
+        format_run_attrs v;
+        pstring font = reader.read_string();
+        if (!font.empty())
+            v.font = m_string_pool.intern(font).first;
+        v.font_size = reader.read_f64();
+        v.color.alpha = reader.read_u8();
+        v.color.red = reader.read_u8();
+        v.color.green = reader.read_u8();
+        v.color.blue = reader.read_u8();
+        v.bold = reader.read_u8() != 0;
+        v.italic = reader.read_u8() != 0;
+        attrs.push_back(&*m_run_attrs.insert(v).first);
+    }
+
+    const uint64_t* runs = reader.read_array<uint64_t>(n);
+    if (n % 3)
+        throw general_error("import_shared_strings::read_snapshot: invalid format runs.");
+
+    m_format_runs.clear();
+    m_format_runs.reserve(n / 3);
+    for (size_t i = 0; i < n; i += 3)
+    {
+        if (runs[i+2] >= attrs.size())
+            throw general_error("import_shared_strings::read_snapshot: invalid format run attributes.");
+
+        format_run run;
+        run.pos = runs[i];
+        run.size = runs[i+1];
+        run.attrs = attrs[runs[i+2]];
+        m_format_runs.push_back(run);
+    }
+
+    const uint64_t* run_offsets = reader.read_array<uint64_t>(n);
+    m_format_run_offsets.assign(run_offsets, run_offsets + n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (m_format_run_offsets[i] > m_format_runs.size() || (i && m_format_run_offsets[i] < m_format_run_offsets[i-1]))
+            throw general_error("import_shared_strings::read_snapshot: invalid format run offset.");
+    }
+
+    m_cur_runs_begin = m_format_runs.size();
 }
 
 }}
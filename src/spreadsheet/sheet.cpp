@@ -16,9 +16,13 @@
 #include "orcus/global.hpp"
 #include "orcus/exception.hpp"
 #include "orcus/measurement.hpp"
+#include "orcus/parser_global.hpp"
 #include "orcus/string_pool.hpp"
 
 #include "data_table.hpp"
+#include "memory_global.hpp"
+#include "range_index.hpp"
+#include "snapshot.hpp"
 #include "table.hpp"
 #include "formula_global.hpp"
 
@@ -30,10 +34,14 @@
 #include <cassert>
 #include <memory>
 #include <cstdlib>
+#include <cstdio>
+#include <cmath>
 #include <unordered_map>
+#include <set>
+#include <type_traits>
+#include <limits>
 
 #include <mdds/flat_segment_tree.hpp>
-#include <mdds/multi_type_matrix.hpp>
 
 #include <ixion/cell.hpp>
 #include <ixion/formula.hpp>
@@ -43,6 +51,7 @@
 #include <ixion/matrix.hpp>
 #include <ixion/model_context.hpp>
 #include <ixion/address.hpp>
+#include <ixion/column_store_type.hpp>
 
 #define ORCUS_DEBUG_SHEET 0
 
@@ -61,17 +70,150 @@ struct merge_size
         width(_width), height(_height) {}
 };
 
-// Merged cell data stored in sheet.
-typedef std::unordered_map<row_t, merge_size> merge_size_type;
-typedef std::unordered_map<col_t, merge_size_type*> col_merge_size_type;
-
-// Overlapped cells per row, used when rendering sheet content.
-typedef mdds::flat_segment_tree<col_t, bool> overlapped_col_index_type;
-typedef std::unordered_map<row_t, overlapped_col_index_type*> overlapped_cells_type;
+// Merged cell ranges stored in sheet, indexed by their 2-dimensional extent.
+typedef range_index<merge_size> merge_range_index_type;
 
 typedef mdds::flat_segment_tree<row_t, size_t>  segment_row_index_type;
 typedef std::unordered_map<col_t, segment_row_index_type*> cell_format_type;
 
+// Rows of numeric cells that store date-time serial values, per column.
+typedef mdds::flat_segment_tree<row_t, bool> date_time_row_index_type;
+typedef std::unordered_map<col_t, date_time_row_index_type*> date_time_cells_type;
+
+/**
+ * Flat, read-only copy of a flat_segment_tree, stored as the start position
+ * and value of each segment sorted by position.  The last node holds the
+ * end position of the last segment.
+ */
+template<typename _ValueT>
+class segment_array
+{
+public:
+    typedef row_t key_type;
+    typedef _ValueT value_type;
+    typedef std::pair<row_t, _ValueT> node_type;
+    typedef std::vector<node_type> nodes_type;
+    typedef typename nodes_type::const_iterator const_iterator;
+
+private:
+    nodes_type m_nodes;
+
+    struct node_start_less
+    {
+        bool operator() (row_t row, const node_type& nd) const { return row < nd.first; }
+    };
+
+public:
+    template<typename _TreeT>
+    explicit segment_array(const _TreeT& tree)
+    {
+        typename _TreeT::const_iterator it = tree.begin(), it_end = tree.end();
+        for (; it != it_end; ++it)
+            m_nodes.push_back(node_type(it->first, it->second));
+
+        m_nodes.shrink_to_fit();
+    }
+
+    const_iterator begin() const { return m_nodes.begin(); }
+    const_iterator end() const { return m_nodes.end(); }
+
+    /**
+     * @return true if the whole range holds the default value.
+     */
+    bool is_default() const
+    {
+        return m_nodes.size() <= 2 && (m_nodes.empty() || m_nodes[0].second == _ValueT());
+    }
+
+    bool find(row_t row, _ValueT& value) const
+    {
+        const_iterator it = std::upper_bound(m_nodes.begin(), m_nodes.end(), row, node_start_less());
+        if (it == m_nodes.begin() || it == m_nodes.end())
+            // Outside of the range.
+            return false;
+
+        --it;
+        value = it->second;
+        return true;
+    }
+
+    size_t heap_size() const
+    {
+        return m_nodes.capacity() * sizeof(node_type);
+    }
+};
+
+/**
+ * Compacted per-column segments, sorted by column.
+ */
+template<typename _ValueT>
+struct column_segments
+{
+    col_t col;
+    segment_array<_ValueT> segments;
+
+    template<typename _TreeT>
+    column_segments(col_t _col, const _TreeT& tree) : col(_col), segments(tree) {}
+};
+
+struct column_segments_less
+{
+    template<typename _T>
+    bool operator() (const _T& left, const _T& right) const { return left.col < right.col; }
+
+    template<typename _T>
+    bool operator() (const _T& left, col_t right) const { return left.col < right; }
+};
+
+typedef std::vector<column_segments<size_t>> compact_cell_format_type;
+typedef std::vector<column_segments<bool>> compact_date_time_cells_type;
+
+/**
+ * Move all per-column segment trees of a store into a sorted array of flat
+ * segments, dropping the columns that only hold the default value.
+ *
+ * @return estimated number of bytes released.
+ */
+template<typename _MapT, typename _ValueT>
+size_t compact_segment_map(_MapT& store, std::vector<column_segments<_ValueT>>& dest)
+{
+    size_t before = estimate_hash_container_bytes(store);
+    typename _MapT::iterator it = store.begin(), it_end = store.end();
+    for (; it != it_end; ++it)
+    {
+        before += estimate_segment_tree_bytes(*it->second);
+        column_segments<_ValueT> v(it->first, *it->second);
+        if (!v.segments.is_default())
+            dest.push_back(v);
+
+        delete it->second;
+    }
+
+    _MapT().swap(store);
+    std::sort(dest.begin(), dest.end(), column_segments_less());
+    dest.shrink_to_fit();
+
+    size_t after = dest.capacity() * sizeof(column_segments<_ValueT>);
+    for (size_t i = 0, n = dest.size(); i < n; ++i)
+        after += dest[i].segments.heap_size();
+
+    return before > after ? before - after : 0;
+}
+
+template<typename _ValueT>
+_ValueT find_segment_value(
+    const std::vector<column_segments<_ValueT>>& store, row_t row, col_t col, _ValueT default_value)
+{
+    typename std::vector<column_segments<_ValueT>>::const_iterator it =
+        std::lower_bound(store.begin(), store.end(), col, column_segments_less());
+
+    if (it == store.end() || it->col != col)
+        return default_value;
+
+    _ValueT ret = default_value;
+    return it->segments.find(row, ret) ? ret : default_value;
+}
+
 // Widths and heights are stored in twips.
 typedef mdds::flat_segment_tree<col_t, col_width_t> col_widths_store_type;
 typedef mdds::flat_segment_tree<row_t, row_height_t> row_heights_store_type;
@@ -80,11 +222,218 @@ typedef mdds::flat_segment_tree<row_t, row_height_t> row_heights_store_type;
 typedef mdds::flat_segment_tree<col_t, bool> col_hidden_store_type;
 typedef mdds::flat_segment_tree<row_t, bool> row_hidden_store_type;
 
-struct overlapped_cells_tree_builder : std::unary_function<overlapped_cells_type::value_type, void>
+/**
+ * Number of days since 1970-01-01 in the proleptic Gregorian calendar.
+ */
+long days_from_civil(long y, int m, int d)
+{
+    y -= m <= 2 ? 1 : 0;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/**
+ * Inverse of days_from_civil().
+ */
+void civil_from_days(long z, int& y, int& m, int& d)
+{
+    z += 719468;
+    long era = (z >= 0 ? z : z - 146096) / 146097;
+    long doe = z - era * 146097;
+    long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long mp = (5 * doy + 2) / 153;
+    d = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    m = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    y = static_cast<int>(yoe + era * 400 + (m <= 2 ? 1 : 0));
+}
+
+void write_date_time(ostream& os, const date_time_t& dt)
 {
-    void operator() (overlapped_cells_type::value_type& node)
+    os << dt.year << '-';
+    if (dt.month < 10)
+        os << '0';
+    os << dt.month << '-';
+    if (dt.day < 10)
+        os << '0';
+    os << dt.day << 'T';
+    if (dt.hour < 10)
+        os << '0';
+    os << dt.hour << ':';
+    if (dt.minute < 10)
+        os << '0';
+    os << dt.minute << ':';
+    if (dt.second < 10.0)
+        os << '0';
+    os << dt.second;
+}
+
+/**
+ * Replace the decimal separator that snprintf writes for the current C
+ * locale, which may be a ',' or even span multiple bytes, with '.'.  The
+ * separator is whatever follows the leading digits, unless it starts the
+ * exponent.
+ *
+ * @return pointer past the last character of the fixed number.
+ */
+char* fix_decimal_point(char* first, char* last)
+{
+    char* p = first;
+    if (p != last && *p == '-')
+        ++p;
+
+    char* digits_begin = p;
+    for (; p != last && is_numeric(*p); ++p)
+        ;
+
+    if (p == digits_begin || p == last || *p == '.' || *p == 'e' || *p == 'E')
+        return last;
+
+    char* p_frac = p + 1;
+    for (; p_frac != last && !is_numeric(*p_frac); ++p_frac)
+        ;
+
+    *p++ = '.';
+    return std::copy(p_frac, last, p);
+}
+
+/**
+ * Format a numeric value the way an output stream with default settings
+ * would, i.e. with up to 6 significant digits as in printf's %g, but
+ * without going through a stream.  Integral values, which are by far the
+ * most common, are formatted without calling into the C library.
+ *
+ * @param first beginning of the output buffer.
+ * @param last end of the output buffer, which must hold at least 32
+ *             characters.
+ *
+ * @return pointer past the last character written.
+ */
+char* format_number(char* first, char* last, double val)
+{
+    if (val == std::floor(val) && std::fabs(val) < 1000000.0 && !(val == 0.0 && std::signbit(val)))
+    {
+        long n = static_cast<long>(val);
+        if (n < 0)
+        {
+            *first++ = '-';
+            n = -n;
+        }
+
+        char digits[8];
+        char* p = digits;
+        do
+        {
+            *p++ = static_cast<char>('0' + n % 10);
+            n /= 10;
+        }
+        while (n);
+
+        while (p != digits)
+            *first++ = *--p;
+
+        return first;
+    }
+
+    int n = std::snprintf(first, last - first, "%.6g", val);
+    if (n < 0)
+        return first;
+
+    return fix_decimal_point(first, first + std::min<ptrdiff_t>(n, last - first - 1));
+}
+
+void write_number(ostream& os, double val)
+{
+    char buf[32];
+    char* p = format_number(buf, buf + sizeof(buf), val);
+    os.write(buf, p - buf);
+}
+
+void append_number(string& buf, double val)
+{
+    char tmp[32];
+    char* p = format_number(tmp, tmp + sizeof(tmp), val);
+    buf.append(tmp, p);
+}
+
+/**
+ * Format a numeric value with the fewest significant digits that still
+ * parse back to the exact same value.  Integral values that fit in the
+ * mantissa are written as plain integers.
+ *
+ * @param first beginning of the output buffer.
+ * @param last end of the output buffer, which must hold at least 32
+ *             characters.
+ *
+ * @return pointer past the last character written.
+ */
+char* format_number_shortest(char* first, char* last, double val)
+{
+    if (val == std::floor(val) && std::fabs(val) < 9007199254740992.0 && !(val == 0.0 && std::signbit(val)))
+    {
+        long long n = static_cast<long long>(val);
+        unsigned long long u = n < 0 ? -n : n;
+        if (n < 0)
+            *first++ = '-';
+
+        char digits[20];
+        char* p = digits;
+        do
+        {
+            *p++ = static_cast<char>('0' + u % 10);
+            u /= 10;
+        }
+        while (u);
+
+        while (p != digits)
+            *first++ = *--p;
+
+        return first;
+    }
+
+    if (!std::isfinite(val))
     {
-        node.second->build_tree();
+        int n = std::snprintf(first, last - first, "%g", val);
+        return n < 0 ? first : first + n;
+    }
+
+    // Any value representable with 15 significant digits or fewer is
+    // printed that way by %.15g; otherwise 16 or 17 digits are needed.
+    char* p_end = first;
+    for (int prec = 15; prec <= 17; ++prec)
+    {
+        int n = std::snprintf(first, last - first, "%.*g", prec, val);
+        if (n < 0)
+            return first;
+
+        p_end = fix_decimal_point(first, first + n);
+
+        double check = 0.0;
+        if (parse_numeric_string(first, p_end - first, check) && check == val)
+            break;
+    }
+
+    return p_end;
+}
+
+/**
+ * Find the merged range whose top-left cell is at the specified position.
+ */
+struct merge_anchor_finder
+{
+    row_t m_row;
+    col_t m_col;
+    const merge_size* mp_found;
+
+    merge_anchor_finder(row_t row, col_t col) : m_row(row), m_col(col), mp_found(NULL) {}
+
+    void operator() (const merge_range_index_type::entry& e)
+    {
+        if (e.range.first_row == m_row && e.range.first_col == m_col)
+            mp_found = &e.value;
     }
 };
 
@@ -172,12 +521,21 @@ struct sheet_impl
     col_hidden_store_type::const_iterator m_col_hidden_pos;
     row_hidden_store_type::const_iterator m_row_hidden_pos;
 
-    col_merge_size_type m_merge_ranges; /// 2-dimensional merged cell ranges.
-    overlapped_cells_type m_overlapped_ranges;
+    merge_range_index_type m_merge_ranges; /// 2-dimensional merged cell ranges.
 
     std::unique_ptr<auto_filter_t> mp_auto_filter_data;
 
     cell_format_type m_cell_formats;
+    date_time_cells_type m_date_time_cells;
+
+    /**
+     * Read-only replacements for m_cell_formats and m_date_time_cells
+     * after the sheet has been compacted.
+     */
+    compact_cell_format_type m_compact_cell_formats;
+    compact_date_time_cells_type m_compact_date_time_cells;
+    bool m_compacted;
+
     row_t m_row_size;
     col_t m_col_size;
     const sheet_t m_sheet; /// sheet ID
@@ -199,91 +557,92 @@ struct sheet_impl
         m_row_hidden(0, row_size, false),
         m_col_hidden_pos(m_col_hidden.begin()),
         m_row_hidden_pos(m_row_hidden.begin()),
+        m_compacted(false),
         m_row_size(row_size), m_col_size(col_size), m_sheet(sheet_index) {}
 
     ~sheet_impl()
     {
         for_each(m_cell_formats.begin(), m_cell_formats.end(),
                  map_object_deleter<cell_format_type>());
-        for_each(m_merge_ranges.begin(), m_merge_ranges.end(),
-                 map_object_deleter<col_merge_size_type>());
-
-        clear_overlapped_ranges();
+        for_each(m_date_time_cells.begin(), m_date_time_cells.end(),
+                 map_object_deleter<date_time_cells_type>());
     }
 
-    const merge_size* get_merge_size(row_t row, col_t col) const
+    /**
+     * Clear the date-time flags of the cells in a column, which get
+     * overwritten with values that are not date-time values.
+     */
+    void clear_date_time(row_t row, col_t col, row_t row_count = 1)
     {
-        col_merge_size_type::const_iterator it_col = m_merge_ranges.find(col);
-        if (it_col == m_merge_ranges.end())
-            return NULL;
-
-        merge_size_type& col_merge_sizes = *it_col->second;
-        merge_size_type::const_iterator it_row = col_merge_sizes.find(row);
-        if (it_row == col_merge_sizes.end())
-            return NULL;
-
-        return &it_row->second;
+        date_time_cells_type::iterator it = m_date_time_cells.find(col);
+        if (it != m_date_time_cells.end())
+            it->second->insert_back(row, row+row_count, false);
     }
 
-    const overlapped_col_index_type* get_overlapped_ranges(row_t row) const
+    /**
+     * Get the merged range whose top-left cell is at the specified
+     * position.
+     */
+    const merge_size* get_merge_size(row_t row, col_t col) const
     {
-        overlapped_cells_type::const_iterator it = m_overlapped_ranges.find(row);
-        if (it == m_overlapped_ranges.end())
-            return NULL;
-
-        return it->second;
+        merge_anchor_finder func(row, col);
+        m_merge_ranges.query(cell_rect_t(row, col, row, col), func);
+        return func.mp_found;
     }
 
-    void clear_overlapped_ranges()
+    /**
+     * Get the merged range that covers the specified cell, or NULL if the
+     * cell is not part of any merged range.
+     */
+    const cell_rect_t* get_merge_range(row_t row, col_t col) const
     {
-        for_each(m_overlapped_ranges.begin(), m_overlapped_ranges.end(),
-                 map_object_deleter<overlapped_cells_type>());
-        m_overlapped_ranges.clear();
+        const merge_range_index_type::entry* p = m_merge_ranges.find(row, col);
+        return p ? &p->range : NULL;
     }
 
-    void update_overlapped_ranges()
+    /**
+     * Append the expression of a formula cell to the buffer.
+     *
+     * @return false if no formula tokens are associated with the cell, in
+     *         which case nothing is appended.
+     */
+    bool append_formula(string& buf, const sheet_cell_t& cell) const
     {
-        clear_overlapped_ranges();
-
-        col_merge_size_type::const_iterator it_col = m_merge_ranges.begin(), it_col_end = m_merge_ranges.end();
-        for (; it_col != it_col_end; ++it_col)
-        {
-            col_t col = it_col->first;
-            const merge_size_type& data = *it_col->second;
-            merge_size_type::const_iterator it = data.begin(), it_end = data.end();
-            for (; it != it_end; ++it)
-            {
-                row_t row = it->first;
-                const merge_size& item = it->second;
-                for (row_t i = 0; i < item.height; ++i, ++row)
-                {
-                    // Get the container for this row.
-                    overlapped_cells_type::iterator it_cont = m_overlapped_ranges.find(row);
-                    if (it_cont == m_overlapped_ranges.end())
-                    {
-                        std::unique_ptr<overlapped_col_index_type> p(new overlapped_col_index_type(0, m_col_size, false));
-                        std::pair<overlapped_cells_type::iterator, bool> r =
-                            m_overlapped_ranges.insert(overlapped_cells_type::value_type(row, p.get()));
-
-                        if (!r.second)
-                        {
-                            // Insertion failed.
-                            return;
-                        }
+        const ixion::model_context& cxt = m_doc.get_model_context();
+        const ixion::formula_cell* fcell = cell.formula;
+        assert(fcell);
+        size_t index = fcell->get_identifier();
+        const ixion::formula_tokens_t* t = NULL;
+        if (fcell->is_shared())
+            t = cxt.get_shared_formula_tokens(m_sheet, index);
+        else
+            t = cxt.get_formula_tokens(m_sheet, index);
 
-                        p.release();
-                        it_cont = r.first;
-                    }
+        if (!t)
+            return false;
 
-                    overlapped_col_index_type& cont = *it_cont->second;
-                    cont.insert_back(col, col+item.width, true);
-                }
-            }
+        const ixion::formula_name_resolver* resolver = m_doc.get_formula_name_resolver();
+        if (!resolver)
+        {
+            buf += "???";
+            return true;
         }
 
-        // Build trees.
-        for_each(m_overlapped_ranges.begin(), m_overlapped_ranges.end(),
-                 overlapped_cells_tree_builder());
+        string formula;
+        ixion::abs_address_t pos(m_sheet, cell.row, cell.col);
+        ixion::print_formula_tokens(cxt, pos, *resolver, *t, formula);
+        buf += formula;
+        return true;
+    }
+
+    /**
+     * Append the cached result of a formula cell to the buffer, if any.
+     */
+    void append_formula_result(string& buf, const sheet_cell_t& cell) const
+    {
+        const ixion::formula_result* res = cell.formula->get_result_cache();
+        if (res)
+            buf += res->str(m_doc.get_model_context());
     }
 };
 
@@ -328,12 +687,11 @@ void sheet::set_auto(row_t row, col_t col, const char* p, size_t n)
         return;
 
     ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
+    mp_impl->clear_date_time(row, col);
 
     // First, see if this can be parsed as a number.
-    char* endptr = NULL;
-    double val = strtod(p, &endptr);
-    const char* endptr_check = p + n;
-    if (endptr == endptr_check)
+    double val = 0.0;
+    if (parse_numeric_string(p, n, val))
         // Treat this as a numeric value.
         cxt.set_numeric_cell(ixion::abs_address_t(mp_impl->m_sheet,row,col), val);
     else
@@ -345,6 +703,7 @@ void sheet::set_string(row_t row, col_t col, size_t sindex)
 {
     ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
     cxt.set_string_cell(ixion::abs_address_t(mp_impl->m_sheet,row,col), sindex);
+    mp_impl->clear_date_time(row, col);
 
 #if ORCUS_DEBUG_SHEET
     cout << "sheet::set_string: sheet=" << mp_impl->m_sheet << ", row=" << row << ", col=" << col << ", si=" << sindex << endl;
@@ -355,37 +714,57 @@ void sheet::set_value(row_t row, col_t col, double value)
 {
     ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
     cxt.set_numeric_cell(ixion::abs_address_t(mp_impl->m_sheet,row,col), value);
+    mp_impl->clear_date_time(row, col);
+}
+
+void sheet::set_values(row_t row, col_t col, const double* values, size_t n)
+{
+    // TODO : Insert the values as a single block once the model context
+    // provides a way to do so.
+    ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
+    ixion::abs_address_t pos(mp_impl->m_sheet, row, col);
+    for (size_t i = 0; i < n; ++i, ++pos.row)
+        cxt.set_numeric_cell(pos, values[i]);
+
+    if (n)
+        mp_impl->clear_date_time(row, col, n);
 }
 
 void sheet::set_bool(row_t row, col_t col, bool value)
 {
     ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
     cxt.set_boolean_cell(ixion::abs_address_t(mp_impl->m_sheet,row,col), value);
+    mp_impl->clear_date_time(row, col);
 }
 
 void sheet::set_date_time(row_t row, col_t col, int year, int month, int day, int hour, int minute, double second)
 {
-    // I'll convert this into a string value for now.
+    // Store the value as the number of days since the origin date, which
+    // is how spreadsheet applications represent date-time values.  Whether
+    // the cell holds a date-time is recorded separately.
+    date_time_t origin = mp_impl->m_doc.get_origin_date();
+    long days = days_from_civil(year, month, day) - days_from_civil(origin.year, origin.month, origin.day);
+    double serial = days + (hour * 3600.0 + minute * 60.0 + second) / 86400.0;
 
-    ostringstream os;
-    os << year << '-';
-    if (month < 10)
-        os << '0';
-    os << month << '-';
-    if (day < 10)
-        os << '0';
-    os << day << 'T';
-    if (hour < 10)
-        os << '0';
-    os << hour << ':';
-    if (minute < 10)
-        os << '0';
-    os << minute << ':';
-    if (second < 10.0)
-        os << '0';
-    os << second;
-    string s = os.str();
-    set_auto(row, col, &s[0], s.size());
+    ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
+    cxt.set_numeric_cell(ixion::abs_address_t(mp_impl->m_sheet,row,col), serial);
+
+    date_time_cells_type::iterator itr = mp_impl->m_date_time_cells.find(col);
+    if (itr == mp_impl->m_date_time_cells.end())
+    {
+        std::unique_ptr<date_time_row_index_type> p(new date_time_row_index_type(0, mp_impl->m_row_size+1, false));
+
+        pair<date_time_cells_type::iterator, bool> r =
+            mp_impl->m_date_time_cells.insert(date_time_cells_type::value_type(col, p.get()));
+
+        if (!r.second)
+            return;
+
+        p.release();
+        itr = r.first;
+    }
+
+    itr->second->insert_back(row, row+1, true);
 }
 
 void sheet::set_format(row_t row, col_t col, size_t index)
@@ -436,6 +815,7 @@ void sheet::set_formula(row_t row, col_t col, formula_grammar_t grammar,
     cxt.set_formula_cell(pos, p, n, *resolver);
     ixion::register_formula_cell(cxt, pos);
     mp_impl->m_doc.insert_dirty_cell(pos);
+    mp_impl->clear_date_time(row, col);
 }
 
 void sheet::set_shared_formula(
@@ -473,6 +853,7 @@ void sheet::set_shared_formula(row_t row, col_t col, size_t sindex)
     cxt.set_formula_cell(pos, sindex, true);
     ixion::register_formula_cell(cxt, pos);
     mp_impl->m_doc.insert_dirty_cell(pos);
+    mp_impl->clear_date_time(row, col);
 }
 
 void sheet::set_array_formula(
@@ -517,6 +898,155 @@ void sheet::write_string(ostream& os, row_t row, col_t col) const
     }
 }
 
+void sheet::get_data_size(row_t& row_count, col_t& col_count) const
+{
+    const ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
+    ixion::abs_range_t range = cxt.get_data_range(mp_impl->m_sheet);
+    if (!range.valid())
+    {
+        row_count = 0;
+        col_count = 0;
+        return;
+    }
+
+    row_count = range.last.row + 1;
+    col_count = range.last.column + 1;
+}
+
+namespace {
+
+/**
+ * Mark a range of elements as valid in an Arrow validity bitmap.
+ */
+void set_validity_bits(std::vector<uint8_t>& bitmap, size_t start, size_t n)
+{
+    size_t end = start + n;
+
+    // Leading bits up to the first byte boundary.
+    for (; start < end && (start % 8); ++start)
+        bitmap[start / 8] |= static_cast<uint8_t>(1u << (start % 8));
+
+    // Whole bytes.
+    for (; start + 8 <= end; start += 8)
+        bitmap[start / 8] = 0xFF;
+
+    // Trailing bits.
+    for (; start < end; ++start)
+        bitmap[start / 8] |= static_cast<uint8_t>(1u << (start % 8));
+}
+
+/**
+ * Convert a string identifier to the int32 dictionary index of a column
+ * chunk.
+ */
+int32_t to_chunk_string_id(size_t sid)
+{
+    if (sid > static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+    {
+        std::ostringstream os;
+        os << "sheet::get_column_chunk: string identifier " << sid << " is out of the int32 range.";
+        throw general_error(os.str());
+    }
+
+    return static_cast<int32_t>(sid);
+}
+
+}
+
+void sheet::get_column_chunk(
+    col_t col, row_t row_start, size_t length, iface::column_chunk& chunk) const
+{
+    chunk.reset(row_start, length);
+
+    const ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
+    const ixion::column_stores_t* stores = cxt.get_columns(mp_impl->m_sheet);
+    if (!stores || col < 0 || static_cast<size_t>(col) >= stores->size() || row_start < 0)
+    {
+        chunk.append_type_run(iface::column_cell_t::empty, length);
+        return;
+    }
+
+    const ixion::column_store_t& store = *(*stores)[col];
+    size_t pos = 0; // position within the chunk.
+
+    if (static_cast<size_t>(row_start) < store.size())
+    {
+        ixion::column_store_t::const_position_type store_pos = store.position(row_start);
+        ixion::column_store_t::const_iterator it = store_pos.first, it_end = store.end();
+        size_t offset = store_pos.second;
+
+        for (; it != it_end && pos < length; ++it, offset = 0)
+        {
+            size_t n = std::min(it->size - offset, length - pos);
+
+            switch (it->type)
+            {
+                case mdds::mtv::element_type_numeric:
+                {
+                    mdds::mtv::numeric_element_block::const_iterator it_val =
+                        mdds::mtv::numeric_element_block::begin(*it->data) + offset;
+                    std::copy(it_val, it_val + n, chunk.numeric_values.begin() + pos);
+                    set_validity_bits(chunk.numeric_validity, pos, n);
+                    chunk.numeric_null_count -= n;
+                    chunk.append_type_run(iface::column_cell_t::numeric, n);
+                }
+                break;
+                case mdds::mtv::element_type_ulong:
+                {
+                    mdds::mtv::ulong_element_block::const_iterator it_val =
+                        mdds::mtv::ulong_element_block::begin(*it->data) + offset;
+                    for (size_t i = 0; i < n; ++i, ++it_val)
+                        chunk.string_ids[pos+i] = to_chunk_string_id(*it_val);
+                    set_validity_bits(chunk.string_validity, pos, n);
+                    chunk.string_null_count -= n;
+                    chunk.append_type_run(iface::column_cell_t::string, n);
+                }
+                break;
+                case ixion::element_type_formula:
+                {
+                    // Formula cells contribute their cached results.
+                    ixion::formula_element_block::const_iterator it_val =
+                        ixion::formula_element_block::begin(*it->data) + offset;
+                    for (size_t i = 0; i < n; ++i, ++it_val)
+                    {
+                        const ixion::formula_result* res = (*it_val)->get_result_cache();
+                        if (!res)
+                            continue;
+
+                        switch (res->get_type())
+                        {
+                            case ixion::formula_result::result_type::value:
+                                chunk.numeric_values[pos+i] = res->get_value();
+                                set_validity_bits(chunk.numeric_validity, pos+i, 1);
+                                --chunk.numeric_null_count;
+                            break;
+                            case ixion::formula_result::result_type::string:
+                                chunk.string_ids[pos+i] = to_chunk_string_id(res->get_string());
+                                set_validity_bits(chunk.string_validity, pos+i, 1);
+                                --chunk.string_null_count;
+                            break;
+                            default:
+                                ;
+                        }
+                    }
+                    chunk.append_type_run(iface::column_cell_t::formula, n);
+                }
+                break;
+                case mdds::mtv::element_type_empty:
+                    chunk.append_type_run(iface::column_cell_t::empty, n);
+                break;
+                default:
+                    chunk.append_type_run(iface::column_cell_t::unknown, n);
+            }
+
+            pos += n;
+        }
+    }
+
+    // Rows past the end of the sheet.
+    chunk.append_type_run(iface::column_cell_t::empty, length - pos);
+}
+
 void sheet::set_col_width(col_t col, col_width_t width)
 {
     mp_impl->m_col_width_pos =
@@ -578,26 +1108,9 @@ void sheet::set_merge_cell_range(const char* p_ref, size_t p_ref_len)
     if (res.type != ixion::formula_name_type::range_reference)
         return;
 
-    col_merge_size_type::iterator it_col = mp_impl->m_merge_ranges.find(res.range.first.col);
-    if (it_col == mp_impl->m_merge_ranges.end())
-    {
-        std::unique_ptr<merge_size_type> p(new merge_size_type);
-        pair<col_merge_size_type::iterator, bool> r =
-            mp_impl->m_merge_ranges.insert(
-                col_merge_size_type::value_type(res.range.first.col, p.get()));
-
-        if (!r.second)
-            // Insertion failed.
-            return;
-
-        p.release();
-        it_col = r.first;
-    }
-
-    merge_size_type& col_data = *it_col->second;
     merge_size sz(res.range.last.col-res.range.first.col+1, res.range.last.row-res.range.first.row+1);
-    col_data.insert(
-        merge_size_type::value_type(res.range.first.row, sz));
+    mp_impl->m_merge_ranges.insert(
+        cell_rect_t(res.range.first.row, res.range.first.col, res.range.last.row, res.range.last.col), sz);
 }
 
 size_t sheet::get_string_identifier(row_t row, col_t col) const
@@ -636,11 +1149,284 @@ sheet_t sheet::get_index() const
     return mp_impl->m_sheet;
 }
 
+sheet_cell_iterator sheet::begin_cells(cell_order_t order) const
+{
+    return sheet_cell_iterator(mp_impl->m_doc.get_model_context(), mp_impl->m_sheet, order);
+}
+
+sheet_cell_iterator sheet::end_cells() const
+{
+    return sheet_cell_iterator();
+}
+
 void sheet::finalize()
 {
     mp_impl->m_col_widths.build_tree();
     mp_impl->m_row_heights.build_tree();
-    mp_impl->update_overlapped_ranges();
+    mp_impl->m_merge_ranges.build();
+}
+
+void sheet::freeze()
+{
+    finalize();
+    mp_impl->m_col_hidden.build_tree();
+    mp_impl->m_row_hidden.build_tree();
+
+    cell_format_type::iterator it_fmt = mp_impl->m_cell_formats.begin(), it_fmt_end = mp_impl->m_cell_formats.end();
+    for (; it_fmt != it_fmt_end; ++it_fmt)
+        it_fmt->second->build_tree();
+
+    date_time_cells_type::iterator it_dt = mp_impl->m_date_time_cells.begin(), it_dt_end = mp_impl->m_date_time_cells.end();
+    for (; it_dt != it_dt_end; ++it_dt)
+        it_dt->second->build_tree();
+}
+
+void sheet::clear()
+{
+    ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
+    const sheet_t sheet_index = mp_impl->m_sheet;
+
+    // Collect the positions of all non-empty cells first, since erasing
+    // cells invalidates the iterator.  Formula cells must be unregistered
+    // before they get erased.
+    std::vector<ixion::abs_address_t> positions;
+    sheet_cell_iterator it = begin_cells(), it_end = end_cells();
+    for (; it != it_end; ++it)
+    {
+        ixion::abs_address_t pos(sheet_index, it->row, it->col);
+        if (it->type == ixion::celltype_t::formula)
+            ixion::unregister_formula_cell(cxt, pos);
+
+        positions.push_back(pos);
+    }
+
+    // Erase from the bottom of each column up, so that no cell blocks need
+    // to be shifted.
+    std::vector<ixion::abs_address_t>::reverse_iterator it_pos = positions.rbegin(), it_pos_end = positions.rend();
+    for (; it_pos != it_pos_end; ++it_pos)
+        cxt.erase_cell(*it_pos);
+
+    mp_impl->m_col_widths.clear();
+    mp_impl->m_row_heights.clear();
+    mp_impl->m_col_width_pos = mp_impl->m_col_widths.begin();
+    mp_impl->m_row_height_pos = mp_impl->m_row_heights.begin();
+
+    mp_impl->m_col_hidden.clear();
+    mp_impl->m_row_hidden.clear();
+    mp_impl->m_col_hidden_pos = mp_impl->m_col_hidden.begin();
+    mp_impl->m_row_hidden_pos = mp_impl->m_row_hidden.begin();
+
+    mp_impl->m_merge_ranges.clear();
+    mp_impl->mp_auto_filter_data.reset();
+
+    for_each(mp_impl->m_cell_formats.begin(), mp_impl->m_cell_formats.end(),
+             map_object_deleter<cell_format_type>());
+    mp_impl->m_cell_formats.clear();
+    for_each(mp_impl->m_date_time_cells.begin(), mp_impl->m_date_time_cells.end(),
+             map_object_deleter<date_time_cells_type>());
+    mp_impl->m_date_time_cells.clear();
+
+    mp_impl->m_compact_cell_formats.clear();
+    mp_impl->m_compact_date_time_cells.clear();
+    mp_impl->m_compacted = false;
+}
+
+size_t sheet::compact()
+{
+    if (mp_impl->m_compacted)
+        return 0;
+
+    freeze();
+
+    size_t bytes = 0;
+    bytes += compact_segment_map(mp_impl->m_cell_formats, mp_impl->m_compact_cell_formats);
+    bytes += compact_segment_map(mp_impl->m_date_time_cells, mp_impl->m_compact_date_time_cells);
+    bytes += mp_impl->m_merge_ranges.shrink_to_fit();
+    mp_impl->m_compacted = true;
+
+    return bytes;
+}
+
+namespace {
+
+template<typename _MapT>
+size_t get_segment_map_bytes(const _MapT& store)
+{
+    size_t bytes = estimate_hash_container_bytes(store);
+    typename _MapT::const_iterator it = store.begin(), it_end = store.end();
+    for (; it != it_end; ++it)
+        bytes += estimate_segment_tree_bytes(*it->second);
+
+    return bytes;
+}
+
+template<typename _ValueT>
+size_t get_segment_map_bytes(const std::vector<column_segments<_ValueT>>& store)
+{
+    size_t bytes = get_vector_bytes(store);
+    for (size_t i = 0, n = store.size(); i < n; ++i)
+        bytes += store[i].segments.heap_size();
+
+    return bytes;
+}
+
+/**
+ * Heap memory used by a formula token array.  Tokens are allocated
+ * individually and held by pointer.
+ */
+size_t get_formula_tokens_bytes(const ixion::formula_tokens_t* tokens)
+{
+    return tokens ? tokens->size() * (sizeof(void*) + sizeof(ixion::formula_token)) : 0;
+}
+
+}
+
+sheet_memory_usage_t sheet::get_memory_usage() const
+{
+    sheet_memory_usage_t ret;
+    const ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
+
+    const ixion::column_stores_t* stores = cxt.get_columns(mp_impl->m_sheet);
+    if (stores)
+    {
+        // Each formula token array is shared by all cells that reference it
+        // by its identifier.
+        std::set<size_t> formula_ids, shared_formula_ids;
+
+        ret.cell_stores += get_vector_bytes(*stores);
+        for (size_t col = 0, n = stores->size(); col < n; ++col)
+        {
+            const ixion::column_store_t& store = *(*stores)[col];
+            ret.cell_stores += sizeof(ixion::column_store_t);
+
+            ixion::column_store_t::const_iterator it = store.begin(), it_end = store.end();
+            for (; it != it_end; ++it)
+            {
+                // Block pointer and header, plus the element block header.
+                ret.cell_stores += sizeof(void*) + 2 * sizeof(size_t);
+                if (it->type != mdds::mtv::element_type_empty)
+                    ret.cell_stores += sizeof(std::vector<char>) + sizeof(int);
+
+                switch (it->type)
+                {
+                    case mdds::mtv::element_type_numeric:
+                        ret.cell_stores += it->size * sizeof(double);
+                    break;
+                    case mdds::mtv::element_type_ulong:
+                        ret.cell_stores += it->size * sizeof(unsigned long);
+                    break;
+                    case mdds::mtv::element_type_boolean:
+                        ret.cell_stores += (it->size + 7) / 8;
+                    break;
+                    case ixion::element_type_formula:
+                    {
+                        ret.cell_stores += it->size * sizeof(ixion::formula_cell*);
+                        ret.formula_tokens += it->size * sizeof(ixion::formula_cell);
+
+                        ixion::formula_element_block::const_iterator it_cell =
+                            ixion::formula_element_block::begin(*it->data);
+                        ixion::formula_element_block::const_iterator it_cell_end =
+                            ixion::formula_element_block::end(*it->data);
+
+                        for (; it_cell != it_cell_end; ++it_cell)
+                        {
+                            const ixion::formula_cell* fcell = *it_cell;
+                            size_t id = fcell->get_identifier();
+                            if (fcell->is_shared())
+                            {
+                                if (shared_formula_ids.insert(id).second)
+                                    ret.formula_tokens += get_formula_tokens_bytes(
+                                        cxt.get_shared_formula_tokens(mp_impl->m_sheet, id));
+                            }
+                            else if (formula_ids.insert(id).second)
+                                ret.formula_tokens += get_formula_tokens_bytes(
+                                    cxt.get_formula_tokens(mp_impl->m_sheet, id));
+                        }
+                    }
+                    break;
+                    default:
+                        ;
+                }
+            }
+        }
+    }
+
+    ret.format_trees += estimate_segment_tree_bytes(mp_impl->m_col_widths);
+    ret.format_trees += estimate_segment_tree_bytes(mp_impl->m_row_heights);
+    ret.format_trees += estimate_segment_tree_bytes(mp_impl->m_col_hidden);
+    ret.format_trees += estimate_segment_tree_bytes(mp_impl->m_row_hidden);
+    if (mp_impl->m_compacted)
+    {
+        ret.format_trees += get_segment_map_bytes(mp_impl->m_compact_cell_formats);
+        ret.format_trees += get_segment_map_bytes(mp_impl->m_compact_date_time_cells);
+    }
+    else
+    {
+        ret.format_trees += get_segment_map_bytes(mp_impl->m_cell_formats);
+        ret.format_trees += get_segment_map_bytes(mp_impl->m_date_time_cells);
+    }
+
+    ret.merge_ranges = mp_impl->m_merge_ranges.heap_size();
+
+    if (mp_impl->mp_auto_filter_data)
+        ret.auto_filter = sizeof(auto_filter_t) + get_auto_filter_bytes(*mp_impl->mp_auto_filter_data);
+
+    return ret;
+}
+
+namespace {
+
+/**
+ * Append the text of a single cell as it appears in the flat dump.
+ */
+void append_flat_cell_text(string& buf, const sheet& sh, const sheet_impl& impl, const sheet_cell_t& cell)
+{
+    switch (cell.type)
+    {
+        case ixion::celltype_t::string:
+        {
+            const string* p = impl.m_doc.get_model_context().get_string(cell.string_id);
+            assert(p);
+            buf += *p;
+        }
+        break;
+        case ixion::celltype_t::numeric:
+        {
+            if (sh.is_date_time(cell.row, cell.col))
+            {
+                ostringstream os;
+                write_date_time(os, sh.get_date_time(cell.row, cell.col));
+                buf += os.str();
+            }
+            else
+            {
+                append_number(buf, cell.numeric);
+                buf += " [v]";
+            }
+        }
+        break;
+        case ixion::celltype_t::formula:
+        {
+            // print the formula and the formula result.
+            if (impl.append_formula(buf, cell) && cell.formula->get_result_cache())
+            {
+                buf += " (";
+                impl.append_formula_result(buf, cell);
+                buf += ")";
+            }
+        }
+        break;
+        default:
+            ;
+    }
+}
+
+void write_padding(ostream& os, char c, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        os.put(c);
+}
+
 }
 
 void sheet::dump_flat(std::ostream& os) const
@@ -651,238 +1437,321 @@ void sheet::dump_flat(std::ostream& os) const
         // Sheet is empty.  Nothing to print.
         return;
 
-    const ixion::formula_name_resolver* resolver = mp_impl->m_doc.get_formula_name_resolver();
-
     size_t row_count = range.last.row + 1;
     size_t col_count = range.last.column + 1;
     os << "rows: " << row_count << "  cols: " << col_count << endl;
 
-    typedef mdds::multi_type_matrix<mdds::mtm::std_string_trait> mx_type;
-    mx_type mx(row_count, col_count);
+    // Calculate column widths first.  Cell text is formatted twice rather
+    // than stored, so that memory use stays independent of the sheet size.
+    vector<size_t> col_widths(col_count, 0);
+    string buf;
 
-    // Put all cell values into matrix as string elements first.
-    for (size_t row = 0; row < row_count; ++row)
+    sheet_cell_iterator it = begin_cells(cell_order_t::column_major), it_end = end_cells();
+    for (; it != it_end; ++it)
     {
-        for (size_t col = 0; col < col_count; ++col)
+        buf.clear();
+        append_flat_cell_text(buf, *this, *mp_impl, *it);
+        size_t& cw = col_widths[it->col];
+        if (cw < buf.size())
+            cw = buf.size();
+    }
+
+    // Create a row separator string;
+    string sep(1, '+');
+    for (size_t i = 0; i < col_widths.size(); ++i)
+    {
+        sep.append(col_widths[i] + 2, '-');
+        sep += '+';
+    }
+
+    // Now print to the output stream, one row at a time.
+    os << sep << '\n';
+    it = begin_cells(cell_order_t::row_major);
+    for (size_t r = 0; r < row_count; ++r)
+    {
+        os.put('|');
+        for (size_t c = 0; c < col_count; ++c)
         {
-            ixion::abs_address_t pos(mp_impl->m_sheet,row,col);
-            switch (cxt.get_celltype(pos))
+            size_t cw = col_widths[c]; // column width
+            buf.clear();
+            if (it != it_end && static_cast<size_t>(it->row) == r && static_cast<size_t>(it->col) == c)
             {
-                case ixion::celltype_t::string:
-                {
-                    size_t sindex = cxt.get_string_identifier(pos);
-                    const string* p = cxt.get_string(sindex);
-                    assert(p);
-                    mx.set(row, col, *p);
-                }
-                break;
-                case ixion::celltype_t::numeric:
-                {
-                    ostringstream os2;
-                    os2 << cxt.get_numeric_value(pos) << " [v]";
-                    mx.set(row, col, os2.str());
-                }
-                break;
-                case ixion::celltype_t::formula:
-                {
-                    // print the formula and the formula result.
-                    const ixion::formula_cell* cell = cxt.get_formula_cell(pos);
-                    assert(cell);
-                    size_t index = cell->get_identifier();
-                    const ixion::formula_tokens_t* t = NULL;
-                    if (cell->is_shared())
-                        t = cxt.get_shared_formula_tokens(mp_impl->m_sheet, index);
-                    else
-                        t = cxt.get_formula_tokens(mp_impl->m_sheet, index);
+                append_flat_cell_text(buf, *this, *mp_impl, *it);
+                ++it;
+            }
 
-                    if (t)
-                    {
-                        ostringstream os2;
-                        string formula;
-                        if (resolver)
-                        {
-                            ixion::print_formula_tokens(
-                               mp_impl->m_doc.get_model_context(), pos, *resolver, *t, formula);
-                        }
-                        else
-                            formula = "???";
+            os.put(' ');
+            os.write(buf.data(), buf.size());
+            write_padding(os, ' ', cw - buf.size());
+            os.write(" |", 2);
+        }
+        os << '\n' << sep << '\n';
+    }
+
+    os.flush();
+}
+
+namespace {
+
+void write_cell_position(ostream& os, const pstring& sheet_name, row_t row, col_t col)
+{
+    os << sheet_name << '/' << row << '/' << col << ':';
+}
+
+void write_escaped_chars(ostream& os, const string& str)
+{
+    const char* p = str.data();
+    const char* p_end = p + str.size();
+    const char* p_head = p;
+    for (; p != p_end; ++p)
+    {
+        if (*p != '"')
+            continue;
+
+        os.write(p_head, p - p_head);
+        os.put('\\');
+        p_head = p;
+    }
+
+    os.write(p_head, p_end - p_head);
+}
 
-                        os2 << formula;
+}
+
+void sheet::dump_check(ostream& os, const pstring& sheet_name) const
+{
+    const ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
+    string buf;
+
+    sheet_cell_iterator it = begin_cells(cell_order_t::row_major), it_end = end_cells();
+    for (; it != it_end; ++it)
+    {
+        const sheet_cell_t& cell = *it;
+        switch (cell.type)
+        {
+            case ixion::celltype_t::string:
+            {
+                write_cell_position(os, sheet_name, cell.row, cell.col);
+                const string* p = cxt.get_string(cell.string_id);
+                assert(p);
+                os << "string:\"";
+                write_escaped_chars(os, *p);
+                os << "\"\n";
+            }
+            break;
+            case ixion::celltype_t::numeric:
+            {
+                write_cell_position(os, sheet_name, cell.row, cell.col);
+                os << "numeric:";
+                write_number(os, cell.numeric);
+                os << '\n';
+            }
+            break;
+            case ixion::celltype_t::formula:
+            {
+                write_cell_position(os, sheet_name, cell.row, cell.col);
+                os << "formula";
 
-                        const ixion::formula_result* res = cell->get_result_cache();
-                        if (res)
-                            os2 << " (" << res->str(mp_impl->m_doc.get_model_context()) << ")";
+                // print the formula and the formula result.
+                buf.clear();
+                if (mp_impl->append_formula(buf, cell))
+                {
+                    os << ':' << buf;
 
-                        mx.set(row, col, os2.str());
+                    if (cell.formula->get_result_cache())
+                    {
+                        buf.clear();
+                        mp_impl->append_formula_result(buf, cell);
+                        os << ':' << buf;
                     }
                 }
-                break;
-                default:
-                    ;
+                os << '\n';
             }
+            break;
+            default:
+                ;
         }
     }
 
-    // Calculate column widths first.
-    mx_type::size_pair_type sp = mx.size();
-    vector<size_t> col_widths(sp.column, 0);
+    os.flush();
+}
+
+
+namespace {
+
+/**
+ * Output buffer for CSV content.  Characters accumulate in a large string
+ * buffer that is handed to the stream in big chunks.
+ */
+class csv_writer
+{
+    static const size_t flush_threshold = 1024 * 1024;
 
-    for (size_t r = 0; r < sp.row; ++r)
+    std::ostream& m_os;
+    std::string m_buf;
+
+public:
+    csv_writer(std::ostream& os) : m_os(os)
     {
-        for (size_t c = 0; c < sp.column; ++c)
-        {
-            if (mx.get_type(r, c) == mdds::mtm::element_empty)
-                continue;
+        m_buf.reserve(flush_threshold + 4096);
+    }
 
-            const string s = mx.get_string(r, c);
-            if (col_widths[c] < s.size())
-                col_widths[c] = s.size();
-        }
+    ~csv_writer()
+    {
+        flush();
     }
 
-    // Create a row separator string;
-    ostringstream os2;
-    os2 << '+';
-    for (size_t i = 0; i < col_widths.size(); ++i)
+    void flush()
     {
-        os2 << '-';
-        size_t cw = col_widths[i];
-        for (size_t i = 0; i < cw; ++i)
-            os2 << '-';
-        os2 << "-+";
+        m_os.write(m_buf.data(), m_buf.size());
+        m_buf.clear();
     }
 
-    string sep = os2.str();
+    void put(char c)
+    {
+        m_buf += c;
+    }
 
-    // Now print to stdout.
-    os << sep << endl;
-    for (size_t r = 0; r < row_count; ++r)
+    void end_row()
     {
-        os << "|";
-        for (size_t c = 0; c < col_count; ++c)
+        m_buf += '\n';
+        if (m_buf.size() >= flush_threshold)
+            flush();
+    }
+
+    void write_number(double val)
+    {
+        char tmp[32];
+        char* p = format_number_shortest(tmp, tmp + sizeof(tmp), val);
+        m_buf.append(tmp, p);
+    }
+
+    /**
+     * Write a field value, quoting it when it contains a separator, a
+     * quote or a line break, and doubling any quotes within it.
+     */
+    void write_text(const char* p, size_t n)
+    {
+        const char* p_end = p + n;
+        bool quote = false;
+        for (const char* p2 = p; p2 != p_end; ++p2)
         {
-            size_t cw = col_widths[c]; // column width
-            if (mx.get_type(r, c) == mdds::mtm::element_empty)
+            char c = *p2;
+            if (c == ',' || c == '"' || c == '\n' || c == '\r')
             {
-                for (size_t i = 0; i < cw; ++i)
-                    os << ' ';
-                os << "  |";
-            }
-            else
-            {
-                const string s = mx.get_string(r, c);
-                os << ' ' << s;
-                cw -= s.size();
-                for (size_t i = 0; i < cw; ++i)
-                    os << ' ';
-                os << " |";
+                quote = true;
+                break;
             }
         }
-        os << endl;
-        os << sep << endl;
-    }
-}
 
-namespace {
+        if (!quote)
+        {
+            m_buf.append(p, n);
+            return;
+        }
 
-void write_cell_position(ostream& os, const pstring& sheet_name, row_t row, col_t col)
-{
-    os << sheet_name << '/' << row << '/' << col << ':';
-}
+        m_buf += '"';
+        const char* p_head = p;
+        for (; p != p_end; ++p)
+        {
+            if (*p != '"')
+                continue;
 
-string escape_chars(const string& str)
-{
-    if (str.empty())
-        return str;
+            m_buf.append(p_head, p + 1);
+            m_buf += '"';
+            p_head = p + 1;
+        }
+        m_buf.append(p_head, p_end);
+        m_buf += '"';
+    }
 
-    string ret;
-    const char* p = &str[0];
-    const char* p_end = p + str.size();
-    for (; p != p_end; ++p)
+    void write_text(const std::string& s)
     {
-        if (*p == '"')
-            ret.push_back('\\');
-        ret.push_back(*p);
+        write_text(s.data(), s.size());
     }
-    return ret;
-}
+};
 
 }
 
-void sheet::dump_check(ostream& os, const pstring& sheet_name) const
+void sheet::dump_csv(std::ostream& os) const
 {
     const ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
     ixion::abs_range_t range = cxt.get_data_range(mp_impl->m_sheet);
     if (!range.valid())
-        // Sheet is empty.  Nothing to print.
+        // Sheet is empty.  Nothing to write.
         return;
 
-    const ixion::formula_name_resolver* resolver = mp_impl->m_doc.get_formula_name_resolver();
+    row_t row_count = range.last.row + 1;
+    col_t col_count = range.last.column + 1;
 
-    size_t row_count = range.last.row + 1;
-    size_t col_count = range.last.column + 1;
+    csv_writer writer(os);
+    sheet_cell_iterator it = begin_cells(cell_order_t::row_major), it_end = end_cells();
 
-    for (size_t row = 0; row < row_count; ++row)
+    for (row_t row = 0; row < row_count; ++row)
     {
-        for (size_t col = 0; col < col_count; ++col)
+        col_t col = 0;
+        for (; it != it_end && it->row == row; ++it)
         {
-            ixion::abs_address_t pos(mp_impl->m_sheet, row, col);
-            switch (cxt.get_celltype(pos))
+            // Separators for the empty cells preceding this one.
+            for (; col < it->col; ++col)
+                writer.put(',');
+
+            const sheet_cell_t& cell = *it;
+            switch (cell.type)
             {
                 case ixion::celltype_t::string:
                 {
-                    write_cell_position(os, sheet_name, row, col);
-                    size_t sindex = cxt.get_string_identifier(pos);
-                    const string* p = cxt.get_string(sindex);
+                    const string* p = cxt.get_string(cell.string_id);
                     assert(p);
-                    os << "string:\"" << escape_chars(*p) << '"' << endl;
+                    writer.write_text(*p);
                 }
                 break;
                 case ixion::celltype_t::numeric:
                 {
-                    write_cell_position(os, sheet_name, row, col);
-                    os << "numeric:" << cxt.get_numeric_value(pos) << endl;
+                    if (is_date_time(cell.row, cell.col))
+                    {
+                        ostringstream os_dt;
+                        write_date_time(os_dt, get_date_time(cell.row, cell.col));
+                        writer.write_text(os_dt.str());
+                    }
+                    else
+                        writer.write_number(cell.numeric);
                 }
                 break;
                 case ixion::celltype_t::formula:
                 {
-                    write_cell_position(os, sheet_name, row, col);
-                    os << "formula";
-
-                    // print the formula and the formula result.
-                    const ixion::formula_cell* cell = cxt.get_formula_cell(pos);
-                    assert(cell);
-                    size_t index = cell->get_identifier();
-                    const ixion::formula_tokens_t* t = NULL;
-                    if (cell->is_shared())
-                        t = cxt.get_shared_formula_tokens(mp_impl->m_sheet, index);
-                    else
-                        t = cxt.get_formula_tokens(mp_impl->m_sheet, index);
+                    // Write the cached formula result.
+                    const ixion::formula_result* res = cell.formula->get_result_cache();
+                    if (!res)
+                        break;
 
-                    if (t)
+                    switch (res->get_type())
                     {
-                        string formula;
-                        if (resolver)
+                        case ixion::formula_result::result_type::value:
+                            writer.write_number(res->get_value());
+                        break;
+                        case ixion::formula_result::result_type::string:
                         {
-                            ixion::print_formula_tokens(
-                                mp_impl->m_doc.get_model_context(), pos, *resolver, *t, formula);
+                            const string* p = cxt.get_string(res->get_string());
+                            if (p)
+                                writer.write_text(*p);
                         }
-                        else
-                            formula = "???";
-
-                        os << ':' << formula;
-
-                        const ixion::formula_result* res = cell->get_result_cache();
-                        if (res)
-                            os << ':' << res->str(mp_impl->m_doc.get_model_context());
+                        break;
+                        default:
+                            writer.write_text(res->str(cxt));
                     }
-                    os << endl;
                 }
                 break;
                 default:
                     ;
             }
         }
+
+        // Pad the row to the full width of the data range.
+        for (++col; col < col_count; ++col)
+            writer.put(',');
+
+        writer.end_row();
     }
 }
 
@@ -987,17 +1856,18 @@ private:
     const char* m_name;
 };
 
-void print_formatted_text(ostream& strm, const string& text, const format_runs_t& formats)
+void print_formatted_text(ostream& strm, const string& text, const format_runs_span& formats)
 {
     typedef html_elem elem;
 
     const char* p_span = "span";
 
     size_t pos = 0;
-    format_runs_t::const_iterator itr = formats.begin(), itr_end = formats.end();
+    format_runs_span::const_iterator itr = formats.begin(), itr_end = formats.end();
     for (; itr != itr_end; ++itr)
     {
         const format_run& run = *itr;
+        const format_run_attrs& attrs = *run.attrs;
         if (pos < run.pos)
         {
             // flush unformatted text.
@@ -1009,27 +1879,27 @@ void print_formatted_text(ostream& strm, const string& text, const format_runs_t
             continue;
 
         string style = "";
-        if (run.bold)
+        if (attrs.bold)
             style += "font-weight: bold;";
         else
             style += "font-weight: normal;";
 
-        if (run.italic)
+        if (attrs.italic)
             style += "font-style: italic;";
         else
             style += "font-style: normal;";
 
-        if (!run.font.empty())
-            style += "font-family: " + run.font.str() + ";";
+        if (!attrs.font.empty())
+            style += "font-family: " + attrs.font.str() + ";";
 
-        if (run.font_size)
+        if (attrs.font_size)
         {
             ostringstream os;
-            os << "font-size: " << run.font_size << "pt;";
+            os << "font-size: " << attrs.font_size << "pt;";
             style += os.str();
         }
 
-        const color_t& col = run.color;
+        const color_t& col = attrs.color;
         if (col.red || col.green || col.blue)
         {
             ostringstream os;
@@ -1294,13 +2164,14 @@ void sheet::dump_html(const string& filepath) const
             // Sheet is empty.  Nothing to print.
             return;
 
-        const ixion::formula_name_resolver* resolver = mp_impl->m_doc.get_formula_name_resolver();
         const import_shared_strings* sstrings = mp_impl->m_doc.get_shared_strings();
 
         elem table(file, p_table);
 
         row_t row_count = range.last.row + 1;
         col_t col_count = range.last.column + 1;
+        sheet_cell_iterator it_cell = begin_cells(cell_order_t::row_major), it_cell_end = end_cells();
+        string buf;
         for (row_t row = 0; row < row_count; ++row)
         {
             // Set the row height.
@@ -1324,22 +2195,17 @@ void sheet::dump_html(const string& filepath) const
                 style_str = row_style.c_str();
             elem tr(file, p_tr, style_str);
 
-            const overlapped_col_index_type* p_overlapped = mp_impl->get_overlapped_ranges(row);
-
             for (col_t col = 0; col < col_count; ++col)
             {
-                ixion::abs_address_t pos(mp_impl->m_sheet,row,col);
-
                 const merge_size* p_merge_size = mp_impl->get_merge_size(row, col);
-                if (!p_merge_size && p_overlapped)
+                if (!p_merge_size)
                 {
                     // Check if this cell is overlapped by a merged cell.
-                    bool overlapped = false;
-                    col_t last_col;
-                    if (p_overlapped->search_tree(col, overlapped, NULL, &last_col).second && overlapped)
+                    const cell_rect_t* p_merged = mp_impl->get_merge_range(row, col);
+                    if (p_merged)
                     {
                         // Skip all overlapped cells on this row.
-                        col = last_col - 1;
+                        col = p_merged->last_col;
                         continue;
                     }
                 }
@@ -1372,7 +2238,15 @@ void sheet::dump_html(const string& filepath) const
                         build_style_string(style, *p_styles, *fmt);
                 }
 
-                ixion::celltype_t ct = cxt.get_celltype(pos);
+                // Move the cell iterator up to the current position.
+                while (it_cell != it_cell_end &&
+                       (it_cell->row < row || (it_cell->row == row && it_cell->col < col)))
+                    ++it_cell;
+
+                ixion::celltype_t ct = ixion::celltype_t::empty;
+                if (it_cell != it_cell_end && it_cell->row == row && it_cell->col == col)
+                    ct = it_cell->type;
+
                 if (ct == ixion::celltype_t::empty)
                 {
                     html_elem::attrs_type attrs;
@@ -1387,60 +2261,42 @@ void sheet::dump_html(const string& filepath) const
                 build_html_elem_attributes(attrs, style, p_merge_size);
                 elem td(file, p_td, attrs);
 
-                ostringstream os;
                 switch (ct)
                 {
                     case ixion::celltype_t::string:
                     {
-                        size_t sindex = cxt.get_string_identifier(pos);
+                        size_t sindex = it_cell->string_id;
                         const string* p = cxt.get_string(sindex);
                         assert(p);
-                        const format_runs_t* pformat = sstrings->get_format_runs(sindex);
-                        if (pformat)
-                            print_formatted_text(os, *p, *pformat);
+                        format_runs_span formats = sstrings->get_format_runs(sindex);
+                        if (!formats.empty())
+                            print_formatted_text(file, *p, formats);
                         else
-                            os << *p;
+                            file << *p;
                     }
                     break;
                     case ixion::celltype_t::numeric:
-                        os << cxt.get_numeric_value(pos);
+                        if (is_date_time(row, col))
+                            write_date_time(file, get_date_time(row, col));
+                        else
+                            write_number(file, it_cell->numeric);
                     break;
                     case ixion::celltype_t::formula:
                     {
                         // print the formula and the formula result.
-                        const ixion::formula_cell* cell = cxt.get_formula_cell(pos);
-                        assert(cell);
-                        size_t index = cell->get_identifier();
-                        const ixion::formula_tokens_t* t = NULL;
-                        if (cell->is_shared())
-                            t = cxt.get_shared_formula_tokens(mp_impl->m_sheet, index);
-                        else
-                            t = cxt.get_formula_tokens(mp_impl->m_sheet, index);
-
-                        if (t)
+                        buf.clear();
+                        if (mp_impl->append_formula(buf, *it_cell) && it_cell->formula->get_result_cache())
                         {
-                            string formula;
-                            if (resolver)
-                            {
-                                ixion::print_formula_tokens(
-                                    mp_impl->m_doc.get_model_context(), pos, *resolver, *t, formula);
-                            }
-                            else
-                                formula = "???";
-
-                            os << formula;
-
-                            const ixion::formula_result* res = cell->get_result_cache();
-                            if (res)
-                                os << " (" << res->str(mp_impl->m_doc.get_model_context()) << ")";
+                            buf += " (";
+                            mp_impl->append_formula_result(buf, *it_cell);
+                            buf += ")";
                         }
+                        file << buf;
                     }
                     break;
                     default:
                         ;
                 }
-
-                file << os.str();
             }
         }
     }
@@ -1448,6 +2304,9 @@ void sheet::dump_html(const string& filepath) const
 
 size_t sheet::get_cell_format(row_t row, col_t col) const
 {
+    if (mp_impl->m_compacted)
+        return find_segment_value<size_t>(mp_impl->m_compact_cell_formats, row, col, 0);
+
     cell_format_type::const_iterator itr = mp_impl->m_cell_formats.find(col);
     if (itr == mp_impl->m_cell_formats.end())
         return 0;
@@ -1463,6 +2322,427 @@ size_t sheet::get_cell_format(row_t row, col_t col) const
     return index;
 }
 
+bool sheet::is_date_time(row_t row, col_t col) const
+{
+    if (mp_impl->m_compacted)
+        return find_segment_value<bool>(mp_impl->m_compact_date_time_cells, row, col, false);
+
+    date_time_cells_type::const_iterator itr = mp_impl->m_date_time_cells.find(col);
+    if (itr == mp_impl->m_date_time_cells.end())
+        return false;
+
+    date_time_row_index_type& con = *itr->second;
+    if (!con.is_tree_valid())
+        con.build_tree();
+
+    bool ret = false;
+    if (!con.search_tree(row, ret).second)
+        return false;
+
+    return ret;
+}
+
+date_time_t sheet::get_date_time(row_t row, col_t col) const
+{
+    const ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
+    double serial = cxt.get_numeric_value(ixion::abs_address_t(mp_impl->m_sheet, row, col));
+
+    // Split the serial value into whole days and the time of day, rounded
+    // to the nearest microsecond to absorb the representation error.
+    double days = std::floor(serial);
+    double usec = std::floor((serial - days) * 86400000000.0 + 0.5);
+    if (usec >= 86400000000.0)
+    {
+        days += 1.0;
+        usec = 0.0;
+    }
+
+    date_time_t origin = mp_impl->m_doc.get_origin_date();
+    long z = days_from_civil(origin.year, origin.month, origin.day) + static_cast<long>(days);
+
+    date_time_t ret;
+    civil_from_days(z, ret.year, ret.month, ret.day);
+
+    long secs = static_cast<long>(usec / 1000000.0);
+    ret.hour = static_cast<int>(secs / 3600);
+    ret.minute = static_cast<int>((secs % 3600) / 60);
+    ret.second = (secs % 60) + (usec - secs * 1000000.0) / 1000000.0;
+    return ret;
+}
+
+void sheet::remap_cell_formats(const std::vector<size_t>& xf_map)
+{
+    if (mp_impl->m_compacted)
+        throw general_error("sheet::remap_cell_formats: sheet has been compacted.");
+
+    cell_format_type::iterator itr = mp_impl->m_cell_formats.begin(), itr_end = mp_impl->m_cell_formats.end();
+    for (; itr != itr_end; ++itr)
+    {
+        const segment_row_index_type& con = *itr->second;
+        std::unique_ptr<segment_row_index_type> p(
+            new segment_row_index_type(con.min_key(), con.max_key(), con.default_value()));
+
+        // Each node marks the start of a segment, and the last node marks
+        // the end of the last segment.
+        segment_row_index_type::const_iterator it = con.begin(), it_end = con.end();
+        row_t start = it->first;
+        size_t index = it->second;
+        for (++it; it != it_end; ++it)
+        {
+            if (index < xf_map.size())
+                index = xf_map[index];
+
+            p->insert_back(start, it->first, index);
+            start = it->first;
+            index = it->second;
+        }
+
+        delete itr->second;
+        itr->second = p.release();
+    }
+}
+
+namespace {
+
+/**
+ * Types of the cell blocks stored in a document snapshot.
+ */
+enum class snapshot_block_t : uint32_t
+{
+    numeric = 1,
+    string  = 2,
+    boolean = 3,
+    formula = 4
+};
+
+bool to_snapshot_block_type(mdds::mtv::element_t type, snapshot_block_t& block_type)
+{
+    switch (type)
+    {
+        case mdds::mtv::element_type_numeric:
+            block_type = snapshot_block_t::numeric;
+        break;
+        case mdds::mtv::element_type_ulong:
+            block_type = snapshot_block_t::string;
+        break;
+        case mdds::mtv::element_type_boolean:
+            block_type = snapshot_block_t::boolean;
+        break;
+        case ixion::element_type_formula:
+            block_type = snapshot_block_t::formula;
+        break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Write the nodes of a segment tree as an array of keys followed by an
+ * array of values.  Each node starts a segment that ends at the next one.
+ */
+template<typename _TreeT>
+void write_segments(snapshot_writer& writer, const _TreeT& tree)
+{
+    std::vector<int64_t> keys;
+    std::vector<uint64_t> values;
+    typename _TreeT::const_iterator it = tree.begin(), it_end = tree.end();
+    for (; it != it_end; ++it)
+    {
+        keys.push_back(it->first);
+        values.push_back(it->second);
+    }
+
+    writer.write_array(keys);
+    writer.write_array(values);
+}
+
+template<typename _TreeT>
+void read_segments(snapshot_reader& reader, _TreeT& tree)
+{
+    typedef typename _TreeT::key_type key_type;
+    typedef typename _TreeT::value_type value_type;
+
+    size_t n_keys = 0, n_values = 0;
+    const int64_t* keys = reader.read_array<int64_t>(n_keys);
+    const uint64_t* values = reader.read_array<uint64_t>(n_values);
+    if (n_keys != n_values)
+        throw general_error("sheet::read_snapshot: segment keys and values don't match.");
+
+    for (size_t i = 0; i + 1 < n_keys; ++i)
+    {
+        tree.insert_back(
+            static_cast<key_type>(keys[i]), static_cast<key_type>(keys[i+1]),
+            static_cast<value_type>(values[i]));
+    }
+}
+
+/**
+ * Write a map of per-column segment trees, ordered by column.
+ */
+template<typename _MapT>
+void write_segment_map(snapshot_writer& writer, const _MapT& store)
+{
+    std::vector<col_t> cols;
+    typename _MapT::const_iterator it = store.begin(), it_end = store.end();
+    for (; it != it_end; ++it)
+        cols.push_back(it->first);
+
+    std::sort(cols.begin(), cols.end());
+
+    writer.write_u64(cols.size());
+    for (size_t i = 0; i < cols.size(); ++i)
+    {
+        writer.write_i32(cols[i]);
+        write_segments(writer, *store.find(cols[i])->second);
+    }
+}
+
+template<typename _ValueT>
+void write_segment_map(snapshot_writer& writer, const std::vector<column_segments<_ValueT>>& store)
+{
+    writer.write_u64(store.size());
+    for (size_t i = 0; i < store.size(); ++i)
+    {
+        writer.write_i32(store[i].col);
+        write_segments(writer, store[i].segments);
+    }
+}
+
+template<typename _MapT>
+void read_segment_map(snapshot_reader& reader, row_t row_size, _MapT& store)
+{
+    typedef typename std::remove_pointer<typename _MapT::mapped_type>::type tree_type;
+
+    for (uint64_t i = 0, n = reader.read_u64(); i < n; ++i)
+    {
+        col_t col = reader.read_i32();
+        std::unique_ptr<tree_type> p(new tree_type(0, row_size+1, typename tree_type::value_type()));
+        read_segments(reader, *p);
+
+        if (!store.insert(typename _MapT::value_type(col, p.get())).second)
+            throw general_error("sheet::read_snapshot: duplicate column.");
+
+        p.release();
+    }
+}
+
+}
+
+void sheet::write_snapshot(snapshot_writer& writer) const
+{
+    const ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
+    const ixion::column_stores_t* stores = cxt.get_columns(mp_impl->m_sheet);
+    size_t col_count = stores ? stores->size() : 0;
+
+    // Cell values, as runs of same-typed cells within each column.
+    writer.write_u64(col_count);
+    string buf;
+    for (size_t col = 0; col < col_count; ++col)
+    {
+        const ixion::column_store_t& store = *(*stores)[col];
+        snapshot_block_t block_type;
+
+        size_t block_count = 0;
+        ixion::column_store_t::const_iterator it = store.begin(), it_end = store.end();
+        for (; it != it_end; ++it)
+        {
+            if (to_snapshot_block_type(it->type, block_type))
+                ++block_count;
+        }
+
+        writer.write_u64(block_count);
+        for (it = store.begin(); it != it_end; ++it)
+        {
+            if (!to_snapshot_block_type(it->type, block_type))
+                continue;
+
+            writer.write_u32(static_cast<uint32_t>(block_type));
+            writer.write_i32(static_cast<row_t>(it->position));
+
+            switch (block_type)
+            {
+                case snapshot_block_t::numeric:
+                    writer.write_array(&*mdds::mtv::numeric_element_block::begin(*it->data), it->size);
+                break;
+                case snapshot_block_t::string:
+                {
+                    std::vector<uint64_t> ids(
+                        mdds::mtv::ulong_element_block::begin(*it->data),
+                        mdds::mtv::ulong_element_block::end(*it->data));
+                    writer.write_array(ids);
+                }
+                break;
+                case snapshot_block_t::boolean:
+                {
+                    std::vector<uint8_t> values(
+                        mdds::mtv::boolean_element_block::begin(*it->data),
+                        mdds::mtv::boolean_element_block::end(*it->data));
+                    writer.write_array(values);
+                }
+                break;
+                case snapshot_block_t::formula:
+                {
+                    // Formula tokens refer to run-time objects, so formulas
+                    // are stored as expressions and compiled again on load.
+                    writer.write_u64(it->size);
+                    sheet_cell_t cell;
+                    cell.col = static_cast<col_t>(col);
+                    cell.type = ixion::celltype_t::formula;
+                    ixion::formula_element_block::const_iterator it_cell =
+                        ixion::formula_element_block::begin(*it->data);
+                    for (size_t i = 0; i < it->size; ++i, ++it_cell)
+                    {
+                        cell.row = static_cast<row_t>(it->position + i);
+                        cell.formula = *it_cell;
+                        buf.clear();
+                        if (!mp_impl->append_formula(buf, cell) || buf.empty())
+                        {
+                            // It could not be compiled again on load.
+                            ostringstream os;
+                            os << "sheet::write_snapshot: formula cell at (row=" << cell.row
+                                << ", column=" << cell.col << ") has no expression.";
+                            throw general_error(os.str());
+                        }
+
+                        writer.write_string(buf);
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    // Sheet properties.
+    write_segments(writer, mp_impl->m_col_widths);
+    write_segments(writer, mp_impl->m_row_heights);
+    write_segments(writer, mp_impl->m_col_hidden);
+    write_segments(writer, mp_impl->m_row_hidden);
+
+    std::vector<int32_t> merges;
+    merges.reserve(mp_impl->m_merge_ranges.size() * 4);
+    merge_range_index_type::const_iterator it = mp_impl->m_merge_ranges.begin(), it_end = mp_impl->m_merge_ranges.end();
+    for (; it != it_end; ++it)
+    {
+        merges.push_back(it->range.first_row);
+        merges.push_back(it->range.first_col);
+        merges.push_back(it->range.last_row);
+        merges.push_back(it->range.last_col);
+    }
+    writer.write_array(merges);
+
+    if (mp_impl->m_compacted)
+    {
+        write_segment_map(writer, mp_impl->m_compact_cell_formats);
+        write_segment_map(writer, mp_impl->m_compact_date_time_cells);
+    }
+    else
+    {
+        write_segment_map(writer, mp_impl->m_cell_formats);
+        write_segment_map(writer, mp_impl->m_date_time_cells);
+    }
+}
+
+void sheet::read_snapshot(snapshot_reader& reader)
+{
+    ixion::model_context& cxt = mp_impl->m_doc.get_model_context();
+    formula_grammar_t grammar = mp_impl->m_doc.get_formula_grammar();
+    const sheet_t sheet_index = mp_impl->m_sheet;
+
+    uint64_t col_count = reader.read_u64();
+    if (col_count > static_cast<uint64_t>(mp_impl->m_col_size))
+        throw general_error("sheet::read_snapshot: too many columns.");
+
+    for (col_t col = 0; col < static_cast<col_t>(col_count); ++col)
+    {
+        for (uint64_t i = 0, block_count = reader.read_u64(); i < block_count; ++i)
+        {
+            uint32_t block_type = reader.read_u32();
+            row_t row = reader.read_i32();
+            size_t n = 0;
+
+            switch (static_cast<snapshot_block_t>(block_type))
+            {
+                case snapshot_block_t::numeric:
+                {
+                    const double* p = reader.read_array<double>(n);
+                    if (row < 0 || n > static_cast<size_t>(mp_impl->m_row_size - row))
+                        throw general_error("sheet::read_snapshot: cell block out of range.");
+
+                    for (size_t j = 0; j < n; ++j)
+                        cxt.set_numeric_cell(ixion::abs_address_t(sheet_index, row+j, col), p[j]);
+                }
+                break;
+                case snapshot_block_t::string:
+                {
+                    const uint64_t* p = reader.read_array<uint64_t>(n);
+                    if (row < 0 || n > static_cast<size_t>(mp_impl->m_row_size - row))
+                        throw general_error("sheet::read_snapshot: cell block out of range.");
+
+                    for (size_t j = 0; j < n; ++j)
+                        cxt.set_string_cell(ixion::abs_address_t(sheet_index, row+j, col), p[j]);
+                }
+                break;
+                case snapshot_block_t::boolean:
+                {
+                    const uint8_t* p = reader.read_array<uint8_t>(n);
+                    if (row < 0 || n > static_cast<size_t>(mp_impl->m_row_size - row))
+                        throw general_error("sheet::read_snapshot: cell block out of range.");
+
+                    for (size_t j = 0; j < n; ++j)
+                        cxt.set_boolean_cell(ixion::abs_address_t(sheet_index, row+j, col), p[j] != 0);
+                }
+                break;
+                case snapshot_block_t::formula:
+                {
+                    n = reader.read_u64();
+                    if (row < 0 || n > static_cast<size_t>(mp_impl->m_row_size - row))
+                        throw general_error("sheet::read_snapshot: cell block out of range.");
+
+                    for (size_t j = 0; j < n; ++j)
+                    {
+                        pstring expr = reader.read_string();
+                        if (expr.empty())
+                            throw general_error("sheet::read_snapshot: formula cell without expression.");
+
+                        set_formula(row+j, col, grammar, expr.get(), expr.size());
+                    }
+                }
+                break;
+                default:
+                    throw general_error("sheet::read_snapshot: unknown cell block type.");
+            }
+        }
+    }
+
+    read_segments(reader, mp_impl->m_col_widths);
+    read_segments(reader, mp_impl->m_row_heights);
+    read_segments(reader, mp_impl->m_col_hidden);
+    read_segments(reader, mp_impl->m_row_hidden);
+
+    // The insertion hints may point to nodes that no longer exist.
+    mp_impl->m_col_width_pos = mp_impl->m_col_widths.begin();
+    mp_impl->m_row_height_pos = mp_impl->m_row_heights.begin();
+    mp_impl->m_col_hidden_pos = mp_impl->m_col_hidden.begin();
+    mp_impl->m_row_hidden_pos = mp_impl->m_row_hidden.begin();
+
+    size_t n = 0;
+    const int32_t* merges = reader.read_array<int32_t>(n);
+    if (n % 4)
+        throw general_error("sheet::read_snapshot: invalid merged cell ranges.");
+
+    for (size_t i = 0; i < n; i += 4)
+    {
+        cell_rect_t range(merges[i], merges[i+1], merges[i+2], merges[i+3]);
+        merge_size sz(range.last_col-range.first_col+1, range.last_row-range.first_row+1);
+        mp_impl->m_merge_ranges.insert(range, sz);
+    }
+
+    read_segment_map(reader, mp_impl->m_row_size, mp_impl->m_cell_formats);
+    read_segment_map(reader, mp_impl->m_row_size, mp_impl->m_date_time_cells);
+}
+
 }}
 
 /* vim:set shiftwidth=4 softtabstop=4 expandtab: */
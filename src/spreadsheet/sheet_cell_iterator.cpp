@@ -0,0 +1,301 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "orcus/spreadsheet/sheet_cell_iterator.hpp"
+
+#include <ixion/model_context.hpp>
+#include <ixion/column_store_type.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+namespace orcus { namespace spreadsheet {
+
+namespace {
+
+/**
+ * Position of the next non-empty cell within a single column store.
+ */
+struct column_cursor
+{
+    ixion::column_store_t::const_iterator it_block;
+    ixion::column_store_t::const_iterator it_block_end;
+    size_t offset; /// position within the current block.
+
+    column_cursor(const ixion::column_store_t& store) :
+        it_block(store.begin()), it_block_end(store.end()), offset(0)
+    {
+        skip_empty_blocks();
+    }
+
+    bool valid() const { return it_block != it_block_end; }
+
+    row_t row() const { return static_cast<row_t>(it_block->position + offset); }
+
+    void skip_empty_blocks()
+    {
+        while (it_block != it_block_end && it_block->type == mdds::mtv::element_type_empty)
+            ++it_block;
+    }
+
+    void next()
+    {
+        ++offset;
+        if (offset < it_block->size)
+            return;
+
+        ++it_block;
+        offset = 0;
+        skip_empty_blocks();
+    }
+
+    void get_cell(sheet_cell_t& cell) const
+    {
+        cell.row = row();
+
+        switch (it_block->type)
+        {
+            case mdds::mtv::element_type_numeric:
+                cell.type = ixion::celltype_t::numeric;
+                cell.numeric = mdds::mtv::numeric_element_block::at(*it_block->data, offset);
+            break;
+            case mdds::mtv::element_type_ulong:
+                cell.type = ixion::celltype_t::string;
+                cell.string_id = mdds::mtv::ulong_element_block::at(*it_block->data, offset);
+            break;
+            case ixion::element_type_formula:
+                cell.type = ixion::celltype_t::formula;
+                cell.formula = ixion::formula_element_block::at(*it_block->data, offset);
+            break;
+            default:
+                cell.type = ixion::celltype_t::unknown;
+                cell.formula = NULL;
+        }
+    }
+};
+
+typedef std::vector<column_cursor> column_cursors_type;
+
+/**
+ * Heap ordering that puts the column whose next cell comes first in
+ * row-major order at the top.
+ */
+class row_major_greater
+{
+    const column_cursors_type& m_cursors;
+public:
+    row_major_greater(const column_cursors_type& cursors) : m_cursors(cursors) {}
+
+    bool operator() (col_t left, col_t right) const
+    {
+        row_t row_left = m_cursors[left].row(), row_right = m_cursors[right].row();
+        if (row_left != row_right)
+            return row_left > row_right;
+
+        return left > right;
+    }
+};
+
+}
+
+struct sheet_cell_iterator_impl
+{
+    cell_order_t m_order;
+    column_cursors_type m_cursors;
+
+    /**
+     * Column-major: the current column.  Row-major: heap of columns that
+     * still have cells left, ordered by row_major_greater.
+     */
+    std::vector<col_t> m_columns;
+
+    sheet_cell_t m_cell;
+    bool m_end;
+
+    sheet_cell_iterator_impl(const ixion::model_context& cxt, sheet_t sheet, cell_order_t order) :
+        m_order(order), m_end(false)
+    {
+        const ixion::column_stores_t* stores = cxt.get_columns(sheet);
+        if (stores)
+        {
+            m_cursors.reserve(stores->size());
+            for (size_t i = 0, n = stores->size(); i < n; ++i)
+                m_cursors.push_back(column_cursor(*(*stores)[i]));
+        }
+
+        if (m_order == cell_order_t::row_major)
+        {
+            for (size_t i = 0, n = m_cursors.size(); i < n; ++i)
+            {
+                if (m_cursors[i].valid())
+                    m_columns.push_back(static_cast<col_t>(i));
+            }
+
+            std::make_heap(m_columns.begin(), m_columns.end(), row_major_greater(m_cursors));
+        }
+        else
+        {
+            m_columns.push_back(0);
+            skip_empty_columns();
+        }
+
+        update_cell();
+    }
+
+    col_t current_column() const
+    {
+        return m_order == cell_order_t::row_major ? m_columns.front() : m_columns.back();
+    }
+
+    bool has_cell() const
+    {
+        if (m_order == cell_order_t::row_major)
+            return !m_columns.empty();
+
+        return static_cast<size_t>(m_columns.back()) < m_cursors.size();
+    }
+
+    void skip_empty_columns()
+    {
+        col_t& col = m_columns.back();
+        while (static_cast<size_t>(col) < m_cursors.size() && !m_cursors[col].valid())
+            ++col;
+    }
+
+    void update_cell()
+    {
+        if (!has_cell())
+        {
+            m_end = true;
+            return;
+        }
+
+        col_t col = current_column();
+        m_cell.col = col;
+        m_cursors[col].get_cell(m_cell);
+    }
+
+    void next()
+    {
+        assert(!m_end);
+
+        if (m_order == cell_order_t::row_major)
+        {
+            row_major_greater comp(m_cursors);
+            std::pop_heap(m_columns.begin(), m_columns.end(), comp);
+            col_t col = m_columns.back();
+            m_cursors[col].next();
+            if (m_cursors[col].valid())
+                std::push_heap(m_columns.begin(), m_columns.end(), comp);
+            else
+                m_columns.pop_back();
+        }
+        else
+        {
+            col_t col = m_columns.back();
+            m_cursors[col].next();
+            if (!m_cursors[col].valid())
+            {
+                ++m_columns.back();
+                skip_empty_columns();
+            }
+        }
+
+        update_cell();
+    }
+};
+
+sheet_cell_t::sheet_cell_t() :
+    row(0), col(0), type(ixion::celltype_t::unknown), formula(NULL) {}
+
+sheet_cell_iterator::sheet_cell_iterator() : mp_impl(NULL) {}
+
+sheet_cell_iterator::sheet_cell_iterator(const ixion::model_context& cxt, sheet_t sheet, cell_order_t order) :
+    mp_impl(new sheet_cell_iterator_impl(cxt, sheet, order))
+{
+    if (mp_impl->m_end)
+    {
+        // Nothing to iterate over.
+        delete mp_impl;
+        mp_impl = NULL;
+    }
+}
+
+sheet_cell_iterator::sheet_cell_iterator(const sheet_cell_iterator& other) :
+    mp_impl(other.mp_impl ? new sheet_cell_iterator_impl(*other.mp_impl) : NULL) {}
+
+sheet_cell_iterator::~sheet_cell_iterator()
+{
+    delete mp_impl;
+}
+
+sheet_cell_iterator& sheet_cell_iterator::operator= (const sheet_cell_iterator& other)
+{
+    if (this == &other)
+        return *this;
+
+    sheet_cell_iterator tmp(other);
+    std::swap(mp_impl, tmp.mp_impl);
+    return *this;
+}
+
+bool sheet_cell_iterator::operator== (const sheet_cell_iterator& other) const
+{
+    if (!mp_impl || !other.mp_impl)
+        return mp_impl == other.mp_impl;
+
+    return mp_impl->m_cell.row == other.mp_impl->m_cell.row &&
+        mp_impl->m_cell.col == other.mp_impl->m_cell.col &&
+        mp_impl->m_order == other.mp_impl->m_order;
+}
+
+bool sheet_cell_iterator::operator!= (const sheet_cell_iterator& other) const
+{
+    return !operator==(other);
+}
+
+const sheet_cell_t& sheet_cell_iterator::operator* () const
+{
+    assert(mp_impl);
+    return mp_impl->m_cell;
+}
+
+const sheet_cell_t* sheet_cell_iterator::operator-> () const
+{
+    assert(mp_impl);
+    return &mp_impl->m_cell;
+}
+
+sheet_cell_iterator& sheet_cell_iterator::operator++ ()
+{
+    assert(mp_impl);
+    mp_impl->next();
+    if (mp_impl->m_end)
+    {
+        delete mp_impl;
+        mp_impl = NULL;
+    }
+
+    return *this;
+}
+
+sheet_cell_iterator sheet_cell_iterator::operator++ (int)
+{
+    sheet_cell_iterator ret(*this);
+    ++(*this);
+    return ret;
+}
+
+bool sheet_cell_iterator::at_end() const
+{
+    return mp_impl == NULL;
+}
+
+}}
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
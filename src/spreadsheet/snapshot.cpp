@@ -0,0 +1,257 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "snapshot.hpp"
+
+#include <cassert>
+
+namespace orcus { namespace spreadsheet {
+
+namespace {
+
+const char snapshot_magic[8] = { 'O', 'R', 'C', 'U', 'S', 'S', 'N', 'P' };
+const uint32_t snapshot_version = 1;
+const uint32_t snapshot_byte_order = 0x01020304;
+
+/**
+ * Fixed-size header at the start of every snapshot.  It is followed by
+ * section_count directory entries.
+ */
+struct snapshot_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t section_count;
+    uint32_t reserved;
+};
+
+struct snapshot_dir_entry
+{
+    uint32_t id;
+    uint32_t reserved;
+    uint64_t offset; /// offset of the section body from the start of the file.
+    uint64_t size;
+};
+
+const size_t snapshot_alignment = 8;
+
+size_t padding_size(size_t pos)
+{
+    return (snapshot_alignment - pos % snapshot_alignment) % snapshot_alignment;
+}
+
+}
+
+snapshot_writer::snapshot_writer() {}
+
+void snapshot_writer::align()
+{
+    m_buf.append(padding_size(m_buf.size()), '\0');
+}
+
+void snapshot_writer::write_bytes(const void* p, size_t n)
+{
+    m_buf.append(static_cast<const char*>(p), n);
+}
+
+void snapshot_writer::begin_section(snapshot_section_t id)
+{
+    align();
+    section sec;
+    sec.id = id;
+    sec.offset = m_buf.size();
+    sec.size = 0;
+    m_sections.push_back(sec);
+}
+
+void snapshot_writer::end_section()
+{
+    assert(!m_sections.empty());
+    section& sec = m_sections.back();
+    sec.size = m_buf.size() - sec.offset;
+}
+
+void snapshot_writer::write_u8(uint8_t v)
+{
+    m_buf.push_back(static_cast<char>(v));
+}
+
+void snapshot_writer::write_u32(uint32_t v)
+{
+    write_bytes(&v, sizeof(v));
+}
+
+void snapshot_writer::write_i32(int32_t v)
+{
+    write_bytes(&v, sizeof(v));
+}
+
+void snapshot_writer::write_u64(uint64_t v)
+{
+    write_bytes(&v, sizeof(v));
+}
+
+void snapshot_writer::write_f64(double v)
+{
+    write_bytes(&v, sizeof(v));
+}
+
+void snapshot_writer::write_string(const char* p, size_t n)
+{
+    write_array(p, n);
+}
+
+void snapshot_writer::write_string(const pstring& s)
+{
+    write_array(s.get(), s.size());
+}
+
+void snapshot_writer::write_string(const std::string& s)
+{
+    write_array(s.data(), s.size());
+}
+
+void snapshot_writer::write_to(std::ostream& os) const
+{
+    snapshot_header header;
+    std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+    header.version = snapshot_version;
+    header.byte_order = snapshot_byte_order;
+    header.section_count = static_cast<uint32_t>(m_sections.size());
+    header.reserved = 0;
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Both the header and the directory entries are multiples of 8 bytes,
+    // which keeps the section bodies aligned.
+    uint64_t body_offset = sizeof(header) + m_sections.size() * sizeof(snapshot_dir_entry);
+
+    std::vector<section>::const_iterator it = m_sections.begin(), it_end = m_sections.end();
+    for (; it != it_end; ++it)
+    {
+        snapshot_dir_entry entry;
+        entry.id = static_cast<uint32_t>(it->id);
+        entry.reserved = 0;
+        entry.offset = body_offset + it->offset;
+        entry.size = it->size;
+        os.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    }
+
+    os.write(m_buf.data(), m_buf.size());
+}
+
+snapshot_reader::snapshot_reader(const char* p, size_t n) :
+    mp_begin(p), mp_end(p + n), mp_cur(p), mp_section_end(p)
+{
+    if (reinterpret_cast<uintptr_t>(p) % snapshot_alignment)
+        throw general_error("snapshot_reader: snapshot data is not aligned.");
+
+    snapshot_header header;
+    if (n < sizeof(header))
+        throw general_error("snapshot_reader: snapshot is too short.");
+
+    std::memcpy(&header, p, sizeof(header));
+    if (std::memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)))
+        throw general_error("snapshot_reader: not a document snapshot.");
+
+    if (header.version != snapshot_version)
+        throw general_error("snapshot_reader: unsupported snapshot version.");
+
+    if (header.byte_order != snapshot_byte_order)
+        throw general_error("snapshot_reader: snapshot was written with a different byte order.");
+
+    if (header.section_count > (n - sizeof(header)) / sizeof(snapshot_dir_entry))
+        throw general_error("snapshot_reader: section directory is truncated.");
+}
+
+bool snapshot_reader::seek_section(snapshot_section_t id)
+{
+    snapshot_header header;
+    std::memcpy(&header, mp_begin, sizeof(header));
+
+    const char* p = mp_begin + sizeof(header);
+    for (uint32_t i = 0; i < header.section_count; ++i, p += sizeof(snapshot_dir_entry))
+    {
+        snapshot_dir_entry entry;
+        std::memcpy(&entry, p, sizeof(entry));
+        if (entry.id != static_cast<uint32_t>(id))
+            continue;
+
+        size_t total = mp_end - mp_begin;
+        if (entry.offset > total || entry.size > total - entry.offset || entry.offset % snapshot_alignment)
+            throw general_error("snapshot_reader: section lies outside of the snapshot.");
+
+        mp_cur = mp_begin + entry.offset;
+        mp_section_end = mp_cur + entry.size;
+        return true;
+    }
+
+    return false;
+}
+
+void snapshot_reader::align()
+{
+    size_t n = padding_size(mp_cur - mp_begin);
+    if (n > static_cast<size_t>(mp_section_end - mp_cur))
+        n = mp_section_end - mp_cur;
+
+    mp_cur += n;
+}
+
+const char* snapshot_reader::read_bytes(size_t n)
+{
+    if (n > static_cast<size_t>(mp_section_end - mp_cur))
+        throw general_error("snapshot_reader: value extends past the end of section.");
+
+    const char* p = mp_cur;
+    mp_cur += n;
+    return p;
+}
+
+uint8_t snapshot_reader::read_u8()
+{
+    return static_cast<uint8_t>(*read_bytes(1));
+}
+
+uint32_t snapshot_reader::read_u32()
+{
+    uint32_t v;
+    std::memcpy(&v, read_bytes(sizeof(v)), sizeof(v));
+    return v;
+}
+
+int32_t snapshot_reader::read_i32()
+{
+    int32_t v;
+    std::memcpy(&v, read_bytes(sizeof(v)), sizeof(v));
+    return v;
+}
+
+uint64_t snapshot_reader::read_u64()
+{
+    uint64_t v;
+    std::memcpy(&v, read_bytes(sizeof(v)), sizeof(v));
+    return v;
+}
+
+double snapshot_reader::read_f64()
+{
+    double v;
+    std::memcpy(&v, read_bytes(sizeof(v)), sizeof(v));
+    return v;
+}
+
+pstring snapshot_reader::read_string()
+{
+    size_t n = 0;
+    const char* p = read_array<char>(n);
+    return pstring(p, n);
+}
+
+}}
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
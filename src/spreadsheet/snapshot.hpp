@@ -0,0 +1,158 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef ORCUS_SPREADSHEET_SNAPSHOT_HPP
+#define ORCUS_SPREADSHEET_SNAPSHOT_HPP
+
+#include "orcus/pstring.hpp"
+#include "orcus/exception.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace orcus { namespace spreadsheet {
+
+/**
+ * Sections stored in a document snapshot.
+ */
+enum class snapshot_section_t : uint32_t
+{
+    document = 1,
+    strings  = 2,
+    styles   = 3,
+    sheets   = 4,
+    tables   = 5,
+    auto_filters = 6
+};
+
+/**
+ * Builds a document snapshot in memory.
+ *
+ * A snapshot consists of a fixed-size header, a directory of sections,
+ * and the section bodies.  Values are stored in the native byte order,
+ * which is recorded in the header, and every array starts at an 8-byte
+ * boundary so that the reader can use it in place without copying.
+ */
+class snapshot_writer
+{
+    struct section
+    {
+        snapshot_section_t id;
+        uint64_t offset; /// offset of the body from the start of m_buf.
+        uint64_t size;
+    };
+
+    std::string m_buf;
+    std::vector<section> m_sections;
+
+    void align();
+    void write_bytes(const void* p, size_t n);
+
+public:
+    snapshot_writer();
+
+    void begin_section(snapshot_section_t id);
+    void end_section();
+
+    void write_u8(uint8_t v);
+    void write_u32(uint32_t v);
+    void write_i32(int32_t v);
+    void write_u64(uint64_t v);
+    void write_f64(double v);
+    void write_string(const char* p, size_t n);
+    void write_string(const pstring& s);
+    void write_string(const std::string& s);
+
+    /**
+     * Write an array of fixed-width values, preceded by its element count.
+     */
+    template<typename _T>
+    void write_array(const _T* p, size_t n)
+    {
+        write_u64(n);
+        align();
+        write_bytes(p, n * sizeof(_T));
+    }
+
+    template<typename _T>
+    void write_array(const std::vector<_T>& v)
+    {
+        write_array(v.data(), v.size());
+    }
+
+    /**
+     * Write the header, the section directory and all section bodies.
+     */
+    void write_to(std::ostream& os) const;
+};
+
+/**
+ * Reads a document snapshot from a memory buffer.  Strings and arrays are
+ * returned as pointers into the buffer, which must therefore outlive all
+ * values obtained from the reader.  Reading past the end of the current
+ * section throws general_error.
+ */
+class snapshot_reader
+{
+    const char* mp_begin;
+    const char* mp_end;
+    const char* mp_cur;
+    const char* mp_section_end;
+
+    void align();
+    const char* read_bytes(size_t n);
+
+public:
+    /**
+     * @param p beginning of the snapshot data, which must be aligned to 8
+     *          bytes.
+     * @param n size of the snapshot data.
+     */
+    snapshot_reader(const char* p, size_t n);
+
+    /**
+     * Move to the beginning of a section.
+     *
+     * @return false if the snapshot doesn't contain the section.
+     */
+    bool seek_section(snapshot_section_t id);
+
+    uint8_t read_u8();
+    uint32_t read_u32();
+    int32_t read_i32();
+    uint64_t read_u64();
+    double read_f64();
+    pstring read_string();
+
+    /**
+     * Read an array written by snapshot_writer::write_array().
+     *
+     * @param n number of elements in the array.
+     *
+     * @return pointer to the first element within the buffer.
+     */
+    template<typename _T>
+    const _T* read_array(size_t& n)
+    {
+        uint64_t count = read_u64();
+        align();
+        if (count > static_cast<uint64_t>(mp_section_end - mp_cur) / sizeof(_T))
+            throw general_error("snapshot_reader: array extends past the end of section.");
+
+        n = static_cast<size_t>(count);
+        return reinterpret_cast<const _T*>(read_bytes(n * sizeof(_T)));
+    }
+};
+
+}}
+
+#endif
+
+/* vim:set shiftwidth=4 softtabstop=4 expandtab: */
@@ -8,8 +8,13 @@
 #include "orcus/spreadsheet/styles.hpp"
 #include "orcus/string_pool.hpp"
 
+#include "memory_global.hpp"
+#include "snapshot.hpp"
+
 #include <algorithm>
 #include <cassert>
+#include <functional>
+#include <unordered_map>
 
 namespace orcus { namespace spreadsheet {
 
@@ -49,7 +54,8 @@ void fill_t::reset()
     *this = fill_t();
 }
 
-border_attrs_t::border_attrs_t()
+border_attrs_t::border_attrs_t() :
+    style(border_style_t::unknown)
 {
 }
 
@@ -121,6 +127,17 @@ void cell_style_t::reset()
     *this = cell_style_t();
 }
 
+styles_remap_t::styles_remap_t() :
+    records_before(0), records_after(0), bytes_saved(0) {}
+
+double styles_remap_t::dedup_ratio() const
+{
+    if (!records_after)
+        return 1.0;
+
+    return double(records_before) / double(records_after);
+}
+
 import_styles::import_styles(string_pool& sp) : m_string_pool(sp) {}
 
 import_styles::~import_styles()
@@ -528,5 +545,471 @@ size_t import_styles::get_cell_styles_count() const
     return m_cell_styles.size();
 }
 
+namespace {
+
+void hash_combine(size_t& seed, size_t v)
+{
+    seed ^= v + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+size_t hash_color(const color_t& v)
+{
+    size_t n = v.alpha;
+    n = (n << 8) | v.red;
+    n = (n << 8) | v.green;
+    n = (n << 8) | v.blue;
+    return n;
+}
+
+bool equal_color(const color_t& l, const color_t& r)
+{
+    return l.alpha == r.alpha && l.red == r.red && l.green == r.green && l.blue == r.blue;
+}
+
+size_t hash_border_attrs(const border_attrs_t& v)
+{
+    size_t n = static_cast<size_t>(v.style);
+    hash_combine(n, hash_color(v.border_color));
+    return n;
+}
+
+bool equal_border_attrs(const border_attrs_t& l, const border_attrs_t& r)
+{
+    return l.style == r.style && equal_color(l.border_color, r.border_color);
+}
+
+/**
+ * Hash and equality functions for each style record type.  They operate
+ * on pointers so that the records can be looked up in place without
+ * being copied into the hash table.
+ */
+struct font_traits
+{
+    size_t operator() (const font_t* p) const
+    {
+        size_t n = pstring::hash()(p->name);
+        hash_combine(n, std::hash<double>()(p->size));
+        hash_combine(n, (p->bold ? 2 : 0) | (p->italic ? 1 : 0));
+        hash_combine(n, static_cast<size_t>(p->underline));
+        hash_combine(n, hash_color(p->color));
+        return n;
+    }
+
+    bool operator() (const font_t* l, const font_t* r) const
+    {
+        return l->name == r->name && l->size == r->size &&
+            l->bold == r->bold && l->italic == r->italic &&
+            l->underline == r->underline && equal_color(l->color, r->color);
+    }
+};
+
+struct fill_traits
+{
+    size_t operator() (const fill_t* p) const
+    {
+        size_t n = pstring::hash()(p->pattern_type);
+        hash_combine(n, hash_color(p->fg_color));
+        hash_combine(n, hash_color(p->bg_color));
+        return n;
+    }
+
+    bool operator() (const fill_t* l, const fill_t* r) const
+    {
+        return l->pattern_type == r->pattern_type &&
+            equal_color(l->fg_color, r->fg_color) && equal_color(l->bg_color, r->bg_color);
+    }
+};
+
+struct border_traits
+{
+    size_t operator() (const border_t* p) const
+    {
+        size_t n = hash_border_attrs(p->top);
+        hash_combine(n, hash_border_attrs(p->bottom));
+        hash_combine(n, hash_border_attrs(p->left));
+        hash_combine(n, hash_border_attrs(p->right));
+        hash_combine(n, hash_border_attrs(p->diagonal));
+        return n;
+    }
+
+    bool operator() (const border_t* l, const border_t* r) const
+    {
+        return equal_border_attrs(l->top, r->top) &&
+            equal_border_attrs(l->bottom, r->bottom) &&
+            equal_border_attrs(l->left, r->left) &&
+            equal_border_attrs(l->right, r->right) &&
+            equal_border_attrs(l->diagonal, r->diagonal);
+    }
+};
+
+struct protection_traits
+{
+    size_t operator() (const protection_t* p) const
+    {
+        return (p->locked ? 2 : 0) | (p->hidden ? 1 : 0);
+    }
+
+    bool operator() (const protection_t* l, const protection_t* r) const
+    {
+        return l->locked == r->locked && l->hidden == r->hidden;
+    }
+};
+
+struct cell_format_traits
+{
+    size_t operator() (const cell_format_t* p) const
+    {
+        size_t n = p->font;
+        hash_combine(n, p->fill);
+        hash_combine(n, p->border);
+        hash_combine(n, p->protection);
+        hash_combine(n, p->number_format);
+        hash_combine(n, p->style_xf);
+        hash_combine(n, static_cast<size_t>(p->hor_align));
+        hash_combine(n, static_cast<size_t>(p->ver_align));
+
+        size_t flags = 0;
+        flags = (flags << 1) | (p->apply_num_format ? 1 : 0);
+        flags = (flags << 1) | (p->apply_font ? 1 : 0);
+        flags = (flags << 1) | (p->apply_fill ? 1 : 0);
+        flags = (flags << 1) | (p->apply_border ? 1 : 0);
+        flags = (flags << 1) | (p->apply_alignment ? 1 : 0);
+        hash_combine(n, flags);
+        return n;
+    }
+
+    bool operator() (const cell_format_t* l, const cell_format_t* r) const
+    {
+        return l->font == r->font && l->fill == r->fill && l->border == r->border &&
+            l->protection == r->protection && l->number_format == r->number_format &&
+            l->style_xf == r->style_xf &&
+            l->hor_align == r->hor_align && l->ver_align == r->ver_align &&
+            l->apply_num_format == r->apply_num_format &&
+            l->apply_font == r->apply_font &&
+            l->apply_fill == r->apply_fill &&
+            l->apply_border == r->apply_border &&
+            l->apply_alignment == r->apply_alignment;
+    }
+};
+
+/**
+ * Remove duplicate records from the store while keeping the first
+ * occurrence of each record in its original relative order.
+ */
+template<typename _RecT, typename _TraitsT>
+void dedup_records(std::vector<_RecT>& store, styles_remap_t::index_map_type& index_map, styles_remap_t& stats)
+{
+    typedef std::unordered_map<const _RecT*, size_t, _TraitsT, _TraitsT> map_type;
+
+    size_t bytes_before = store.capacity() * sizeof(_RecT);
+
+    map_type map;
+    map.reserve(store.size());
+    index_map.clear();
+    index_map.reserve(store.size());
+
+    std::vector<_RecT> uniques;
+    typename std::vector<_RecT>::const_iterator it = store.begin(), it_end = store.end();
+    for (; it != it_end; ++it)
+    {
+        std::pair<typename map_type::iterator, bool> r =
+            map.insert(typename map_type::value_type(&*it, uniques.size()));
+
+        if (r.second)
+            uniques.push_back(*it);
+
+        index_map.push_back(r.first->second);
+    }
+
+    uniques.shrink_to_fit();
+
+    stats.records_before += store.size();
+    stats.records_after += uniques.size();
+    stats.bytes_saved += bytes_before - uniques.capacity() * sizeof(_RecT);
+
+    store.swap(uniques);
+}
+
+void remap_index(size_t& index, const styles_remap_t::index_map_type& index_map)
+{
+    // Leave out-of-range indices alone.  They don't point to any record.
+    if (index < index_map.size())
+        index = index_map[index];
+}
+
+void remap_cell_format(cell_format_t& fmt, const styles_remap_t& remap)
+{
+    remap_index(fmt.font, remap.fonts);
+    remap_index(fmt.fill, remap.fills);
+    remap_index(fmt.border, remap.borders);
+    remap_index(fmt.protection, remap.protections);
+}
+
+}
+
+styles_remap_t import_styles::deduplicate()
+{
+    styles_remap_t ret;
+
+    dedup_records<font_t, font_traits>(m_fonts, ret.fonts, ret);
+    dedup_records<fill_t, fill_traits>(m_fills, ret.fills, ret);
+    dedup_records<border_t, border_traits>(m_borders, ret.borders, ret);
+    dedup_records<protection_t, protection_traits>(m_protections, ret.protections, ret);
+
+    // Cell formats must reference the surviving records before they can be
+    // compared with each other.
+    for (size_t i = 0, n = m_cell_formats.size(); i < n; ++i)
+        remap_cell_format(m_cell_formats[i], ret);
+    for (size_t i = 0, n = m_cell_style_formats.size(); i < n; ++i)
+        remap_cell_format(m_cell_style_formats[i], ret);
+    for (size_t i = 0, n = m_dxf_formats.size(); i < n; ++i)
+        remap_cell_format(m_dxf_formats[i], ret);
+
+    dedup_records<cell_format_t, cell_format_traits>(m_cell_formats, ret.cell_formats, ret);
+
+    return ret;
+}
+
+namespace {
+
+pstring read_interned_string(snapshot_reader& reader, string_pool& sp)
+{
+    pstring s = reader.read_string();
+    return s.empty() ? pstring() : sp.intern(s).first;
+}
+
+void write_record(snapshot_writer& writer, const color_t& v)
+{
+    writer.write_u8(v.alpha);
+    writer.write_u8(v.red);
+    writer.write_u8(v.green);
+    writer.write_u8(v.blue);
+}
+
+void read_record(snapshot_reader& reader, string_pool&, color_t& v)
+{
+    v.alpha = reader.read_u8();
+    v.red = reader.read_u8();
+    v.green = reader.read_u8();
+    v.blue = reader.read_u8();
+}
+
+void write_record(snapshot_writer& writer, const font_t& v)
+{
+    writer.write_string(v.name);
+    writer.write_f64(v.size);
+    writer.write_u8(v.bold);
+    writer.write_u8(v.italic);
+    writer.write_u32(static_cast<uint32_t>(v.underline));
+    write_record(writer, v.color);
+}
+
+void read_record(snapshot_reader& reader, string_pool& sp, font_t& v)
+{
+    v.name = read_interned_string(reader, sp);
+    v.size = reader.read_f64();
+    v.bold = reader.read_u8() != 0;
+    v.italic = reader.read_u8() != 0;
+    v.underline = static_cast<underline_t>(reader.read_u32());
+    read_record(reader, sp, v.color);
+}
+
+void write_record(snapshot_writer& writer, const fill_t& v)
+{
+    writer.write_string(v.pattern_type);
+    write_record(writer, v.fg_color);
+    write_record(writer, v.bg_color);
+}
+
+void read_record(snapshot_reader& reader, string_pool& sp, fill_t& v)
+{
+    v.pattern_type = read_interned_string(reader, sp);
+    read_record(reader, sp, v.fg_color);
+    read_record(reader, sp, v.bg_color);
+}
+
+void write_record(snapshot_writer& writer, const border_attrs_t& v)
+{
+    writer.write_u32(static_cast<uint32_t>(v.style));
+    write_record(writer, v.border_color);
+}
+
+void read_record(snapshot_reader& reader, string_pool& sp, border_attrs_t& v)
+{
+    v.style = static_cast<border_style_t>(reader.read_u32());
+    read_record(reader, sp, v.border_color);
+}
+
+void write_record(snapshot_writer& writer, const border_t& v)
+{
+    write_record(writer, v.top);
+    write_record(writer, v.bottom);
+    write_record(writer, v.left);
+    write_record(writer, v.right);
+    write_record(writer, v.diagonal);
+}
+
+void read_record(snapshot_reader& reader, string_pool& sp, border_t& v)
+{
+    read_record(reader, sp, v.top);
+    read_record(reader, sp, v.bottom);
+    read_record(reader, sp, v.left);
+    read_record(reader, sp, v.right);
+    read_record(reader, sp, v.diagonal);
+}
+
+void write_record(snapshot_writer& writer, const protection_t& v)
+{
+    writer.write_u8(v.locked);
+    writer.write_u8(v.hidden);
+}
+
+void read_record(snapshot_reader& reader, string_pool&, protection_t& v)
+{
+    v.locked = reader.read_u8() != 0;
+    v.hidden = reader.read_u8() != 0;
+}
+
+void write_record(snapshot_writer& writer, const number_format_t& v)
+{
+    writer.write_u64(v.identifier);
+    writer.write_string(v.format_string);
+}
+
+void read_record(snapshot_reader& reader, string_pool& sp, number_format_t& v)
+{
+    v.identifier = reader.read_u64();
+    v.format_string = read_interned_string(reader, sp);
+}
+
+void write_record(snapshot_writer& writer, const cell_format_t& v)
+{
+    writer.write_u64(v.font);
+    writer.write_u64(v.fill);
+    writer.write_u64(v.border);
+    writer.write_u64(v.protection);
+    writer.write_u64(v.number_format);
+    writer.write_u64(v.style_xf);
+    writer.write_u32(static_cast<uint32_t>(v.hor_align));
+    writer.write_u32(static_cast<uint32_t>(v.ver_align));
+    writer.write_u8(v.apply_num_format);
+    writer.write_u8(v.apply_font);
+    writer.write_u8(v.apply_fill);
+    writer.write_u8(v.apply_border);
+    writer.write_u8(v.apply_alignment);
+}
+
+void read_record(snapshot_reader& reader, string_pool&, cell_format_t& v)
+{
+    v.font = reader.read_u64();
+    v.fill = reader.read_u64();
+    v.border = reader.read_u64();
+    v.protection = reader.read_u64();
+    v.number_format = reader.read_u64();
+    v.style_xf = reader.read_u64();
+    v.hor_align = static_cast<hor_alignment_t>(reader.read_u32());
+    v.ver_align = static_cast<ver_alignment_t>(reader.read_u32());
+    v.apply_num_format = reader.read_u8() != 0;
+    v.apply_font = reader.read_u8() != 0;
+    v.apply_fill = reader.read_u8() != 0;
+    v.apply_border = reader.read_u8() != 0;
+    v.apply_alignment = reader.read_u8() != 0;
+}
+
+void write_record(snapshot_writer& writer, const cell_style_t& v)
+{
+    writer.write_string(v.name);
+    writer.write_u64(v.xf);
+    writer.write_u64(v.builtin);
+    writer.write_string(v.parent_name);
+}
+
+void read_record(snapshot_reader& reader, string_pool& sp, cell_style_t& v)
+{
+    v.name = read_interned_string(reader, sp);
+    v.xf = reader.read_u64();
+    v.builtin = reader.read_u64();
+    v.parent_name = read_interned_string(reader, sp);
+}
+
+template<typename _RecT>
+void write_records(snapshot_writer& writer, const std::vector<_RecT>& store)
+{
+    writer.write_u64(store.size());
+    typename std::vector<_RecT>::const_iterator it = store.begin(), it_end = store.end();
+    for (; it != it_end; ++it)
+        write_record(writer, *it);
+}
+
+template<typename _RecT>
+void read_records(snapshot_reader& reader, string_pool& sp, std::vector<_RecT>& store)
+{
+    store.clear();
+    for (uint64_t i = 0, n = reader.read_u64(); i < n; ++i)
+    {
+        _RecT rec;
+        read_record(reader, sp, rec);
+        store.push_back(rec);
+    }
+}
+
+}
+
+size_t import_styles::compact()
+{
+    size_t bytes = 0;
+    bytes += shrink_vector(m_fonts);
+    bytes += shrink_vector(m_fills);
+    bytes += shrink_vector(m_borders);
+    bytes += shrink_vector(m_protections);
+    bytes += shrink_vector(m_number_formats);
+    bytes += shrink_vector(m_cell_style_formats);
+    bytes += shrink_vector(m_cell_formats);
+    bytes += shrink_vector(m_dxf_formats);
+    bytes += shrink_vector(m_cell_styles);
+    return bytes;
+}
+
+size_t import_styles::get_memory_usage() const
+{
+    size_t bytes = 0;
+    bytes += get_vector_bytes(m_fonts);
+    bytes += get_vector_bytes(m_fills);
+    bytes += get_vector_bytes(m_borders);
+    bytes += get_vector_bytes(m_protections);
+    bytes += get_vector_bytes(m_number_formats);
+    bytes += get_vector_bytes(m_cell_style_formats);
+    bytes += get_vector_bytes(m_cell_formats);
+    bytes += get_vector_bytes(m_dxf_formats);
+    bytes += get_vector_bytes(m_cell_styles);
+    return bytes;
+}
+
+void import_styles::write_snapshot(snapshot_writer& writer) const
+{
+    write_records(writer, m_fonts);
+    write_records(writer, m_fills);
+    write_records(writer, m_borders);
+    write_records(writer, m_protections);
+    write_records(writer, m_number_formats);
+    write_records(writer, m_cell_style_formats);
+    write_records(writer, m_cell_formats);
+    write_records(writer, m_dxf_formats);
+    write_records(writer, m_cell_styles);
+}
+
+void import_styles::read_snapshot(snapshot_reader& reader)
+{
+    read_records(reader, m_string_pool, m_fonts);
+    read_records(reader, m_string_pool, m_fills);
+    read_records(reader, m_string_pool, m_borders);
+    read_records(reader, m_string_pool, m_protections);
+    read_records(reader, m_string_pool, m_number_formats);
+    read_records(reader, m_string_pool, m_cell_style_formats);
+    read_records(reader, m_string_pool, m_cell_formats);
+    read_records(reader, m_string_pool, m_dxf_formats);
+    read_records(reader, m_string_pool, m_cell_styles);
+}
+
 }}
 /* vim:set shiftwidth=4 softtabstop=4 expandtab: */
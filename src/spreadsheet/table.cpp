@@ -149,7 +149,7 @@ void table::set_totals_row_count(size_t row_count)
 
 void table::set_column_count(size_t n)
 {
-    mp_impl->mp_data->columns.reserve(n);
+    mp_impl->mp_data->reserve_columns(n);
 }
 
 void table::set_column_identifier(size_t id)
@@ -176,7 +176,7 @@ void table::set_column_totals_row_function(orcus::spreadsheet::totals_row_functi
 
 void table::commit_column()
 {
-    mp_impl->mp_data->columns.push_back(mp_impl->m_column);
+    mp_impl->mp_data->append_column(mp_impl->m_column);
     mp_impl->m_column.reset();
 }
 
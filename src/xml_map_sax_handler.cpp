@@ -137,12 +137,12 @@ void xml_map_sax_handler::attribute(const sax::parser_attribute& attr)
 
 void read_map_file(orcus_xml& app, const char* filepath)
 {
-    string strm = load_file_content(filepath);
+    file_content strm(filepath);
     if (strm.empty())
         return;
 
     xml_map_sax_handler handler(app);
-    sax_parser<xml_map_sax_handler> parser(strm.c_str(), strm.size(), handler);
+    sax_parser<xml_map_sax_handler> parser(strm.data(), strm.size(), handler);
     parser.parse();
 }
 